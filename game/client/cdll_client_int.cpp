@@ -124,6 +124,7 @@
 #include "sourcevr/isourcevirtualreality.h"
 #include "client_virtualreality.h"
 #include "mumble.h"
+#include "bone_setup.h"
 
 // NVNT includes
 #include "hud_macros.h"
@@ -1699,6 +1700,9 @@ void CHLClient::LevelShutdown( void )
 	// Now release/delete the entities
 	cl_entitylist->Release();
 
+	// Models and their animation blocks can be unloaded after this
+	Studio_InvalidateKeyframeCache();
+
 	C_BaseEntityClassList *pClassList = s_pClassLists;
 	while ( pClassList )
 	{
@@ -89,6 +89,7 @@
 #include "tier3/tier3.h"
 #include "serverbenchmark_base.h"
 #include "querycache.h"
+#include "bone_setup.h"
 
 
 #ifdef TF_DLL
@@ -1386,6 +1387,9 @@ void CServerGameDLL::LevelShutdown( void )
 
 	InvalidateQueryCache();
 
+	// Models and their animation blocks can be unloaded after this
+	Studio_InvalidateKeyframeCache();
+
 	IGameSystem::LevelShutdownPostEntityAllSystems();
 
 	// In case we quit out during initial load
@@ -33,6 +33,14 @@
 
 #include "mathlib/ssemath.h"
 #include "mathlib/ssequaternion.h"
+#include "mathlib/ssewide.h"
+
+#if defined( _WIN32 ) && !defined( _X360 )
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined( GNUC ) && ( defined( __i386__ ) || defined( __x86_64__ ) )
+#include <cpuid.h>
+#endif
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -1946,6 +1954,414 @@ void QuaternionMatrix( const Quaternion &q, matrix3x4_t& matrix )
 }
 
 
+//-----------------------------------------------------------------------------
+// Array versions of VectorTransform, ConcatTransforms, QuaternionMatrix and
+// AngleMatrix. The kernels are written for any lane count (see ssewide.h) and
+// work on LANES items at a time, held one member per register; leftovers go
+// through the single item versions.
+//-----------------------------------------------------------------------------
+
+// Builds with AVX enabled go 8 wide, everything else 4
+#if SIMD_NATIVE_FLTX8
+#define TRANSFORM_ARRAY_LANES	8
+#else
+#define TRANSFORM_ARRAY_LANES	4
+#endif
+
+COMPILE_TIME_ASSERT( sizeof( Vector ) == 3 * sizeof( float ) );
+COMPILE_TIME_ASSERT( sizeof( QAngle ) == 3 * sizeof( float ) );
+COMPILE_TIME_ASSERT( sizeof( Quaternion ) == 4 * sizeof( float ) );
+COMPILE_TIME_ASSERT( sizeof( matrix3x4_t ) == 12 * sizeof( float ) );
+
+// Loads four floats from each of LANES items nStride floats apart, transposed
+// so that pOut[j] holds float j of every item
+template < int LANES >
+static FORCEINLINE void LoadTransposed4( const float *pBase, int nStride, typename SIMDLanes< LANES >::fltx *pOut )
+{
+	fltx4 parts[4][LANES / 4];
+	for ( int k = 0; k < LANES / 4; k++ )
+	{
+		const float *p = pBase + 4 * k * nStride;
+		fltx4 a = LoadUnalignedSIMD( p );
+		fltx4 b = LoadUnalignedSIMD( p + nStride );
+		fltx4 c = LoadUnalignedSIMD( p + 2 * nStride );
+		fltx4 d = LoadUnalignedSIMD( p + 3 * nStride );
+		TransposeSIMD( a, b, c, d );
+		parts[0][k] = a;
+		parts[1][k] = b;
+		parts[2][k] = c;
+		parts[3][k] = d;
+	}
+
+	for ( int j = 0; j < 4; j++ )
+	{
+		pOut[j] = SIMDLanes< LANES >::FromFltx4( parts[j] );
+	}
+}
+
+// Same for items of three floats, fills pOut[0..2]. Every fourth item is
+// loaded along with the float in front of it, so this never reads past the
+// end of the array.
+template < int LANES >
+static FORCEINLINE void LoadTransposed3( const float *pBase, int nStride, typename SIMDLanes< LANES >::fltx *pOut )
+{
+	fltx4 parts[3][LANES / 4];
+	for ( int k = 0; k < LANES / 4; k++ )
+	{
+		const float *p = pBase + 4 * k * nStride;
+		fltx4 a = LoadUnalignedSIMD( p );
+		fltx4 b = LoadUnalignedSIMD( p + nStride );
+		fltx4 c = LoadUnalignedSIMD( p + 2 * nStride );
+		fltx4 d = RotateLeft( LoadUnalignedSIMD( p + 3 * nStride - 1 ) );
+		TransposeSIMD( a, b, c, d );
+		parts[0][k] = a;
+		parts[1][k] = b;
+		parts[2][k] = c;
+	}
+
+	for ( int j = 0; j < 3; j++ )
+	{
+		pOut[j] = SIMDLanes< LANES >::FromFltx4( parts[j] );
+	}
+}
+
+// The reverse of LoadTransposed4
+template < int LANES >
+static FORCEINLINE void StoreTransposed4( float *pBase, int nStride, const typename SIMDLanes< LANES >::fltx *pIn )
+{
+	fltx4 parts[4][LANES / 4];
+	for ( int j = 0; j < 4; j++ )
+	{
+		SIMDLanes< LANES >::ToFltx4( pIn[j], parts[j] );
+	}
+
+	for ( int k = 0; k < LANES / 4; k++ )
+	{
+		float *p = pBase + 4 * k * nStride;
+		fltx4 a = parts[0][k];
+		fltx4 b = parts[1][k];
+		fltx4 c = parts[2][k];
+		fltx4 d = parts[3][k];
+		TransposeSIMD( a, b, c, d );
+		StoreUnalignedSIMD( p, a );
+		StoreUnalignedSIMD( p + nStride, b );
+		StoreUnalignedSIMD( p + 2 * nStride, c );
+		StoreUnalignedSIMD( p + 3 * nStride, d );
+	}
+}
+
+// The reverse of LoadTransposed3. The first three items of every four are
+// stored four floats wide, running into the next item, which is written
+// after them; nothing outside the LANES items is touched.
+template < int LANES >
+static FORCEINLINE void StoreTransposed3( float *pBase, int nStride, const typename SIMDLanes< LANES >::fltx *pIn )
+{
+	fltx4 parts[3][LANES / 4];
+	for ( int j = 0; j < 3; j++ )
+	{
+		SIMDLanes< LANES >::ToFltx4( pIn[j], parts[j] );
+	}
+
+	for ( int k = 0; k < LANES / 4; k++ )
+	{
+		float *p = pBase + 4 * k * nStride;
+		fltx4 a = parts[0][k];
+		fltx4 b = parts[1][k];
+		fltx4 c = parts[2][k];
+		fltx4 d = LoadZeroSIMD();
+		TransposeSIMD( a, b, c, d );
+		StoreUnalignedSIMD( p, a );
+		StoreUnalignedSIMD( p + nStride, b );
+		StoreUnalignedSIMD( p + 2 * nStride, c );
+		StoreUnaligned3SIMD( p + 3 * nStride, d );
+	}
+}
+
+// sin and cos of angles in degrees. Reduces to +-45 degrees around a multiple
+// of 90 and uses the Cephes single precision polynomials, which are good to
+// a couple of ulps there.
+template < int LANES >
+static FORCEINLINE void SinCosDegreesSIMD( const typename SIMDTraits< LANES >::fltx &degrees, typename SIMDTraits< LANES >::fltx &sine, typename SIMDTraits< LANES >::fltx &cosine )
+{
+	typedef SIMDTraits< LANES > Traits;
+	typedef typename Traits::fltx FLTX;
+	FLTX one = Traits::One();
+	FLTX two = Traits::Replicate( 2.0f );
+	FLTX signMask = Traits::Replicate( -0.0f );
+
+	// Nearest multiple of 90, adding and removing 1.5 * 2^23 rounds to an integer
+	FLTX absDegrees = AndNotSIMD( signMask, degrees );
+	FLTX roundBias = Traits::Replicate( 12582912.0f );
+	FLTX quadrants = SubSIMD( AddSIMD( MulSIMD( absDegrees, Traits::Replicate( 1.0f / 90.0f ) ), roundBias ), roundBias );
+	FLTX r = MulSIMD( SubSIMD( absDegrees, MulSIMD( quadrants, Traits::Replicate( 90.0f ) ) ), Traits::Replicate( M_PI_F / 180.0f ) );
+
+	// quadrants mod 4. Only positive numbers go through FloorSIMD, which rounds negative ones toward zero.
+	FLTX quadrant = SubSIMD( quadrants, MulSIMD( FloorSIMD( MulSIMD( quadrants, Traits::Replicate( 0.25f ) ) ), Traits::Replicate( 4.0f ) ) );
+
+	FLTX r2 = MulSIMD( r, r );
+	FLTX s = MaddSIMD( r2, Traits::Replicate( -1.9515295891e-4f ), Traits::Replicate( 8.3321608736e-3f ) );
+	s = MaddSIMD( s, r2, Traits::Replicate( -1.6666654611e-1f ) );
+	s = MaddSIMD( MulSIMD( s, r2 ), r, r );
+	FLTX c = MaddSIMD( r2, Traits::Replicate( 2.443315711809948e-5f ), Traits::Replicate( -1.388731625493765e-3f ) );
+	c = MaddSIMD( c, r2, Traits::Replicate( 4.166664568298827e-2f ) );
+	c = MaddSIMD( MulSIMD( c, r2 ), r2, MsubSIMD( r2, Traits::Replicate( 0.5f ), one ) );
+
+	// sin and cos trade places in odd quadrants; sin is negative in 2 and 3, cos in 1 and 2
+	FLTX odd = OrSIMD( CmpEqSIMD( quadrant, one ), CmpEqSIMD( quadrant, Traits::Replicate( 3.0f ) ) );
+	FLTX sinNegative = CmpGeSIMD( quadrant, two );
+	FLTX cosNegative = AndSIMD( CmpGeSIMD( quadrant, one ), CmpLeSIMD( quadrant, two ) );
+	FLTX sinAbs = MaskedAssign( odd, c, s );
+	FLTX cosAbs = MaskedAssign( odd, s, c );
+
+	// sin(-x) = -sin(x)
+	sine = XorSIMD( sinAbs, AndSIMD( signMask, XorSIMD( sinNegative, degrees ) ) );
+	cosine = XorSIMD( cosAbs, AndSIMD( signMask, cosNegative ) );
+}
+
+// Each kernel does as many whole groups of LANES as fit in nCount and
+// returns how many items that was
+template < int LANES >
+static int VectorTransformArray_SIMD( const Vector *pIn, const matrix3x4_t &matrix, Vector *pOut, int nCount )
+{
+	typedef SIMDLanes< LANES > Lanes;
+	typedef typename Lanes::fltx fltx;
+
+	fltx m[3][4];
+	for ( int r = 0; r < 3; r++ )
+	{
+		for ( int c = 0; c < 4; c++ )
+		{
+			m[r][c] = Lanes::Replicate( matrix[r][c] );
+		}
+	}
+
+	int nDone = nCount - ( nCount % LANES );
+	for ( int i = 0; i < nDone; i += LANES )
+	{
+		fltx v[3];
+		LoadTransposed3< LANES >( pIn[i].Base(), 3, v );
+
+		fltx out[3];
+		for ( int r = 0; r < 3; r++ )
+		{
+			out[r] = MaddSIMD( v[2], m[r][2], MaddSIMD( v[1], m[r][1], MaddSIMD( v[0], m[r][0], m[r][3] ) ) );
+		}
+
+		StoreTransposed3< LANES >( pOut[i].Base(), 3, out );
+	}
+	return nDone;
+}
+
+template < int LANES >
+static int QuaternionMatrixArray_SIMD( const Quaternion *pQ, const Vector *pPos, matrix3x4_t *pOut, int nCount )
+{
+	typedef SIMDLanes< LANES > Lanes;
+	typedef typename Lanes::fltx fltx;
+
+	fltx one = Lanes::One();
+	int nDone = nCount - ( nCount % LANES );
+	for ( int i = 0; i < nDone; i += LANES )
+	{
+		fltx q[4];
+		LoadTransposed4< LANES >( pQ[i].Base(), 4, q );
+
+		fltx pos[3];
+		if ( pPos )
+		{
+			LoadTransposed3< LANES >( pPos[i].Base(), 3, pos );
+		}
+		else
+		{
+			pos[0] = pos[1] = pos[2] = Lanes::Zero();
+		}
+
+		fltx x2 = AddSIMD( q[0], q[0] );
+		fltx y2 = AddSIMD( q[1], q[1] );
+		fltx z2 = AddSIMD( q[2], q[2] );
+		fltx xx = MulSIMD( q[0], x2 );
+		fltx xy = MulSIMD( q[0], y2 );
+		fltx xz = MulSIMD( q[0], z2 );
+		fltx yy = MulSIMD( q[1], y2 );
+		fltx yz = MulSIMD( q[1], z2 );
+		fltx zz = MulSIMD( q[2], z2 );
+		fltx wx = MulSIMD( q[3], x2 );
+		fltx wy = MulSIMD( q[3], y2 );
+		fltx wz = MulSIMD( q[3], z2 );
+
+		fltx row[4];
+		row[0] = SubSIMD( one, AddSIMD( yy, zz ) );
+		row[1] = SubSIMD( xy, wz );
+		row[2] = AddSIMD( xz, wy );
+		row[3] = pos[0];
+		StoreTransposed4< LANES >( pOut[i][0], 12, row );
+
+		row[0] = AddSIMD( xy, wz );
+		row[1] = SubSIMD( one, AddSIMD( xx, zz ) );
+		row[2] = SubSIMD( yz, wx );
+		row[3] = pos[1];
+		StoreTransposed4< LANES >( pOut[i][1], 12, row );
+
+		row[0] = SubSIMD( xz, wy );
+		row[1] = AddSIMD( yz, wx );
+		row[2] = SubSIMD( one, AddSIMD( xx, yy ) );
+		row[3] = pos[2];
+		StoreTransposed4< LANES >( pOut[i][2], 12, row );
+	}
+	return nDone;
+}
+
+template < int LANES >
+static int AngleMatrixArray_SIMD( const QAngle *pAngles, const Vector *pPos, matrix3x4_t *pOut, int nCount )
+{
+	typedef SIMDLanes< LANES > Lanes;
+	typedef typename Lanes::fltx fltx;
+
+	int nDone = nCount - ( nCount % LANES );
+	for ( int i = 0; i < nDone; i += LANES )
+	{
+		fltx angles[3];
+		LoadTransposed3< LANES >( pAngles[i].Base(), 3, angles );
+
+		fltx pos[3];
+		if ( pPos )
+		{
+			LoadTransposed3< LANES >( pPos[i].Base(), 3, pos );
+		}
+		else
+		{
+			pos[0] = pos[1] = pos[2] = Lanes::Zero();
+		}
+
+		fltx sp, cp, sy, cy, sr, cr;
+		SinCosDegreesSIMD< LANES >( angles[PITCH], sp, cp );
+		SinCosDegreesSIMD< LANES >( angles[YAW], sy, cy );
+		SinCosDegreesSIMD< LANES >( angles[ROLL], sr, cr );
+
+		// matrix = (YAW * PITCH) * ROLL
+		fltx crcy = MulSIMD( cr, cy );
+		fltx crsy = MulSIMD( cr, sy );
+		fltx srcy = MulSIMD( sr, cy );
+		fltx srsy = MulSIMD( sr, sy );
+
+		fltx row[4];
+		row[0] = MulSIMD( cp, cy );
+		row[1] = SubSIMD( MulSIMD( sp, srcy ), crsy );
+		row[2] = AddSIMD( MulSIMD( sp, crcy ), srsy );
+		row[3] = pos[0];
+		StoreTransposed4< LANES >( pOut[i][0], 12, row );
+
+		row[0] = MulSIMD( cp, sy );
+		row[1] = AddSIMD( MulSIMD( sp, srsy ), crcy );
+		row[2] = SubSIMD( MulSIMD( sp, crsy ), srcy );
+		row[3] = pos[1];
+		StoreTransposed4< LANES >( pOut[i][1], 12, row );
+
+		row[0] = NegSIMD( sp );
+		row[1] = MulSIMD( sr, cp );
+		row[2] = MulSIMD( cr, cp );
+		row[3] = pos[2];
+		StoreTransposed4< LANES >( pOut[i][2], 12, row );
+	}
+	return nDone;
+}
+
+void VectorTransformArray( const Vector *pIn, const matrix3x4_t &matrix, Vector *pOut, int nCount )
+{
+	Assert( s_bMathlibInitialized );
+
+	int i = VectorTransformArray_SIMD< TRANSFORM_ARRAY_LANES >( pIn, matrix, pOut, nCount );
+	i += VectorTransformArray_SIMD< 4 >( pIn + i, matrix, pOut + i, nCount - i );
+	for ( ; i < nCount; i++ )
+	{
+		Vector vecIn = pIn[i];
+		VectorTransform( vecIn, matrix, pOut[i] );
+	}
+}
+
+void ConcatTransformsArray( const matrix3x4_t *pIn1, const matrix3x4_t *pIn2, matrix3x4_t *pOut, int nCount )
+{
+	Assert( s_bMathlibInitialized );
+
+	// ConcatTransforms already keeps all four lanes busy with one matrix.
+	// With AVX the same thing is done for two at once, one per 128 bit half.
+	int i = 0;
+#if SIMD_NATIVE_FLTX8
+	typedef SIMDLanes< 8 > Lanes;
+	fltx4 lastMaskHalf = LoadAlignedSIMD( g_SIMD_ComponentMask[3] );
+	fltx4 lastMaskParts[2] = { lastMaskHalf, lastMaskHalf };
+	fltx8 lastMask = Lanes::FromFltx4( lastMaskParts );
+
+	for ( ; i + 2 <= nCount; i += 2 )
+	{
+		fltx8 rowA[3], rowB[3];
+		for ( int r = 0; r < 3; r++ )
+		{
+			fltx4 partsA[2] = { LoadUnalignedSIMD( pIn1[i][r] ), LoadUnalignedSIMD( pIn1[i+1][r] ) };
+			fltx4 partsB[2] = { LoadUnalignedSIMD( pIn2[i][r] ), LoadUnalignedSIMD( pIn2[i+1][r] ) };
+			rowA[r] = Lanes::FromFltx4( partsA );
+			rowB[r] = Lanes::FromFltx4( partsB );
+		}
+
+		for ( int r = 0; r < 3; r++ )
+		{
+			fltx8 out = AndSIMD( rowA[r], lastMask );
+			out = MaddSIMD( _mm256_permute_ps( rowA[r], 0x00 ), rowB[0], out );
+			out = MaddSIMD( _mm256_permute_ps( rowA[r], 0x55 ), rowB[1], out );
+			out = MaddSIMD( _mm256_permute_ps( rowA[r], 0xaa ), rowB[2], out );
+
+			fltx4 parts[2];
+			Lanes::ToFltx4( out, parts );
+			StoreUnalignedSIMD( pOut[i][r], parts[0] );
+			StoreUnalignedSIMD( pOut[i+1][r], parts[1] );
+		}
+	}
+#endif
+
+	for ( ; i < nCount; i++ )
+	{
+		ConcatTransforms( pIn1[i], pIn2[i], pOut[i] );
+	}
+}
+
+void QuaternionMatrixArray( const Quaternion *pQ, const Vector *pPos, matrix3x4_t *pOut, int nCount )
+{
+	Assert( s_bMathlibInitialized );
+
+	int i = QuaternionMatrixArray_SIMD< TRANSFORM_ARRAY_LANES >( pQ, pPos, pOut, nCount );
+	i += QuaternionMatrixArray_SIMD< 4 >( pQ + i, pPos ? pPos + i : NULL, pOut + i, nCount - i );
+	for ( ; i < nCount; i++ )
+	{
+		if ( pPos )
+		{
+			QuaternionMatrix( pQ[i], pPos[i], pOut[i] );
+		}
+		else
+		{
+			QuaternionMatrix( pQ[i], pOut[i] );
+		}
+	}
+}
+
+void AngleMatrixArray( const QAngle *pAngles, const Vector *pPos, matrix3x4_t *pOut, int nCount )
+{
+	Assert( s_bMathlibInitialized );
+
+	int i = AngleMatrixArray_SIMD< TRANSFORM_ARRAY_LANES >( pAngles, pPos, pOut, nCount );
+	i += AngleMatrixArray_SIMD< 4 >( pAngles + i, pPos ? pPos + i : NULL, pOut + i, nCount - i );
+	for ( ; i < nCount; i++ )
+	{
+		if ( pPos )
+		{
+			AngleMatrix( pAngles[i], pPos[i], pOut[i] );
+		}
+		else
+		{
+			AngleMatrix( pAngles[i], pOut[i] );
+		}
+	}
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: Converts a quaternion into engine angles
 // Input  : *quaternion - q3 + q0.i + q1.j + q2.k
@@ -3316,6 +3732,91 @@ static bool s_b3DNowEnabled = false;
 static bool s_bMMXEnabled = false;
 static bool s_bSSEEnabled = false;
 static bool s_bSSE2Enabled = false;
+static bool s_bAVXEnabled = false;
+static bool s_bAVX2Enabled = false;
+static bool s_bAVX512FEnabled = false;
+static int s_nSIMDLanes = 4;
+
+//-----------------------------------------------------------------------------
+// AVX detection. This lives here rather than in tier1's processor_detect so
+// mathlib doesn't have to link against tier1 for it.
+//-----------------------------------------------------------------------------
+#define MATHLIB_CPU_AVX			0x01
+#define MATHLIB_CPU_AVX2		0x02	// AVX2 with FMA3
+#define MATHLIB_CPU_AVX512F		0x04
+
+#if defined( _WIN32 ) && !defined( _X360 )
+
+static void MathLib_CPUID( int nLeaf, unsigned int *pRegs )
+{
+	__cpuidex( (int *)pRegs, nLeaf, 0 );
+}
+
+static unsigned int MathLib_OSSavedRegisterSets()
+{
+	return (unsigned int)_xgetbv( 0 );
+}
+
+#define MATHLIB_HAS_CPUID
+
+#elif defined( GNUC ) && ( defined( __i386__ ) || defined( __x86_64__ ) )
+
+static void MathLib_CPUID( int nLeaf, unsigned int *pRegs )
+{
+	__cpuid_count( nLeaf, 0, pRegs[0], pRegs[1], pRegs[2], pRegs[3] );
+}
+
+static unsigned int MathLib_OSSavedRegisterSets()
+{
+	// xgetbv is spelled out because older assemblers don't know it
+	unsigned int nEAX, nEDX;
+	__asm__ __volatile__ ( ".byte 0x0f, 0x01, 0xd0" : "=a" (nEAX), "=d" (nEDX) : "c" (0) );
+	return nEAX;
+}
+
+#define MATHLIB_HAS_CPUID
+
+#endif
+
+static int MathLib_GetAVXSupport()
+{
+#ifdef MATHLIB_HAS_CPUID
+	unsigned int nRegs[4];		// eax, ebx, ecx, edx
+	MathLib_CPUID( 0, nRegs );
+	unsigned int nMaxLeaf = nRegs[0];
+
+	// leaf 1 ecx bit 27 is set when the OS has enabled xgetbv, bit 28 is AVX
+	MathLib_CPUID( 1, nRegs );
+	unsigned int nFeaturesECX = nRegs[2];
+	if ( ( nFeaturesECX & 0x18000000 ) != 0x18000000 )
+		return 0;
+
+	// The OS has to save the xmm and ymm registers (XCR0 bits 1 and 2)
+	unsigned int nSavedRegisterSets = MathLib_OSSavedRegisterSets();
+	if ( ( nSavedRegisterSets & 0x06 ) != 0x06 )
+		return 0;
+
+	int nSupport = MATHLIB_CPU_AVX;
+	if ( nMaxLeaf < 7 )
+		return nSupport;
+
+	// leaf 7 ebx bit 5 is AVX2. We also insist on FMA3 (leaf 1 ecx bit 12), which every
+	// AVX2 part has, so code built for AVX2 can use fused multiply-adds.
+	MathLib_CPUID( 7, nRegs );
+	if ( !( nRegs[1] & 0x00000020 ) || !( nFeaturesECX & 0x00001000 ) )
+		return nSupport;
+	nSupport |= MATHLIB_CPU_AVX2;
+
+	// leaf 7 ebx bit 16 is AVX-512F; the OS also has to save the opmask and zmm registers (XCR0 bits 5-7)
+	if ( ( nRegs[1] & 0x00010000 ) && ( nSavedRegisterSets & 0xe6 ) == 0xe6 )
+	{
+		nSupport |= MATHLIB_CPU_AVX512F;
+	}
+	return nSupport;
+#else
+	return 0;
+#endif
+}
 
 void MathLib_Init( float gamma, float texGamma, float brightness, int overbright, bool bAllow3DNow, bool bAllowSSE, bool bAllowSSE2, bool bAllowMMX )
 {
@@ -3406,6 +3907,17 @@ void MathLib_Init( float gamma, float texGamma, float brightness, int overbright
 	{
 		s_bSSE2Enabled = false;
 	}
+
+	// The wide kernels assume everything narrower is there too
+	int nAVXSupport = s_bSSE2Enabled ? MathLib_GetAVXSupport() : 0;
+	s_bAVXEnabled = ( nAVXSupport & MATHLIB_CPU_AVX ) != 0;
+	s_bAVX2Enabled = ( nAVXSupport & MATHLIB_CPU_AVX2 ) != 0;
+	s_bAVX512FEnabled = ( nAVXSupport & MATHLIB_CPU_AVX512F ) != 0;
+
+	// 8 lane code is built for AVX2, plain AVX parts stay on 4 lanes. fltx16 is
+	// still a pair of fltx8s, so AVX-512 parts don't get 16 lanes until there's
+	// a native one.
+	s_nSIMDLanes = s_bAVX2Enabled ? 8 : 4;
 #endif // !_X360
 
 	s_bMathlibInitialized = true;
@@ -3438,6 +3950,30 @@ bool MathLib_SSE2Enabled( void )
 	return s_bSSE2Enabled;
 }
 
+bool MathLib_AVXEnabled( void )
+{
+	Assert( s_bMathlibInitialized );
+	return s_bAVXEnabled;
+}
+
+bool MathLib_AVX2Enabled( void )
+{
+	Assert( s_bMathlibInitialized );
+	return s_bAVX2Enabled;
+}
+
+bool MathLib_AVX512FEnabled( void )
+{
+	Assert( s_bMathlibInitialized );
+	return s_bAVX512FEnabled;
+}
+
+int MathLib_SIMDLanes( void )
+{
+	Assert( s_bMathlibInitialized );
+	return s_nSIMDLanes;
+}
+
 float Approach( float target, float value, float speed )
 {
 	float delta = target - value;
@@ -8,6 +8,7 @@
 
 #include "mathlib/polyhedron.h"
 #include "mathlib/vmatrix.h"
+#include "mathlib/ssemath.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include "tier1/utlvector.h"
@@ -25,9 +26,11 @@ struct GeneratePolyhedronFromPlanes_UnorderedPointLL;
 struct GeneratePolyhedronFromPlanes_UnorderedLineLL;
 struct GeneratePolyhedronFromPlanes_UnorderedPolygonLL;
 
+class CPolyhedronScratch;
+
 Vector FindPointInPlanes( const float *pPlanes, int planeCount );
 bool FindConvexShapeLooseAABB( const float *pInwardFacingPlanes, int iPlaneCount, Vector *pAABBMins, Vector *pAABBMaxs );
-CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory );
+CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory, CPolyhedronScratch &scratch );
 CPolyhedron *ConvertLinkedGeometryToPolyhedron( GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints, bool bUseTemporaryMemory );
 
 //#define ENABLE_DEBUG_POLYHEDRON_DUMPS //Dumps debug information to disk for use with glview. Requires that tier2 also be in all projects using debug mathlib
@@ -56,6 +59,55 @@ static int g_iPolyhedronDumpCounter = 0;
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
 
+
+
+//scratch memory for building and cutting polyhedra, all thrown away at once when this goes out of scope. The first block lives in the scratch itself, so it's on the calling thread's stack, anything that doesn't fit in it comes from heap blocks freed with the scratch
+#define POLYHEDRON_SCRATCH_ALIGNMENT 16
+#define POLYHEDRON_SCRATCH_STACK_SIZE ( 8 * 1024 )
+#define POLYHEDRON_SCRATCH_HEAP_SIZE ( 64 * 1024 )
+
+class CPolyhedronScratch
+{
+public:
+	CPolyhedronScratch( void ) : m_pBlock( m_StackBlock ), m_iBlockSize( sizeof( m_StackBlock ) ), m_iBlockUsed( 0 )
+	{
+	}
+
+	~CPolyhedronScratch( void )
+	{
+		for( int i = 0; i != m_HeapBlocks.Count(); ++i )
+			MemAlloc_FreeAligned( m_HeapBlocks[i] );
+	}
+
+	template< typename T > T *Alloc( int iCount )
+	{
+		COMPILE_TIME_ASSERT( __alignof( T ) <= POLYHEDRON_SCRATCH_ALIGNMENT );
+
+		size_t iBytes = AlignValue( iCount * sizeof( T ), POLYHEDRON_SCRATCH_ALIGNMENT );
+		if( m_iBlockUsed + iBytes > m_iBlockSize )
+			NewHeapBlock( iBytes );
+
+		T *pResult = (T *)(m_pBlock + m_iBlockUsed);
+		m_iBlockUsed += iBytes;
+		return pResult;
+	}
+
+private:
+	void NewHeapBlock( size_t iMinSize )
+	{
+		m_iBlockSize = MAX( iMinSize, (size_t)POLYHEDRON_SCRATCH_HEAP_SIZE );
+		m_iBlockUsed = 0;
+		m_pBlock = (uint8 *)MemAlloc_AllocAligned( m_iBlockSize, POLYHEDRON_SCRATCH_ALIGNMENT );
+		m_HeapBlocks.AddToTail( m_pBlock );
+	}
+
+	uint8 *m_pBlock;
+	size_t m_iBlockSize;
+	size_t m_iBlockUsed;
+	CUtlVector<void *> m_HeapBlocks;
+	ALIGN16 uint8 m_StackBlock[POLYHEDRON_SCRATCH_STACK_SIZE] ALIGN16_POST;
+};
+
 #if defined( _DEBUG ) && defined( ENABLE_DEBUG_POLYHEDRON_DUMPS )
 void CreateDumpDirectory( const char *szDirectoryName )
 {
@@ -254,38 +306,52 @@ CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float
 
 	AssertMsg( (pExistingPolyhedron->iVertexCount >= 3) && (pExistingPolyhedron->iPolygonCount >= 2), "Polyhedron doesn't meet absolute minimum spec" );
 
-	float *pUsefulPlanes = (float *)stackalloc( sizeof( float ) * 4 * iPlaneCount );
+	CPolyhedronScratch scratch;
+
+	float *pUsefulPlanes = scratch.Alloc<float>( 4 * iPlaneCount );
 	int iUsefulPlaneCount = 0;
 	Vector *pExistingVertices = pExistingPolyhedron->pVertices;
 
 	//A large part of clipping will either eliminate the polyhedron entirely, or clip nothing at all, so lets just check for those first and throw away useless planes
 	{
-		int iLiveCount = 0;
-		int iDeadCount = 0;
-		const float fNegativeOnPlaneEpsilon = -fOnPlaneEpsilon;
+		//classify 4 points at a time, pad the last group with copies of the last point so it can't change the outcome
+		int iVertexGroupCount = (pExistingPolyhedron->iVertexCount + 3) / 4;
+		FourVectors *pVertexGroups = scratch.Alloc<FourVectors>( iVertexGroupCount );
+		for( int j = 0; j != iVertexGroupCount * 4; ++j )
+		{
+			const Vector &vPoint = pExistingVertices[MIN( j, pExistingPolyhedron->iVertexCount - 1 )];
+			pVertexGroups[j >> 2].X( j & 3 ) = vPoint.x;
+			pVertexGroups[j >> 2].Y( j & 3 ) = vPoint.y;
+			pVertexGroups[j >> 2].Z( j & 3 ) = vPoint.z;
+		}
+
+		//these carry over from plane to plane, same as the counts they replace
+		fltx4 fl4AnyLive = LoadZeroSIMD();
+		fltx4 fl4AnyDead = LoadZeroSIMD();
+		const fltx4 fl4OnPlaneEpsilon = ReplicateX4( fOnPlaneEpsilon );
+		const fltx4 fl4NegativeOnPlaneEpsilon = ReplicateX4( -fOnPlaneEpsilon );
 
 		for( int i = 0; i != iPlaneCount; ++i )
 		{
 			Vector vNormal = *((Vector *)&pOutwardFacingPlanes[(i * 4) + 0]);
 			float fPlaneDist = pOutwardFacingPlanes[(i * 4) + 3];
+			fltx4 fl4PlaneDist = ReplicateX4( fPlaneDist );
 
-			for( int j = 0; j != pExistingPolyhedron->iVertexCount; ++j )
+			for( int j = 0; j != iVertexGroupCount; ++j )
 			{
-				float fPointDist = vNormal.Dot( pExistingVertices[j] ) - fPlaneDist;
+				fltx4 fl4PointDist = SubSIMD( pVertexGroups[j] * vNormal, fl4PlaneDist );
 				
-				if( fPointDist <= fNegativeOnPlaneEpsilon )
-					++iLiveCount;
-				else if( fPointDist > fOnPlaneEpsilon )
-					++iDeadCount;
+				fl4AnyLive = OrSIMD( fl4AnyLive, CmpLeSIMD( fl4PointDist, fl4NegativeOnPlaneEpsilon ) );
+				fl4AnyDead = OrSIMD( fl4AnyDead, CmpGtSIMD( fl4PointDist, fl4OnPlaneEpsilon ) );
 			}
 
-			if( iLiveCount == 0 )
+			if( !IsAnyNegative( fl4AnyLive ) )
 			{
 				//all points are dead or on the plane, so the polyhedron is dead
 				return NULL;
 			}
 
-			if( iDeadCount != 0 )
+			if( IsAnyNegative( fl4AnyDead ) )
 			{
 				//at least one point died, this plane yields useful results
 				pUsefulPlanes[(iUsefulPlaneCount * 4) + 0] = vNormal.x;
@@ -328,11 +394,11 @@ CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float
 
 
 	//convert the polyhedron to linked geometry
-	GeneratePolyhedronFromPlanes_Point *pStartPoints = (GeneratePolyhedronFromPlanes_Point *)stackalloc( pExistingPolyhedron->iVertexCount * sizeof( GeneratePolyhedronFromPlanes_Point ) );
-	GeneratePolyhedronFromPlanes_Line *pStartLines = (GeneratePolyhedronFromPlanes_Line *)stackalloc( pExistingPolyhedron->iLineCount * sizeof( GeneratePolyhedronFromPlanes_Line ) );
-	GeneratePolyhedronFromPlanes_Polygon *pStartPolygons = (GeneratePolyhedronFromPlanes_Polygon *)stackalloc( pExistingPolyhedron->iPolygonCount * sizeof( GeneratePolyhedronFromPlanes_Polygon ) );
+	GeneratePolyhedronFromPlanes_Point *pStartPoints = scratch.Alloc<GeneratePolyhedronFromPlanes_Point>( pExistingPolyhedron->iVertexCount );
+	GeneratePolyhedronFromPlanes_Line *pStartLines = scratch.Alloc<GeneratePolyhedronFromPlanes_Line>( pExistingPolyhedron->iLineCount );
+	GeneratePolyhedronFromPlanes_Polygon *pStartPolygons = scratch.Alloc<GeneratePolyhedronFromPlanes_Polygon>( pExistingPolyhedron->iPolygonCount );
 
-	GeneratePolyhedronFromPlanes_LineLL *pStartLineLinks = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( pExistingPolyhedron->iLineCount * 4 * sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+	GeneratePolyhedronFromPlanes_LineLL *pStartLineLinks = scratch.Alloc<GeneratePolyhedronFromPlanes_LineLL>( pExistingPolyhedron->iLineCount * 4 );
 	
 	int iCurrentLineLinkIndex = 0;
 
@@ -443,9 +509,9 @@ CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float
 		} while( pWorkLink != pFirstLink );
 	}
 
-	GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints = (GeneratePolyhedronFromPlanes_UnorderedPointLL *)stackalloc( pExistingPolyhedron->iVertexCount * sizeof( GeneratePolyhedronFromPlanes_UnorderedPointLL ) );
-	GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines = (GeneratePolyhedronFromPlanes_UnorderedLineLL *)stackalloc( pExistingPolyhedron->iLineCount * sizeof( GeneratePolyhedronFromPlanes_UnorderedLineLL ) );
-	GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons = (GeneratePolyhedronFromPlanes_UnorderedPolygonLL *)stackalloc( pExistingPolyhedron->iPolygonCount * sizeof( GeneratePolyhedronFromPlanes_UnorderedPolygonLL ) );
+	GeneratePolyhedronFromPlanes_UnorderedPointLL *pPoints = scratch.Alloc<GeneratePolyhedronFromPlanes_UnorderedPointLL>( pExistingPolyhedron->iVertexCount );
+	GeneratePolyhedronFromPlanes_UnorderedLineLL *pLines = scratch.Alloc<GeneratePolyhedronFromPlanes_UnorderedLineLL>( pExistingPolyhedron->iLineCount );
+	GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pPolygons = scratch.Alloc<GeneratePolyhedronFromPlanes_UnorderedPolygonLL>( pExistingPolyhedron->iPolygonCount );
 
 	//setup point collection
 	{
@@ -498,7 +564,7 @@ CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float
 		pPolygons[iLastPolygon].pNext = NULL;
 	}
 
-	return ClipLinkedGeometry( pPolygons, pLines, pPoints, pUsefulPlanes, iUsefulPlaneCount, fOnPlaneEpsilon, bUseTemporaryMemory );
+	return ClipLinkedGeometry( pPolygons, pLines, pPoints, pUsefulPlanes, iUsefulPlaneCount, fOnPlaneEpsilon, bUseTemporaryMemory, scratch );
 }
 
 
@@ -532,7 +598,9 @@ bool FindConvexShapeLooseAABB( const float *pInwardFacingPlanes, int iPlaneCount
 		int iVertCount;
 	};
 
-	float *pMovedPlanes = (float *)stackalloc( iPlaneCount * 4 * sizeof( float ) );
+	CPolyhedronScratch scratch;
+
+	float *pMovedPlanes = scratch.Alloc<float>( iPlaneCount * 4 );
 	//Vector vPointInPlanes = FindPointInPlanes( pInwardFacingPlanes, iPlaneCount );
 
 	for( int i = 0; i != iPlaneCount; ++i )
@@ -547,10 +615,10 @@ bool FindConvexShapeLooseAABB( const float *pInwardFacingPlanes, int iPlaneCount
 
 	//vAABBMins = vAABBMaxs = FindPointInPlanes( pPlanes, iPlaneCount );
 	float *vertsIn = NULL; //we'll be allocating a new buffer for this with each new polygon, and moving it off to the polygon array
-	float *vertsOut = (float *)stackalloc( (iPlaneCount + 4) * (sizeof( float ) * 3) ); //each plane will initially have 4 points in its polygon representation, and each plane clip has the possibility to add 1 point to the polygon
+	float *vertsOut = scratch.Alloc<float>( (iPlaneCount + 4) * 3 ); //each plane will initially have 4 points in its polygon representation, and each plane clip has the possibility to add 1 point to the polygon
 	float *vertsSwap;
 
-	FindConvexShapeAABB_Polygon_t *pPolygons = (FindConvexShapeAABB_Polygon_t *)stackalloc( iPlaneCount * sizeof( FindConvexShapeAABB_Polygon_t ) );
+	FindConvexShapeAABB_Polygon_t *pPolygons = scratch.Alloc<FindConvexShapeAABB_Polygon_t>( iPlaneCount );
 	int iPolyCount = 0;
 
 	for ( int i = 0; i < iPlaneCount; i++ )
@@ -559,7 +627,7 @@ bool FindConvexShapeLooseAABB( const float *pInwardFacingPlanes, int iPlaneCount
 		float fPlaneDist = pInwardFacingPlanes[(i*4) + 3];
 
 		if( vertsIn == NULL )
-			vertsIn = (float *)stackalloc( (iPlaneCount + 4) * (sizeof( float ) * 3) );
+			vertsIn = scratch.Alloc<float>( (iPlaneCount + 4) * 3 );
 
 		// Build a big-ass poly in this plane
 		int vertCount = PolyFromPlane( (Vector *)vertsIn, *pPlaneNormal, fPlaneDist, 100000.0f );
@@ -861,7 +929,8 @@ const char * DumpPolyhedronCutHistory( const CUtlVector<CPolyhedron *> &DumpedHi
 
 #endif
 
-CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pAllPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pAllLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pAllPoints, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory )
+//linked geometry is allocated from the caller's scratch memory, it's all thrown away at once when that goes out of scope
+CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL *pAllPolygons, GeneratePolyhedronFromPlanes_UnorderedLineLL *pAllLines, GeneratePolyhedronFromPlanes_UnorderedPointLL *pAllPoints, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory, CPolyhedronScratch &scratch )
 {
 	const float fNegativeOnPlaneEpsilon = -fOnPlaneEpsilon;
 
@@ -1318,10 +1387,10 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 					//We'll be de-linking from the old point and generating a new one. We do this so other lines can still access the dead point's untouched data.
 					
 					//Generate a new point
-					GeneratePolyhedronFromPlanes_Point *pNewPoint = (GeneratePolyhedronFromPlanes_Point *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_Point ) );
+					GeneratePolyhedronFromPlanes_Point *pNewPoint = scratch.Alloc<GeneratePolyhedronFromPlanes_Point>( 1 );
 					{
 						//add this point to the active list
-						pAllPoints->pPrev = (GeneratePolyhedronFromPlanes_UnorderedPointLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_UnorderedPointLL ) );
+						pAllPoints->pPrev = scratch.Alloc<GeneratePolyhedronFromPlanes_UnorderedPointLL>( 1 );
 						pAllPoints->pPrev->pNext = pAllPoints;
 						pAllPoints = pAllPoints->pPrev;
 						pAllPoints->pPrev = NULL;
@@ -1355,7 +1424,7 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 						pNewPoint->fPlaneDist = 0.0f;
 					}
 					
-					GeneratePolyhedronFromPlanes_LineLL *pNewLineLink = pNewPoint->pConnectedLines = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+					GeneratePolyhedronFromPlanes_LineLL *pNewLineLink = pNewPoint->pConnectedLines = scratch.Alloc<GeneratePolyhedronFromPlanes_LineLL>( 1 );
 					pNewLineLink->pLine = pWorkLine;
 					pNewLineLink->pNext = pNewLineLink;
 					pNewLineLink->pPrev = pNewLineLink;
@@ -1454,10 +1523,10 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 			}
 
 			//create the new polygon
-			GeneratePolyhedronFromPlanes_Polygon *pNewPolygon = (GeneratePolyhedronFromPlanes_Polygon *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_Polygon ) );
+			GeneratePolyhedronFromPlanes_Polygon *pNewPolygon = scratch.Alloc<GeneratePolyhedronFromPlanes_Polygon>( 1 );
 			{
 				//before we forget, add this polygon to the active list
-				pAllPolygons->pPrev = (GeneratePolyhedronFromPlanes_UnorderedPolygonLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_UnorderedPolygonLL ) );
+				pAllPolygons->pPrev = scratch.Alloc<GeneratePolyhedronFromPlanes_UnorderedPolygonLL>( 1 );
 				pAllPolygons->pPrev->pNext = pAllPolygons;
 				pAllPolygons = pAllPolygons->pPrev;
 				pAllPolygons->pPrev = NULL;
@@ -1503,10 +1572,10 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 					}
 #endif
 
-					GeneratePolyhedronFromPlanes_Line *pJoinLine = (GeneratePolyhedronFromPlanes_Line *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_Line ) );
+					GeneratePolyhedronFromPlanes_Line *pJoinLine = scratch.Alloc<GeneratePolyhedronFromPlanes_Line>( 1 );
 					{
 						//before we forget, add this line to the active list
-						pAllLines->pPrev = (GeneratePolyhedronFromPlanes_UnorderedLineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_UnorderedLineLL ) );
+						pAllLines->pPrev = scratch.Alloc<GeneratePolyhedronFromPlanes_UnorderedLineLL>( 1 );
 						pAllLines->pPrev->pNext = pAllLines;
 						pAllLines = pAllLines->pPrev;
 						pAllLines->pPrev = NULL;
@@ -1525,12 +1594,12 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 
 					//now create all 4 links into the line
 					GeneratePolyhedronFromPlanes_LineLL *pPointLinks[2];
-					pPointLinks[0] = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
-					pPointLinks[1] = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+					pPointLinks[0] = scratch.Alloc<GeneratePolyhedronFromPlanes_LineLL>( 1 );
+					pPointLinks[1] = scratch.Alloc<GeneratePolyhedronFromPlanes_LineLL>( 1 );
 
 					GeneratePolyhedronFromPlanes_LineLL *pPolygonLinks[2];
-					pPolygonLinks[0] = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
-					pPolygonLinks[1] = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+					pPolygonLinks[0] = scratch.Alloc<GeneratePolyhedronFromPlanes_LineLL>( 1 );
+					pPolygonLinks[1] = scratch.Alloc<GeneratePolyhedronFromPlanes_LineLL>( 1 );
 
 					pPointLinks[0]->pLine = pPointLinks[1]->pLine = pPolygonLinks[0]->pLine = pPolygonLinks[1]->pLine = pJoinLine;
 
@@ -1637,7 +1706,7 @@ CPolyhedron *ClipLinkedGeometry( GeneratePolyhedronFromPlanes_UnorderedPolygonLL
 					
 					//link to this line from the new polygon
 					GeneratePolyhedronFromPlanes_LineLL *pNewLineLink;
-					pNewLineLink = (GeneratePolyhedronFromPlanes_LineLL *)stackalloc( sizeof( GeneratePolyhedronFromPlanes_LineLL ) );
+					pNewLineLink = scratch.Alloc<GeneratePolyhedronFromPlanes_LineLL>( 1 );
 					
 					pNewLineLink->pLine = pTestLine->pLine;
 					pNewLineLink->iReferenceIndex = pTestLine->iReferenceIndex;
@@ -1782,7 +1851,9 @@ CPolyhedron *GeneratePolyhedronFromPlanes( const float *pOutwardFacingPlanes, in
 	//this version will start with a cube and hack away at it (retaining point connection information) to produce a polyhedron with no guesswork involved, this method should be rock solid
 	
 	//the polygon clipping functions we're going to use want inward facing planes
-	float *pFlippedPlanes = (float *)stackalloc( (iPlaneCount * 4) * sizeof( float ) );
+	CPolyhedronScratch scratch;
+
+	float *pFlippedPlanes = scratch.Alloc<float>( iPlaneCount * 4 );
 	for( int i = 0; i != iPlaneCount * 4; ++i )
 	{
 		pFlippedPlanes[i] = -pOutwardFacingPlanes[i];
@@ -2003,7 +2074,44 @@ CPolyhedron *GeneratePolyhedronFromPlanes( const float *pOutwardFacingPlanes, in
 		}
 	}
 
-	return ClipLinkedGeometry( StartingPolygonList, StartingLineList, StartingPointList, pOutwardFacingPlanes, iPlaneCount, fOnPlaneEpsilon, bUseTemporaryMemory );
+	return ClipLinkedGeometry( StartingPolygonList, StartingLineList, StartingPointList, pOutwardFacingPlanes, iPlaneCount, fOnPlaneEpsilon, bUseTemporaryMemory, scratch );
+}
+
+
+
+struct ClipPolyhedraContext_t
+{
+	PolyhedronClip_t *pClips;
+	float fOnPlaneEpsilon;
+};
+
+static void ClipPolyhedraBody( int i, void *pContext )
+{
+	//the temporary polyhedron is shared by everyone, so always allocate the results
+	ClipPolyhedraContext_t *pClipContext = (ClipPolyhedraContext_t *)pContext;
+	PolyhedronClip_t &clip = pClipContext->pClips[i];
+	if( clip.pPolyhedron )
+		clip.pResult = ClipPolyhedron( clip.pPolyhedron, clip.pOutwardFacingPlanes, clip.iPlaneCount, pClipContext->fOnPlaneEpsilon, false );
+	else
+		clip.pResult = GeneratePolyhedronFromPlanes( clip.pOutwardFacingPlanes, clip.iPlaneCount, pClipContext->fOnPlaneEpsilon, false );
+}
+
+void ClipPolyhedra( PolyhedronClip_t *pClips, int iClipCount, float fOnPlaneEpsilon, PolyhedronForEachFn_t pfnForEach )
+{
+	ClipPolyhedraContext_t context;
+	context.pClips = pClips;
+	context.fOnPlaneEpsilon = fOnPlaneEpsilon;
+
+	//every clip works out of its own thread's scratch memory, so they can all run at once. mathlib doesn't know about threads, the caller hands us the loop
+	if( pfnForEach )
+	{
+		pfnForEach( iClipCount, ClipPolyhedraBody, &context );
+	}
+	else
+	{
+		for( int i = 0; i != iClipCount; ++i )
+			ClipPolyhedraBody( i, &context );
+	}
 }
 
 
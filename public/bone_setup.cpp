@@ -20,6 +20,9 @@
 #include "datamanager.h"
 #include "convar.h"
 #include "tier0/tslist.h"
+#include "tier1/generichash.h"
+#include "tier1/taskscheduler.h"
+#include "tier1/threadexit.h"
 #include "vphysics_interface.h"
 #ifdef CLIENT_DLL
 	#include "posedebugger.h"
@@ -78,6 +81,122 @@ CBoneSetupMemoryPool<Quaternion> g_QaternionPool;
 CBoneSetupMemoryPool<Vector> g_VectorPool;
 CBoneSetupMemoryPool<matrix3x4_t> g_MatrixPool;
 
+//-----------------------------------------------------------------------------
+// Bone cache blocks are recycled through small per thread free lists. Blocks
+// are allocated in powers of two so any model of about the same size can
+// reuse them; very big ones go straight to the heap.
+//-----------------------------------------------------------------------------
+#define BONECACHE_MIN_BLOCK_SHIFT	8		// 256 bytes
+#define BONECACHE_BLOCK_CLASSES		7		// up to 16k
+#define BONECACHE_BLOCKS_PER_CLASS	4
+
+// One per thread that uses the bone cache, freed when the thread exits.
+// Lookup counters are kept here too so lookups never share a cache line.
+struct BoneCacheThreadData_t
+{
+	void					*m_pBlocks[BONECACHE_BLOCK_CLASSES][BONECACHE_BLOCKS_PER_CLASS];
+	int						m_nBlocks[BONECACHE_BLOCK_CLASSES];
+	int						m_nHits;
+	int						m_nMisses;
+	BoneCacheThreadData_t	*m_pNext;
+};
+
+static CThreadLocalPtr< BoneCacheThreadData_t > g_pBoneCacheThreadData;
+static BoneCacheThreadData_t *g_pBoneCacheThreadDataList;
+static CThreadFastMutex g_BoneCacheThreadDataMutex;
+
+// Counters of threads that have exited
+static int g_nBoneCacheExitedHits;
+static int g_nBoneCacheExitedMisses;
+
+static void FreeBoneCacheThreadData( void *pThreadData )
+{
+	BoneCacheThreadData_t *pData = (BoneCacheThreadData_t *)pThreadData;
+	g_pBoneCacheThreadData = (BoneCacheThreadData_t *)NULL;
+
+	{
+		AUTO_LOCK( g_BoneCacheThreadDataMutex );
+		BoneCacheThreadData_t **ppData = &g_pBoneCacheThreadDataList;
+		while ( *ppData != pData )
+		{
+			ppData = &(*ppData)->m_pNext;
+		}
+		*ppData = pData->m_pNext;
+
+		g_nBoneCacheExitedHits += pData->m_nHits;
+		g_nBoneCacheExitedMisses += pData->m_nMisses;
+
+		for ( int nClass = 0; nClass < BONECACHE_BLOCK_CLASSES; nClass++ )
+		{
+			while ( pData->m_nBlocks[nClass] )
+			{
+				free( pData->m_pBlocks[nClass][ --pData->m_nBlocks[nClass] ] );
+			}
+		}
+	}
+
+	delete pData;
+}
+
+static BoneCacheThreadData_t *GetBoneCacheThreadData()
+{
+	BoneCacheThreadData_t *pData = g_pBoneCacheThreadData;
+	if ( !pData )
+	{
+		pData = new BoneCacheThreadData_t;
+		memset( pData, 0, sizeof( *pData ) );
+		g_pBoneCacheThreadData = pData;
+
+		// Linked up so the stats can add up every thread's counters
+		{
+			AUTO_LOCK( g_BoneCacheThreadDataMutex );
+			pData->m_pNext = g_pBoneCacheThreadDataList;
+			g_pBoneCacheThreadDataList = pData;
+		}
+
+		ThreadAddExitCallback( FreeBoneCacheThreadData, pData );
+	}
+	return pData;
+}
+
+static int BoneCacheBlockClass( unsigned int size )
+{
+	int nClass = 0;
+	while ( nClass < BONECACHE_BLOCK_CLASSES && ( 1u << ( nClass + BONECACHE_MIN_BLOCK_SHIFT ) ) < size )
+	{
+		nClass++;
+	}
+	return nClass;
+}
+
+static void *AllocBoneCacheBlock( unsigned int size )
+{
+	int nClass = BoneCacheBlockClass( size );
+	if ( nClass == BONECACHE_BLOCK_CLASSES )
+		return malloc( size );
+
+	BoneCacheThreadData_t *pData = GetBoneCacheThreadData();
+	if ( pData->m_nBlocks[nClass] )
+		return pData->m_pBlocks[nClass][ --pData->m_nBlocks[nClass] ];
+
+	return malloc( 1u << ( nClass + BONECACHE_MIN_BLOCK_SHIFT ) );
+}
+
+static void FreeBoneCacheBlock( void *pBlock, unsigned int size )
+{
+	int nClass = BoneCacheBlockClass( size );
+	if ( nClass < BONECACHE_BLOCK_CLASSES )
+	{
+		BoneCacheThreadData_t *pData = GetBoneCacheThreadData();
+		if ( pData->m_nBlocks[nClass] < BONECACHE_BLOCKS_PER_CLASS )
+		{
+			pData->m_pBlocks[nClass][ pData->m_nBlocks[nClass]++ ] = pBlock;
+			return;
+		}
+	}
+	free( pBlock );
+}
+
 // -----------------------------------------------------------------
 CBoneCache *CBoneCache::CreateResource( const bonecacheparams_t &params )
 {
@@ -101,7 +220,7 @@ CBoneCache *CBoneCache::CreateResource( const bonecacheparams_t &params )
 	int matrixSize = sizeof(matrix3x4_t) * cachedBoneCount;
 	int size = ( sizeof(CBoneCache) + tableSizeStudio + tableSizeCached + matrixSize + 3 ) & ~3;
 	
-	CBoneCache *pMem = (CBoneCache *)malloc( size );
+	CBoneCache *pMem = (CBoneCache *)AllocBoneCacheBlock( size );
 	Construct( pMem );
 	pMem->Init( params, size, studioToCachedIndex, cachedToStudioIndex, cachedBoneCount );
 	return pMem;
@@ -115,7 +234,7 @@ unsigned int CBoneCache::EstimatedSize( const bonecacheparams_t &params )
 
 void CBoneCache::DestroyResource()
 {
-	free( this );
+	FreeBoneCacheBlock( this, m_size );
 }
 
 
@@ -212,35 +331,446 @@ short *CBoneCache::CachedToStudio()
 	return (short *)( (char *)(this+1) + m_cachedToStudioOffset );
 }
 
+//-----------------------------------------------------------------------------
+// The bone cache. Slots are split over shards, each with its own lock for
+// creating and destroying caches; looking a handle up doesn't lock at all.
+// A handle holds the shard, the slot and the slot's serial number, which
+// changes whenever the slot is freed, so stale handles simply miss.
+//
+// Rather than moving caches around an LRU list on every lookup, lookups stamp
+// their slot with the current aging pass. Every create that finds the caches
+// over the budget evicts the caches that weren't used since the last pass,
+// oldest first, until they're back under the low water mark; every so many of
+// those creates start a new pass. Caches used since the last pass are never
+// evicted, so the budget can be overshot for a while when every cache is in
+// use.
+//
+// Evicted caches are only freed by the next pass, so a thread that looked one
+// up just as it was evicted can still finish with it. Other than that, as
+// before, a pointer from Studio_GetBoneCache is only good until another
+// thread creates or destroys a cache.
+//-----------------------------------------------------------------------------
+#define BONECACHE_SHARD_BITS		4
+#define BONECACHE_SLOT_BITS			12
+#define BONECACHE_SHARDS			( 1 << BONECACHE_SHARD_BITS )
+#define BONECACHE_SLOTS_PER_SHARD	( 1 << BONECACHE_SLOT_BITS )
+#define BONECACHE_SLOTS_PER_CHUNK	256
+#define BONECACHE_CHUNKS_PER_SHARD	( BONECACHE_SLOTS_PER_SHARD / BONECACHE_SLOTS_PER_CHUNK )
+#define BONECACHE_MAX_SERIAL		0xfffe	// serial 0xffff would make INVALID_MEMHANDLE a valid handle
+
+#define BONECACHE_MEMORY_BUDGET		( 128 * 1024 )
+#define BONECACHE_MEMORY_LOW_WATER	( BONECACHE_MEMORY_BUDGET * 3 / 4 )
+#define BONECACHE_CREATES_PER_PASS	32
+
+struct BoneCacheSlot_t
+{
+	CBoneCache * volatile	m_pCache;
+	volatile int			m_nSerial;
+	volatile int			m_nLastUsed;	// aging pass of the last lookup
+};
+
+struct BoneCacheShard_t
+{
+	CThreadFastMutex		m_Mutex;
+	BoneCacheSlot_t * volatile m_pChunks[BONECACHE_CHUNKS_PER_SHARD];
+	int						m_nSlots;		// slots handed out so far, free ones are in m_FreeSlots
+	CUtlVector< unsigned short > m_FreeSlots;
+	CInterlockedInt			m_nContended;
+
+	// Keep the next shard's lock off our cache line
+	char					m_Pad[64];
+};
+
+struct BoneCacheAge_t
+{
+	unsigned int	m_nHandle;
+	int				m_nLastUsed;
+};
+
+static inline memhandle_t BoneCacheHandle( int iShard, int iSlot, int nSerial )
+{
+	return (memhandle_t)(uintp)( ( (unsigned int)nSerial << ( BONECACHE_SHARD_BITS + BONECACHE_SLOT_BITS ) ) | ( iSlot << BONECACHE_SHARD_BITS ) | iShard );
+}
+
+static inline int BoneCacheHandleShard( unsigned int nHandle )
+{
+	return nHandle & ( BONECACHE_SHARDS - 1 );
+}
+
+static inline int BoneCacheHandleSlot( unsigned int nHandle )
+{
+	return ( nHandle >> BONECACHE_SHARD_BITS ) & ( BONECACHE_SLOTS_PER_SHARD - 1 );
+}
+
+static inline int BoneCacheHandleSerial( unsigned int nHandle )
+{
+	return nHandle >> ( BONECACHE_SHARD_BITS + BONECACHE_SLOT_BITS );
+}
+
+static int __cdecl BoneCacheAgeCompare( const BoneCacheAge_t *pLeft, const BoneCacheAge_t *pRight )
+{
+	return pLeft->m_nLastUsed - pRight->m_nLastUsed;
+}
+
+class CBoneCacheManager
+{
+public:
+	CBoneCacheManager();
+	~CBoneCacheManager();
+
+	CBoneCache *Get( memhandle_t hCache );
+	memhandle_t Create( const bonecacheparams_t &params );
+	void Destroy( memhandle_t hCache );
+	void Invalidate( memhandle_t hCache );
+	void GetStats( BoneCacheStats_t &stats );
+
+private:
+	void LockShard( BoneCacheShard_t &shard );
+	BoneCacheSlot_t *FindSlot( unsigned int nHandle );
+	int AllocSlot( BoneCacheShard_t &shard );
+	CBoneCache *Remove( memhandle_t hCache );
+	void Age( bool bNewPass );
+
+	BoneCacheShard_t	m_Shards[BONECACHE_SHARDS];
+	CUtlVector< CBoneCache * > m_Evicted;	// freed by the next pass
+	volatile int		m_nPass;
+	CInterlockedInt		m_nAging;
+	CInterlockedInt		m_nCreatesSincePass;
+	CInterlockedInt		m_nMemoryUsed;
+	CInterlockedInt		m_nCaches;
+	CInterlockedInt		m_nCreated;
+	CInterlockedInt		m_nEvicted;
+	CInterlockedInt		m_nAgingPasses;
+};
+
+CBoneCacheManager::CBoneCacheManager()
+{
+	for ( int i = 0; i < BONECACHE_SHARDS; i++ )
+	{
+		memset( (void *)m_Shards[i].m_pChunks, 0, sizeof( m_Shards[i].m_pChunks ) );
+		m_Shards[i].m_nSlots = 0;
+	}
+	m_nPass = 1;
+}
+
+CBoneCacheManager::~CBoneCacheManager()
+{
+	for ( int i = 0; i < BONECACHE_SHARDS; i++ )
+	{
+		BoneCacheShard_t &shard = m_Shards[i];
+		for ( int iSlot = 0; iSlot < shard.m_nSlots; iSlot++ )
+		{
+			BoneCacheSlot_t &slot = shard.m_pChunks[ iSlot / BONECACHE_SLOTS_PER_CHUNK ][ iSlot % BONECACHE_SLOTS_PER_CHUNK ];
+			if ( slot.m_pCache )
+			{
+				slot.m_pCache->DestroyResource();
+			}
+		}
+		for ( int iChunk = 0; iChunk < BONECACHE_CHUNKS_PER_SHARD; iChunk++ )
+		{
+			delete [] shard.m_pChunks[iChunk];
+		}
+	}
+
+	for ( int i = 0; i < m_Evicted.Count(); i++ )
+	{
+		m_Evicted[i]->DestroyResource();
+	}
+
+	AUTO_LOCK( g_BoneCacheThreadDataMutex );
+	for ( BoneCacheThreadData_t *pData = g_pBoneCacheThreadDataList; pData; pData = pData->m_pNext )
+	{
+		for ( int nClass = 0; nClass < BONECACHE_BLOCK_CLASSES; nClass++ )
+		{
+			while ( pData->m_nBlocks[nClass] )
+			{
+				free( pData->m_pBlocks[nClass][ --pData->m_nBlocks[nClass] ] );
+			}
+		}
+	}
+}
+
+void CBoneCacheManager::LockShard( BoneCacheShard_t &shard )
+{
+	if ( !shard.m_Mutex.TryLock() )
+	{
+		++shard.m_nContended;
+		shard.m_Mutex.Lock();
+	}
+}
+
+BoneCacheSlot_t *CBoneCacheManager::FindSlot( unsigned int nHandle )
+{
+	int iSlot = BoneCacheHandleSlot( nHandle );
+	BoneCacheSlot_t *pChunk = m_Shards[ BoneCacheHandleShard( nHandle ) ].m_pChunks[ iSlot / BONECACHE_SLOTS_PER_CHUNK ];
+	return pChunk ? &pChunk[ iSlot % BONECACHE_SLOTS_PER_CHUNK ] : NULL;
+}
+
+// Must hold the shard's lock
+int CBoneCacheManager::AllocSlot( BoneCacheShard_t &shard )
+{
+	if ( shard.m_FreeSlots.Count() )
+	{
+		int iSlot = shard.m_FreeSlots.Tail();
+		shard.m_FreeSlots.RemoveMultipleFromTail( 1 );
+		return iSlot;
+	}
+
+	if ( shard.m_nSlots == BONECACHE_SLOTS_PER_SHARD )
+		return -1;
+
+	int iChunk = shard.m_nSlots / BONECACHE_SLOTS_PER_CHUNK;
+	if ( !shard.m_pChunks[iChunk] )
+	{
+		BoneCacheSlot_t *pChunk = new BoneCacheSlot_t[BONECACHE_SLOTS_PER_CHUNK];
+		for ( int i = 0; i < BONECACHE_SLOTS_PER_CHUNK; i++ )
+		{
+			pChunk[i].m_pCache = NULL;
+			pChunk[i].m_nSerial = 1;
+			pChunk[i].m_nLastUsed = 0;
+		}
+
+		// Lookups may find the chunk as soon as it's stored
+		ThreadMemoryBarrier();
+		shard.m_pChunks[iChunk] = pChunk;
+	}
+	return shard.m_nSlots++;
+}
+
+CBoneCache *CBoneCacheManager::Get( memhandle_t hCache )
+{
+	unsigned int nHandle = (unsigned int)(uintp)hCache;
+	BoneCacheSlot_t *pSlot = FindSlot( nHandle );
+	CBoneCache *pCache = pSlot ? pSlot->m_pCache : NULL;
+
+	// The cache must have been read before the serial that says it's ours
+	ThreadMemoryBarrier();
+
+	BoneCacheThreadData_t *pData = GetBoneCacheThreadData();
+	if ( !pCache || pSlot->m_nSerial != BoneCacheHandleSerial( nHandle ) )
+	{
+		pData->m_nMisses++;
+		return NULL;
+	}
+
+	// Only write the stamp when it changes so lookups don't keep dirtying the slot
+	int nPass = m_nPass;
+	if ( pSlot->m_nLastUsed != nPass )
+	{
+		pSlot->m_nLastUsed = nPass;
+	}
+	pData->m_nHits++;
+	return pCache;
+}
+
+memhandle_t CBoneCacheManager::Create( const bonecacheparams_t &params )
+{
+	// Build the cache before taking any lock
+	CBoneCache *pCache = CBoneCache::CreateResource( params );
+	int nSize = pCache->Size();
+
+	// Each thread starts at its own shard so creating threads don't fight over a lock
+	int iHome = HashIntAlternate( ThreadGetCurrentId() );
+	for ( int i = 0; i < BONECACHE_SHARDS; i++ )
+	{
+		int iShard = ( iHome + i ) & ( BONECACHE_SHARDS - 1 );
+		BoneCacheShard_t &shard = m_Shards[iShard];
+		LockShard( shard );
+		int iSlot = AllocSlot( shard );
+		if ( iSlot < 0 )
+		{
+			shard.m_Mutex.Unlock();
+			continue;
+		}
+
+		// Counted before it's published, it can be evicted as soon as we unlock
+		m_nMemoryUsed += nSize;
+		++m_nCaches;
+		++m_nCreated;
+
+		BoneCacheSlot_t &slot = shard.m_pChunks[ iSlot / BONECACHE_SLOTS_PER_CHUNK ][ iSlot % BONECACHE_SLOTS_PER_CHUNK ];
+		slot.m_nLastUsed = m_nPass;
+		slot.m_pCache = pCache;
+		int nSerial = slot.m_nSerial;
+		shard.m_Mutex.Unlock();
+
+		if ( m_nMemoryUsed > BONECACHE_MEMORY_BUDGET )
+		{
+			Age( ++m_nCreatesSincePass >= BONECACHE_CREATES_PER_PASS );
+		}
+		return BoneCacheHandle( iShard, iSlot, nSerial );
+	}
+
+	AssertMsg( 0, "Out of bone cache handles\n" );
+	pCache->DestroyResource();
+	return (memhandle_t)0;
+}
+
+// Takes the cache out of its slot, NULL if the handle is stale
+CBoneCache *CBoneCacheManager::Remove( memhandle_t hCache )
+{
+	unsigned int nHandle = (unsigned int)(uintp)hCache;
+	BoneCacheShard_t &shard = m_Shards[ BoneCacheHandleShard( nHandle ) ];
+	LockShard( shard );
+
+	BoneCacheSlot_t *pSlot = FindSlot( nHandle );
+	CBoneCache *pCache = pSlot ? pSlot->m_pCache : NULL;
+	if ( !pCache || pSlot->m_nSerial != BoneCacheHandleSerial( nHandle ) )
+	{
+		shard.m_Mutex.Unlock();
+		return NULL;
+	}
+
+	// Retire the serial before clearing the slot so lookups can't see it half way
+	int nSerial = pSlot->m_nSerial + 1;
+	pSlot->m_nSerial = ( nSerial > BONECACHE_MAX_SERIAL ) ? 1 : nSerial;
+	ThreadMemoryBarrier();
+	pSlot->m_pCache = NULL;
+	shard.m_FreeSlots.AddToTail( (unsigned short)BoneCacheHandleSlot( nHandle ) );
+	shard.m_Mutex.Unlock();
+
+	m_nMemoryUsed -= pCache->Size();
+	--m_nCaches;
+	return pCache;
+}
+
+void CBoneCacheManager::Destroy( memhandle_t hCache )
+{
+	CBoneCache *pCache = Remove( hCache );
+	if ( pCache )
+	{
+		pCache->DestroyResource();
+	}
+}
+
+void CBoneCacheManager::Invalidate( memhandle_t hCache )
+{
+	unsigned int nHandle = (unsigned int)(uintp)hCache;
+	BoneCacheShard_t &shard = m_Shards[ BoneCacheHandleShard( nHandle ) ];
+
+	// Locked so the cache can't be evicted under us
+	LockShard( shard );
+	BoneCacheSlot_t *pSlot = FindSlot( nHandle );
+	if ( pSlot && pSlot->m_pCache && pSlot->m_nSerial == BoneCacheHandleSerial( nHandle ) )
+	{
+		pSlot->m_pCache->m_timeValid = -1.0f;
+	}
+	shard.m_Mutex.Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: evicts the caches that weren't used since the last pass, oldest
+//			first, until the memory used is back under the low water mark.
+//			A new pass also frees what the previous one evicted.
+//-----------------------------------------------------------------------------
+void CBoneCacheManager::Age( bool bNewPass )
+{
+	// One thread ages at a time, the others carry on
+	if ( !m_nAging.AssignIf( 0, 1 ) )
+		return;
+
+	int nLastPass = m_nPass - 1;
+	if ( bNewPass )
+	{
+		++m_nAgingPasses;
+		m_nCreatesSincePass = 0;
+		nLastPass = m_nPass;
+		m_nPass = nLastPass + 1;
+
+		for ( int i = 0; i < m_Evicted.Count(); i++ )
+		{
+			m_Evicted[i]->DestroyResource();
+		}
+		m_Evicted.RemoveAll();
+	}
+
+	CUtlVector< BoneCacheAge_t > candidates;
+	for ( int iShard = 0; iShard < BONECACHE_SHARDS; iShard++ )
+	{
+		BoneCacheShard_t &shard = m_Shards[iShard];
+		LockShard( shard );
+		for ( int iSlot = 0; iSlot < shard.m_nSlots; iSlot++ )
+		{
+			BoneCacheSlot_t &slot = shard.m_pChunks[ iSlot / BONECACHE_SLOTS_PER_CHUNK ][ iSlot % BONECACHE_SLOTS_PER_CHUNK ];
+			if ( slot.m_pCache && slot.m_nLastUsed < nLastPass )
+			{
+				BoneCacheAge_t &age = candidates[ candidates.AddToTail() ];
+				age.m_nHandle = (unsigned int)(uintp)BoneCacheHandle( iShard, iSlot, slot.m_nSerial );
+				age.m_nLastUsed = slot.m_nLastUsed;
+			}
+		}
+		shard.m_Mutex.Unlock();
+	}
+
+	candidates.Sort( BoneCacheAgeCompare );
+
+	// Anything destroyed since we looked just misses
+	for ( int i = 0; i < candidates.Count() && m_nMemoryUsed > BONECACHE_MEMORY_LOW_WATER; i++ )
+	{
+		CBoneCache *pCache = Remove( (memhandle_t)(uintp)candidates[i].m_nHandle );
+		if ( pCache )
+		{
+			m_Evicted.AddToTail( pCache );
+			++m_nEvicted;
+		}
+	}
+
+	m_nAging = 0;
+}
+
+void CBoneCacheManager::GetStats( BoneCacheStats_t &stats )
+{
+	stats.m_nCaches = m_nCaches;
+	stats.m_nMemoryUsed = m_nMemoryUsed;
+	stats.m_nHits = 0;
+	stats.m_nMisses = 0;
+	stats.m_nCreated = m_nCreated;
+	stats.m_nEvicted = m_nEvicted;
+	stats.m_nAgingPasses = m_nAgingPasses;
+	stats.m_nContended = 0;
+
+	for ( int i = 0; i < BONECACHE_SHARDS; i++ )
+	{
+		stats.m_nContended += m_Shards[i].m_nContended;
+	}
+
+	// The other threads' counters may be a little behind
+	AUTO_LOCK( g_BoneCacheThreadDataMutex );
+	stats.m_nHits += g_nBoneCacheExitedHits;
+	stats.m_nMisses += g_nBoneCacheExitedMisses;
+	for ( BoneCacheThreadData_t *pData = g_pBoneCacheThreadDataList; pData; pData = pData->m_pNext )
+	{
+		stats.m_nHits += pData->m_nHits;
+		stats.m_nMisses += pData->m_nMisses;
+	}
+}
+
 // Construct a singleton
-static CDataManager<CBoneCache, bonecacheparams_t, CBoneCache *, CThreadFastMutex> g_StudioBoneCache( 128 * 1024L );
+static CBoneCacheManager g_StudioBoneCache;
 
 CBoneCache *Studio_GetBoneCache( memhandle_t cacheHandle )
 {
-	AUTO_LOCK( g_StudioBoneCache.AccessMutex() );
-	return g_StudioBoneCache.GetResource_NoLock( cacheHandle );
+	return g_StudioBoneCache.Get( cacheHandle );
 }
 
 memhandle_t Studio_CreateBoneCache( bonecacheparams_t &params )
 {
-	AUTO_LOCK( g_StudioBoneCache.AccessMutex() );
-	return g_StudioBoneCache.CreateResource( params );
+	return g_StudioBoneCache.Create( params );
 }
 
 void Studio_DestroyBoneCache( memhandle_t cacheHandle )
 {
-	AUTO_LOCK( g_StudioBoneCache.AccessMutex() );
-	g_StudioBoneCache.DestroyResource( cacheHandle );
+	g_StudioBoneCache.Destroy( cacheHandle );
 }
 
 void Studio_InvalidateBoneCache( memhandle_t cacheHandle )
 {
-	AUTO_LOCK( g_StudioBoneCache.AccessMutex() );
-	CBoneCache *pCache = g_StudioBoneCache.GetResource_NoLock( cacheHandle );
-	if ( pCache )
-	{
-		pCache->m_timeValid = -1.0f;
-	}
+	g_StudioBoneCache.Invalidate( cacheHandle );
+}
+
+void Studio_GetBoneCacheStats( BoneCacheStats_t &stats )
+{
+	g_StudioBoneCache.GetStats( stats );
 }
 
 //-----------------------------------------------------------------------------
@@ -533,35 +1063,453 @@ void CalcBonePosition(	int frame, float s,
 	}
 	else
 	{
-		for (j = 0; j < 3; j++)
+		for (j = 0; j < 3; j++)
+		{
+			ExtractAnimValue( frame, pPosV->pAnimvalue( j ), baseBoneScale[j], pos[j] );
+		}
+	}
+
+	if (!(panim->flags & STUDIO_ANIM_DELTA))
+	{
+		pos.x = pos.x + basePos.x;
+		pos.y = pos.y + basePos.y;
+		pos.z = pos.z + basePos.z;
+	}
+
+	Assert( pos.IsValid() );
+}
+
+
+inline void CalcBonePosition( int frame, float s, 
+						const mstudiobone_t *pBone,
+						const mstudiolinearbone_t *pLinearBones,
+						const mstudioanim_t *panim, Vector &pos )
+{
+	if (pLinearBones)
+	{
+		CalcBonePosition( frame, s, pLinearBones->pos(panim->bone), pLinearBones->posscale(panim->bone), panim, pos );
+	}
+	else
+	{
+		CalcBonePosition( frame, s, pBone->pos, pBone->posscale, panim, pos );
+	}
+}
+
+
+
+//-----------------------------------------------------------------------------
+// Batched animation decode
+//
+// CalcAnimation and CalcVirtualAnimation mark the bones of an anim they want
+// and decode them together. The RLE streams of the animated channels are
+// walked once for both keyframes, then the euler to quaternion conversion and
+// the blend between the keyframes run on four bones at a time. Bones with raw
+// or constant data still go through CalcBoneQuaternion and CalcBonePosition.
+//
+// Decoded keyframes don't depend on the mask, the weights or the blend
+// fraction, so each thread can keep the last few around. Entities playing the
+// same sequence, and the same entity set up with different masks, then skip
+// the RLE walks. Demand loaded anim blocks can be freed and something else
+// loaded at the same address, so the cache is keyed on what the data is (the
+// model's checksum, the anim and the frame) rather than only where it is,
+// and everything is thrown away at level shutdown.
+//-----------------------------------------------------------------------------
+static ConVar anim_keyframecache( "anim_keyframecache", "1", FCVAR_REPLICATED, "Cache decoded animation keyframes." );
+
+// Decoded anims kept per thread, must be a power of two
+#define ANIM_KEYFRAME_CACHE_SIZE	32
+
+// Both keyframes of an animated rotation or position, base pose added
+struct DecodedChannel_t
+{
+	float m_flValue1[3];
+	float m_flValue2[3];
+};
+
+// Every animated channel of an anim at one frame: the rotations in chain order, then the positions
+struct AnimKeyframes_t
+{
+	const mstudioanim_t *m_pAnim;
+	const mstudiobone_t *m_pBaseBones;
+	const mstudioanimdesc_t *m_pAnimDesc;
+	int m_nChecksum;
+	int m_iFrame;			// Frame of the whole anim, not of its section
+	int m_nGeneration;
+	uint32 m_nLayout;
+	int m_nRot;
+	CUtlVector< DecodedChannel_t > m_Channels;
+};
+
+// An animated channel the caller asked for
+struct SelectedChannel_t
+{
+	const mstudioanim_t *m_pAnim;
+	int m_iChannel;
+	int m_iOut;
+};
+
+class CAnimDecodeContext
+{
+public:
+	CAnimDecodeContext()
+	{
+		for ( int i = 0; i < ANIM_KEYFRAME_CACHE_SIZE; i++ )
+		{
+			m_Cache[i].m_pAnim = NULL;
+			m_Cache[i].m_pAnimDesc = NULL;
+		}
+	}
+
+	AnimKeyframes_t m_Cache[ANIM_KEYFRAME_CACHE_SIZE];
+	AnimKeyframes_t m_Uncached;
+	const mstudioanim_t *m_pRotAnims[MAXSTUDIOBONES];
+	const mstudioanim_t *m_pPosAnims[MAXSTUDIOBONES];
+	SelectedChannel_t m_Rot[MAXSTUDIOBONES];
+	SelectedChannel_t m_Pos[MAXSTUDIOBONES];
+};
+
+// One per thread that sets up bones, freed when the thread exits
+static CThreadLocalPtr< CAnimDecodeContext > g_pAnimDecodeContext;
+static CInterlockedInt g_nKeyframeCacheGeneration;
+
+//-----------------------------------------------------------------------------
+// Purpose: drops every thread's decoded keyframes, for when animation data
+//			is unloaded and something else may be loaded at the same address
+//-----------------------------------------------------------------------------
+void Studio_InvalidateKeyframeCache()
+{
+	++g_nKeyframeCacheGeneration;
+}
+
+static void FreeAnimDecodeContext( void *pContext )
+{
+	g_pAnimDecodeContext = (CAnimDecodeContext *)NULL;
+	delete (CAnimDecodeContext *)pContext;
+}
+
+static CAnimDecodeContext *GetAnimDecodeContext()
+{
+	CAnimDecodeContext *pContext = g_pAnimDecodeContext;
+	if ( !pContext )
+	{
+		pContext = new CAnimDecodeContext;
+		g_pAnimDecodeContext = pContext;
+		ThreadAddExitCallback( FreeAnimDecodeContext, pContext );
+	}
+	return pContext;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: extract both keyframes of one animated rotation or position
+//-----------------------------------------------------------------------------
+static void DecodeChannel( int frame, const mstudioanim_t *panim, bool bRotation, 
+						const mstudiobone_t *pBaseBones, const mstudiolinearbone_t *pLinearBones, 
+						DecodedChannel_t &channel )
+{
+	int iBone = panim->bone;
+	mstudioanim_valueptr_t *pValuesPtr;
+	Vector vecScale, vecBase;
+	if ( bRotation )
+	{
+		pValuesPtr = panim->pRotV();
+		if ( pLinearBones )
+		{
+			RadianEuler rot = pLinearBones->rot( iBone );
+			vecScale = pLinearBones->rotscale( iBone );
+			vecBase.Init( rot.x, rot.y, rot.z );
+		}
+		else
+		{
+			vecScale = pBaseBones[iBone].rotscale;
+			vecBase.Init( pBaseBones[iBone].rot.x, pBaseBones[iBone].rot.y, pBaseBones[iBone].rot.z );
+		}
+	}
+	else
+	{
+		pValuesPtr = panim->pPosV();
+		if ( pLinearBones )
+		{
+			vecScale = pLinearBones->posscale( iBone );
+			vecBase = pLinearBones->pos( iBone );
+		}
+		else
+		{
+			vecScale = pBaseBones[iBone].posscale;
+			vecBase = pBaseBones[iBone].pos;
+		}
+	}
+
+	if ( panim->flags & STUDIO_ANIM_DELTA )
+	{
+		vecBase.Init( 0.0f, 0.0f, 0.0f );
+	}
+
+	for ( int j = 0; j < 3; j++ )
+	{
+		ExtractAnimValue( frame, pValuesPtr->pAnimvalue( j ), vecScale[j], channel.m_flValue1[j], channel.m_flValue2[j] );
+		channel.m_flValue1[j] += vecBase[j];
+		channel.m_flValue2[j] += vecBase[j];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: AngleQuaternion on four sets of euler angles
+//-----------------------------------------------------------------------------
+static FORCEINLINE void AngleQuaternionSIMD( const fltx4 &x, const fltx4 &y, const fltx4 &z, 
+						fltx4 &qx, fltx4 &qy, fltx4 &qz, fltx4 &qw )
+{
+	fltx4 sr, cr, sp, cp, sy, cy;
+	SinCosSIMD( sr, cr, MulSIMD( x, Four_PointFives ) );
+	SinCosSIMD( sp, cp, MulSIMD( y, Four_PointFives ) );
+	SinCosSIMD( sy, cy, MulSIMD( z, Four_PointFives ) );
+
+	fltx4 srXcp = MulSIMD( sr, cp ), crXsp = MulSIMD( cr, sp );
+	qx = SubSIMD( MulSIMD( srXcp, cy ), MulSIMD( crXsp, sy ) );
+	qy = MaddSIMD( crXsp, cy, MulSIMD( srXcp, sy ) );
+
+	fltx4 crXcp = MulSIMD( cr, cp ), srXsp = MulSIMD( sr, sp );
+	qz = SubSIMD( MulSIMD( crXcp, sy ), MulSIMD( srXsp, cy ) );
+	qw = MaddSIMD( crXcp, cy, MulSIMD( srXsp, sy ) );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: convert and blend up to four decoded rotations
+//-----------------------------------------------------------------------------
+static void CalcRotationsSIMD( float s, const DecodedChannel_t *pChannels, const SelectedChannel_t *pSelected, int nCount, 
+						Quaternion *q )
+{
+	ALIGN16 float angles[6][4] ALIGN16_POST;
+	for ( int i = 0; i < 4; i++ )
+	{
+		// Pad out the last group with copies of its first bone
+		const DecodedChannel_t &channel = pChannels[ pSelected[ i < nCount ? i : 0 ].m_iChannel ];
+		for ( int j = 0; j < 3; j++ )
+		{
+			angles[j][i] = channel.m_flValue1[j];
+			angles[j + 3][i] = channel.m_flValue2[j];
+		}
+	}
+
+	fltx4 qx, qy, qz, qw;
+	AngleQuaternionSIMD( LoadAlignedSIMD( angles[0] ), LoadAlignedSIMD( angles[1] ), LoadAlignedSIMD( angles[2] ), qx, qy, qz, qw );
+
+	if ( s > 0.001f )
+	{
+		fltx4 q2x, q2y, q2z, q2w;
+		AngleQuaternionSIMD( LoadAlignedSIMD( angles[3] ), LoadAlignedSIMD( angles[4] ), LoadAlignedSIMD( angles[5] ), q2x, q2y, q2z, q2w );
+
+		// QuaternionBlend: flip the second one into the same hemisphere, lerp and renormalize
+		fltx4 dot = MulSIMD( qx, q2x );
+		dot = MaddSIMD( qy, q2y, dot );
+		dot = MaddSIMD( qz, q2z, dot );
+		dot = MaddSIMD( qw, q2w, dot );
+		fltx4 sclq = ReplicateX4( s );
+		sclq = MaskedAssign( CmpLtSIMD( dot, Four_Zeros ), NegSIMD( sclq ), sclq );
+		fltx4 sclp = ReplicateX4( 1.0f - s );
+
+		qx = MaddSIMD( q2x, sclq, MulSIMD( qx, sclp ) );
+		qy = MaddSIMD( q2y, sclq, MulSIMD( qy, sclp ) );
+		qz = MaddSIMD( q2z, sclq, MulSIMD( qz, sclp ) );
+		qw = MaddSIMD( q2w, sclq, MulSIMD( qw, sclp ) );
+
+		fltx4 radius = MulSIMD( qx, qx );
+		radius = MaddSIMD( qy, qy, radius );
+		radius = MaddSIMD( qz, qz, radius );
+		radius = MaddSIMD( qw, qw, radius );
+		fltx4 iradius = ReciprocalSqrtSIMD( radius );
+		qx = MulSIMD( qx, iradius );
+		qy = MulSIMD( qy, iradius );
+		qz = MulSIMD( qz, iradius );
+		qw = MulSIMD( qw, iradius );
+	}
+
+	for ( int i = 0; i < nCount; i++ )
+	{
+		Quaternion &out = q[ pSelected[i].m_iOut ];
+		out.Init( SubFloat( qx, i ), SubFloat( qy, i ), SubFloat( qz, i ), SubFloat( qw, i ) );
+		Assert( out.IsValid() );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: blend up to four decoded positions
+//-----------------------------------------------------------------------------
+static void CalcPositionsSIMD( float s, const DecodedChannel_t *pChannels, const SelectedChannel_t *pSelected, int nCount, 
+						Vector *pos )
+{
+	if ( s <= 0.001f )
+	{
+		for ( int i = 0; i < nCount; i++ )
+		{
+			const DecodedChannel_t &channel = pChannels[ pSelected[i].m_iChannel ];
+			pos[ pSelected[i].m_iOut ].Init( channel.m_flValue1[0], channel.m_flValue1[1], channel.m_flValue1[2] );
+		}
+		return;
+	}
+
+	ALIGN16 float values[6][4] ALIGN16_POST;
+	for ( int i = 0; i < 4; i++ )
+	{
+		const DecodedChannel_t &channel = pChannels[ pSelected[ i < nCount ? i : 0 ].m_iChannel ];
+		for ( int j = 0; j < 3; j++ )
+		{
+			values[j][i] = channel.m_flValue1[j];
+			values[j + 3][i] = channel.m_flValue2[j];
+		}
+	}
+
+	fltx4 sclp = ReplicateX4( 1.0f - s );
+	fltx4 sclq = ReplicateX4( s );
+	fltx4 x = MaddSIMD( LoadAlignedSIMD( values[3] ), sclq, MulSIMD( LoadAlignedSIMD( values[0] ), sclp ) );
+	fltx4 y = MaddSIMD( LoadAlignedSIMD( values[4] ), sclq, MulSIMD( LoadAlignedSIMD( values[1] ), sclp ) );
+	fltx4 z = MaddSIMD( LoadAlignedSIMD( values[5] ), sclq, MulSIMD( LoadAlignedSIMD( values[2] ), sclp ) );
+
+	for ( int i = 0; i < nCount; i++ )
+	{
+		Vector &out = pos[ pSelected[i].m_iOut ];
+		out.Init( SubFloat( x, i ), SubFloat( y, i ), SubFloat( z, i ) );
+		Assert( out.IsValid() );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: decode the bones of an anim chain which have an output index in 
+//			pBoneOutput (indexed by anim bone, -1 to skip). frame is within the
+//			section pFirstAnim belongs to, iAnimFrame within the whole anim.
+//-----------------------------------------------------------------------------
+static void CalcAnimatedBones( const studiohdr_t *pAnimStudioHdr, const mstudioanimdesc_t &animdesc, int iAnimFrame,
+						int frame, float s, const mstudioanim_t *pFirstAnim, 
+						const mstudiobone_t *pBaseBones, const mstudiolinearbone_t *pLinearBones, 
+						const short *pBoneOutput, Vector *pos, Quaternion *q )
+{
+	CAnimDecodeContext *pContext = GetAnimDecodeContext();
+
+	// Sort the chain into channels that need decoding and ones that don't. The
+	// layout hash catches different anim data showing up at a cached address.
+	int nRot = 0, nPos = 0;
+	int nSelectedRot = 0, nSelectedPos = 0;
+	uint32 nLayout = 0;
+	for ( const mstudioanim_t *panim = pFirstAnim; panim && panim->bone < 255; panim = panim->pNext() )
+	{
+		nLayout = HashIntAlternate( nLayout ^ ( panim->bone | ( panim->flags << 8 ) | ( (uint16)panim->nextoffset << 16 ) ) );
+
+		bool bAnimRot = ( panim->flags & ( STUDIO_ANIM_RAWROT | STUDIO_ANIM_RAWROT2 | STUDIO_ANIM_ANIMROT ) ) == STUDIO_ANIM_ANIMROT && nRot < MAXSTUDIOBONES;
+		bool bAnimPos = ( panim->flags & ( STUDIO_ANIM_RAWPOS | STUDIO_ANIM_ANIMPOS ) ) == STUDIO_ANIM_ANIMPOS && nPos < MAXSTUDIOBONES;
+		int iOut = pBoneOutput[ panim->bone ];
+
+		if ( bAnimRot )
+		{
+			if ( iOut >= 0 )
+			{
+				SelectedChannel_t &selected = pContext->m_Rot[ nSelectedRot++ ];
+				selected.m_pAnim = panim;
+				selected.m_iChannel = nRot;
+				selected.m_iOut = iOut;
+			}
+			pContext->m_pRotAnims[ nRot++ ] = panim;
+		}
+		else if ( iOut >= 0 )
+		{
+			CalcBoneQuaternion( frame, s, &pBaseBones[ panim->bone ], pLinearBones, panim, q[iOut] );
+		}
+
+		if ( bAnimPos )
+		{
+			if ( iOut >= 0 )
+			{
+				SelectedChannel_t &selected = pContext->m_Pos[ nSelectedPos++ ];
+				selected.m_pAnim = panim;
+				selected.m_iChannel = nPos;
+				selected.m_iOut = iOut;
+			}
+			pContext->m_pPosAnims[ nPos++ ] = panim;
+		}
+		else if ( iOut >= 0 )
+		{
+			CalcBonePosition( frame, s, &pBaseBones[ panim->bone ], pLinearBones, panim, pos[iOut] );
+		}
+	}
+
+	if ( nSelectedRot == 0 && nSelectedPos == 0 )
+		return;
+
+	AnimKeyframes_t *pKeyframes;
+	if ( anim_keyframecache.GetBool() )
+	{
+		uint32 nHash = HashIntAlternate( (uint32)( (uintp)&animdesc >> 2 ) ^ ( (uint32)iAnimFrame * 0x9E3779B9 ) );
+		pKeyframes = &pContext->m_Cache[ nHash & ( ANIM_KEYFRAME_CACHE_SIZE - 1 ) ];
+		if ( pKeyframes->m_pAnimDesc != &animdesc || pKeyframes->m_nChecksum != pAnimStudioHdr->checksum || pKeyframes->m_iFrame != iAnimFrame || 
+			pKeyframes->m_pAnim != pFirstAnim || pKeyframes->m_pBaseBones != pBaseBones || 
+			pKeyframes->m_nGeneration != g_nKeyframeCacheGeneration || pKeyframes->m_nLayout != nLayout )
+		{
+			pKeyframes->m_pAnim = pFirstAnim;
+			pKeyframes->m_pBaseBones = pBaseBones;
+			pKeyframes->m_pAnimDesc = &animdesc;
+			pKeyframes->m_nChecksum = pAnimStudioHdr->checksum;
+			pKeyframes->m_iFrame = iAnimFrame;
+			pKeyframes->m_nGeneration = g_nKeyframeCacheGeneration;
+			pKeyframes->m_nLayout = nLayout;
+			pKeyframes->m_nRot = nRot;
+			pKeyframes->m_Channels.SetCount( nRot + nPos );
+
+			DecodedChannel_t *pChannels = pKeyframes->m_Channels.Base();
+			for ( int i = 0; i < nRot; i++ )
+			{
+				DecodeChannel( frame, pContext->m_pRotAnims[i], true, pBaseBones, pLinearBones, pChannels[i] );
+			}
+			for ( int i = 0; i < nPos; i++ )
+			{
+				DecodeChannel( frame, pContext->m_pPosAnims[i], false, pBaseBones, pLinearBones, pChannels[nRot + i] );
+			}
+		}
+	}
+	else
+	{
+		// Only decode what was asked for, renumbering the selection to match
+		pKeyframes = &pContext->m_Uncached;
+		pKeyframes->m_nRot = nSelectedRot;
+		pKeyframes->m_Channels.SetCount( nSelectedRot + nSelectedPos );
+
+		DecodedChannel_t *pChannels = pKeyframes->m_Channels.Base();
+		for ( int i = 0; i < nSelectedRot; i++ )
 		{
-			ExtractAnimValue( frame, pPosV->pAnimvalue( j ), baseBoneScale[j], pos[j] );
+			DecodeChannel( frame, pContext->m_Rot[i].m_pAnim, true, pBaseBones, pLinearBones, pChannels[i] );
+			pContext->m_Rot[i].m_iChannel = i;
+		}
+		for ( int i = 0; i < nSelectedPos; i++ )
+		{
+			DecodeChannel( frame, pContext->m_Pos[i].m_pAnim, false, pBaseBones, pLinearBones, pChannels[nSelectedRot + i] );
+			pContext->m_Pos[i].m_iChannel = i;
 		}
 	}
 
-	if (!(panim->flags & STUDIO_ANIM_DELTA))
+	const DecodedChannel_t *pRotChannels = pKeyframes->m_Channels.Base();
+	const DecodedChannel_t *pPosChannels = pRotChannels + pKeyframes->m_nRot;
+
+	for ( int i = 0; i < nSelectedRot; i += 4 )
 	{
-		pos.x = pos.x + basePos.x;
-		pos.y = pos.y + basePos.y;
-		pos.z = pos.z + basePos.z;
+		CalcRotationsSIMD( s, pRotChannels, &pContext->m_Rot[i], MIN( nSelectedRot - i, 4 ), q );
 	}
 
-	Assert( pos.IsValid() );
-}
-
-
-inline void CalcBonePosition( int frame, float s, 
-						const mstudiobone_t *pBone,
-						const mstudiolinearbone_t *pLinearBones,
-						const mstudioanim_t *panim, Vector &pos )
-{
-	if (pLinearBones)
+	// align to unified bone
+	for ( int i = 0; i < nSelectedRot; i++ )
 	{
-		CalcBonePosition( frame, s, pLinearBones->pos(panim->bone), pLinearBones->posscale(panim->bone), panim, pos );
+		const mstudioanim_t *panim = pContext->m_Rot[i].m_pAnim;
+		if ( panim->flags & STUDIO_ANIM_DELTA )
+			continue;
+
+		int iBone = panim->bone;
+		int iBaseFlags = pLinearBones ? pLinearBones->flags( iBone ) : pBaseBones[iBone].flags;
+		if ( iBaseFlags & BONE_FIXED_ALIGNMENT )
+		{
+			Quaternion &out = q[ pContext->m_Rot[i].m_iOut ];
+			QuaternionAlign( pLinearBones ? pLinearBones->qalignment( iBone ) : pBaseBones[iBone].qAlignment, out, out );
+		}
 	}
-	else
+
+	for ( int i = 0; i < nSelectedPos; i += 4 )
 	{
-		CalcBonePosition( frame, s, pBone->pos, pBone->posscale, panim, pos );
+		CalcPositionsSIMD( s, pPosChannels, &pContext->m_Pos[i], MIN( nSelectedPos - i, 4 ), pos );
 	}
 }
 
@@ -965,6 +1913,10 @@ static void CalcVirtualAnimation( virtualmodel_t *pVModel, const CStudioHdr *pSt
 		return;
 	}
 
+	short boneOutput[256];
+	memset( boneOutput, 0xff, sizeof( boneOutput ) );
+	const mstudioanim_t *pFirstAnim = panim;
+
 	// FIXME: change encoding so that bone -1 is never the case
 	while (panim && panim->bone < 255)
 	{
@@ -975,8 +1927,7 @@ static void CalcVirtualAnimation( virtualmodel_t *pVModel, const CStudioHdr *pSt
 
 			if (k >= 0 && pweight[k] > 0.0f)
 			{
-				CalcBoneQuaternion( iLocalFrame, s, &pAnimbone[panim->bone], pAnimLinearBones, panim, q[j] );
-				CalcBonePosition  ( iLocalFrame, s, &pAnimbone[panim->bone], pAnimLinearBones, panim, pos[j] );
+				boneOutput[panim->bone] = j;
 #ifdef STUDIO_ENABLE_PERF_COUNTERS
 				pStudioHdr->m_nPerfAnimatedBones++;
 #endif
@@ -985,6 +1936,8 @@ static void CalcVirtualAnimation( virtualmodel_t *pVModel, const CStudioHdr *pSt
 		panim = panim->pNext();
 	}
 
+	CalcAnimatedBones( pAnimStudioHdr, animdesc, iFrame, iLocalFrame, s, pFirstAnim, pAnimbone, pAnimLinearBones, boneOutput, pos, q );
+
 	// cross fade in previous zeroframe data
 	if (flStall > 0.0f)
 	{
@@ -1096,6 +2049,10 @@ static void CalcAnimation( const CStudioHdr *pStudioHdr,	Vector *pos, Quaternion
 		return;
 	}
 
+	short boneOutput[256];
+	memset( boneOutput, 0xff, sizeof( boneOutput ) );
+	const mstudioanim_t *pFirstAnim = panim;
+
 	// BUGBUG: the sequence, the anim, and the model can have all different bone mappings.
 	for (i = 0; i < pStudioHdr->numbones(); i++, pbone++, pweight++)
 	{
@@ -1103,8 +2060,7 @@ static void CalcAnimation( const CStudioHdr *pStudioHdr,	Vector *pos, Quaternion
 		{
 			if (*pweight > 0 && (pStudioHdr->boneFlags(i) & boneMask))
 			{
-				CalcBoneQuaternion( iLocalFrame, s, pbone, pLinearBones, panim, q[i] );
-				CalcBonePosition  ( iLocalFrame, s, pbone, pLinearBones, panim, pos[i] );
+				boneOutput[i] = i;
 #ifdef STUDIO_ENABLE_PERF_COUNTERS
 				pStudioHdr->m_nPerfAnimatedBones++;
 				pStudioHdr->m_nPerfUsedBones++;
@@ -1130,6 +2086,8 @@ static void CalcAnimation( const CStudioHdr *pStudioHdr,	Vector *pos, Quaternion
 		}
 	}
 
+	CalcAnimatedBones( pStudioHdr->GetRenderHdr(), animdesc, iFrame, iLocalFrame, s, pFirstAnim, pStudioHdr->pBone( 0 ), pLinearBones, boneOutput, pos, q );
+
 	// cross fade in previous zeroframe data
 	if (flStall > 0.0f)
 	{
@@ -1372,6 +2330,39 @@ void WorldSpaceSlerp(
 
 
 
+//-----------------------------------------------------------------------------
+// Purpose: gather the bones in pBones four at a time for the SIMD blends. The
+//			last group is padded with its last bone, which is harmless since
+//			every lane of that bone computes the same result.
+//-----------------------------------------------------------------------------
+static FORCEINLINE int GatherBoneGroup( const int *pBones, int nBones, int nFirst, int iBone[4] )
+{
+	for ( int k = 0; k < 4; k++ )
+	{
+		iBone[k] = pBones[ MIN( nFirst + k, nBones - 1 ) ];
+	}
+	return MIN( nBones - nFirst, 4 );
+}
+
+// Like QuaternionAlignSIMD, except lanes of bones with fixed alignment keep q as is
+static FORCEINLINE FourQuaternions AlignBoneGroup( const CStudioHdr *pStudioHdr, const int iBone[4], const FourQuaternions &p, const FourQuaternions &q )
+{
+	ALIGN16 int32 fixed[4] ALIGN16_POST;
+	for ( int k = 0; k < 4; k++ )
+	{
+		fixed[k] = ( pStudioHdr->boneFlags( iBone[k] ) & BONE_FIXED_ALIGNMENT ) ? -1 : 0;
+	}
+	fltx4 fixedMask = LoadAlignedSIMD( fixed );
+
+	FourQuaternions result = QuaternionAlignSIMD( p, q );
+	result.x = MaskedAssign( fixedMask, q.x, result.x );
+	result.y = MaskedAssign( fixedMask, q.y, result.y );
+	result.z = MaskedAssign( fixedMask, q.z, result.z );
+	result.w = MaskedAssign( fixedMask, q.w, result.w );
+	return result;
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: blend together q1,pos1 with q2,pos2.  Return result in q1,pos1.  
 //			0 returns q1, pos1.  1 returns q2, pos2
@@ -1481,49 +2472,45 @@ void SlerpBones(
 		return;
 	}
 
-	QuaternionAligned q3;
+	int *pActive = (int*)stackalloc( nBoneCount * sizeof(int) );
+	int nActive = 0;
 	for (i = 0; i < nBoneCount; i++)
 	{
-		s2 = pS2[i];
-		if ( s2 <= 0.0f )
-			continue;
-
-		s1 = 1.0 - s2;
-
-#ifdef _X360
-		fltx4  q1simd, q2simd, result;
-		q1simd = LoadUnalignedSIMD( q1[i].Base() );
-		q2simd = LoadAlignedSIMD( q2[i] );
-#endif
-		if ( pStudioHdr->boneFlags(i) & BONE_FIXED_ALIGNMENT )
+		if ( pS2[i] > 0.0f )
 		{
-#ifndef _X360
-			QuaternionSlerpNoAlign( q2[i], q1[i], s1, q3 );
-#else
-			result = QuaternionSlerpNoAlignSIMD( q2simd, q1simd, s1 );
-#endif
+			pActive[nActive++] = i;
 		}
-		else
+	}
+
+	// slerp four bones at a time, each with its own weight
+	for ( int n = 0; n < nActive; n += 4 )
+	{
+		int iBone[4];
+		int nCount = GatherBoneGroup( pActive, nActive, n, iBone );
+
+		ALIGN16 float flS1[4] ALIGN16_POST;
+		for ( int k = 0; k < 4; k++ )
 		{
-#ifndef _X360
-			QuaternionSlerp( q2[i], q1[i], s1, q3 );
-#else
-			result = QuaternionSlerpSIMD( q2simd, q1simd, s1 );
-#endif
+			flS1[k] = 1.0 - pS2[ iBone[k] ];
 		}
 
-#ifndef _X360
-		q1[i][0] = q3[0];
-		q1[i][1] = q3[1];
-		q1[i][2] = q3[2];
-		q1[i][3] = q3[3];
-#else
-		StoreUnalignedSIMD( q1[i].Base(), result );
-#endif
+		FourQuaternions a, b;
+		a.LoadAndSwizzle( q2[iBone[0]], q2[iBone[1]], q2[iBone[2]], q2[iBone[3]] );
+		b.LoadAndSwizzle( q1[iBone[0]], q1[iBone[1]], q1[iBone[2]], q1[iBone[3]] );
+		b = AlignBoneGroup( pStudioHdr, iBone, a, b );
 
-		pos1[i][0] = pos1[i][0] * s1 + pos2[i][0] * s2;
-		pos1[i][1] = pos1[i][1] * s1 + pos2[i][1] * s2;
-		pos1[i][2] = pos1[i][2] * s1 + pos2[i][2] * s2;
+		FourQuaternions result = QuaternionSlerpNoAlignSIMD( a, b, LoadAlignedSIMD( flS1 ) );
+		result.SwizzleAndStore( q1[iBone[0]], q1[iBone[1]], q1[iBone[2]], q1[iBone[3]] );
+
+		for ( int k = 0; k < nCount; k++ )
+		{
+			i = iBone[k];
+			s2 = pS2[i];
+			s1 = flS1[k];
+			pos1[i][0] = pos1[i][0] * s1 + pos2[i][0] * s2;
+			pos1[i][1] = pos1[i][1] * s1 + pos2[i][1] * s2;
+			pos1[i][2] = pos1[i][2] * s1 + pos2[i][2] * s2;
+		}
 	}
 }
 
@@ -1546,7 +2533,6 @@ void BlendBones(
 	int boneMask )
 {
 	int			i, j;
-	Quaternion		q3;
 
 	virtualmodel_t *pVModel = pStudioHdr->GetVirtualModel();
 	const virtualgroup_t *pSeqGroup = NULL;
@@ -1592,7 +2578,10 @@ void BlendBones(
 	float s2 = s;
 	float s1 = 1.0 - s2;
 
-	for (i = 0; i < pStudioHdr->numbones(); i++)
+	int nBoneCount = pStudioHdr->numbones();
+	int *pActive = (int*)stackalloc( nBoneCount * sizeof(int) );
+	int nActive = 0;
+	for (i = 0; i < nBoneCount; i++)
 	{
 		// skip unused bones
 		if (!(pStudioHdr->boneFlags(i) & boneMask))
@@ -1611,18 +2600,27 @@ void BlendBones(
 
 		if (j >= 0 && seqdesc.weight( j ) > 0.0)
 		{
-			if (pStudioHdr->boneFlags(i) & BONE_FIXED_ALIGNMENT)
-			{
-				QuaternionBlendNoAlign( q2[i], q1[i], s1, q3 );
-			}
-			else
-			{
-				QuaternionBlend( q2[i], q1[i], s1, q3 );
-			}
-			q1[i][0] = q3[0];
-			q1[i][1] = q3[1];
-			q1[i][2] = q3[2];
-			q1[i][3] = q3[3];
+			pActive[nActive++] = i;
+		}
+	}
+
+	fltx4 s1simd = ReplicateX4( s1 );
+	for ( int n = 0; n < nActive; n += 4 )
+	{
+		int iBone[4];
+		int nCount = GatherBoneGroup( pActive, nActive, n, iBone );
+
+		FourQuaternions a, b;
+		a.LoadAndSwizzle( q2[iBone[0]], q2[iBone[1]], q2[iBone[2]], q2[iBone[3]] );
+		b.LoadAndSwizzle( q1[iBone[0]], q1[iBone[1]], q1[iBone[2]], q1[iBone[3]] );
+		b = AlignBoneGroup( pStudioHdr, iBone, a, b );
+
+		FourQuaternions result = QuaternionBlendNoAlignSIMD( a, b, s1simd );
+		result.SwizzleAndStore( q1[iBone[0]], q1[iBone[1]], q1[iBone[2]], q1[iBone[3]] );
+
+		for ( int k = 0; k < nCount; k++ )
+		{
+			i = iBone[k];
 			pos1[i][0] = pos1[i][0] * s1 + pos2[i][0] * s2;
 			pos1[i][1] = pos1[i][1] * s1 + pos2[i][1] * s2;
 			pos1[i][2] = pos1[i][2] * s1 + pos2[i][2] * s2;
@@ -1644,7 +2642,6 @@ void ScaleBones(
 	int boneMask )
 {
 	int			i, j;
-	Quaternion		q3;
 
 	mstudioseqdesc_t &seqdesc = ((CStudioHdr *)pStudioHdr)->pSeqdesc( sequence );
 
@@ -1658,7 +2655,10 @@ void ScaleBones(
 	float s2 = s;
 	float s1 = 1.0 - s2;
 
-	for (i = 0; i < pStudioHdr->numbones(); i++)
+	int nBoneCount = pStudioHdr->numbones();
+	int *pActive = (int*)stackalloc( nBoneCount * sizeof(int) );
+	int nActive = 0;
+	for (i = 0; i < nBoneCount; i++)
 	{
 		// skip unused bones
 		if (!(pStudioHdr->boneFlags(i) & boneMask))
@@ -1677,8 +2677,24 @@ void ScaleBones(
 
 		if (j >= 0 && seqdesc.weight( j ) > 0.0)
 		{
-			QuaternionIdentityBlend( q1[i], s1, q1[i] );
-			VectorScale( pos1[i], s2, pos1[i] );
+			pActive[nActive++] = i;
+		}
+	}
+
+	fltx4 s1simd = ReplicateX4( s1 );
+	for ( int n = 0; n < nActive; n += 4 )
+	{
+		int iBone[4];
+		int nCount = GatherBoneGroup( pActive, nActive, n, iBone );
+
+		FourQuaternions a;
+		a.LoadAndSwizzle( q1[iBone[0]], q1[iBone[1]], q1[iBone[2]], q1[iBone[3]] );
+		FourQuaternions result = QuaternionIdentityBlendSIMD( a, s1simd );
+		result.SwizzleAndStore( q1[iBone[0]], q1[iBone[1]], q1[iBone[2]], q1[iBone[3]] );
+
+		for ( int k = 0; k < nCount; k++ )
+		{
+			VectorScale( pos1[iBone[k]], s2, pos1[iBone[k]] );
 		}
 	}
 }
@@ -4519,17 +5535,8 @@ void Studio_BuildMatrices(
 	if (iBone < -1 || iBone >= pStudioHdr->numbones())
 		iBone = 0;
 
-	// build list of what bones to use
-	if (iBone == -1)
-	{
-		// all bones
-		chainlength = pStudioHdr->numbones();
-		for (i = 0; i < pStudioHdr->numbones(); i++)
-		{
-			chain[chainlength - i - 1] = i;
-		}
-	}
-	else
+	// build list of what bones to use, all bones are done in order below
+	if (iBone != -1)
 	{
 		// only the parent bones
 		i = iBone;
@@ -4560,6 +5567,40 @@ void Studio_BuildMatrices(
 		VectorScale( rotationmatrix[2], flScale, rotationmatrix[2] );
 	}
 
+	if (iBone == -1)
+	{
+		// all bones: build the local matrices for each run of used bones in one
+		// go, then chain them. Parents always come before their children.
+		int nBones = pStudioHdr->numbones();
+		matrix3x4_t *pBoneMatrices = g_MatrixPool.Alloc();
+		for (i = 0; i < nBones; )
+		{
+			if ( !(pStudioHdr->boneFlags(i) & boneMask) )
+			{
+				i++;
+				continue;
+			}
+
+			int iFirst = i;
+			while ( i < nBones && (pStudioHdr->boneFlags(i) & boneMask) )
+			{
+				i++;
+			}
+			QuaternionMatrixArray( &q[iFirst], &pos[iFirst], &pBoneMatrices[iFirst], i - iFirst );
+		}
+
+		for (i = 0; i < nBones; i++)
+		{
+			if (pStudioHdr->boneFlags(i) & boneMask)
+			{
+				int iParent = pStudioHdr->boneParent(i);
+				ConcatTransforms( ( iParent == -1 ) ? rotationmatrix : bonetoworld[iParent], pBoneMatrices[i], bonetoworld[i] );
+			}
+		}
+		g_MatrixPool.Free( pBoneMatrices );
+		return;
+	}
+
 	for (j = chainlength - 1; j >= 0; j--)
 	{
 		i = chain[j];
@@ -4580,6 +5621,89 @@ void Studio_BuildMatrices(
 }
 
 
+//-----------------------------------------------------------------------------
+// Batched bone setup
+//-----------------------------------------------------------------------------
+static void Studio_SetupBones( const BoneSetupRequest_t &request )
+{
+	const CStudioHdr *pStudioHdr = request.m_pStudioHdr;
+	Vector *pos = g_VectorPool.Alloc();
+	Quaternion *q = g_QaternionPool.Alloc();
+
+	CBoneSetup boneSetup( pStudioHdr, request.m_nBoneMask, request.m_pPoseParameters );
+	InitPose( pStudioHdr, pos, q, request.m_nBoneMask );
+
+	for ( int i = 0; i < request.m_nLayers; i++ )
+	{
+		const BoneSetupLayer_t &layer = request.m_pLayers[i];
+		if ( layer.m_flWeight > 0.0f && layer.m_nSequence >= 0 && layer.m_nSequence < pStudioHdr->GetNumSeq() )
+		{
+			boneSetup.AccumulatePose( pos, q, layer.m_nSequence, layer.m_flCycle, layer.m_flWeight, request.m_flTime, NULL );
+		}
+	}
+
+	boneSetup.CalcAutoplaySequences( pos, q, request.m_flTime, NULL );
+
+	if ( request.m_pControllers )
+	{
+		CalcBoneAdj( pStudioHdr, pos, q, request.m_pControllers, request.m_nBoneMask );
+	}
+
+	Studio_BuildMatrices( pStudioHdr, request.m_angles, request.m_origin, pos, q, -1, request.m_flScale, request.m_pBoneToWorld, request.m_nBoneMask );
+
+	g_QaternionPool.Free( q );
+	g_VectorPool.Free( pos );
+}
+
+// Keep entities of the same model next to each other so a thread works through
+// the same animation data, and the same keyframes when they play the same sequence
+static int __cdecl BoneSetupRequestCompare( BoneSetupRequest_t * const *ppLeft, BoneSetupRequest_t * const *ppRight )
+{
+	const BoneSetupRequest_t *pLeft = *ppLeft;
+	const BoneSetupRequest_t *pRight = *ppRight;
+	if ( pLeft->m_pStudioHdr != pRight->m_pStudioHdr )
+		return ( pLeft->m_pStudioHdr < pRight->m_pStudioHdr ) ? -1 : 1;
+
+	int nLeftSequence = pLeft->m_nLayers ? pLeft->m_pLayers[0].m_nSequence : -1;
+	int nRightSequence = pRight->m_nLayers ? pRight->m_pLayers[0].m_nSequence : -1;
+	if ( nLeftSequence != nRightSequence )
+		return ( nLeftSequence < nRightSequence ) ? -1 : 1;
+
+	return ( pLeft < pRight ) ? -1 : ( pLeft > pRight ) ? 1 : 0;
+}
+
+class CBoneSetupBatchBody
+{
+public:
+	CBoneSetupBatchBody( BoneSetupRequest_t **ppRequests ) : m_ppRequests( ppRequests ) {}
+
+	void operator()( int i )
+	{
+		Studio_SetupBones( *m_ppRequests[i] );
+	}
+
+private:
+	BoneSetupRequest_t **m_ppRequests;
+};
+
+void Studio_SetupBonesBatch( BoneSetupRequest_t *pRequests, int nRequests, int nGrain )
+{
+	if ( nRequests <= 0 )
+		return;
+
+	CUtlVector< BoneSetupRequest_t * > sorted;
+	sorted.SetCount( nRequests );
+	for ( int i = 0; i < nRequests; i++ )
+	{
+		sorted[i] = &pRequests[i];
+	}
+	sorted.Sort( BoneSetupRequestCompare );
+
+	CBoneSetupBatchBody body( sorted.Base() );
+	ParallelFor( 0, nRequests, body, nGrain );
+}
+
+
 //-----------------------------------------------------------------------------
 // Purpose: look at single column vector of another bones local transformation 
 //			and generate a procedural transformation based on how that column 
@@ -5261,6 +6385,189 @@ static int ClipRayToHitbox( const Ray_t &ray, mstudiobbox_t *pbox, matrix3x4_t&
 #pragma warning (default : 4701)
 #endif
 
+//-----------------------------------------------------------------------------
+// Hitboxes are culled against the ray four at a time: a slab test in each
+// box's space finds where the ray enters it. Only the boxes the ray enters are
+// clipped exactly, nearest first, and once the nearest hit so far is closer
+// than where the ray enters the next box the rest can't be hit first.
+//-----------------------------------------------------------------------------
+
+// Boxes are grown by this much so the cull never rejects a box the exact clip would hit
+#define HITBOX_CULL_EPSILON		0.01f
+
+struct HitboxCandidate_t
+{
+	int		m_nHitbox;
+	float	m_flEnter;
+};
+
+static void ScaleHitboxMatrix( const matrix3x4_t &matrix, const Vector &vecOrigin, float flInvScale, matrix3x4_t &matScaled )
+{
+	MatrixCopy( matrix, matScaled );
+
+	Vector vecBoneOrigin;
+	MatrixGetColumn( matScaled, 3, vecBoneOrigin );
+	
+	// Pre-scale the origin down
+	Vector vecNewOrigin = vecBoneOrigin - vecOrigin;
+	vecNewOrigin *= flInvScale;
+	vecNewOrigin += vecOrigin;
+	MatrixSetColumn( vecNewOrigin, 3, matScaled );
+
+	// Scale it uniformly
+	VectorScale( matScaled[0], flInvScale, matScaled[0] );
+	VectorScale( matScaled[1], flInvScale, matScaled[1] );
+	VectorScale( matScaled[2], flInvScale, matScaled[2] );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: slab test of a ray, or a box swept along it, against four hitboxes.
+//			Returns a mask of the boxes entered before flMaxFraction and where
+//			the ray enters each of them. Works in the same M^T space the exact
+//			clips do.
+//-----------------------------------------------------------------------------
+static fltx4 EnterHitboxesSIMD( const Vector &vecStart, const Vector &vecDelta, const Vector &vecExtents, float flMaxFraction,
+	const matrix3x4_t *pMatrices[4], const mstudiobbox_t *pBoxes[4], fltx4 &flEnter )
+{
+	// Transpose the boxes into lanes
+	ALIGN16 float flMatrices[3][4][4] ALIGN16_POST;	// [row][column][box]
+	ALIGN16 float flMins[3][4] ALIGN16_POST;
+	ALIGN16 float flMaxs[3][4] ALIGN16_POST;
+	for ( int k = 0; k < 4; k++ )
+	{
+		const matrix3x4_t &matrix = *pMatrices[k];
+		for ( int i = 0; i < 3; i++ )
+		{
+			flMatrices[i][0][k] = matrix[i][0];
+			flMatrices[i][1][k] = matrix[i][1];
+			flMatrices[i][2][k] = matrix[i][2];
+			flMatrices[i][3][k] = matrix[i][3];
+			flMins[i][k] = pBoxes[k]->bbmin[i];
+			flMaxs[i][k] = pBoxes[k]->bbmax[i];
+		}
+	}
+
+	FourVectors axis[3], start;
+	for ( int j = 0; j < 3; j++ )
+	{
+		axis[j].x = LoadAlignedSIMD( flMatrices[0][j] );
+		axis[j].y = LoadAlignedSIMD( flMatrices[1][j] );
+		axis[j].z = LoadAlignedSIMD( flMatrices[2][j] );
+	}
+	start.x = SubSIMD( ReplicateX4( vecStart.x ), LoadAlignedSIMD( flMatrices[0][3] ) );
+	start.y = SubSIMD( ReplicateX4( vecStart.y ), LoadAlignedSIMD( flMatrices[1][3] ) );
+	start.z = SubSIMD( ReplicateX4( vecStart.z ), LoadAlignedSIMD( flMatrices[2][3] ) );
+
+	fltx4 extentsX = ReplicateX4( vecExtents.x );
+	fltx4 extentsY = ReplicateX4( vecExtents.y );
+	fltx4 extentsZ = ReplicateX4( vecExtents.z );
+	fltx4 epsilon = ReplicateX4( HITBOX_CULL_EPSILON );
+
+	fltx4 enter = Four_Zeros;
+	fltx4 exit = ReplicateX4( flMaxFraction );
+	for ( int j = 0; j < 3; j++ )
+	{
+		fltx4 s = start * axis[j];
+		fltx4 d = axis[j] * vecDelta;
+
+		// A swept box grows each slab by its extents along the axis
+		fltx4 bloat = MaddSIMD( fabs( axis[j].x ), extentsX, MaddSIMD( fabs( axis[j].y ), extentsY, MaddSIMD( fabs( axis[j].z ), extentsZ, epsilon ) ) );
+		fltx4 lo = SubSIMD( SubSIMD( LoadAlignedSIMD( flMins[j] ), bloat ), s );
+		fltx4 hi = SubSIMD( AddSIMD( LoadAlignedSIMD( flMaxs[j] ), bloat ), s );
+
+		// A ray parallel to the slab is either inside it all the way or misses
+		fltx4 parallel = CmpLtSIMD( fabs( d ), Four_Epsilons );
+		fltx4 inside = AndSIMD( CmpLeSIMD( lo, Four_Zeros ), CmpGeSIMD( hi, Four_Zeros ) );
+		fltx4 safeD = MaskedAssign( parallel, Four_Ones, d );
+		fltx4 t1 = DivSIMD( lo, safeD );
+		fltx4 t2 = DivSIMD( hi, safeD );
+		fltx4 tNear = MaskedAssign( parallel, MaskedAssign( inside, Four_Negative_FLT_MAX, Four_FLT_MAX ), MinSIMD( t1, t2 ) );
+		fltx4 tFar = MaskedAssign( parallel, MaskedAssign( inside, Four_FLT_MAX, Four_Negative_FLT_MAX ), MaxSIMD( t1, t2 ) );
+
+		enter = MaxSIMD( enter, tNear );
+		exit = MinSIMD( exit, tFar );
+	}
+
+	flEnter = enter;
+	return CmpLeSIMD( enter, exit );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: finds the hitboxes the ray, or a box swept along it, may hit.
+//			Returns them sorted by where the ray enters them.
+//-----------------------------------------------------------------------------
+static int CollectHitboxCandidates( const Vector &vecStart, const Vector &vecDelta, const Vector &vecExtents, 
+	CStudioHdr *pStudioHdr, mstudiohitboxset_t *set, matrix3x4_t **hitboxbones, int fContentsMask, 
+	bool bScaled, const Vector &vecOrigin, float flInvScale, HitboxCandidate_t *pCandidates )
+{
+	int nCandidates = 0;
+	int iBox[4];
+	const mstudiobbox_t *pBoxes[4];
+	const matrix3x4_t *pMatrices[4];
+	matrix3x4_t matScaled[4];
+
+	int i = 0;
+	while ( i < set->numhitboxes )
+	{
+		// Gather the next four boxes that pass the contents filter
+		int nBoxes = 0;
+		for ( ; i < set->numhitboxes && nBoxes < 4; i++ )
+		{
+			mstudiobbox_t *pbox = set->pHitbox(i);
+			int fBoneContents = pStudioHdr->pBone( pbox->bone )->contents;
+			if ( ( fBoneContents & fContentsMask ) == 0 )
+				continue;
+
+			iBox[nBoxes] = i;
+			pBoxes[nBoxes] = pbox;
+			if ( bScaled )
+			{
+				ScaleHitboxMatrix( *hitboxbones[pbox->bone], vecOrigin, flInvScale, matScaled[nBoxes] );
+				pMatrices[nBoxes] = &matScaled[nBoxes];
+			}
+			else
+			{
+				pMatrices[nBoxes] = hitboxbones[pbox->bone];
+			}
+			nBoxes++;
+		}
+
+		if ( !nBoxes )
+			break;
+
+		// Pad a short group with copies of its first box
+		for ( int j = nBoxes; j < 4; j++ )
+		{
+			pBoxes[j] = pBoxes[0];
+			pMatrices[j] = pMatrices[0];
+		}
+
+		fltx4 enter;
+		int nMask = TestSignSIMD( EnterHitboxesSIMD( vecStart, vecDelta, vecExtents, 1.0f, pMatrices, pBoxes, enter ) );
+		if ( !( nMask & ( ( 1 << nBoxes ) - 1 ) ) )
+			continue;
+
+		for ( int j = 0; j < nBoxes; j++ )
+		{
+			if ( !( nMask & ( 1 << j ) ) )
+				continue;
+
+			// Insertion sort, there are only ever a few
+			float flEnter = SubFloat( enter, j );
+			int k = nCandidates++;
+			while ( k > 0 && pCandidates[k - 1].m_flEnter > flEnter )
+			{
+				pCandidates[k] = pCandidates[k - 1];
+				k--;
+			}
+			pCandidates[k].m_nHitbox = iBox[j];
+			pCandidates[k].m_flEnter = flEnter;
+		}
+	}
+
+	return nCandidates;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose:
 //-----------------------------------------------------------------------------
@@ -5270,31 +6577,31 @@ bool SweepBoxToStudio( IPhysicsSurfaceProps *pProps, const Ray_t& ray, CStudioHd
 	tr.fraction = 1.0;
 	tr.startsolid = false;
 
-	// OPTIMIZE: Partition these?
-	Ray_t clippedRay = ray;
+	HitboxCandidate_t *pCandidates = (HitboxCandidate_t *)stackalloc( set->numhitboxes * sizeof( HitboxCandidate_t ) );
+	int nCandidates = CollectHitboxCandidates( ray.m_Start, ray.m_Delta, ray.m_Extents, pStudioHdr, set, hitboxbones, 
+		fContentsMask, false, vec3_origin, 1.0f, pCandidates );
+
 	int hitbox = -1;
-	for ( int i = 0; i < set->numhitboxes; i++ )
+	for ( int c = 0; c < nCandidates; c++ )
 	{
+		// Nearest first, nothing from here on can be hit before what we've hit
+		if ( pCandidates[c].m_flEnter > tr.fraction )
+			break;
+
+		int i = pCandidates[c].m_nHitbox;
 		mstudiobbox_t *pbox = set->pHitbox(i);
 
-		// Filter based on contents mask
-		int fBoneContents = pStudioHdr->pBone( pbox->bone )->contents;
-		if ( ( fBoneContents & fContentsMask ) == 0 )
-			continue;
-		
+		// The whole ray every time, the candidates already give us the early outs
 		//FIXME: Won't work with scaling!
 		trace_t obbTrace;
-		if ( IntersectRayWithOBB( clippedRay, *hitboxbones[pbox->bone], pbox->bbmin, pbox->bbmax, 0.0f, &obbTrace ) )
+		if ( IntersectRayWithOBB( ray, *hitboxbones[pbox->bone], pbox->bbmin, pbox->bbmax, 0.0f, &obbTrace ) && obbTrace.fraction <= tr.fraction )
 		{
 			tr.startpos = obbTrace.startpos;
 			tr.endpos = obbTrace.endpos;
 			tr.plane = obbTrace.plane;
 			tr.startsolid = obbTrace.startsolid;
 			tr.allsolid = obbTrace.allsolid;
-
-			// This logic here is to shorten the ray each time to get more early outs
-			tr.fraction *= obbTrace.fraction;
-			clippedRay.m_Delta *= obbTrace.fraction;
+			tr.fraction = obbTrace.fraction;
 			hitbox = i;
 			if (tr.startsolid)
 				break;
@@ -5337,60 +6644,53 @@ bool TraceToStudio( IPhysicsSurfaceProps *pProps, const Ray_t& ray, CStudioHdr *
 	int hitbox = -1;
 	int hitside = -1;
 
-	// OPTIMIZE: Partition these?
-	for ( int i = 0; i < set->numhitboxes; i++ )
+	// Because we're sending in a matrix with scale data, and because the matrix inversion in the hitbox
+	// code does not handle that case, we pre-scale the bones and ray down here and do our collision checks
+	// in unscaled space.  We can then rescale the results afterwards.
+	bool bScaled = ( flScale < 1.0f-FLT_EPSILON || flScale > 1.0f+FLT_EPSILON );
+	float invScale = 1.0f;
+	Ray_t newRay;
+	if ( bScaled )
 	{
-		mstudiobbox_t *pbox = set->pHitbox(i);
+		invScale = 1.0f / flScale;
 
-		// Filter based on contents mask
-		int fBoneContents = pStudioHdr->pBone( pbox->bone )->contents;
-		if ( ( fBoneContents & fContentsMask ) == 0 )
-			continue;
+		// Pre-scale our ray as well
+		Vector vecRayStart = ray.m_Start - vecOrigin;
+		vecRayStart *= invScale;
+		vecRayStart += vecOrigin;
 		
+		Vector vecRayDelta = ray.m_Delta * invScale;
+
+		newRay.Init( vecRayStart, vecRayStart + vecRayDelta );  
+	}
+	const Ray_t &clipRay = bScaled ? newRay : ray;
+
+	HitboxCandidate_t *pCandidates = (HitboxCandidate_t *)stackalloc( set->numhitboxes * sizeof( HitboxCandidate_t ) );
+	int nCandidates = CollectHitboxCandidates( clipRay.m_Start, clipRay.m_Delta, vec3_origin, pStudioHdr, set, hitboxbones, 
+		fContentsMask, bScaled, vecOrigin, invScale, pCandidates );
+
+	for ( int c = 0; c < nCandidates; c++ )
+	{
+		// Nearest first, nothing from here on can be hit before what we've hit
+		if ( pCandidates[c].m_flEnter > tr.fraction )
+			break;
+
+		int i = pCandidates[c].m_nHitbox;
+		mstudiobbox_t *pbox = set->pHitbox(i);
+
 		// columns are axes of the bones in world space, translation is in world space
 		matrix3x4_t& matrix = *hitboxbones[pbox->bone];
-		
-		// Because we're sending in a matrix with scale data, and because the matrix inversion in the hitbox
-		// code does not handle that case, we pre-scale the bones and ray down here and do our collision checks
-		// in unscaled space.  We can then rescale the results afterwards.
 
 		int side = -1;
-		if ( flScale < 1.0f-FLT_EPSILON || flScale > 1.0f+FLT_EPSILON )
+		if ( bScaled )
 		{
 			matrix3x4_t matScaled;
-			MatrixCopy( matrix, matScaled );
-			
-			float invScale = 1.0f / flScale;
-
-			Vector vecBoneOrigin;
-			MatrixGetColumn( matScaled, 3, vecBoneOrigin );
-			
-			// Pre-scale the origin down
-			Vector vecNewOrigin = vecBoneOrigin - vecOrigin;
-			vecNewOrigin *= invScale;
-			vecNewOrigin += vecOrigin;
-			MatrixSetColumn( vecNewOrigin, 3, matScaled );
-
-			// Scale it uniformly
-			VectorScale( matScaled[0], invScale, matScaled[0] );
-			VectorScale( matScaled[1], invScale, matScaled[1] );
-			VectorScale( matScaled[2], invScale, matScaled[2] );
-			
-			// Pre-scale our ray as well
-			Vector vecRayStart = ray.m_Start - vecOrigin;
-			vecRayStart *= invScale;
-			vecRayStart += vecOrigin;
-			
-			Vector vecRayDelta = ray.m_Delta * invScale;
-
-			Ray_t newRay;
-			newRay.Init( vecRayStart, vecRayStart + vecRayDelta );  
-			
-			side = ClipRayToHitbox( newRay, pbox, matScaled, tr );
+			ScaleHitboxMatrix( matrix, vecOrigin, invScale, matScaled );
+			side = ClipRayToHitbox( clipRay, pbox, matScaled, tr );
 		}
 		else
 		{
-			side = ClipRayToHitbox( ray, pbox, matrix, tr );
+			side = ClipRayToHitbox( clipRay, pbox, matrix, tr );
 		}
 
 		if ( side >= 0 )
@@ -332,6 +332,39 @@ void Studio_BuildMatrices(
 	);
 
 
+//-----------------------------------------------------------------------------
+// Purpose: sets up the bones of many entities at once on the task scheduler.
+//			Each request runs InitPose, AccumulatePose for every layer in
+//			order, CalcAutoplaySequences, CalcBoneAdj if there are controllers
+//			and Studio_BuildMatrices. IK isn't applied. The CStudioHdrs must be
+//			fully loaded and not change until the call returns.
+//-----------------------------------------------------------------------------
+struct BoneSetupLayer_t
+{
+	int		m_nSequence;
+	float	m_flCycle;
+	float	m_flWeight;
+};
+
+struct BoneSetupRequest_t
+{
+	const CStudioHdr		*m_pStudioHdr;
+	int						m_nBoneMask;
+	const float				*m_pPoseParameters;		// MAXSTUDIOPOSEPARAM
+	const float				*m_pControllers;		// MAXSTUDIOBONECTRLS, or NULL
+	const BoneSetupLayer_t	*m_pLayers;				// the base sequence first, at weight 1
+	int						m_nLayers;
+	float					m_flTime;				// for autoplay sequences
+	QAngle					m_angles;
+	Vector					m_origin;
+	float					m_flScale;
+	matrix3x4_t				*m_pBoneToWorld;		// one per bone of the model
+};
+
+// nGrain is the most requests a thread takes at once, 0 picks one from the number of threads
+void Studio_SetupBonesBatch( BoneSetupRequest_t *pRequests, int nRequests, int nGrain = 0 );
+
+
 // Get a bone->bone relative transform
 void Studio_CalcBoneToBoneTransform( const CStudioHdr *pStudioHdr, int inputBoneIndex, int outputBoneIndex, matrix3x4_t &matrixOut );
 
@@ -436,6 +469,24 @@ memhandle_t Studio_CreateBoneCache( bonecacheparams_t &params );
 void Studio_DestroyBoneCache( memhandle_t cacheHandle );
 void Studio_InvalidateBoneCache( memhandle_t cacheHandle );
 
+struct BoneCacheStats_t
+{
+	int m_nCaches;			// caches alive right now
+	int m_nMemoryUsed;
+	int m_nHits;			// lookups that found their cache
+	int m_nMisses;			// lookups of destroyed, evicted or never created caches
+	int m_nCreated;
+	int m_nEvicted;
+	int m_nAgingPasses;
+	int m_nContended;		// times a create, destroy or aging pass had to wait for a shard lock
+};
+
+// Totals since startup
+void Studio_GetBoneCacheStats( BoneCacheStats_t &stats );
+
+// Drops the decoded animation keyframes of every thread, call when models or animation data may be unloaded
+void Studio_InvalidateKeyframeCache();
+
 // Given a ray, trace for an intersection with this studiomodel.  Get the array of bones from StudioSetupHitboxBones
 bool TraceToStudio( class IPhysicsSurfaceProps *pProps, const Ray_t& ray, CStudioHdr *pStudioHdr, mstudiohitboxset_t *set, matrix3x4_t **hitboxbones, int fContentsMask, const Vector &vecOrigin, float flScale, trace_t &trace );
 
@@ -3259,4 +3259,338 @@ bool RayHasFullyContainedIntersectionWithQuad( const Ray_t &ray,
 	return true; //there were lines crossing the quad plane, and every line crossing that plane had its intersection with the plane within the quad's boundaries
 }
 
+
+//-----------------------------------------------------------------------------
+// Batch tests
+//-----------------------------------------------------------------------------
+void FourOBBs_t::Set( int nLane, const matrix3x4_t &matOBBToWorld, const Vector &vecMins, const Vector &vecMaxs )
+{
+	Assert( ( nLane >= 0 ) && ( nLane < 4 ) );
+	for ( int i = 0; i < 3; i++ )
+	{
+		m_Axis[i].X( nLane ) = matOBBToWorld[0][i];
+		m_Axis[i].Y( nLane ) = matOBBToWorld[1][i];
+		m_Axis[i].Z( nLane ) = matOBBToWorld[2][i];
+	}
+	m_Origin.X( nLane ) = matOBBToWorld[0][3];
+	m_Origin.Y( nLane ) = matOBBToWorld[1][3];
+	m_Origin.Z( nLane ) = matOBBToWorld[2][3];
+	m_Mins.X( nLane ) = vecMins.x;
+	m_Mins.Y( nLane ) = vecMins.y;
+	m_Mins.Z( nLane ) = vecMins.z;
+	m_Maxs.X( nLane ) = vecMaxs.x;
+	m_Maxs.Y( nLane ) = vecMaxs.y;
+	m_Maxs.Z( nLane ) = vecMaxs.z;
+}
+
+static const int s_nFourBitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+static FORCEINLINE void Collision_ClearBatchHits( int nCount, uint32 *pHitMask )
+{
+	memset( pHitMask, 0, COLLISION_BATCH_MASK_WORDS( nCount ) * sizeof( uint32 ) );
+}
+
+//-----------------------------------------------------------------------------
+// Records the hits of the four shapes starting at nFirst, returns how many
+// there were
+//-----------------------------------------------------------------------------
+static FORCEINLINE int Collision_StoreBatchHits( int nFirst, int nCount, const fltx4 &hit, const fltx4 &t, uint32 *pHitMask, float *pFractions )
+{
+	int nMask = TestSignSIMD( hit );
+
+	// Lanes past the end of the array hold garbage
+	if ( nCount - nFirst < 4 )
+	{
+		nMask &= ( 1 << ( nCount - nFirst ) ) - 1;
+	}
+
+	if ( !nMask )
+		return 0;
+
+	pHitMask[ nFirst >> 5 ] |= (uint32)nMask << ( nFirst & 31 );
+	if ( pFractions )
+	{
+		ALIGN16 float flT[4] ALIGN16_POST;
+		StoreAlignedSIMD( flT, t );
+		for ( int i = 0; i < 4; i++ )
+		{
+			if ( nMask & ( 1 << i ) )
+			{
+				pFractions[ nFirst + i ] = flT[i];
+			}
+		}
+	}
+
+	return s_nFourBitCount[nMask];
+}
+
+//-----------------------------------------------------------------------------
+// The face loop of IntersectRayWithBox for four boxes at a time. d1 and d2
+// are how far the ray start and end are in front of one face of each box.
+//-----------------------------------------------------------------------------
+struct FourBoxTraces_t
+{
+	fltx4 t1;
+	fltx4 t2;
+	fltx4 miss;
+	fltx4 startInside;
+
+	FourBoxTraces_t()
+	{
+		t1 = Four_NegativeOnes;
+		t2 = Four_Ones;
+		miss = Four_Zeros;
+		startInside = LoadAlignedSIMD( g_SIMD_AllOnesMask );
+	}
+
+	FORCEINLINE void ClipToFace( const fltx4 &d1, const fltx4 &d2, const fltx4 &tolerance )
+	{
+		fltx4 startInFront = CmpGtSIMD( d1, Four_Zeros );
+		fltx4 endInFront = CmpGtSIMD( d2, Four_Zeros );
+
+		// Completely in front of the face misses the box, completely behind it doesn't clip
+		miss = OrSIMD( miss, AndSIMD( startInFront, endInFront ) );
+		startInside = AndNotSIMD( startInFront, startInside );
+		fltx4 crosses = OrSIMD( startInFront, endInFront );
+
+		// Like the scalar version the tolerance pulls the entry back, it doesn't grow the box
+		fltx4 denom = SubSIMD( d1, d2 );
+		fltx4 safeDenom = MaskedAssign( CmpEqSIMD( denom, Four_Zeros ), Four_Ones, denom );
+		fltx4 enter = DivSIMD( MaxSIMD( SubSIMD( d1, tolerance ), Four_Zeros ), safeDenom );
+		fltx4 leave = DivSIMD( AddSIMD( d1, tolerance ), safeDenom );
+
+		fltx4 entering = CmpGtSIMD( d1, d2 );
+		t1 = MaskedAssign( AndSIMD( crosses, entering ), MaxSIMD( t1, enter ), t1 );
+		t2 = MaskedAssign( AndNotSIMD( entering, crosses ), MinSIMD( t2, leave ), t2 );
+	}
+
+	// Same test as IntersectRayWithBox
+	FORCEINLINE fltx4 Hit() const
+	{
+		return AndNotSIMD( miss, OrSIMD( startInside, EntersBox() ) );
+	}
+
+	// Where the ray enters the box, 0 if it starts inside without entering
+	FORCEINLINE fltx4 Fraction() const
+	{
+		return AndSIMD( EntersBox(), t1 );
+	}
+
+	FORCEINLINE fltx4 EntersBox() const
+	{
+		return AndSIMD( CmpLtSIMD( t1, t2 ), CmpGeSIMD( t1, Four_Zeros ) );
+	}
+};
+
+int IntersectRayWithBoxes( const Ray_t &ray, const FourVectors *pBoxMins, const FourVectors *pBoxMaxs, int nCount, 
+						   uint32 *pHitMask, float *pFractions, float flTolerance )
+{
+	Collision_ClearBatchHits( nCount, pHitMask );
+
+	FourVectors start, delta, extents;
+	start.DuplicateVector( ray.m_Start );
+	delta.DuplicateVector( ray.m_Delta );
+	extents.DuplicateVector( ray.m_Extents );
+	fltx4 tolerance = ReplicateX4( flTolerance );
+
+	int nHits = 0;
+	for ( int i = 0; i < nCount; i += 4, pBoxMins++, pBoxMaxs++ )
+	{
+		FourBoxTraces_t trace;
+		for ( int j = 0; j < 3; j++ )
+		{
+			fltx4 d1 = SubSIMD( SubSIMD( (*pBoxMins)[j], extents[j] ), start[j] );
+			trace.ClipToFace( d1, SubSIMD( d1, delta[j] ), tolerance );
+			d1 = SubSIMD( start[j], AddSIMD( (*pBoxMaxs)[j], extents[j] ) );
+			trace.ClipToFace( d1, AddSIMD( d1, delta[j] ), tolerance );
+		}
+
+		nHits += Collision_StoreBatchHits( i, nCount, trace.Hit(), trace.Fraction(), pHitMask, pFractions );
+	}
+
+	return nHits;
+}
+
+int IntersectRayWithOBBs( const Vector &vecRayStart, const Vector &vecRayDelta, const FourOBBs_t *pBoxes, int nCount, 
+						  uint32 *pHitMask, float *pFractions, float flTolerance )
+{
+	Collision_ClearBatchHits( nCount, pHitMask );
+
+	FourVectors start;
+	start.DuplicateVector( vecRayStart );
+	fltx4 tolerance = ReplicateX4( flTolerance );
+
+	int nHits = 0;
+	for ( int i = 0; i < nCount; i += 4, pBoxes++ )
+	{
+		FourVectors toStart = start;
+		toStart -= pBoxes->m_Origin;
+
+		// Box test in the space of each box
+		FourBoxTraces_t trace;
+		for ( int j = 0; j < 3; j++ )
+		{
+			fltx4 s = toStart * pBoxes->m_Axis[j];
+			fltx4 d = pBoxes->m_Axis[j] * vecRayDelta;
+			fltx4 d1 = SubSIMD( pBoxes->m_Mins[j], s );
+			trace.ClipToFace( d1, SubSIMD( d1, d ), tolerance );
+			d1 = SubSIMD( s, pBoxes->m_Maxs[j] );
+			trace.ClipToFace( d1, AddSIMD( d1, d ), tolerance );
+		}
+
+		nHits += Collision_StoreBatchHits( i, nCount, trace.Hit(), trace.Fraction(), pHitMask, pFractions );
+	}
+
+	return nHits;
+}
+
+int IntersectRayWithSpheres( const Vector &vecRayOrigin, const Vector &vecRayDelta, const FourVectors *pCenters, const fltx4 *pRadii, int nCount, 
+							 uint32 *pHitMask, float *pFractions )
+{
+	Collision_ClearBatchHits( nCount, pHitMask );
+
+	FourVectors origin;
+	origin.DuplicateVector( vecRayOrigin );
+
+	// See IntersectInfiniteRayWithSphere
+	float a = DotProduct( vecRayDelta, vecRayDelta );
+	fltx4 fourA = ReplicateX4( 4.0f * a );
+	fltx4 oo2a = ReplicateX4( ( a != 0.0f ) ? 0.5f / a : 0.0f );
+
+	int nHits = 0;
+	for ( int i = 0; i < nCount; i += 4, pCenters++, pRadii++ )
+	{
+		FourVectors sphereToRay = origin;
+		sphereToRay -= *pCenters;
+		fltx4 c = SubSIMD( sphereToRay * sphereToRay, MulSIMD( *pRadii, *pRadii ) );
+
+		fltx4 hit, t;
+		if ( a == 0.0f )
+		{
+			// Zero-length ray
+			hit = CmpLeSIMD( c, Four_Zeros );
+			t = Four_Zeros;
+		}
+		else
+		{
+			fltx4 b = MulSIMD( Four_Twos, sphereToRay * vecRayDelta );
+			fltx4 discrim = SubSIMD( MulSIMD( b, b ), MulSIMD( fourA, c ) );
+			hit = CmpGeSIMD( discrim, Four_Zeros );
+			discrim = SqrtSIMD( MaxSIMD( discrim, Four_Zeros ) );
+			fltx4 t1 = MulSIMD( SubSIMD( NegSIMD( b ), discrim ), oo2a );
+			fltx4 t2 = MulSIMD( SubSIMD( discrim, b ), oo2a );
+			hit = AndSIMD( hit, AndSIMD( CmpLeSIMD( t1, Four_Ones ), CmpGeSIMD( t2, Four_Zeros ) ) );
+			t = MaxSIMD( t1, Four_Zeros );
+		}
+
+		nHits += Collision_StoreBatchHits( i, nCount, hit, t, pHitMask, pFractions );
+	}
+
+	return nHits;
+}
+
+int IntersectRayWithTriangles( const Ray_t &ray, const FourVectors *pV1, const FourVectors *pV2, const FourVectors *pV3, int nCount, 
+							   bool oneSided, uint32 *pHitMask, float *pFractions )
+{
+	Collision_ClearBatchHits( nCount, pHitMask );
+
+	FourVectors start, delta;
+	start.DuplicateVector( ray.m_Start );
+	delta.DuplicateVector( ray.m_Delta );
+
+	// See IntersectRayWithTriangle
+	float boxt = ComputeBoxOffset( ray );
+	fltx4 tMin = ReplicateX4( -boxt );
+	fltx4 tMax = ReplicateX4( 1.0f + boxt );
+	fltx4 minDenom = ReplicateX4( 1e-6f );
+
+	int nHits = 0;
+	for ( int i = 0; i < nCount; i += 4, pV1++, pV2++, pV3++ )
+	{
+		FourVectors edge1 = *pV2;
+		edge1 -= *pV1;
+		FourVectors edge2 = *pV3;
+		edge2 -= *pV1;
+
+		FourVectors dirCrossEdge2 = delta ^ edge2;
+		fltx4 denom = dirCrossEdge2 * edge1;
+		fltx4 hit = CmpGeSIMD( fabs( denom ), minDenom );
+
+		// Cull out one-sided stuff
+		if ( oneSided )
+		{
+			FourVectors normal = edge1 ^ edge2;
+			hit = AndSIMD( hit, CmpLtSIMD( normal * delta, Four_Zeros ) );
+		}
+
+		fltx4 invDenom = DivSIMD( Four_Ones, denom );
+
+		FourVectors org = start;
+		org -= *pV1;
+		fltx4 u = MulSIMD( dirCrossEdge2 * org, invDenom );
+		hit = AndSIMD( hit, AndSIMD( CmpGeSIMD( u, Four_Zeros ), CmpLeSIMD( u, Four_Ones ) ) );
+
+		FourVectors orgCrossEdge1 = org ^ edge1;
+		fltx4 v = MulSIMD( orgCrossEdge1 * delta, invDenom );
+		hit = AndSIMD( hit, AndSIMD( CmpGeSIMD( v, Four_Zeros ), CmpLeSIMD( AddSIMD( u, v ), Four_Ones ) ) );
+
+		fltx4 t = MulSIMD( orgCrossEdge1 * edge2, invDenom );
+		hit = AndSIMD( hit, AndSIMD( CmpGeSIMD( t, tMin ), CmpLeSIMD( t, tMax ) ) );
+		t = MinSIMD( MaxSIMD( t, Four_Zeros ), Four_Ones );
+
+		nHits += Collision_StoreBatchHits( i, nCount, hit, t, pHitMask, pFractions );
+	}
+
+	return nHits;
+}
+
+int IsBoxIntersectingBoxes( const Vector &boxMin, const Vector &boxMax, const FourVectors *pBoxMins, const FourVectors *pBoxMaxs, int nCount, 
+						    uint32 *pHitMask )
+{
+	Collision_ClearBatchHits( nCount, pHitMask );
+
+	FourVectors mins, maxs;
+	mins.DuplicateVector( boxMin );
+	maxs.DuplicateVector( boxMax );
+
+	int nHits = 0;
+	for ( int i = 0; i < nCount; i += 4, pBoxMins++, pBoxMaxs++ )
+	{
+		fltx4 hit = AndSIMD( CmpLeSIMD( mins.x, pBoxMaxs->x ), CmpGeSIMD( maxs.x, pBoxMins->x ) );
+		hit = AndSIMD( hit, AndSIMD( CmpLeSIMD( mins.y, pBoxMaxs->y ), CmpGeSIMD( maxs.y, pBoxMins->y ) ) );
+		hit = AndSIMD( hit, AndSIMD( CmpLeSIMD( mins.z, pBoxMaxs->z ), CmpGeSIMD( maxs.z, pBoxMins->z ) ) );
+
+		nHits += Collision_StoreBatchHits( i, nCount, hit, Four_Zeros, pHitMask, NULL );
+	}
+
+	return nHits;
+}
+
+int IsBoxIntersectingSpheres( const Vector &boxMin, const Vector &boxMax, const FourVectors *pCenters, const fltx4 *pRadii, int nCount, 
+							  uint32 *pHitMask )
+{
+	Collision_ClearBatchHits( nCount, pHitMask );
+
+	FourVectors mins, maxs;
+	mins.DuplicateVector( boxMin );
+	maxs.DuplicateVector( boxMax );
+
+	int nHits = 0;
+	for ( int i = 0; i < nCount; i += 4, pCenters++, pRadii++ )
+	{
+		// Squared distance from each center to the box
+		fltx4 distSq = Four_Zeros;
+		for ( int j = 0; j < 3; j++ )
+		{
+			fltx4 d = MaxSIMD( MaxSIMD( SubSIMD( mins[j], (*pCenters)[j] ), SubSIMD( (*pCenters)[j], maxs[j] ) ), Four_Zeros );
+			distSq = MaddSIMD( d, d, distSq );
+		}
+
+		fltx4 hit = CmpLtSIMD( distSq, MulSIMD( *pRadii, *pRadii ) );
+		nHits += Collision_StoreBatchHits( i, nCount, hit, Four_Zeros, pHitMask, NULL );
+	}
+
+	return nHits;
+}
+
 #endif // !_STATIC_LINKED || _SHARED_LIB
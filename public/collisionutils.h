@@ -422,6 +422,63 @@ bool RayHasFullyContainedIntersectionWithQuad( const Ray_t &ray,
 											  const Vector &vQuadExtent2_Normalized, float fQuadExtent2Length );
 
 
+//-----------------------------------------------------------------------------
+//
+// Batch tests
+//
+// Test one ray or box against many shapes at once. The shapes are stored in
+// structure of arrays form, four to a FourVectors, so an array of nCount
+// shapes is ( nCount + 3 ) / 4 entries long and whatever is in the unused
+// lanes at the end is ignored.
+//
+// Hits come back as a bit mask, bit i of pHitMask[ i / 32 ] is set if shape i
+// was hit; size it with COLLISION_BATCH_MASK_WORDS. Each test returns the
+// number of shapes hit. Where the scalar version returns a fraction along the
+// ray, pFractions (optional) gets it too, for the shapes that were hit only.
+//
+//-----------------------------------------------------------------------------
+#define COLLISION_BATCH_MASK_WORDS( _count )	( ( (_count) + 31 ) >> 5 )
+
+// Four OBBs: their OBB to world transforms, split into axes and origin, and their local bounds
+struct FourOBBs_t
+{
+	FourVectors m_Axis[3];
+	FourVectors m_Origin;
+	FourVectors m_Mins;
+	FourVectors m_Maxs;
+
+	void Set( int nLane, const matrix3x4_t &matOBBToWorld, const Vector &vecMins, const Vector &vecMaxs );
+};
+
+// Same as IntersectRayWithBox( const Ray_t &, ... ) for each box: the box is grown by
+// the ray extents, flTolerance only pulls the entry fraction back. Fractions are
+// where the ray enters the box, 0 if it starts inside
+int IntersectRayWithBoxes( const Ray_t &ray, const FourVectors *pBoxMins, const FourVectors *pBoxMaxs, int nCount, 
+						   uint32 *pHitMask, float *pFractions = NULL, float flTolerance = 0.0f );
+
+// Same as the BoxTraceInfo_t version of IntersectRayWithOBB for each OBB. Fractions as above
+int IntersectRayWithOBBs( const Vector &vecRayStart, const Vector &vecRayDelta, const FourOBBs_t *pBoxes, int nCount, 
+						  uint32 *pHitMask, float *pFractions = NULL, float flTolerance = 0.0f );
+
+// Same as IntersectRayWithSphere for each sphere, the fraction is the clamped first intersection
+int IntersectRayWithSpheres( const Vector &vecRayOrigin, const Vector &vecRayDelta, const FourVectors *pCenters, const fltx4 *pRadii, int nCount, 
+							 uint32 *pHitMask, float *pFractions = NULL );
+
+// Same as IntersectRayWithTriangle for each triangle
+int IntersectRayWithTriangles( const Ray_t &ray, const FourVectors *pV1, const FourVectors *pV2, const FourVectors *pV3, int nCount, 
+							   bool oneSided, uint32 *pHitMask, float *pFractions = NULL );
+
+// Same as IsBoxIntersectingBox for each box
+int IsBoxIntersectingBoxes( const Vector &boxMin, const Vector &boxMax, const FourVectors *pBoxMins, const FourVectors *pBoxMaxs, int nCount, 
+						    uint32 *pHitMask );
+
+// Same as IsBoxIntersectingSphere for each sphere
+int IsBoxIntersectingSpheres( const Vector &boxMin, const Vector &boxMax, const FourVectors *pCenters, const fltx4 *pRadii, int nCount, 
+							  uint32 *pHitMask );
+
+// NOTE: There's no batch version of IsOBBIntersectingOBB yet
+
+
 
 //-----------------------------------------------------------------------------
 // INLINES
@@ -288,6 +288,55 @@ int FORCEINLINE CDispCollTree::BuildRayLeafList( int iNode, rayleaflist_t &list
 	return listIndex;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Same walk as BuildRayLeafList for a packet of rays. Every node in
+//          the list has the mask of the rays that touch it, so its boxes are
+//          loaded once for all of them. A ray sees its nodes in the same order
+//          as it would on its own.
+//-----------------------------------------------------------------------------
+int FORCEINLINE CDispCollTree::BuildRayPacketLeafList( int iNode, raypacketleaflist_t &list, unsigned int nRayMask )
+{
+	list.nodeList[0] = iNode;
+	list.rayMask[0] = nRayMask;
+	int listIndex = 0;
+	list.maxIndex = 0;
+	while ( listIndex <= list.maxIndex )
+	{
+		iNode = list.nodeList[listIndex];
+		// the rest are all leaves
+		if ( IsLeafNode(iNode) )
+			return listIndex;
+		unsigned int nodeRays = list.rayMask[listIndex];
+		listIndex++;
+		const CDispCollNode &node = m_nodes[iNode];
+		unsigned int childRays[4] = { 0, 0, 0, 0 };
+		for ( int iRay = 0; nodeRays; iRay++, nodeRays >>= 1 )
+		{
+			if ( !( nodeRays & 1 ) )
+				continue;
+			unsigned int mask = IntersectRayWithFourBoxes( list.rayStart[iRay], list.invDelta[iRay], list.rayExtents[iRay], node.m_mins, node.m_maxs );
+			childRays[0] |= ( mask & 1 ) << iRay;
+			childRays[1] |= ( ( mask >> 1 ) & 1 ) << iRay;
+			childRays[2] |= ( ( mask >> 2 ) & 1 ) << iRay;
+			childRays[3] |= ( ( mask >> 3 ) & 1 ) << iRay;
+		}
+
+		int child = Nodes_GetChild( iNode, 0 );
+		for ( int i = 0; i < 4; i++ )
+		{
+			if ( childRays[i] )
+			{
+				++list.maxIndex;
+				list.nodeList[list.maxIndex] = child + i;
+				list.rayMask[list.maxIndex] = childRays[i];
+			}
+		}
+		Assert(list.maxIndex < MAX_AABB_LIST);
+	}
+
+	return listIndex;
+}
+
 
 //-----------------------------------------------------------------------------
 // Purpose: Create the AABB tree.
@@ -937,6 +986,207 @@ bool CDispCollTree::AABBTree_SweepAABB( const Ray_t &ray, const Vector &vecInvDe
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Splats up to MAX_RAY_PACKET rays for the box tests, returns the
+//          mask with a bit set for each of them
+//-----------------------------------------------------------------------------
+static unsigned int InitRayPacket( raypacketleaflist_t &list, const Ray_t *pRays, int nRays )
+{
+	Assert( nRays > 0 && nRays <= MAX_RAY_PACKET );
+	for ( int i = 0; i < nRays; i++ )
+	{
+		const Ray_t &ray = pRays[i];
+		list.invDelta[i].DuplicateVector( ray.InvDelta() );
+		list.rayStart[i].DuplicateVector( ray.m_Start );
+		Vector ext = ray.m_Extents + g_Vec3DispCollEpsilons;
+		list.rayExtents[i].DuplicateVector( ext );
+	}
+
+	return 0xffffffffu >> ( MAX_RAY_PACKET - nRays );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+int CDispCollTree::AABBTree_RayPacket( const Ray_t *pRays, int nRays, CBaseTrace * const *ppTraces, bool *pHit, bool bSide )
+{
+	VPROF("AABBTree_RayPacket");
+
+	if ( pHit )
+	{
+		memset( pHit, 0, nRays * sizeof( bool ) );
+	}
+
+	// Check for ray test.
+	if ( CheckFlags( CCoreDispInfo::SURF_NORAY_COLL ) )
+		return 0;
+
+	// Check for opacity.
+	if ( !( m_nContents & MASK_OPAQUE ) )
+		return 0;
+
+	int nHits = 0;
+	raypacketleaflist_t list;
+	CDispCollTri *pImpactTri[MAX_RAY_PACKET];
+	for ( int iFirst = 0; iFirst < nRays; iFirst += MAX_RAY_PACKET )
+	{
+		int nPacket = MIN( nRays - iFirst, MAX_RAY_PACKET );
+		const Ray_t *pPacketRays = pRays + iFirst;
+		CBaseTrace * const *ppPacketTraces = ppTraces + iFirst;
+
+		unsigned int nRayMask = InitRayPacket( list, pPacketRays, nPacket );
+		int listIndex = BuildRayPacketLeafList( DISPCOLL_ROOTNODE_INDEX, list, nRayMask );
+
+		for ( int i = 0; i < nPacket; i++ )
+		{
+			pImpactTri[i] = NULL;
+		}
+
+		for ( ; listIndex <= list.maxIndex; listIndex++ )
+		{
+			int leafIndex = list.nodeList[listIndex] - m_nodes.Count();
+			CDispCollTri *pTri0 = &m_aTris[m_leaves[leafIndex].m_tris[0]];
+			CDispCollTri *pTri1 = &m_aTris[m_leaves[leafIndex].m_tris[1]];
+			const Vector &vecTri0A = m_aVerts[pTri0->GetVert( 0 )];
+			const Vector &vecTri0B = m_aVerts[pTri0->GetVert( 2 )];
+			const Vector &vecTri0C = m_aVerts[pTri0->GetVert( 1 )];
+			const Vector &vecTri1A = m_aVerts[pTri1->GetVert( 0 )];
+			const Vector &vecTri1B = m_aVerts[pTri1->GetVert( 2 )];
+			const Vector &vecTri1C = m_aVerts[pTri1->GetVert( 1 )];
+
+			unsigned int leafRays = list.rayMask[listIndex];
+			for ( int iRay = 0; leafRays; iRay++, leafRays >>= 1 )
+			{
+				if ( !( leafRays & 1 ) )
+					continue;
+
+				const Ray_t &ray = pPacketRays[iRay];
+				CBaseTrace *pTrace = ppPacketTraces[iRay];
+				float flFrac = IntersectRayWithTriangle( ray, vecTri0A, vecTri0B, vecTri0C, bSide );
+				if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
+				{
+					pTrace->fraction = flFrac;
+					pImpactTri[iRay] = pTri0;
+				}
+
+				flFrac = IntersectRayWithTriangle( ray, vecTri1A, vecTri1B, vecTri1C, bSide );
+				if( ( flFrac >= 0.0f ) && ( flFrac < pTrace->fraction ) )
+				{
+					pTrace->fraction = flFrac;
+					pImpactTri[iRay] = pTri1;
+				}
+			}
+		}
+
+		for ( int i = 0; i < nPacket; i++ )
+		{
+			if ( !pImpactTri[i] )
+				continue;
+
+			// Collision.
+			CBaseTrace *pTrace = ppPacketTraces[i];
+			VectorCopy( pImpactTri[i]->m_vecNormal, pTrace->plane.normal );
+			pTrace->plane.dist = pImpactTri[i]->m_flDist;
+			pTrace->dispFlags = pImpactTri[i]->m_uiFlags;
+			if ( pHit )
+			{
+				pHit[iFirst + i] = true;
+			}
+			nHits++;
+		}
+	}
+
+	return nHits;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+int CDispCollTree::AABBTree_SweepAABBPacket( const Ray_t *pRays, int nRays, CBaseTrace * const *ppTraces, bool *pHit )
+{
+	VPROF( "DispHullTestPacket" );
+
+	if ( pHit )
+	{
+		memset( pHit, 0, nRays * sizeof( bool ) );
+	}
+
+	// Check for hull test.
+	if ( CheckFlags( CCoreDispInfo::SURF_NOHULL_COLL ) )
+		return 0;
+
+	int nHits = 0;
+	bool bLocked = false;
+	raypacketleaflist_t list;
+	Vector rayDir[MAX_RAY_PACKET];
+	float flFrac[MAX_RAY_PACKET];
+	for ( int iFirst = 0; iFirst < nRays; iFirst += MAX_RAY_PACKET )
+	{
+		int nPacket = MIN( nRays - iFirst, MAX_RAY_PACKET );
+		const Ray_t *pPacketRays = pRays + iFirst;
+		CBaseTrace * const *ppPacketTraces = ppTraces + iFirst;
+
+		unsigned int nRayMask = InitRayPacket( list, pPacketRays, nPacket );
+		int listIndex = BuildRayPacketLeafList( 0, list, nRayMask );
+		if ( listIndex > list.maxIndex )
+			continue;
+
+		// Hold on to the cache until the whole batch is done
+		if ( !bLocked )
+		{
+			LockCache();
+			bLocked = true;
+		}
+
+		for ( int i = 0; i < nPacket; i++ )
+		{
+			VectorCopy( pPacketRays[i].m_Delta, rayDir[i] );
+			VectorNormalize( rayDir[i] );
+			// Save fraction.
+			flFrac[i] = ppPacketTraces[i]->fraction;
+		}
+
+		for ( ; listIndex <= list.maxIndex; listIndex++ )
+		{
+			int leafIndex = list.nodeList[listIndex] - m_nodes.Count();
+			int iTri0 = m_leaves[leafIndex].m_tris[0];
+			int iTri1 = m_leaves[leafIndex].m_tris[1];
+			CDispCollTri *pTri0 = &m_aTris[iTri0];
+			CDispCollTri *pTri1 = &m_aTris[iTri1];
+
+			unsigned int leafRays = list.rayMask[listIndex];
+			for ( int iRay = 0; leafRays; iRay++, leafRays >>= 1 )
+			{
+				if ( !( leafRays & 1 ) )
+					continue;
+
+				SweepAABBTriIntersect( pPacketRays[iRay], rayDir[iRay], iTri0, pTri0, ppPacketTraces[iRay] );
+				SweepAABBTriIntersect( pPacketRays[iRay], rayDir[iRay], iTri1, pTri1, ppPacketTraces[iRay] );
+			}
+		}
+
+		for ( int i = 0; i < nPacket; i++ )
+		{
+			// Collision.
+			if ( ppPacketTraces[i]->fraction < flFrac[i] )
+			{
+				if ( pHit )
+				{
+					pHit[iFirst + i] = true;
+				}
+				nHits++;
+			}
+		}
+	}
+
+	if ( bLocked )
+	{
+		UnlockCache();
+	}
+
+	return nHits;
+}
+
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
 bool CDispCollTree::ResolveRayPlaneIntersect( float flStart, float flEnd, const Vector &vecNormal, float flDist, CDispCollHelper *pHelper )
@@ -148,6 +148,19 @@ struct rayleaflist_t
 	int maxIndex;
 };
 
+// rays traced together in one walk of the tree, each node in the list carries a mask of the rays that reach it
+const int MAX_RAY_PACKET = 32;
+
+struct raypacketleaflist_t
+{
+	FourVectors rayStart[MAX_RAY_PACKET];
+	FourVectors rayExtents[MAX_RAY_PACKET];
+	FourVectors invDelta[MAX_RAY_PACKET];
+	int nodeList[MAX_AABB_LIST];
+	unsigned int rayMask[MAX_AABB_LIST];
+	int maxIndex;
+};
+
 //=============================================================================
 //
 // Displacement Collision Tree Data
@@ -172,6 +185,14 @@ public:
 	// NOTE: These assume you've precalculated invDelta as well as culled to the bounds of this disp
 	bool AABBTree_SweepAABB( const Ray_t &ray, const Vector &invDelta, CBaseTrace *pTrace );
 
+	// Packet versions of the ray and hull tests: the rays are walked down the tree together
+	// so each node and leaf is only loaded once per MAX_RAY_PACKET rays, and the tri cache is
+	// locked once for the whole batch. Each trace must come in with its fraction set, same as
+	// the single ray versions. pHit (optional) gets whether each ray hit this disp.
+	// Returns the number of rays that hit.
+	int AABBTree_RayPacket( const Ray_t *pRays, int nRays, CBaseTrace * const *ppTraces, bool *pHit = NULL, bool bSide = true );
+	int AABBTree_SweepAABBPacket( const Ray_t *pRays, int nRays, CBaseTrace * const *ppTraces, bool *pHit = NULL );
+
 	// Hull Intersection.
 	bool AABBTree_IntersectAABB( const Vector &absMins, const Vector &absMaxs );
 
@@ -265,6 +286,7 @@ protected:
 	void AABBTree_TreeTrisRayBarycentricTest( const Ray_t &ray, const Vector &vecInvDelta, int iNode, RayDispOutput_t &output, CDispCollTri **pImpactTri );
 
 	int FORCEINLINE BuildRayLeafList( int iNode, rayleaflist_t &list );
+	int FORCEINLINE BuildRayPacketLeafList( int iNode, raypacketleaflist_t &list, unsigned int nRayMask );
 
 	struct AABBTree_TreeTrisSweepTest_Args_t
 	{
@@ -591,6 +591,15 @@ inline void MatrixMultiply ( const matrix3x4_t &in1, const matrix3x4_t &in2, mat
 	ConcatTransforms( in1, in2, out );
 }
 
+// Batched versions of VectorTransform, ConcatTransforms, QuaternionMatrix and
+// AngleMatrix, several items at a time with SIMD. pOut may be the same array
+// as an input but must not partially overlap one. pPos may be NULL for a
+// zero translation.
+void VectorTransformArray( const Vector *pIn, const matrix3x4_t &matrix, Vector *pOut, int nCount );
+void ConcatTransformsArray( const matrix3x4_t *pIn1, const matrix3x4_t *pIn2, matrix3x4_t *pOut, int nCount );
+void QuaternionMatrixArray( const Quaternion *pQ, const Vector *pPos, matrix3x4_t *pOut, int nCount );
+void AngleMatrixArray( const QAngle *pAngles, const Vector *pPos, matrix3x4_t *pOut, int nCount );
+
 void QuaternionSlerp( const Quaternion &p, const Quaternion &q, float t, Quaternion &qt );
 void QuaternionSlerpNoAlign( const Quaternion &p, const Quaternion &q, float t, Quaternion &qt );
 void QuaternionBlend( const Quaternion &p, const Quaternion &q, float t, Quaternion &qt );
@@ -1784,6 +1793,12 @@ bool MathLib_3DNowEnabled( void );
 bool MathLib_MMXEnabled( void );
 bool MathLib_SSEEnabled( void );
 bool MathLib_SSE2Enabled( void );
+bool MathLib_AVXEnabled( void );
+bool MathLib_AVX2Enabled( void );
+bool MathLib_AVX512FEnabled( void );
+
+// The widest SIMD (4 or 8 floats) this CPU runs natively, see mathlib/ssewide.h
+int MathLib_SIMDLanes( void );
 
 float Approach( float target, float value, float speed );
 float ApproachAngle( float target, float value, float speed );
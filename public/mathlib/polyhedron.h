@@ -66,6 +66,17 @@ private:
 CPolyhedron *GeneratePolyhedronFromPlanes( const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory = false ); //be sure to polyhedron->Release()
 CPolyhedron *ClipPolyhedron( const CPolyhedron *pExistingPolyhedron, const float *pOutwardFacingPlanes, int iPlaneCount, float fOnPlaneEpsilon, bool bUseTemporaryMemory = false ); //this does NOT modify/delete the existing polyhedron
 
+struct PolyhedronClip_t
+{
+	const CPolyhedron *pPolyhedron; //polyhedron to clip, NULL generates one from the planes like GeneratePolyhedronFromPlanes()
+	const float *pOutwardFacingPlanes;
+	int iPlaneCount;
+	CPolyhedron *pResult; //filled in by ClipPolyhedra(), NULL if nothing is left. be sure to pResult->Release()
+};
+
+typedef void (*PolyhedronForEachFn_t)( int iCount, void (*pfnBody)( int i, void *pContext ), void *pContext ); //must call pfnBody( i, pContext ) for every i in [0, iCount), in any order on any thread
+void ClipPolyhedra( PolyhedronClip_t *pClips, int iClipCount, float fOnPlaneEpsilon, PolyhedronForEachFn_t pfnForEach = NULL ); //pass ParallelForCallback from tier1/taskscheduler.h to do the clips in parallel, NULL does them one after the other. Results never use temporary memory
+
 CPolyhedron *GetTempPolyhedron( unsigned short iVertices, unsigned short iLines, unsigned short iIndices, unsigned short iPolygons ); //grab the temporary polyhedron. Avoids new/delete for quick work. Can only be in use by one chunk of code at a time
 
 
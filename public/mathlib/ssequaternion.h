@@ -363,5 +363,176 @@ FORCEINLINE fltx4 QuaternionSlerpSIMD( const fltx4 &p, const fltx4 &q, float t )
 
 #endif // ALLOW_SIMD_QUATERNION_MATH
 
+
+//---------------------------------------------------------------------
+// Four quaternions in structure of arrays form, one per lane.
+// Unlike the functions above these don't need any horizontal
+// operations, so they're fine to use on every platform.
+//---------------------------------------------------------------------
+class ALIGN16 FourQuaternions
+{
+public:
+	fltx4 x, y, z, w;
+
+	FORCEINLINE void LoadAndSwizzle( const Quaternion &a, const Quaternion &b, const Quaternion &c, const Quaternion &d )
+	{
+		x = LoadUnalignedSIMD( a.Base() );
+		y = LoadUnalignedSIMD( b.Base() );
+		z = LoadUnalignedSIMD( c.Base() );
+		w = LoadUnalignedSIMD( d.Base() );
+		TransposeSIMD( x, y, z, w );
+	}
+
+	FORCEINLINE void SwizzleAndStore( Quaternion &a, Quaternion &b, Quaternion &c, Quaternion &d ) const
+	{
+		fltx4 qa = x, qb = y, qc = z, qd = w;
+		TransposeSIMD( qa, qb, qc, qd );
+		StoreUnalignedSIMD( a.Base(), qa );
+		StoreUnalignedSIMD( b.Base(), qb );
+		StoreUnalignedSIMD( c.Base(), qc );
+		StoreUnalignedSIMD( d.Base(), qd );
+	}
+
+	FORCEINLINE fltx4 operator*( const FourQuaternions &q ) const		// dot product
+	{
+		fltx4 dot = MulSIMD( x, q.x );
+		dot = MaddSIMD( y, q.y, dot );
+		dot = MaddSIMD( z, q.z, dot );
+		dot = MaddSIMD( w, q.w, dot );
+		return dot;
+	}
+};
+
+// Flip the lanes of q that are more than 90 degrees away from p
+FORCEINLINE FourQuaternions QuaternionAlignSIMD( const FourQuaternions &p, const FourQuaternions &q )
+{
+	fltx4 flip = AndSIMD( CmpLtSIMD( p * q, Four_Zeros ), LoadAlignedSIMD( g_SIMD_signmask ) );
+	FourQuaternions result;
+	result.x = XorSIMD( q.x, flip );
+	result.y = XorSIMD( q.y, flip );
+	result.z = XorSIMD( q.z, flip );
+	result.w = XorSIMD( q.w, flip );
+	return result;
+}
+
+// Lanes of length zero are left alone
+FORCEINLINE FourQuaternions QuaternionNormalizeSIMD( const FourQuaternions &q )
+{
+	fltx4 radius = q * q;
+	fltx4 iradius = MaskedAssign( CmpGtSIMD( radius, Four_Zeros ), ReciprocalSqrtSIMD( radius ), Four_Ones );
+	FourQuaternions result;
+	result.x = MulSIMD( q.x, iradius );
+	result.y = MulSIMD( q.y, iradius );
+	result.z = MulSIMD( q.z, iradius );
+	result.w = MulSIMD( q.w, iradius );
+	return result;
+}
+
+// 0.0 returns p, 1.0 return q.
+FORCEINLINE FourQuaternions QuaternionBlendNoAlignSIMD( const FourQuaternions &p, const FourQuaternions &q, const fltx4 &t )
+{
+	fltx4 sclp = SubSIMD( Four_Ones, t );
+	FourQuaternions result;
+	result.x = MaddSIMD( sclp, p.x, MulSIMD( t, q.x ) );
+	result.y = MaddSIMD( sclp, p.y, MulSIMD( t, q.y ) );
+	result.z = MaddSIMD( sclp, p.z, MulSIMD( t, q.z ) );
+	result.w = MaddSIMD( sclp, p.w, MulSIMD( t, q.w ) );
+	return QuaternionNormalizeSIMD( result );
+}
+
+FORCEINLINE FourQuaternions QuaternionBlendSIMD( const FourQuaternions &p, const FourQuaternions &q, const fltx4 &t )
+{
+	return QuaternionBlendNoAlignSIMD( p, QuaternionAlignSIMD( p, q ), t );
+}
+
+// Blend towards the identity, see QuaternionIdentityBlend
+FORCEINLINE FourQuaternions QuaternionIdentityBlendSIMD( const FourQuaternions &p, const fltx4 &t )
+{
+	fltx4 sclp = SubSIMD( Four_Ones, t );
+	FourQuaternions result;
+	result.x = MulSIMD( p.x, sclp );
+	result.y = MulSIMD( p.y, sclp );
+	result.z = MulSIMD( p.z, sclp );
+	result.w = MaddSIMD( p.w, sclp, XorSIMD( t, AndSIMD( p.w, LoadAlignedSIMD( g_SIMD_signmask ) ) ) );
+	return QuaternionNormalizeSIMD( result );
+}
+
+// acos for [-1,1], Abramowitz & Stegun 4.4.46, error below 2e-8
+FORCEINLINE fltx4 _QuaternionArcCosSIMD( const fltx4 &x )
+{
+	fltx4 ax = fabs( x );
+	fltx4 poly = ReplicateX4( -0.0012624911f );
+	poly = MaddSIMD( poly, ax, ReplicateX4( 0.0066700901f ) );
+	poly = MaddSIMD( poly, ax, ReplicateX4( -0.0170881256f ) );
+	poly = MaddSIMD( poly, ax, ReplicateX4( 0.0308918810f ) );
+	poly = MaddSIMD( poly, ax, ReplicateX4( -0.0501743046f ) );
+	poly = MaddSIMD( poly, ax, ReplicateX4( 0.0889789874f ) );
+	poly = MaddSIMD( poly, ax, ReplicateX4( -0.2145988016f ) );
+	poly = MaddSIMD( poly, ax, ReplicateX4( 1.5707963050f ) );
+	fltx4 result = MulSIMD( poly, SqrtSIMD( MaxSIMD( SubSIMD( Four_Ones, ax ), Four_Zeros ) ) );
+
+	// acos( -x ) = pi - acos( x )
+	return MaskedAssign( CmpLtSIMD( x, Four_Zeros ), SubSIMD( ReplicateX4( M_PI_F ), result ), result );
+}
+
+// sin for [0,pi], folded onto [0,pi/2] and evaluated as a Taylor series, error below 1e-7
+FORCEINLINE fltx4 _QuaternionSinSIMD( const fltx4 &x )
+{
+	fltx4 a = MinSIMD( x, SubSIMD( ReplicateX4( M_PI_F ), x ) );
+	fltx4 a2 = MulSIMD( a, a );
+	fltx4 poly = ReplicateX4( -1.0f / 39916800.0f );
+	poly = MaddSIMD( poly, a2, ReplicateX4( 1.0f / 362880.0f ) );
+	poly = MaddSIMD( poly, a2, ReplicateX4( -1.0f / 5040.0f ) );
+	poly = MaddSIMD( poly, a2, ReplicateX4( 1.0f / 120.0f ) );
+	poly = MaddSIMD( poly, a2, ReplicateX4( -1.0f / 6.0f ) );
+	poly = MaddSIMD( poly, a2, Four_Ones );
+	return MulSIMD( poly, a );
+}
+
+// Same cases as QuaternionSlerpNoAlign, picked per lane. 0.0 returns p, 1.0 return q.
+FORCEINLINE FourQuaternions QuaternionSlerpNoAlignSIMD( const FourQuaternions &p, const FourQuaternions &q, const fltx4 &t )
+{
+	fltx4 cosom = p * q;
+	fltx4 epsilon = ReplicateX4( 0.000001f );
+	fltx4 sclp = SubSIMD( Four_Ones, t );
+	fltx4 sclq = t;
+
+	// Far enough apart for a real slerp
+	fltx4 slerpMask = CmpGtSIMD( SubSIMD( Four_Ones, cosom ), epsilon );
+	if ( TestSignSIMD( slerpMask ) )
+	{
+		fltx4 omega = _QuaternionArcCosSIMD( cosom );
+		fltx4 isinom = ReciprocalSIMD( _QuaternionSinSIMD( omega ) );
+		sclp = MaskedAssign( slerpMask, MulSIMD( _QuaternionSinSIMD( MulSIMD( sclp, omega ) ), isinom ), sclp );
+		sclq = MaskedAssign( slerpMask, MulSIMD( _QuaternionSinSIMD( MulSIMD( t, omega ) ), isinom ), sclq );
+	}
+
+	FourQuaternions result;
+	result.x = MaddSIMD( sclp, p.x, MulSIMD( sclq, q.x ) );
+	result.y = MaddSIMD( sclp, p.y, MulSIMD( sclq, q.y ) );
+	result.z = MaddSIMD( sclp, p.z, MulSIMD( sclq, q.z ) );
+	result.w = MaddSIMD( sclp, p.w, MulSIMD( sclq, q.w ) );
+
+	// Exactly opposite, go through the perpendicular quaternion instead
+	fltx4 oppositeMask = CmpLeSIMD( AddSIMD( Four_Ones, cosom ), epsilon );
+	if ( TestSignSIMD( oppositeMask ) )
+	{
+		fltx4 halfPi = ReplicateX4( 0.5f * M_PI_F );
+		fltx4 sclpOpp = _QuaternionSinSIMD( MulSIMD( SubSIMD( Four_Ones, t ), halfPi ) );
+		fltx4 sclqOpp = _QuaternionSinSIMD( MulSIMD( t, halfPi ) );
+		result.x = MaskedAssign( oppositeMask, MsubSIMD( sclqOpp, q.y, MulSIMD( sclpOpp, p.x ) ), result.x );
+		result.y = MaskedAssign( oppositeMask, MaddSIMD( sclqOpp, q.x, MulSIMD( sclpOpp, p.y ) ), result.y );
+		result.z = MaskedAssign( oppositeMask, MsubSIMD( sclqOpp, q.w, MulSIMD( sclpOpp, p.z ) ), result.z );
+		result.w = MaskedAssign( oppositeMask, q.z, result.w );
+	}
+
+	return result;
+}
+
+FORCEINLINE FourQuaternions QuaternionSlerpSIMD( const FourQuaternions &p, const FourQuaternions &q, const fltx4 &t )
+{
+	return QuaternionSlerpNoAlignSIMD( p, QuaternionAlignSIMD( p, q ), t );
+}
+
 #endif // SSEQUATMATH_H
 
@@ -0,0 +1,821 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: 8 and 16 lane versions of the fltx4 / FourVectors SIMD types.
+//
+// fltx8 is an AVX register when the file is compiled with AVX enabled, and a
+// pair of fltx4s everywhere else. fltx16 is always a pair of fltx8s; none of
+// the compilers we ship with can generate AVX-512 code yet.
+//
+// The operations are overloads of the fltx4 ones (AddSIMD, MaddSIMD,
+// CmpLtSIMD, ...), so code which only uses those works unchanged for any
+// width. SIMDLanes<N> supplies what can't be overloaded, like loads and
+// constants, along with a matching FourVectors type, which lets a kernel be
+// written once as a template on the lane count:
+//
+//	template < int LANES >
+//	void ScaleAll( float *pOut, const float *pIn, float flScale, int nCount )
+//	{
+//		typedef SIMDLanes<LANES> Lanes;
+//		typename Lanes::fltx scale = Lanes::Replicate( flScale );
+//		for ( int i = 0; i < nCount; i += LANES )
+//			StoreAlignedSIMD( pOut + i, MulSIMD( Lanes::LoadAligned( pIn + i ), scale ) );
+//	}
+//
+// How wide a fltx8 is depends on how the translation unit was compiled, so
+// a module has to be built with the same instruction set throughout. Don't
+// build single files with /arch:AVX2 (-mavx2) and pick their kernels at
+// runtime: the inline functions those files use (everything in here and in
+// ssemath.h) are emitted with AVX encodings, and the linker may keep those
+// copies for the whole module, which then crashes on CPUs without AVX.
+// MathLib_SIMDLanes() reports what the CPU can run, so a module built for AVX2
+// can check it at startup.
+//
+//=============================================================================//
+
+#ifndef SSEWIDE_H
+#define SSEWIDE_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "mathlib/ssemath.h"
+
+#if defined( __AVX__ ) && !defined( _X360 ) && ( USE_STDC_FOR_SIMD == 0 )
+#define SIMD_NATIVE_FLTX8 1
+#include <immintrin.h>
+#else
+#define SIMD_NATIVE_FLTX8 0
+#endif
+
+
+//-----------------------------------------------------------------------------
+// Lane counts and the operations that can't be picked by overloading
+//
+// These are keyed on the lane count rather than on the register type: gcc
+// drops the alignment attributes of __m128 / __m256 when they're used as a
+// template argument, and warns about it (-Wignored-attributes) everywhere
+// this file is included.
+//-----------------------------------------------------------------------------
+template < int LANES > struct SIMDTraits;
+
+template <> struct SIMDTraits< 4 >
+{
+	typedef fltx4 fltx;
+	enum { LANES = 4 };
+
+	static FORCEINLINE fltx LoadAligned( const float *pSIMD ) { return LoadAlignedSIMD( pSIMD ); }
+	static FORCEINLINE fltx LoadUnaligned( const float *pSIMD ) { return LoadUnalignedSIMD( pSIMD ); }
+	static FORCEINLINE fltx Replicate( float flValue ) { return ReplicateX4( flValue ); }
+	static FORCEINLINE fltx Zero() { return LoadZeroSIMD(); }
+	static FORCEINLINE fltx One() { return LoadOneSIMD(); }
+
+	// Builds a register out of LANES / 4 fltx4s, lowest lanes first, and splits it back up
+	static FORCEINLINE fltx FromFltx4( const fltx4 *pParts ) { return pParts[0]; }
+	static FORCEINLINE void ToFltx4( const fltx &a, fltx4 *pParts ) { pParts[0] = a; }
+};
+
+
+//-----------------------------------------------------------------------------
+// Two narrower registers used as one wide one
+//-----------------------------------------------------------------------------
+template < int HALF >
+struct SIMDPair_t
+{
+	typedef typename SIMDTraits< HALF >::fltx Half_t;
+
+	Half_t m_Lo;
+	Half_t m_Hi;
+};
+
+// SIMDTraits< 2 * HALF > for a pair, see the specializations below
+template < int HALF > struct SIMDPairTraits
+{
+	typedef SIMDPair_t< HALF > fltx;
+	enum { LANES = 2 * HALF };
+
+	static FORCEINLINE fltx LoadAligned( const float *pSIMD )
+	{
+		fltx ret;
+		ret.m_Lo = SIMDTraits< HALF >::LoadAligned( pSIMD );
+		ret.m_Hi = SIMDTraits< HALF >::LoadAligned( pSIMD + HALF );
+		return ret;
+	}
+
+	static FORCEINLINE fltx LoadUnaligned( const float *pSIMD )
+	{
+		fltx ret;
+		ret.m_Lo = SIMDTraits< HALF >::LoadUnaligned( pSIMD );
+		ret.m_Hi = SIMDTraits< HALF >::LoadUnaligned( pSIMD + HALF );
+		return ret;
+	}
+
+	static FORCEINLINE fltx Replicate( float flValue )
+	{
+		fltx ret;
+		ret.m_Lo = ret.m_Hi = SIMDTraits< HALF >::Replicate( flValue );
+		return ret;
+	}
+
+	static FORCEINLINE fltx Zero()
+	{
+		fltx ret;
+		ret.m_Lo = ret.m_Hi = SIMDTraits< HALF >::Zero();
+		return ret;
+	}
+
+	static FORCEINLINE fltx One()
+	{
+		fltx ret;
+		ret.m_Lo = ret.m_Hi = SIMDTraits< HALF >::One();
+		return ret;
+	}
+
+	static FORCEINLINE fltx FromFltx4( const fltx4 *pParts )
+	{
+		fltx ret;
+		ret.m_Lo = SIMDTraits< HALF >::FromFltx4( pParts );
+		ret.m_Hi = SIMDTraits< HALF >::FromFltx4( pParts + HALF / 4 );
+		return ret;
+	}
+
+	static FORCEINLINE void ToFltx4( const fltx &a, fltx4 *pParts )
+	{
+		SIMDTraits< HALF >::ToFltx4( a.m_Lo, pParts );
+		SIMDTraits< HALF >::ToFltx4( a.m_Hi, pParts + HALF / 4 );
+	}
+};
+
+
+#if SIMD_NATIVE_FLTX8
+
+//-----------------------------------------------------------------------------
+// AVX implementation. These need to be declared before the SIMDPair_t
+// templates below, which build fltx16 out of them.
+//-----------------------------------------------------------------------------
+typedef __m256 fltx8;
+
+template <> struct SIMDTraits< 8 >
+{
+	typedef fltx8 fltx;
+	enum { LANES = 8 };
+
+	static FORCEINLINE fltx LoadAligned( const float *pSIMD ) { return _mm256_load_ps( pSIMD ); }
+	static FORCEINLINE fltx LoadUnaligned( const float *pSIMD ) { return _mm256_loadu_ps( pSIMD ); }
+	static FORCEINLINE fltx Replicate( float flValue ) { return _mm256_set1_ps( flValue ); }
+	static FORCEINLINE fltx Zero() { return _mm256_setzero_ps(); }
+	static FORCEINLINE fltx One() { return _mm256_set1_ps( 1.0f ); }
+
+	static FORCEINLINE fltx FromFltx4( const fltx4 *pParts )
+	{
+		return _mm256_insertf128_ps( _mm256_castps128_ps256( pParts[0] ), pParts[1], 1 );
+	}
+
+	static FORCEINLINE void ToFltx4( const fltx &a, fltx4 *pParts )
+	{
+		pParts[0] = _mm256_castps256_ps128( a );
+		pParts[1] = _mm256_extractf128_ps( a, 1 );
+	}
+};
+
+FORCEINLINE void StoreAlignedSIMD( float * RESTRICT pSIMD, const fltx8 & a )
+{
+	_mm256_store_ps( pSIMD, a );
+}
+
+FORCEINLINE void StoreUnalignedSIMD( float * RESTRICT pSIMD, const fltx8 & a )
+{
+	_mm256_storeu_ps( pSIMD, a );
+}
+
+FORCEINLINE float SubFloat( const fltx8 & a, int idx )
+{
+	return ( reinterpret_cast< float const * >( &a ) )[idx];
+}
+
+FORCEINLINE float & SubFloat( fltx8 & a, int idx )
+{
+	return ( reinterpret_cast< float * >( &a ) )[idx];
+}
+
+FORCEINLINE fltx8 AndSIMD( const fltx8 & a, const fltx8 & b )				// a & b
+{
+	return _mm256_and_ps( a, b );
+}
+
+FORCEINLINE fltx8 AndNotSIMD( const fltx8 & a, const fltx8 & b )			// ~a & b
+{
+	return _mm256_andnot_ps( a, b );
+}
+
+FORCEINLINE fltx8 XorSIMD( const fltx8 & a, const fltx8 & b )				// a ^ b
+{
+	return _mm256_xor_ps( a, b );
+}
+
+FORCEINLINE fltx8 OrSIMD( const fltx8 & a, const fltx8 & b )				// a | b
+{
+	return _mm256_or_ps( a, b );
+}
+
+FORCEINLINE fltx8 MaskedAssign( const fltx8 & ReplacementMask, const fltx8 & NewValue, const fltx8 & OldValue )
+{
+	return OrSIMD(
+		AndSIMD( ReplacementMask, NewValue ),
+		AndNotSIMD( ReplacementMask, OldValue ) );
+}
+
+FORCEINLINE fltx8 AddSIMD( const fltx8 & a, const fltx8 & b )				// a+b
+{
+	return _mm256_add_ps( a, b );
+}
+
+FORCEINLINE fltx8 SubSIMD( const fltx8 & a, const fltx8 & b )				// a-b
+{
+	return _mm256_sub_ps( a, b );
+}
+
+FORCEINLINE fltx8 MulSIMD( const fltx8 & a, const fltx8 & b )				// a*b
+{
+	return _mm256_mul_ps( a, b );
+}
+
+FORCEINLINE fltx8 DivSIMD( const fltx8 & a, const fltx8 & b )				// a/b
+{
+	return _mm256_div_ps( a, b );
+}
+
+// With FMA the multiply isn't rounded on its own, so results can differ from
+// the fltx4 versions in the last bit.
+FORCEINLINE fltx8 MaddSIMD( const fltx8 & a, const fltx8 & b, const fltx8 & c )	// a*b + c
+{
+#ifdef __FMA__
+	return _mm256_fmadd_ps( a, b, c );
+#else
+	return _mm256_add_ps( _mm256_mul_ps( a, b ), c );
+#endif
+}
+
+FORCEINLINE fltx8 MsubSIMD( const fltx8 & a, const fltx8 & b, const fltx8 & c )	// c - a*b
+{
+#ifdef __FMA__
+	return _mm256_fnmadd_ps( a, b, c );
+#else
+	return _mm256_sub_ps( c, _mm256_mul_ps( a, b ) );
+#endif
+}
+
+FORCEINLINE fltx8 NegSIMD( const fltx8 &a )								// negate: -a
+{
+	return SubSIMD( _mm256_setzero_ps(), a );
+}
+
+FORCEINLINE int TestSignSIMD( const fltx8 & a )								// mask of which floats have the high bit set
+{
+	return _mm256_movemask_ps( a );
+}
+
+FORCEINLINE bool IsAnyNegative( const fltx8 & a )							// any lane < 0
+{
+	return ( 0 != TestSignSIMD( a ) );
+}
+
+FORCEINLINE fltx8 CmpEqSIMD( const fltx8 & a, const fltx8 & b )				// (a==b) ? ~0:0
+{
+	return _mm256_cmp_ps( a, b, _CMP_EQ_OQ );
+}
+
+FORCEINLINE fltx8 CmpGtSIMD( const fltx8 & a, const fltx8 & b )				// (a>b) ? ~0:0
+{
+	return _mm256_cmp_ps( a, b, _CMP_GT_OS );
+}
+
+FORCEINLINE fltx8 CmpGeSIMD( const fltx8 & a, const fltx8 & b )				// (a>=b) ? ~0:0
+{
+	return _mm256_cmp_ps( a, b, _CMP_GE_OS );
+}
+
+FORCEINLINE fltx8 CmpLtSIMD( const fltx8 & a, const fltx8 & b )				// (a<b) ? ~0:0
+{
+	return _mm256_cmp_ps( a, b, _CMP_LT_OS );
+}
+
+FORCEINLINE fltx8 CmpLeSIMD( const fltx8 & a, const fltx8 & b )				// (a<=b) ? ~0:0
+{
+	return _mm256_cmp_ps( a, b, _CMP_LE_OS );
+}
+
+FORCEINLINE bool IsAllGreaterThan( const fltx8 &a, const fltx8 &b )
+{
+	return TestSignSIMD( CmpLeSIMD( a, b ) ) == 0;
+}
+
+FORCEINLINE bool IsAllGreaterThanOrEq( const fltx8 &a, const fltx8 &b )
+{
+	return TestSignSIMD( CmpLtSIMD( a, b ) ) == 0;
+}
+
+FORCEINLINE bool IsAllEqual( const fltx8 & a, const fltx8 & b )
+{
+	return TestSignSIMD( CmpEqSIMD( a, b ) ) == 0xff;
+}
+
+FORCEINLINE bool IsAllZeros( const fltx8 & a )
+{
+	return TestSignSIMD( CmpEqSIMD( a, _mm256_setzero_ps() ) ) == 0xff;
+}
+
+FORCEINLINE fltx8 CmpInBoundsSIMD( const fltx8 & a, const fltx8 & b )		// (a <= b && a >= -b) ? ~0 : 0
+{
+	return AndSIMD( CmpLeSIMD( a, b ), CmpGeSIMD( a, NegSIMD( b ) ) );
+}
+
+FORCEINLINE fltx8 MinSIMD( const fltx8 & a, const fltx8 & b )				// min(a,b)
+{
+	return _mm256_min_ps( a, b );
+}
+
+FORCEINLINE fltx8 MaxSIMD( const fltx8 & a, const fltx8 & b )				// max(a,b)
+{
+	return _mm256_max_ps( a, b );
+}
+
+// Same results as the SSE FloorSIMD, which rounds negative numbers toward zero
+FORCEINLINE fltx8 FloorSIMD( const fltx8 &a )
+{
+	return _mm256_round_ps( a, _MM_FROUND_TO_ZERO );
+}
+
+FORCEINLINE fltx8 CeilSIMD( const fltx8 &a )
+{
+	return _mm256_ceil_ps( a );
+}
+
+inline fltx8 fabs( const fltx8 & x )
+{
+	return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), x );
+}
+
+FORCEINLINE fltx8 SqrtEstSIMD( const fltx8 & a )							// sqrt(a), more or less
+{
+	return _mm256_sqrt_ps( a );
+}
+
+FORCEINLINE fltx8 SqrtSIMD( const fltx8 & a )								// sqrt(a)
+{
+	return _mm256_sqrt_ps( a );
+}
+
+FORCEINLINE fltx8 ReciprocalSqrtEstSIMD( const fltx8 & a )					// 1/sqrt(a), more or less
+{
+	return _mm256_rsqrt_ps( a );
+}
+
+FORCEINLINE fltx8 ReciprocalSqrtEstSaturateSIMD( const fltx8 & a )
+{
+	fltx8 zero_mask = CmpEqSIMD( a, _mm256_setzero_ps() );
+	fltx8 ret = OrSIMD( a, AndSIMD( _mm256_set1_ps( FLT_EPSILON ), zero_mask ) );
+	return ReciprocalSqrtEstSIMD( ret );
+}
+
+/// uses newton iteration for higher precision results than ReciprocalSqrtEstSIMD
+FORCEINLINE fltx8 ReciprocalSqrtSIMD( const fltx8 & a )						// 1/sqrt(a)
+{
+	fltx8 guess = ReciprocalSqrtEstSIMD( a );
+	// newton iteration for 1/sqrt(a) : y(n+1) = 1/2 (y(n)*(3-a*y(n)^2));
+	guess = MulSIMD( guess, SubSIMD( _mm256_set1_ps( 3.0f ), MulSIMD( a, MulSIMD( guess, guess ) ) ) );
+	return MulSIMD( _mm256_set1_ps( 0.5f ), guess );
+}
+
+FORCEINLINE fltx8 ReciprocalEstSIMD( const fltx8 & a )						// 1/a, more or less
+{
+	return _mm256_rcp_ps( a );
+}
+
+FORCEINLINE fltx8 ReciprocalEstSaturateSIMD( const fltx8 & a )
+{
+	fltx8 zero_mask = CmpEqSIMD( a, _mm256_setzero_ps() );
+	fltx8 ret = OrSIMD( a, AndSIMD( _mm256_set1_ps( FLT_EPSILON ), zero_mask ) );
+	return ReciprocalEstSIMD( ret );
+}
+
+/// uses reciprocal approximation instruction plus newton iteration.
+FORCEINLINE fltx8 ReciprocalSIMD( const fltx8 & a )							// 1/a
+{
+	fltx8 ret = ReciprocalEstSIMD( a );
+	// newton iteration is: Y(n+1) = 2*Y(n)-a*Y(n)^2
+	return SubSIMD( AddSIMD( ret, ret ), MulSIMD( a, MulSIMD( ret, ret ) ) );
+}
+
+FORCEINLINE fltx8 ReciprocalSaturateSIMD( const fltx8 & a )
+{
+	fltx8 zero_mask = CmpEqSIMD( a, _mm256_setzero_ps() );
+	fltx8 ret = OrSIMD( a, AndSIMD( _mm256_set1_ps( FLT_EPSILON ), zero_mask ) );
+	return ReciprocalSIMD( ret );
+}
+
+#else // SIMD_NATIVE_FLTX8
+
+template <> struct SIMDTraits< 8 > : public SIMDPairTraits< 4 > {};
+typedef SIMDPair_t< 4 > fltx8;
+
+#endif // SIMD_NATIVE_FLTX8
+
+template <> struct SIMDTraits< 16 > : public SIMDPairTraits< 8 > {};
+typedef SIMDPair_t< 8 > fltx16;
+
+typedef const fltx8 & FLTX8;
+typedef const fltx16 & FLTX16;
+
+
+//-----------------------------------------------------------------------------
+// Paired implementation, every operation is done on both halves
+//-----------------------------------------------------------------------------
+#define SIMDPAIR_UNARY_OP( _name )															\
+	template < int HALF >																	\
+	FORCEINLINE SIMDPair_t< HALF > _name( const SIMDPair_t< HALF > &a )						\
+	{																						\
+		SIMDPair_t< HALF > ret;																\
+		ret.m_Lo = _name( a.m_Lo );															\
+		ret.m_Hi = _name( a.m_Hi );															\
+		return ret;																			\
+	}
+
+#define SIMDPAIR_BINARY_OP( _name )															\
+	template < int HALF >																	\
+	FORCEINLINE SIMDPair_t< HALF > _name( const SIMDPair_t< HALF > &a, const SIMDPair_t< HALF > &b )	\
+	{																						\
+		SIMDPair_t< HALF > ret;																\
+		ret.m_Lo = _name( a.m_Lo, b.m_Lo );													\
+		ret.m_Hi = _name( a.m_Hi, b.m_Hi );													\
+		return ret;																			\
+	}
+
+#define SIMDPAIR_TERNARY_OP( _name )														\
+	template < int HALF >																	\
+	FORCEINLINE SIMDPair_t< HALF > _name( const SIMDPair_t< HALF > &a, const SIMDPair_t< HALF > &b, const SIMDPair_t< HALF > &c )	\
+	{																						\
+		SIMDPair_t< HALF > ret;																\
+		ret.m_Lo = _name( a.m_Lo, b.m_Lo, c.m_Lo );											\
+		ret.m_Hi = _name( a.m_Hi, b.m_Hi, c.m_Hi );											\
+		return ret;																			\
+	}
+
+#define SIMDPAIR_ALL_OP( _name )															\
+	template < int HALF >																	\
+	FORCEINLINE bool _name( const SIMDPair_t< HALF > &a, const SIMDPair_t< HALF > &b )		\
+	{																						\
+		return _name( a.m_Lo, b.m_Lo ) && _name( a.m_Hi, b.m_Hi );							\
+	}
+
+SIMDPAIR_BINARY_OP( AndSIMD )
+SIMDPAIR_BINARY_OP( AndNotSIMD )
+SIMDPAIR_BINARY_OP( XorSIMD )
+SIMDPAIR_BINARY_OP( OrSIMD )
+SIMDPAIR_TERNARY_OP( MaskedAssign )
+SIMDPAIR_BINARY_OP( AddSIMD )
+SIMDPAIR_BINARY_OP( SubSIMD )
+SIMDPAIR_BINARY_OP( MulSIMD )
+SIMDPAIR_BINARY_OP( DivSIMD )
+SIMDPAIR_TERNARY_OP( MaddSIMD )
+SIMDPAIR_TERNARY_OP( MsubSIMD )
+SIMDPAIR_UNARY_OP( NegSIMD )
+SIMDPAIR_BINARY_OP( CmpEqSIMD )
+SIMDPAIR_BINARY_OP( CmpGtSIMD )
+SIMDPAIR_BINARY_OP( CmpGeSIMD )
+SIMDPAIR_BINARY_OP( CmpLtSIMD )
+SIMDPAIR_BINARY_OP( CmpLeSIMD )
+SIMDPAIR_BINARY_OP( CmpInBoundsSIMD )
+SIMDPAIR_ALL_OP( IsAllGreaterThan )
+SIMDPAIR_ALL_OP( IsAllGreaterThanOrEq )
+SIMDPAIR_ALL_OP( IsAllEqual )
+SIMDPAIR_BINARY_OP( MinSIMD )
+SIMDPAIR_BINARY_OP( MaxSIMD )
+SIMDPAIR_UNARY_OP( FloorSIMD )
+SIMDPAIR_UNARY_OP( CeilSIMD )
+SIMDPAIR_UNARY_OP( fabs )
+SIMDPAIR_UNARY_OP( SqrtEstSIMD )
+SIMDPAIR_UNARY_OP( SqrtSIMD )
+SIMDPAIR_UNARY_OP( ReciprocalSqrtEstSIMD )
+SIMDPAIR_UNARY_OP( ReciprocalSqrtEstSaturateSIMD )
+SIMDPAIR_UNARY_OP( ReciprocalSqrtSIMD )
+SIMDPAIR_UNARY_OP( ReciprocalEstSIMD )
+SIMDPAIR_UNARY_OP( ReciprocalEstSaturateSIMD )
+SIMDPAIR_UNARY_OP( ReciprocalSIMD )
+SIMDPAIR_UNARY_OP( ReciprocalSaturateSIMD )
+
+#undef SIMDPAIR_UNARY_OP
+#undef SIMDPAIR_BINARY_OP
+#undef SIMDPAIR_TERNARY_OP
+#undef SIMDPAIR_ALL_OP
+
+template < int HALF >
+FORCEINLINE void StoreAlignedSIMD( float * RESTRICT pSIMD, const SIMDPair_t< HALF > & a )
+{
+	StoreAlignedSIMD( pSIMD, a.m_Lo );
+	StoreAlignedSIMD( pSIMD + HALF, a.m_Hi );
+}
+
+template < int HALF >
+FORCEINLINE void StoreUnalignedSIMD( float * RESTRICT pSIMD, const SIMDPair_t< HALF > & a )
+{
+	StoreUnalignedSIMD( pSIMD, a.m_Lo );
+	StoreUnalignedSIMD( pSIMD + HALF, a.m_Hi );
+}
+
+template < int HALF >
+FORCEINLINE float SubFloat( const SIMDPair_t< HALF > & a, int idx )
+{
+	return ( reinterpret_cast< float const * >( &a ) )[idx];
+}
+
+template < int HALF >
+FORCEINLINE float & SubFloat( SIMDPair_t< HALF > & a, int idx )
+{
+	return ( reinterpret_cast< float * >( &a ) )[idx];
+}
+
+template < int HALF >
+FORCEINLINE int TestSignSIMD( const SIMDPair_t< HALF > & a )					// mask of which floats have the high bit set
+{
+	return TestSignSIMD( a.m_Lo ) | ( TestSignSIMD( a.m_Hi ) << HALF );
+}
+
+template < int HALF >
+FORCEINLINE bool IsAnyNegative( const SIMDPair_t< HALF > & a )				// any lane < 0
+{
+	return IsAnyNegative( a.m_Lo ) || IsAnyNegative( a.m_Hi );
+}
+
+template < int HALF >
+FORCEINLINE bool IsAllZeros( const SIMDPair_t< HALF > & a )
+{
+	return IsAllZeros( a.m_Lo ) && IsAllZeros( a.m_Hi );
+}
+
+
+//-----------------------------------------------------------------------------
+// FourVectors for any width. Has the FourVectors operations that don't
+// depend on the layout of a fltx4, plus loads and stores which take the
+// width into account.
+//-----------------------------------------------------------------------------
+template < int NUM_LANES >
+class CSIMDVectors
+{
+public:
+	typedef SIMDTraits< NUM_LANES > Traits;
+	typedef typename Traits::fltx FLTX;
+	enum { LANES = NUM_LANES };
+
+	FLTX x, y, z;
+
+	FORCEINLINE void DuplicateVector( Vector const &v )			//< set all vectors to the same vector value
+	{
+		x = Traits::Replicate( v.x );
+		y = Traits::Replicate( v.y );
+		z = Traits::Replicate( v.z );
+	}
+
+	FORCEINLINE FLTX const & operator[]( int idx ) const
+	{
+		return *( ( &x ) + idx );
+	}
+
+	FORCEINLINE FLTX & operator[]( int idx )
+	{
+		return *( ( &x ) + idx );
+	}
+
+	FORCEINLINE void operator+=( CSIMDVectors const &b )
+	{
+		x = AddSIMD( x, b.x );
+		y = AddSIMD( y, b.y );
+		z = AddSIMD( z, b.z );
+	}
+
+	FORCEINLINE void operator-=( CSIMDVectors const &b )
+	{
+		x = SubSIMD( x, b.x );
+		y = SubSIMD( y, b.y );
+		z = SubSIMD( z, b.z );
+	}
+
+	FORCEINLINE void operator*=( CSIMDVectors const &b )			//< scale all vectors per component scale
+	{
+		x = MulSIMD( x, b.x );
+		y = MulSIMD( y, b.y );
+		z = MulSIMD( z, b.z );
+	}
+
+	FORCEINLINE void operator*=( const FLTX & scale )
+	{
+		x = MulSIMD( x, scale );
+		y = MulSIMD( y, scale );
+		z = MulSIMD( z, scale );
+	}
+
+	FORCEINLINE void operator*=( float scale )
+	{
+		*this *= Traits::Replicate( scale );
+	}
+
+	FORCEINLINE FLTX operator*( CSIMDVectors const &b ) const		//< dot products
+	{
+		FLTX dot = MulSIMD( x, b.x );
+		dot = MaddSIMD( y, b.y, dot );
+		dot = MaddSIMD( z, b.z, dot );
+		return dot;
+	}
+
+	FORCEINLINE FLTX operator*( Vector const &b ) const			//< dot product all vectors with 1 vector
+	{
+		FLTX dot = MulSIMD( x, Traits::Replicate( b.x ) );
+		dot = MaddSIMD( y, Traits::Replicate( b.y ), dot );
+		dot = MaddSIMD( z, Traits::Replicate( b.z ), dot );
+		return dot;
+	}
+
+	FORCEINLINE void VProduct( CSIMDVectors const &b )				//< component by component mul
+	{
+		x = MulSIMD( x, b.x );
+		y = MulSIMD( y, b.y );
+		z = MulSIMD( z, b.z );
+	}
+
+	FORCEINLINE void MakeReciprocal( void )						//< (x,y,z)=(1/x,1/y,1/z)
+	{
+		x = ReciprocalSIMD( x );
+		y = ReciprocalSIMD( y );
+		z = ReciprocalSIMD( z );
+	}
+
+	FORCEINLINE void MakeReciprocalSaturate( void )				//< (x,y,z)=(1/x,1/y,1/z), 1/0=1.0e23
+	{
+		x = ReciprocalSaturateSIMD( x );
+		y = ReciprocalSaturateSIMD( y );
+		z = ReciprocalSaturateSIMD( z );
+	}
+
+	// Assumes the matrix is a rotation
+	FORCEINLINE void RotateBy( const matrix3x4_t& matrix )
+	{
+		FLTX x0 = MulSIMD( x, Traits::Replicate( matrix[0][0] ) );
+		FLTX y0 = MulSIMD( x, Traits::Replicate( matrix[1][0] ) );
+		FLTX z0 = MulSIMD( x, Traits::Replicate( matrix[2][0] ) );
+		x0 = MaddSIMD( y, Traits::Replicate( matrix[0][1] ), x0 );
+		y0 = MaddSIMD( y, Traits::Replicate( matrix[1][1] ), y0 );
+		z0 = MaddSIMD( y, Traits::Replicate( matrix[2][1] ), z0 );
+		x = MaddSIMD( z, Traits::Replicate( matrix[0][2] ), x0 );
+		y = MaddSIMD( z, Traits::Replicate( matrix[1][2] ), y0 );
+		z = MaddSIMD( z, Traits::Replicate( matrix[2][2] ), z0 );
+	}
+
+	// Assumes the vectors are points
+	FORCEINLINE void TransformBy( const matrix3x4_t& matrix )
+	{
+		RotateBy( matrix );
+		x = AddSIMD( x, Traits::Replicate( matrix[0][3] ) );
+		y = AddSIMD( y, Traits::Replicate( matrix[1][3] ) );
+		z = AddSIMD( z, Traits::Replicate( matrix[2][3] ) );
+	}
+
+	// X(),Y(),Z() - get at the desired component of the i'th vector.
+	FORCEINLINE float X( int idx ) const { return SubFloat( x, idx ); }
+	FORCEINLINE float Y( int idx ) const { return SubFloat( y, idx ); }
+	FORCEINLINE float Z( int idx ) const { return SubFloat( z, idx ); }
+	FORCEINLINE float & X( int idx ) { return SubFloat( x, idx ); }
+	FORCEINLINE float & Y( int idx ) { return SubFloat( y, idx ); }
+	FORCEINLINE float & Z( int idx ) { return SubFloat( z, idx ); }
+
+	FORCEINLINE Vector Vec( int idx ) const						//< unpack one of the vectors
+	{
+		return Vector( X( idx ), Y( idx ), Z( idx ) );
+	}
+
+	// Loads LANES consecutive Vectors, transposing them
+	FORCEINLINE void LoadAndSwizzle( const Vector *pVecs )
+	{
+		for ( int i = 0; i < LANES; i++ )
+		{
+			X( i ) = pVecs[i].x;
+			Y( i ) = pVecs[i].y;
+			Z( i ) = pVecs[i].z;
+		}
+	}
+
+	// Stores LANES consecutive Vectors
+	FORCEINLINE void StoreUnswizzled( Vector *pVecs ) const
+	{
+		for ( int i = 0; i < LANES; i++ )
+		{
+			pVecs[i].Init( X( i ), Y( i ), Z( i ) );
+		}
+	}
+
+	// Loads from structure of arrays data, each pointer must be aligned to LANES floats
+	FORCEINLINE void LoadAligned( const float *pX, const float *pY, const float *pZ )
+	{
+		x = Traits::LoadAligned( pX );
+		y = Traits::LoadAligned( pY );
+		z = Traits::LoadAligned( pZ );
+	}
+
+	FORCEINLINE void StoreAligned( float *pX, float *pY, float *pZ ) const
+	{
+		StoreAlignedSIMD( pX, x );
+		StoreAlignedSIMD( pY, y );
+		StoreAlignedSIMD( pZ, z );
+	}
+
+	FORCEINLINE FLTX length2( void ) const
+	{
+		return ( *this ) * ( *this );
+	}
+
+	FORCEINLINE FLTX length( void ) const
+	{
+		return SqrtEstSIMD( length2() );
+	}
+
+	/// normalize all vectors in place. not mathematically guaranteed to be accurate, but is for the lengths we care about
+	FORCEINLINE void VectorNormalizeFast( void )
+	{
+		*this *= ReciprocalSqrtEstSIMD( length2() );
+	}
+
+	/// normalize all vectors in place.
+	FORCEINLINE void VectorNormalize( void )
+	{
+		*this *= ReciprocalSqrtSIMD( length2() );
+	}
+
+	FORCEINLINE FLTX DistToSqr( CSIMDVectors const &pnt ) const
+	{
+		FLTX dX = SubSIMD( pnt.x, x );
+		FLTX dY = SubSIMD( pnt.y, y );
+		FLTX dZ = SubSIMD( pnt.z, z );
+		return MaddSIMD( dX, dX, MaddSIMD( dY, dY, MulSIMD( dZ, dZ ) ) );
+	}
+};
+
+/// form cross products
+template < int LANES >
+FORCEINLINE CSIMDVectors< LANES > operator ^( const CSIMDVectors< LANES > &a, const CSIMDVectors< LANES > &b )
+{
+	CSIMDVectors< LANES > ret;
+	ret.x = SubSIMD( MulSIMD( a.y, b.z ), MulSIMD( a.z, b.y ) );
+	ret.y = SubSIMD( MulSIMD( a.z, b.x ), MulSIMD( a.x, b.z ) );
+	ret.z = SubSIMD( MulSIMD( a.x, b.y ), MulSIMD( a.y, b.x ) );
+	return ret;
+}
+
+/// component-by-componentwise MAX operator
+template < int LANES >
+FORCEINLINE CSIMDVectors< LANES > maximum( const CSIMDVectors< LANES > &a, const CSIMDVectors< LANES > &b )
+{
+	CSIMDVectors< LANES > ret;
+	ret.x = MaxSIMD( a.x, b.x );
+	ret.y = MaxSIMD( a.y, b.y );
+	ret.z = MaxSIMD( a.z, b.z );
+	return ret;
+}
+
+/// component-by-componentwise MIN operator
+template < int LANES >
+FORCEINLINE CSIMDVectors< LANES > minimum( const CSIMDVectors< LANES > &a, const CSIMDVectors< LANES > &b )
+{
+	CSIMDVectors< LANES > ret;
+	ret.x = MinSIMD( a.x, b.x );
+	ret.y = MinSIMD( a.y, b.y );
+	ret.z = MinSIMD( a.z, b.z );
+	return ret;
+}
+
+typedef CSIMDVectors< 8 > EightVectors;
+typedef CSIMDVectors< 16 > SixteenVectors;
+
+
+//-----------------------------------------------------------------------------
+// Everything a kernel needs to know about a lane count
+//-----------------------------------------------------------------------------
+template < int LANES > struct SIMDLanes;
+
+// Not FourVectors, which has a different set of members; the layout is the same
+// so one can be copied into the other.
+template <> struct SIMDLanes< 4 > : public SIMDTraits< 4 >
+{
+	typedef CSIMDVectors< 4 > Vectors;
+};
+
+template <> struct SIMDLanes< 8 > : public SIMDTraits< 8 >
+{
+	typedef EightVectors Vectors;
+};
+
+template <> struct SIMDLanes< 16 > : public SIMDTraits< 16 >
+{
+	typedef SixteenVectors Vectors;
+};
+
+
+#endif // SSEWIDE_H
@@ -995,6 +995,331 @@ private:
 	CTSListBase m_FreeNodes;
 } TSLIST_NODE_ALIGN_POST;
 
+
+//-----------------------------------------------------------------------------
+// Bounded lock free queues over a ring buffer
+//
+// Unlike CTSQueue these never allocate after construction, and a push fails
+// when the queue is full. The capacity is rounded up to a power of two.
+//
+// CTSRingQueue is multi producer / multi consumer (D. Vyukov's algorithm):
+// every slot carries a sequence number that says which lap of the ring it is
+// ready for, so producers and consumers only contend on their own index.
+//
+// CTSRingQueueSPSC is for exactly one producer thread and one consumer thread
+// and needs no interlocked operations at all.
+//
+// The batch calls move as many items as they can and return the count.
+//-----------------------------------------------------------------------------
+#define TSRINGQUEUE_CACHE_LINE	64
+
+inline int TSRingQueueCapacity( int nCapacity )
+{
+	int nRounded = 2;
+	while ( nRounded < nCapacity )
+	{
+		nRounded <<= 1;
+	}
+	return nRounded;
+}
+
+template <typename T>
+class CTSRingQueue
+{
+public:
+	CTSRingQueue( int nCapacity )
+	{
+		Assert( nCapacity > 0 && nCapacity <= ( 1 << 30 ) );
+		m_nCapacity = TSRingQueueCapacity( nCapacity );
+		m_nMask = m_nCapacity - 1;
+		m_pCells = (Cell_t *)MemAlloc_AllocAligned( m_nCapacity * sizeof( Cell_t ), TSRINGQUEUE_CACHE_LINE );
+		for ( int i = 0; i < m_nCapacity; i++ )
+		{
+			Construct( &m_pCells[i].m_Elem );
+			m_pCells[i].m_nSequence = i;
+		}
+		m_nEnqueuePos = 0;
+		m_nDequeuePos = 0;
+	}
+
+	~CTSRingQueue()
+	{
+		for ( int i = 0; i < m_nCapacity; i++ )
+		{
+			Destruct( &m_pCells[i].m_Elem );
+		}
+		MemAlloc_FreeAligned( m_pCells );
+	}
+
+	bool PushItem( const T &item )
+	{
+		Cell_t *pCell;
+		uint32 nPos = m_nEnqueuePos;
+		for ( ;; )
+		{
+			pCell = &m_pCells[ nPos & m_nMask ];
+			int nDiff = (int)( pCell->m_nSequence - nPos );
+			if ( nDiff == 0 )
+			{
+				if ( ThreadInterlockedAssignIf( &m_nEnqueuePos, nPos + 1, nPos ) )
+					break;
+			}
+			else if ( nDiff < 0 )
+			{
+				// Still holds the item from the previous lap
+				return false;
+			}
+			nPos = m_nEnqueuePos;
+		}
+
+		WriteCell( pCell, nPos, item );
+		return true;
+	}
+
+	bool PopItem( T *pResult )
+	{
+		Cell_t *pCell;
+		uint32 nPos = m_nDequeuePos;
+		for ( ;; )
+		{
+			pCell = &m_pCells[ nPos & m_nMask ];
+			int nDiff = (int)( pCell->m_nSequence - ( nPos + 1 ) );
+			if ( nDiff == 0 )
+			{
+				if ( ThreadInterlockedAssignIf( &m_nDequeuePos, nPos + 1, nPos ) )
+					break;
+			}
+			else if ( nDiff < 0 )
+			{
+				// Nothing published here yet
+				return false;
+			}
+			nPos = m_nDequeuePos;
+		}
+
+		ReadCell( pCell, nPos, pResult );
+		return true;
+	}
+
+	// Claims a run of slots with one interlocked operation when it can. The
+	// slots before the last one were already claimed by the other side, so
+	// waiting for them to be released is short.
+	int PushItems( const T *pItems, int nItems )
+	{
+		uint32 nPos = m_nEnqueuePos;
+		int nFree = m_nCapacity - (int)( nPos - m_nDequeuePos );
+		int nBatch = MIN( nItems, nFree );
+		if ( nBatch > 1 )
+		{
+			uint32 nLast = nPos + nBatch - 1;
+			if ( m_pCells[ nLast & m_nMask ].m_nSequence == nLast && ThreadInterlockedAssignIf( &m_nEnqueuePos, nPos + nBatch, nPos ) )
+			{
+				for ( int i = 0; i < nBatch; i++ )
+				{
+					Cell_t *pCell = &m_pCells[ ( nPos + i ) & m_nMask ];
+					while ( pCell->m_nSequence != nPos + i )
+					{
+						ThreadPause();
+					}
+					WriteCell( pCell, nPos + i, pItems[i] );
+				}
+				return nBatch;
+			}
+		}
+
+		// Contended or nearly full, go one at a time
+		int nPushed = 0;
+		while ( nPushed < nItems && PushItem( pItems[nPushed] ) )
+		{
+			nPushed++;
+		}
+		return nPushed;
+	}
+
+	int PopItems( T *pResults, int nMaxItems )
+	{
+		uint32 nPos = m_nDequeuePos;
+		int nAvailable = (int)( m_nEnqueuePos - nPos );
+		int nBatch = MIN( nMaxItems, nAvailable );
+		if ( nBatch > 1 )
+		{
+			uint32 nLast = nPos + nBatch - 1;
+			if ( m_pCells[ nLast & m_nMask ].m_nSequence == nLast + 1 && ThreadInterlockedAssignIf( &m_nDequeuePos, nPos + nBatch, nPos ) )
+			{
+				for ( int i = 0; i < nBatch; i++ )
+				{
+					Cell_t *pCell = &m_pCells[ ( nPos + i ) & m_nMask ];
+					while ( pCell->m_nSequence != nPos + i + 1 )
+					{
+						ThreadPause();
+					}
+					ReadCell( pCell, nPos + i, &pResults[i] );
+				}
+				return nBatch;
+			}
+		}
+
+		int nPopped = 0;
+		while ( nPopped < nMaxItems && PopItem( &pResults[nPopped] ) )
+		{
+			nPopped++;
+		}
+		return nPopped;
+	}
+
+	// Only a snapshot while other threads are working on the queue
+	int Count() const
+	{
+		int nCount = (int)( m_nEnqueuePos - m_nDequeuePos );
+		return MIN( MAX( nCount, 0 ), m_nCapacity );
+	}
+
+	int Capacity() const { return m_nCapacity; }
+
+private:
+	struct Cell_t
+	{
+		uint32 volatile	m_nSequence;
+		T				m_Elem;
+	};
+
+	void WriteCell( Cell_t *pCell, uint32 nPos, const T &item )
+	{
+		pCell->m_Elem = item;
+		ThreadMemoryBarrier();
+		pCell->m_nSequence = nPos + 1;
+	}
+
+	void ReadCell( Cell_t *pCell, uint32 nPos, T *pResult )
+	{
+		ThreadMemoryBarrier();
+		*pResult = pCell->m_Elem;
+		ThreadMemoryBarrier();
+		pCell->m_nSequence = nPos + m_nCapacity;
+	}
+
+	// Producers and consumers each get their own cache line
+	Cell_t			*m_pCells;
+	int				m_nCapacity;
+	uint32			m_nMask;
+	char			m_Pad0[ TSRINGQUEUE_CACHE_LINE ];
+	uint32 volatile	m_nEnqueuePos;
+	char			m_Pad1[ TSRINGQUEUE_CACHE_LINE - sizeof( uint32 ) ];
+	uint32 volatile	m_nDequeuePos;
+	char			m_Pad2[ TSRINGQUEUE_CACHE_LINE - sizeof( uint32 ) ];
+
+private:
+	CTSRingQueue( const CTSRingQueue & );
+	CTSRingQueue &operator=( const CTSRingQueue & );
+};
+
+template <typename T>
+class CTSRingQueueSPSC
+{
+public:
+	CTSRingQueueSPSC( int nCapacity )
+	{
+		Assert( nCapacity > 0 && nCapacity <= ( 1 << 30 ) );
+		m_nCapacity = TSRingQueueCapacity( nCapacity );
+		m_nMask = m_nCapacity - 1;
+		m_pElems = (T *)MemAlloc_AllocAligned( m_nCapacity * sizeof( T ), TSRINGQUEUE_CACHE_LINE );
+		for ( int i = 0; i < m_nCapacity; i++ )
+		{
+			Construct( &m_pElems[i] );
+		}
+		m_nHead = m_nTail = 0;
+		m_nProducerHead = m_nConsumerTail = 0;
+	}
+
+	~CTSRingQueueSPSC()
+	{
+		for ( int i = 0; i < m_nCapacity; i++ )
+		{
+			Destruct( &m_pElems[i] );
+		}
+		MemAlloc_FreeAligned( m_pElems );
+	}
+
+	// Producer thread only
+	bool PushItem( const T &item )
+	{
+		return PushItems( &item, 1 ) == 1;
+	}
+
+	int PushItems( const T *pItems, int nItems )
+	{
+		uint32 nTail = m_nTail;
+		int nFree = m_nCapacity - (int)( nTail - m_nProducerHead );
+		if ( nFree < nItems )
+		{
+			// Only look at the consumer's index when our copy says we're full
+			m_nProducerHead = m_nHead;
+			nFree = m_nCapacity - (int)( nTail - m_nProducerHead );
+		}
+
+		int nCount = MIN( nItems, nFree );
+		for ( int i = 0; i < nCount; i++ )
+		{
+			m_pElems[ ( nTail + i ) & m_nMask ] = pItems[i];
+		}
+
+		ThreadMemoryBarrier();
+		m_nTail = nTail + nCount;
+		return nCount;
+	}
+
+	// Consumer thread only
+	bool PopItem( T *pResult )
+	{
+		return PopItems( pResult, 1 ) == 1;
+	}
+
+	int PopItems( T *pResults, int nMaxItems )
+	{
+		uint32 nHead = m_nHead;
+		int nAvailable = (int)( m_nConsumerTail - nHead );
+		if ( nAvailable < nMaxItems )
+		{
+			m_nConsumerTail = m_nTail;
+			nAvailable = (int)( m_nConsumerTail - nHead );
+		}
+
+		int nCount = MIN( nMaxItems, nAvailable );
+		ThreadMemoryBarrier();
+		for ( int i = 0; i < nCount; i++ )
+		{
+			pResults[i] = m_pElems[ ( nHead + i ) & m_nMask ];
+		}
+
+		ThreadMemoryBarrier();
+		m_nHead = nHead + nCount;
+		return nCount;
+	}
+
+	int Count() const { return (int)( m_nTail - m_nHead ); }
+	int Capacity() const { return m_nCapacity; }
+
+private:
+	T				*m_pElems;
+	int				m_nCapacity;
+	uint32			m_nMask;
+	char			m_Pad0[ TSRINGQUEUE_CACHE_LINE ];
+
+	// Written by the producer; m_nProducerHead is its cached copy of m_nHead
+	uint32 volatile	m_nTail;
+	uint32			m_nProducerHead;
+	char			m_Pad1[ TSRINGQUEUE_CACHE_LINE - 2 * sizeof( uint32 ) ];
+
+	// Written by the consumer; m_nConsumerTail is its cached copy of m_nTail
+	uint32 volatile	m_nHead;
+	uint32			m_nConsumerTail;
+	char			m_Pad2[ TSRINGQUEUE_CACHE_LINE - 2 * sizeof( uint32 ) ];
+
+private:
+	CTSRingQueueSPSC( const CTSRingQueueSPSC & );
+	CTSRingQueueSPSC &operator=( const CTSRingQueueSPSC & );
+};
+
 #if defined( _WIN32 )
 // Suppress this spurious warning:
 // warning C4700: uninitialized local variable 'oldHead' used
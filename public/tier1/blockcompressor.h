@@ -0,0 +1,250 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Streaming block compression on top of CUtlBuffer.
+//
+// Data written to a CBlockCompressor is cut into fixed size blocks which are
+// compressed independently with one of the tier1 codecs (Snappy, LZSS, LZMA).
+// Because blocks don't depend on each other they can be compressed on the
+// thread pool, and a block index written at the end of the stream lets
+// CBlockCompressedReader decompress arbitrary ranges without touching the
+// rest of the stream.
+//
+// Stream layout (all fields little endian):
+//
+//	header		blockstream_header_t
+//	blocks		{ uint32 nStoredSize | BLOCKSTREAM_STORED_RAW, uint32 nUncompressedSize, payload }*
+//	end			{ 0, 0 }
+//	index		uint32 nBlocks, blockstream_index_entry_t[nBlocks]
+//	trailer		blockstream_trailer_t
+//
+//=============================================================================
+
+#ifndef BLOCKCOMPRESSOR_H
+#define BLOCKCOMPRESSOR_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlbuffer.h"
+#include "tier1/utlvector.h"
+#include "tier1/utlmemory.h"
+
+class IThreadPool;
+
+#define BLOCKSTREAM_ID				uint32( ('B'<<24)|('C'<<16)|('M'<<8)|('P') )
+#define BLOCKSTREAM_INDEX_ID		uint32( ('B'<<24)|('I'<<16)|('D'<<8)|('X') )
+#define BLOCKSTREAM_VERSION			1
+#define BLOCKSTREAM_STORED_RAW		0x80000000
+
+#define BLOCKSTREAM_DEFAULT_BLOCK_SIZE	( 64 * 1024 )
+#define BLOCKSTREAM_MAX_BLOCK_SIZE		( 16 * 1024 * 1024 )
+
+enum CompressionType_t
+{
+	COMPRESSION_NONE = 0,		// Blocks are stored as-is
+	COMPRESSION_SNAPPY,
+	COMPRESSION_LZSS,
+	COMPRESSION_LZMA,
+
+	COMPRESSION_TYPE_COUNT,
+};
+
+#pragma pack(1)
+struct blockstream_header_t
+{
+	uint32	id;
+	uint8	version;
+	uint8	compressionType;	// CompressionType_t
+	uint16	reserved;
+	uint32	blockSize;
+};
+
+struct blockstream_index_entry_t
+{
+	uint64	uncompressedOffset;
+	uint32	frameOffset;		// Offset of the block frame from the start of the stream
+	uint32	uncompressedSize;
+};
+
+struct blockstream_trailer_t
+{
+	uint32	indexOffset;		// Offset of the index from the start of the stream
+	uint32	id;					// BLOCKSTREAM_INDEX_ID
+};
+#pragma pack()
+
+
+//-----------------------------------------------------------------------------
+// A codec which compresses self-contained blocks. Implementations must be
+// safe to call from several threads at once.
+//-----------------------------------------------------------------------------
+abstract_class ICompressionCodec
+{
+public:
+	virtual CompressionType_t GetType() const = 0;
+
+	// Some codecs are decode only in tier1 (LZMA encoding is tool time only)
+	virtual bool CanCompress() const = 0;
+
+	// Worst case size of the output of Compress
+	virtual unsigned int GetMaxCompressedSize( unsigned int nInputSize ) const = 0;
+
+	// Returns the compressed size, or 0 if the block couldn't be compressed into
+	// nOutputSize bytes, in which case the caller stores it uncompressed.
+	virtual unsigned int Compress( const void *pInput, unsigned int nInputSize, void *pOutput, unsigned int nOutputSize ) = 0;
+
+	// Returns true only if the block decoded to exactly nOutputSize bytes
+	virtual bool Decompress( const void *pInput, unsigned int nInputSize, void *pOutput, unsigned int nOutputSize ) = 0;
+};
+
+// Returns the built in codec for a compression type, or NULL if it isn't available in this build
+ICompressionCodec *GetCompressionCodec( CompressionType_t type );
+
+
+//-----------------------------------------------------------------------------
+// Streaming compressor interface
+//-----------------------------------------------------------------------------
+abstract_class ICompressor
+{
+public:
+	virtual ~ICompressor() {}
+
+	// Feed uncompressed data. Compressed output appears as whole blocks fill up.
+	virtual bool Write( const void *pData, int nBytes ) = 0;
+
+	// Compress whatever is left and write the block index. No more writes are allowed afterwards.
+	virtual bool Finish() = 0;
+
+	virtual int64 GetUncompressedSize() const = 0;
+	virtual int GetCompressedSize() const = 0;
+};
+
+
+//-----------------------------------------------------------------------------
+// Block stream compressor writing into a CUtlBuffer.
+//
+// With nParallelBlocks > 1, that many blocks are buffered up and compressed
+// together on the thread pool before being appended in order.
+//-----------------------------------------------------------------------------
+class CBlockCompressor : public ICompressor
+{
+public:
+	CBlockCompressor( CUtlBuffer &output, CompressionType_t type, int nBlockSize = BLOCKSTREAM_DEFAULT_BLOCK_SIZE, int nParallelBlocks = 1, IThreadPool *pThreadPool = NULL );
+	CBlockCompressor( CUtlBuffer &output, ICompressionCodec *pCodec, int nBlockSize = BLOCKSTREAM_DEFAULT_BLOCK_SIZE, int nParallelBlocks = 1, IThreadPool *pThreadPool = NULL );
+	virtual ~CBlockCompressor();
+
+	// ICompressor
+	virtual bool Write( const void *pData, int nBytes );
+	virtual bool Finish();
+	virtual int64 GetUncompressedSize() const	{ return m_nUncompressedSize; }
+	virtual int GetCompressedSize() const		{ return m_Output.TellPut() - m_nStreamStart; }
+
+	bool IsValid() const { return m_bValid; }
+
+	// Convenience for compressing a whole buffer at once
+	static bool CompressBuffer( CUtlBuffer &output, const void *pData, int nBytes, CompressionType_t type, int nBlockSize = BLOCKSTREAM_DEFAULT_BLOCK_SIZE, int nParallelBlocks = 1 );
+
+private:
+	struct BlockJob_t
+	{
+		ICompressionCodec	*m_pCodec;
+		const uint8			*m_pInput;
+		unsigned int		m_nInputSize;
+		uint8				*m_pOutput;
+		unsigned int		m_nOutputSize;
+		unsigned int		m_nCompressedSize;
+	};
+
+	void Init( ICompressionCodec *pCodec, int nBlockSize, int nParallelBlocks, IThreadPool *pThreadPool );
+	void FlushBlocks( const uint8 *pData, int nBytes );
+	void WriteFrame( const BlockJob_t &job );
+	static void CompressBlock( BlockJob_t &job );
+
+	CUtlBuffer							&m_Output;
+	ICompressionCodec					*m_pCodec;
+	IThreadPool							*m_pThreadPool;
+	int									m_nStreamStart;
+	int									m_nBlockSize;
+	int									m_nParallelBlocks;
+	int64								m_nUncompressedSize;
+	bool								m_bValid;
+	bool								m_bFinished;
+
+	CUtlMemory<uint8>					m_Pending;		// Uncompressed data waiting for a full batch
+	int									m_nPending;
+	CUtlMemory<uint8>					m_Scratch;		// Compression output for a batch
+	CUtlVector<BlockJob_t>				m_Jobs;
+	CUtlVector<blockstream_index_entry_t>	m_Index;
+};
+
+
+//-----------------------------------------------------------------------------
+// Streaming decompressor. Compressed bytes can be fed in arbitrary pieces,
+// whole blocks are decoded into the output buffer as they complete.
+//-----------------------------------------------------------------------------
+class CBlockDecompressor
+{
+public:
+	CBlockDecompressor();
+
+	// Returns false on a corrupt stream or an unsupported codec
+	bool Write( const void *pData, int nBytes, CUtlBuffer &output );
+
+	// True once the end of the block data has been seen
+	bool IsFinished() const		{ return m_bFinished; }
+	bool IsValid() const		{ return m_bValid; }
+
+	int64 GetUncompressedSize() const	{ return m_nUncompressedSize; }
+
+	// Convenience for decompressing a whole stream at once
+	static bool DecompressBuffer( const void *pStream, int nStreamSize, CUtlBuffer &output );
+
+private:
+	bool ProcessInput( CUtlBuffer &output );
+
+	CUtlBuffer			m_Input;
+	ICompressionCodec	*m_pCodec;
+	int					m_nBlockSize;
+	int64				m_nUncompressedSize;
+	bool				m_bHeaderParsed;
+	bool				m_bFinished;
+	bool				m_bValid;
+};
+
+
+//-----------------------------------------------------------------------------
+// Random access over a complete block stream in memory. The stream memory
+// must stay valid for the lifetime of the reader.
+//-----------------------------------------------------------------------------
+class CBlockCompressedReader
+{
+public:
+	CBlockCompressedReader();
+
+	bool Init( const void *pStream, int nStreamSize );
+	bool IsValid() const { return m_pStream != NULL; }
+
+	int64 GetUncompressedSize() const	{ return m_nUncompressedSize; }
+	int GetBlockCount() const			{ return m_Index.Count(); }
+
+	// Decompresses nBytes starting at uncompressed offset nOffset. Only the
+	// blocks overlapping the range are decoded; the last decoded block is
+	// cached so sequential small reads don't decode a block repeatedly.
+	bool ReadRange( int64 nOffset, int nBytes, void *pOutput );
+
+private:
+	int FindBlock( int64 nOffset ) const;
+	bool DecodeBlock( int iBlock, void *pOutput );
+
+	const uint8							*m_pStream;
+	int									m_nFrameAreaSize;
+	ICompressionCodec					*m_pCodec;
+	int64								m_nUncompressedSize;
+	CUtlVector<blockstream_index_entry_t>	m_Index;
+
+	CUtlMemory<uint8>					m_CachedBlock;
+	int									m_iCachedBlock;
+};
+
+#endif // BLOCKCOMPRESSOR_H
@@ -182,6 +182,258 @@ class CCallQueue : public CCallQueueT<>
 {
 };
 
+//-----------------------------------------------------
+// Multi-producer call queue
+//
+// Any number of threads can queue calls at once without locking, one thread
+// at a time runs them. Every producing thread appends its calls to its own
+// chain of chunks, with the functors constructed right in the chunk instead
+// of being allocated one by one. The thread running the calls walks each
+// producer's chain, runs and destructs the functors in place and recycles
+// the chunks it has finished with.
+//
+// Calls from one thread run in the order they were queued; there's no order
+// between calls from different threads. Calls queued while CallQueued() is
+// running wait for the next one, as with CCallQueueT.
+//-----------------------------------------------------
+
+#define DEFINE_CALLQUEUEMP_NONMEMBER_QUEUE_CALL(N) \
+	template <typename FUNCTION_RETTYPE FUNC_TEMPLATE_FUNC_PARAMS_##N FUNC_TEMPLATE_ARG_PARAMS_##N> \
+	void QueueCall(FUNCTION_RETTYPE (*pfnProxied)( FUNC_BASE_TEMPLATE_FUNC_PARAMS_##N ) FUNC_ARG_FORMAL_PARAMS_##N ) \
+		{ \
+		typedef FUNCTION_RETTYPE (*Func_t)(FUNC_BASE_TEMPLATE_FUNC_PARAMS_##N); \
+		typedef CFunctor##N<Func_t FUNC_BASE_TEMPLATE_ARG_PARAMS_##N> Functor_t; \
+		Producer_t *pProducer = GetThreadProducer(); \
+		EndCall( pProducer, ::new( BeginCall( pProducer, sizeof( Functor_t ) ) ) Functor_t( pfnProxied FUNC_FUNCTOR_CALL_ARGS_##N ) ); \
+		}
+
+//-------------------------------------
+
+#define DEFINE_CALLQUEUEMP_MEMBER_QUEUE_CALL(N) \
+	template <typename OBJECT_TYPE_PTR, typename FUNCTION_CLASS, typename FUNCTION_RETTYPE FUNC_TEMPLATE_FUNC_PARAMS_##N FUNC_TEMPLATE_ARG_PARAMS_##N> \
+	void QueueCall(OBJECT_TYPE_PTR pObject, FUNCTION_RETTYPE ( FUNCTION_CLASS::*pfnProxied )( FUNC_BASE_TEMPLATE_FUNC_PARAMS_##N ) FUNC_ARG_FORMAL_PARAMS_##N ) \
+		{ \
+		typedef CMemberFunctor##N<OBJECT_TYPE_PTR, FUNCTION_RETTYPE (FUNCTION_CLASS::*)(FUNC_BASE_TEMPLATE_FUNC_PARAMS_##N) FUNC_BASE_TEMPLATE_ARG_PARAMS_##N> Functor_t; \
+		Producer_t *pProducer = GetThreadProducer(); \
+		EndCall( pProducer, ::new( BeginCall( pProducer, sizeof( Functor_t ) ) ) Functor_t( pObject, pfnProxied FUNC_FUNCTOR_CALL_ARGS_##N ) ); \
+		}
+
+//-------------------------------------
+
+#define DEFINE_CALLQUEUEMP_CONST_MEMBER_QUEUE_CALL(N) \
+	template <typename OBJECT_TYPE_PTR, typename FUNCTION_CLASS, typename FUNCTION_RETTYPE FUNC_TEMPLATE_FUNC_PARAMS_##N FUNC_TEMPLATE_ARG_PARAMS_##N> \
+	void QueueCall(OBJECT_TYPE_PTR pObject, FUNCTION_RETTYPE ( FUNCTION_CLASS::*pfnProxied )( FUNC_BASE_TEMPLATE_FUNC_PARAMS_##N ) const FUNC_ARG_FORMAL_PARAMS_##N ) \
+		{ \
+		typedef CMemberFunctor##N<OBJECT_TYPE_PTR, FUNCTION_RETTYPE (FUNCTION_CLASS::*)(FUNC_BASE_TEMPLATE_FUNC_PARAMS_##N) const FUNC_BASE_TEMPLATE_ARG_PARAMS_##N> Functor_t; \
+		Producer_t *pProducer = GetThreadProducer(); \
+		EndCall( pProducer, ::new( BeginCall( pProducer, sizeof( Functor_t ) ) ) Functor_t( pObject, pfnProxied FUNC_FUNCTOR_CALL_ARGS_##N ) ); \
+		}
+
+//-------------------------------------
+
+#define DEFINE_CALLQUEUEMP_REF_COUNTING_MEMBER_QUEUE_CALL(N) \
+	template <typename OBJECT_TYPE_PTR, typename FUNCTION_CLASS, typename FUNCTION_RETTYPE FUNC_TEMPLATE_FUNC_PARAMS_##N FUNC_TEMPLATE_ARG_PARAMS_##N> \
+	void QueueRefCall(OBJECT_TYPE_PTR pObject, FUNCTION_RETTYPE ( FUNCTION_CLASS::*pfnProxied )( FUNC_BASE_TEMPLATE_FUNC_PARAMS_##N ) FUNC_ARG_FORMAL_PARAMS_##N ) \
+		{ \
+		typedef CMemberFunctor##N<OBJECT_TYPE_PTR, FUNCTION_RETTYPE (FUNCTION_CLASS::*)(FUNC_BASE_TEMPLATE_FUNC_PARAMS_##N) FUNC_BASE_TEMPLATE_ARG_PARAMS_##N, CFunctorBase, CFuncMemPolicyRefCount<OBJECT_TYPE_PTR> > Functor_t; \
+		Producer_t *pProducer = GetThreadProducer(); \
+		EndCall( pProducer, ::new( BeginCall( pProducer, sizeof( Functor_t ) ) ) Functor_t( pObject, pfnProxied FUNC_FUNCTOR_CALL_ARGS_##N ) ); \
+		}
+
+//-------------------------------------
+
+#define DEFINE_CALLQUEUEMP_REF_COUNTING_CONST_MEMBER_QUEUE_CALL(N) \
+	template <typename OBJECT_TYPE_PTR, typename FUNCTION_CLASS, typename FUNCTION_RETTYPE FUNC_TEMPLATE_FUNC_PARAMS_##N FUNC_TEMPLATE_ARG_PARAMS_##N> \
+	void QueueRefCall(OBJECT_TYPE_PTR pObject, FUNCTION_RETTYPE ( FUNCTION_CLASS::*pfnProxied )( FUNC_BASE_TEMPLATE_FUNC_PARAMS_##N ) const FUNC_ARG_FORMAL_PARAMS_##N ) \
+		{ \
+		typedef CMemberFunctor##N<OBJECT_TYPE_PTR, FUNCTION_RETTYPE (FUNCTION_CLASS::*)(FUNC_BASE_TEMPLATE_FUNC_PARAMS_##N) const FUNC_BASE_TEMPLATE_ARG_PARAMS_##N, CFunctorBase, CFuncMemPolicyRefCount<OBJECT_TYPE_PTR> > Functor_t; \
+		Producer_t *pProducer = GetThreadProducer(); \
+		EndCall( pProducer, ::new( BeginCall( pProducer, sizeof( Functor_t ) ) ) Functor_t( pObject, pfnProxied FUNC_FUNCTOR_CALL_ARGS_##N ) ); \
+		}
+
+#define FUNC_GENERATE_QUEUEMP_METHODS() \
+	FUNC_GENERATE_ALL( DEFINE_CALLQUEUEMP_NONMEMBER_QUEUE_CALL ); \
+	FUNC_GENERATE_ALL( DEFINE_CALLQUEUEMP_MEMBER_QUEUE_CALL ); \
+	FUNC_GENERATE_ALL( DEFINE_CALLQUEUEMP_CONST_MEMBER_QUEUE_CALL );\
+	FUNC_GENERATE_ALL( DEFINE_CALLQUEUEMP_REF_COUNTING_MEMBER_QUEUE_CALL ); \
+	FUNC_GENERATE_ALL( DEFINE_CALLQUEUEMP_REF_COUNTING_CONST_MEMBER_QUEUE_CALL )
+
+//-------------------------------------
+
+// Bytes of call records each producer chunk holds
+#define CALLQUEUEMP_CHUNK_SIZE		( 16 * 1024 )
+
+// Call records, and so the functors in them, start on this boundary
+#define CALLQUEUEMP_RECORD_ALIGN	16
+
+struct CallQueueStats_t
+{
+	int		m_nDepth;				// Calls queued and not run yet
+	int		m_nProducers;			// Threads that have queued calls
+	int		m_nChunks;				// Chunks allocated, in use or free
+
+	int		m_nFlushes;				// CallQueued() calls that had something to run
+	int64	m_nCallsRun;
+	int		m_nLastFlushCalls;
+	int		m_nMaxFlushCalls;
+
+	// Time spent running the queued calls
+	float	m_flLastFlushTime;
+	float	m_flMaxFlushTime;
+	float	m_flTotalFlushTime;
+
+	// How long the oldest call had been waiting when its flush started
+	float	m_flLastFlushLatency;
+	float	m_flMaxFlushLatency;
+};
+
+class CCallQueueMP
+{
+public:
+	CCallQueueMP( int nChunkSize = CALLQUEUEMP_CHUNK_SIZE );
+	~CCallQueueMP();
+
+	// Calls queued while disabled run right away on the queueing thread
+	void DisableQueue( bool bDisable );
+	bool IsDisabled() const { return m_bNoQueue; }
+
+	// Calls queued and not run yet. Only exact when no thread is queueing.
+	int Count();
+
+	// Runs everything queued so far. Only one thread may run or flush at a time.
+	void CallQueued();
+
+	// Throws away everything queued so far without running it
+	void Flush();
+
+	// Queues a functor that was created elsewhere; it's referenced, not copied
+	void QueueFunctor( CFunctor *pFunctor )
+	{
+		Assert( pFunctor );
+		Producer_t *pProducer = GetThreadProducer();
+		EndCall( pProducer, ::new( BeginCall( pProducer, sizeof( CFunctorRef ) ) ) CFunctorRef( pFunctor ) );
+	}
+
+	void GetStats( CallQueueStats_t *pStats );
+	void ResetStats();
+
+	FUNC_GENERATE_QUEUEMP_METHODS();
+
+private:
+	struct Chunk_t : public TSLNodeBase_t
+	{
+		Chunk_t * volatile	m_pNext;		// Set once the producer has moved on to the next chunk
+		int volatile		m_nCommitted;	// Bytes of finished call records
+		int					m_nSize;		// Bytes of call records the chunk can hold
+
+		uint8 *Data() { return (uint8 *)this + ALIGN_VALUE( sizeof( Chunk_t ), CALLQUEUEMP_RECORD_ALIGN ); }
+	};
+
+	struct CallRecord_t
+	{
+		CFunctor	*m_pFunctor;
+		int			m_nSize;				// Bytes to the next record, functor included
+
+		void *Functor() { return (uint8 *)this + ALIGN_VALUE( sizeof( CallRecord_t ), CALLQUEUEMP_RECORD_ALIGN ); }
+	};
+
+	struct Producer_t
+	{
+		// Written by the producing thread only
+		Chunk_t				*m_pWriteChunk;
+		int volatile		m_nQueued;
+		double				m_flFirstQueued;	// When the oldest call still waiting was queued
+		char				m_Pad[64];
+
+		// Owned by the thread running the calls
+		Chunk_t				*m_pReadChunk;
+		int					m_nReadOffset;
+		int volatile		m_nRun;
+
+		Producer_t			*m_pNext;
+	};
+
+	// Wraps a functor passed to QueueFunctor
+	class CFunctorRef : public CFunctorBase
+	{
+	public:
+		CFunctorRef( CFunctor *pFunctor ) : m_pFunctor( pFunctor ) { m_pFunctor->AddRef(); }
+		~CFunctorRef() { m_pFunctor->Release(); }
+		void operator()() { (*m_pFunctor)(); }
+
+	private:
+		CFunctor *m_pFunctor;
+	};
+
+	Producer_t *GetThreadProducer()
+	{
+		Producer_t *pProducer = m_pThreadProducer;
+		return pProducer ? pProducer : AddProducer();
+	}
+
+	// Returns where to construct a functor of nSize bytes. Nothing is visible
+	// to the running thread until EndCall.
+	void *BeginCall( Producer_t *pProducer, int nSize )
+	{
+		int nRecordSize = ALIGN_VALUE( (int)ALIGN_VALUE( sizeof( CallRecord_t ), CALLQUEUEMP_RECORD_ALIGN ) + nSize, CALLQUEUEMP_RECORD_ALIGN );
+		Chunk_t *pChunk = pProducer->m_pWriteChunk;
+		if ( pChunk->m_nCommitted + nRecordSize > pChunk->m_nSize )
+		{
+			pChunk = AddChunk( pProducer, nRecordSize );
+		}
+
+		CallRecord_t *pRecord = (CallRecord_t *)( pChunk->Data() + pChunk->m_nCommitted );
+		pRecord->m_nSize = nRecordSize;
+		return pRecord->Functor();
+	}
+
+	void EndCall( Producer_t *pProducer, CFunctor *pFunctor )
+	{
+		if ( m_bNoQueue )
+		{
+			// The space isn't committed, the next call just reuses it
+			(*pFunctor)();
+			pFunctor->~CFunctor();
+			return;
+		}
+
+		Chunk_t *pChunk = pProducer->m_pWriteChunk;
+		CallRecord_t *pRecord = (CallRecord_t *)( pChunk->Data() + pChunk->m_nCommitted );
+		pRecord->m_pFunctor = pFunctor;
+
+		if ( pProducer->m_nQueued == pProducer->m_nRun )
+		{
+			pProducer->m_flFirstQueued = Plat_FloatTime();
+		}
+
+		// The record has to be visible before the new size, and the size before the count
+		ThreadMemoryBarrier();
+		pChunk->m_nCommitted = pChunk->m_nCommitted + pRecord->m_nSize;
+		ThreadMemoryBarrier();
+		pProducer->m_nQueued = pProducer->m_nQueued + 1;
+	}
+
+	Producer_t *AddProducer();
+	Chunk_t *AddChunk( Producer_t *pProducer, int nRecordSize );
+	Chunk_t *AllocChunk( int nRecordSize );
+	void FreeChunk( Chunk_t *pChunk );
+	int RunCalls( Producer_t *pProducer, int nTarget, bool bExecute );
+
+	Producer_t * volatile			m_pProducers;
+	CThreadLocalPtr<Producer_t>		m_pThreadProducer;
+	CTSListBase						m_FreeChunks;
+	int								m_nChunkSize;
+	CInterlockedInt					m_nChunks;
+	CInterlockedInt					m_nProducers;
+	bool							m_bNoQueue;
+
+	CallQueueStats_t				m_Stats;
+
+private:
+	CCallQueueMP( const CCallQueueMP & );
+	CCallQueueMP &operator=( const CCallQueueMP & );
+};
+
 //-----------------------------------------------------
 // Optional interface that can be bound to concrete CCallQueue
 //-----------------------------------------------------
@@ -28,4 +28,21 @@ inline CRC32_t CRC32_ProcessSingleBuffer( const void *p, int len )
 	return crc;
 }
 
+// CRC-32C (Castagnoli polynomial). This is a different checksum from CRC32_*, so only use it
+// where both ends agree on it; it runs on the SSE4.2 crc32 instruction when the CPU has one.
+void CRC32C_Init( CRC32_t *pulCRC );
+void CRC32C_ProcessBuffer( CRC32_t *pulCRC, const void *p, int len );
+void CRC32C_Final( CRC32_t *pulCRC );
+
+inline CRC32_t CRC32C_ProcessSingleBuffer( const void *p, int len )
+{
+	CRC32_t crc;
+
+	CRC32C_Init( &crc );
+	CRC32C_ProcessBuffer( &crc, p, len );
+	CRC32C_Final( &crc );
+
+	return crc;
+}
+
 #endif // CHECKSUM_CRC_H
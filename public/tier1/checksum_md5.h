@@ -44,6 +44,11 @@ char *MD5_Print(unsigned char *digest, int hashlen );
 /// bothering with the context object.
 void MD5_ProcessSingleBuffer( const void *p, int len, MD5Value_t &md5Result );
 
+/// Hashes nBuffers independent buffers, several at a time. pResults[i] is the same
+/// as MD5_ProcessSingleBuffer( ppBuffers[i], pLengths[i] ); batch similar sized buffers
+/// together since each group runs as long as its longest buffer.
+void MD5_ProcessMultipleBuffers( int nBuffers, const void * const *ppBuffers, const int *pLengths, MD5Value_t *pResults );
+
 unsigned int MD5_PseudoRandom(unsigned int nSeed);
 
 /// Returns true if the values match.
@@ -112,6 +112,11 @@ private:
 // hash comparison function, for use with CUtlMap/CUtlRBTree
 bool HashLessFunc( SHADigest_t const &lhs, SHADigest_t const &rhs );
 
+// Hashes nBuffers independent buffers, several at a time. pResults[i] is the same as
+// GenerateHash( pResults[i], ppBuffers[i], pLengths[i] ); batch similar sized buffers
+// together since each group runs as long as its longest buffer.
+void SHA1_ProcessMultipleBuffers( int nBuffers, const void * const *ppBuffers, const int *pLengths, SHADigest_t *pResults );
+
 // utility class for manipulating SHA1 hashes in their compact form
 struct CSHA
 {
@@ -113,4 +113,32 @@ uint32 MurmurHash2LowerCase( char const *pString, uint32 nSeed );
 uint64 MurmurHash64( const void * key, int len, uint32 seed );
 
 
+//-----------------------------------------------------------------------------
+// Fast 64 bit hash. Much quicker than the byte-at-a-time hashes above for
+// anything longer than a few characters, with better distribution. The
+// result is stable across platforms and versions, so it may be persisted.
+//-----------------------------------------------------------------------------
+uint64 FastHash64( const void *pKey, int nLen, uint64 nSeed = 0 );
+
+// Same as FastHash64 of the ASCII-lowercased key, without making a lowercased copy.
+// Only 'A'-'Z' are folded.
+uint64 FastHash64Caseless( const void *pKey, int nLen, uint64 nSeed = 0 );
+
+inline uint64 FastHashString64( const char *pszKey, uint64 nSeed = 0 )
+{
+	return FastHash64( pszKey, (int)strlen( pszKey ), nSeed );
+}
+
+inline uint64 FastHashString64Caseless( const char *pszKey, uint64 nSeed = 0 )
+{
+	return FastHash64Caseless( pszKey, (int)strlen( pszKey ), nSeed );
+}
+
+// Fold a 64 bit hash down for the 32 bit hash table interfaces
+inline uint32 FastHashFold32( uint64 nHash )
+{
+	return (uint32)( nHash ^ ( nHash >> 32 ) );
+}
+
+
 #endif /* !GENERICHASH_H */
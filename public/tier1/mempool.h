@@ -66,8 +66,8 @@ public:
 	static void SetErrorReportFunc( MemoryPoolReportFunc_t func );
 
 	// returns number of allocated blocks
-	int Count() { return m_BlocksAllocated; }
-	int PeakCount() { return m_PeakAlloc; }
+	int Count() const { return m_BlocksAllocated; }
+	int PeakCount() const { return m_PeakAlloc; }
 
 protected:
 	class CBlob
@@ -127,6 +127,148 @@ private:
 };
 
 
+//-----------------------------------------------------------------------------
+// Thread caching variant of CMemoryPoolMT.
+//
+// Every thread keeps two magazines (small arrays of free blocks) and allocates
+// from and frees into them without any synchronization. Only when both are
+// empty, or both are full, does it trade a magazine with the depot: lock free
+// lists of full and empty magazines shared by all threads. The mutex protected
+// pool behind the depot is only locked to fill a whole magazine at a time.
+//
+// Blocks may be freed by a different thread than the one that allocated them.
+// Each pool uses up a TLS slot, so this is meant for the few pools that are
+// hammered by many threads rather than for every pool.
+//-----------------------------------------------------------------------------
+class CThreadCachedMemoryPool
+{
+public:
+	CThreadCachedMemoryPool( int blockSize, int numElements, int growMode = UTLMEMORYPOOL_GROW_FAST, const char *pszAllocOwner = NULL );
+	~CThreadCachedMemoryPool();
+
+	void*		Alloc();
+	void*		Alloc( size_t amount );
+	void*		AllocZero();
+	void*		AllocZero( size_t amount );
+	void		Free( void *pMem );
+
+	// Frees everything. As with CMemoryPoolMT, no other thread may be using the pool.
+	void		Clear();
+
+	// Returns number of allocated blocks. Threads only publish their counts
+	// when they trade magazines, so PeakCount can trail by a few magazines.
+	int			Count();
+	int			PeakCount() { return m_nPeakAlloc; }
+
+	// Gives the calling thread's cached blocks back to the depot. Call this
+	// from threads that are about to exit so their blocks aren't stranded.
+	void		ReleaseThreadCache();
+
+private:
+	enum
+	{
+		MAGAZINE_SIZE = 32,
+	};
+
+	struct Magazine_t : public TSLNodeBase_t
+	{
+		int		m_nBlocks;
+		void	*m_pBlocks[MAGAZINE_SIZE];
+	};
+
+	struct ThreadCache_t
+	{
+		Magazine_t	*m_pLoaded;		// Allocs and frees use this one
+		Magazine_t	*m_pPrevious;	// Swapped in before going to the depot
+		int			m_nCountDelta;	// Allocs minus frees not yet added to m_nBlocksAllocated
+	};
+
+	ThreadCache_t	*GetThreadCache();
+	ThreadCache_t	*CreateThreadCache();
+	Magazine_t		*GetEmptyMagazine();
+	void			ReturnToDepot( Magazine_t *pMagazine );
+	bool			Reload( ThreadCache_t *pCache );
+	void			Unload( ThreadCache_t *pCache );
+	void			PublishCount( ThreadCache_t *pCache );
+
+	CTSListBase						m_FullMagazines;	// Magazines with at least one block
+	CTSListBase						m_EmptyMagazines;
+	CThreadLocalPtr<ThreadCache_t>	m_pThreadCache;
+	int								m_nBlockSize;
+	int volatile					m_nBlocksAllocated;
+	int volatile					m_nPeakAlloc;
+
+	CThreadFastMutex				m_mutex;			// Protects the members below
+	CUtlMemoryPool					m_Pool;
+	CUtlVector<ThreadCache_t *>		m_ThreadCaches;
+	CUtlVector<Magazine_t *>		m_Magazines;		// Every magazine, for cleanup
+};
+
+inline CThreadCachedMemoryPool::ThreadCache_t *CThreadCachedMemoryPool::GetThreadCache()
+{
+	ThreadCache_t *pCache = m_pThreadCache;
+	return pCache ? pCache : CreateThreadCache();
+}
+
+inline void *CThreadCachedMemoryPool::Alloc()
+{
+	ThreadCache_t *pCache = GetThreadCache();
+	Magazine_t *pLoaded = pCache->m_pLoaded;
+	if ( !pLoaded->m_nBlocks )
+	{
+		if ( !Reload( pCache ) )
+			return NULL;
+		pLoaded = pCache->m_pLoaded;
+	}
+
+	pCache->m_nCountDelta++;
+	return pLoaded->m_pBlocks[ --pLoaded->m_nBlocks ];
+}
+
+inline void *CThreadCachedMemoryPool::Alloc( size_t amount )
+{
+	if ( amount > (size_t)m_nBlockSize )
+		return NULL;
+	return Alloc();
+}
+
+inline void *CThreadCachedMemoryPool::AllocZero()
+{
+	return AllocZero( m_nBlockSize );
+}
+
+inline void *CThreadCachedMemoryPool::AllocZero( size_t amount )
+{
+	void *pMem = Alloc( amount );
+	if ( pMem )
+	{
+		memset( pMem, 0x00, amount );
+	}
+	return pMem;
+}
+
+inline void CThreadCachedMemoryPool::Free( void *pMem )
+{
+	if ( !pMem )
+		return;
+
+#ifdef _DEBUG
+	memset( pMem, 0xDD, m_nBlockSize );
+#endif
+
+	ThreadCache_t *pCache = GetThreadCache();
+	Magazine_t *pLoaded = pCache->m_pLoaded;
+	if ( pLoaded->m_nBlocks == MAGAZINE_SIZE )
+	{
+		Unload( pCache );
+		pLoaded = pCache->m_pLoaded;
+	}
+
+	pCache->m_nCountDelta--;
+	pLoaded->m_pBlocks[ pLoaded->m_nBlocks++ ] = pMem;
+}
+
+
 //-----------------------------------------------------------------------------
 // Wrapper macro to make an allocator that returns particular typed allocations
 // and construction and destruction of objects.
@@ -363,6 +505,18 @@ inline void CClassMemoryPool<T>::Clear()
 #define DEFINE_FIXEDSIZE_ALLOCATOR_MT( _class, _initsize, _grow )					\
 	CMemoryPoolMT   _class::s_Allocator(sizeof(_class), _initsize, _grow, #_class " pool")
 
+#define DECLARE_FIXEDSIZE_ALLOCATOR_THREADCACHED( _class )						\
+	public:																		\
+	   inline void* operator new( size_t size ) { MEM_ALLOC_CREDIT_(#_class " pool"); return s_Allocator.Alloc(size); }   \
+	   inline void* operator new( size_t size, int nBlockUse, const char *pFileName, int nLine ) { MEM_ALLOC_CREDIT_(#_class " pool"); return s_Allocator.Alloc(size); }   \
+	   inline void  operator delete( void* p ) { s_Allocator.Free(p); }		\
+	   inline void  operator delete( void* p, int nBlockUse, const char *pFileName, int nLine ) { s_Allocator.Free(p); }   \
+	private:																		\
+		static   CThreadCachedMemoryPool   s_Allocator
+
+#define DEFINE_FIXEDSIZE_ALLOCATOR_THREADCACHED( _class, _initsize, _grow )		\
+	CThreadCachedMemoryPool   _class::s_Allocator(sizeof(_class), _initsize, _grow, #_class " pool")
+
 //-----------------------------------------------------------------------------
 // Macros that make it simple to make a class use a fixed-size allocator
 // This version allows us to use a memory pool which is externally defined...
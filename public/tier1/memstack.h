@@ -202,6 +202,137 @@ private:
 	int m_nAllocated;
 };
 
+//-----------------------------------------------------------------------------
+// Per-thread frame arenas.
+//
+// Each thread gets its own CMemoryStack for transient data, such as lists of
+// entities built and thrown away within a tick. Allocation is a pointer bump,
+// and everything is freed at once by rewinding to a mark or by Reset() at the
+// end of the frame. Memory isn't constructed or destructed, so only put data
+// in there that doesn't need its destructor run.
+//
+//	CFrameArenaMark mark;
+//	CBaseEntity **ppList = mark.Arena().Alloc<CBaseEntity *>( nMaxEntities );
+//	...	// freed when mark goes out of scope
+//-----------------------------------------------------------------------------
+#define FRAME_ARENA_DEFAULT_SIZE	( 4 * 1024 * 1024 )
+#define FRAME_ARENA_ALIGNMENT		16
+
+class CFrameArena
+{
+public:
+	// Returns the calling thread's arena, creating it on first use
+	static CFrameArena &ThreadArena();
+
+	// Frees the calling thread's arena. Happens by itself when the thread
+	// exits, except on platforms without thread exit callbacks (XP).
+	static void ReleaseThreadArena();
+
+	// Size reserved for arenas created after this call
+	static void SetDefaultSize( unsigned nMaxSize );
+
+	// Prints the usage and high water mark of every thread's arena
+	static void PrintStats();
+
+	// Returns NULL if the arena is exhausted. Alignments up to FRAME_ARENA_ALIGNMENT are free.
+	void *Alloc( unsigned nBytes, unsigned nAlignment = 0, bool bClear = false );
+
+	// Room for nCount T's, aligned for T. Nothing is constructed.
+	template < typename T > T *Alloc( int nCount, bool bClear = false );
+
+	MemoryStackMark_t GetMark()					{ return m_Stack.GetCurrentAllocPoint(); }
+	void FreeToMark( MemoryStackMark_t mark );
+
+	// Frees everything; call at the end of the frame
+	void Reset();
+
+	int GetUsed()								{ return m_Stack.GetUsed(); }
+	int GetMaxSize()							{ return m_Stack.GetMaxSize(); }
+
+	// Largest amount in use at once since the last ResetHighWater()
+	int GetHighWater()							{ return MAX( m_nHighWater, GetUsed() ); }
+	void ResetHighWater()						{ m_nHighWater = GetUsed(); }
+
+	// Number of allocations which didn't fit
+	int GetFailedAllocs() const					{ return m_nFailedAllocs; }
+
+private:
+	CFrameArena( unsigned nMaxSize );
+	~CFrameArena();
+
+	static void Free( CFrameArena *pArena );
+	static void ThreadExit( void *pArena );
+
+	CMemoryStack	m_Stack;
+	int				m_nHighWater;
+	int				m_nFailedAllocs;
+	unsigned		m_nThreadId;
+};
+
+inline void *CFrameArena::Alloc( unsigned nBytes, unsigned nAlignment, bool bClear )
+{
+	if ( nAlignment > FRAME_ARENA_ALIGNMENT )
+	{
+		// Every allocation is a multiple of FRAME_ARENA_ALIGNMENT, so the padding is too
+		byte *pNext = (byte *)m_Stack.GetBase() + m_Stack.GetCurrentAllocPoint();
+		unsigned nPad = AlignValue( pNext, nAlignment ) - pNext;
+		if ( nPad && !m_Stack.Alloc( nPad ) )
+		{
+			m_nFailedAllocs++;
+			return NULL;
+		}
+	}
+
+	void *pResult = m_Stack.Alloc( nBytes, bClear );
+	if ( !pResult )
+	{
+		m_nFailedAllocs++;
+		AssertMsg( 0, "CFrameArena: out of memory\n" );
+	}
+	return pResult;
+}
+
+template < typename T >
+inline T *CFrameArena::Alloc( int nCount, bool bClear )
+{
+	Assert( nCount >= 0 );
+	return (T *)Alloc( nCount * sizeof( T ), __alignof( T ), bClear );
+}
+
+inline void CFrameArena::FreeToMark( MemoryStackMark_t mark )
+{
+	m_nHighWater = MAX( m_nHighWater, GetUsed() );
+	m_Stack.FreeToAllocPoint( mark, false );
+}
+
+inline void CFrameArena::Reset()
+{
+	m_nHighWater = MAX( m_nHighWater, GetUsed() );
+	m_Stack.FreeAll( false );
+}
+
+
+//-----------------------------------------------------------------------------
+// Rewinds an arena to where it was when the mark was constructed
+//-----------------------------------------------------------------------------
+class CFrameArenaMark
+{
+public:
+	CFrameArenaMark() : m_Arena( CFrameArena::ThreadArena() ), m_Mark( m_Arena.GetMark() ) {}
+	explicit CFrameArenaMark( CFrameArena &arena ) : m_Arena( arena ), m_Mark( arena.GetMark() ) {}
+	~CFrameArenaMark()							{ m_Arena.FreeToMark( m_Mark ); }
+
+	CFrameArena &Arena()						{ return m_Arena; }
+
+private:
+	CFrameArena			&m_Arena;
+	MemoryStackMark_t	m_Mark;
+
+	// Not copyable
+	CFrameArenaMark( const CFrameArenaMark & );
+	CFrameArenaMark &operator=( const CFrameArenaMark & );
+};
+
 //-----------------------------------------------------------------------------
 
 #endif // MEMSTACK_H
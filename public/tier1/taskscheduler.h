@@ -0,0 +1,325 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Work stealing fork/join task scheduler.
+//
+// Every thread that spawns tasks gets its own deque (Chase-Lev): the owner
+// pushes and pops at the bottom without locking, idle threads steal from the
+// top. Workers are borrowed from an IThreadPool only while there is work, so
+// the scheduler doesn't own any threads and doesn't compete with the pool.
+//
+// Tasks are plain objects owned by the caller; they aren't reference counted
+// and usually live on the stack of the function that waits for them.
+// CTaskGroup::Wait() runs tasks while it waits, so nested parallel calls
+// can't deadlock and never put more threads to work than the pool has.
+//
+//	CTaskGroup group;
+//	group.Run( &taskA );
+//	group.Run( &taskB );
+//	DoOtherWork();
+//	group.Wait();
+//
+//=============================================================================
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/platform.h"
+#include "tier0/dbg.h"
+#include "tier0/threadtools.h"
+
+class IThreadPool;
+class CTaskGroup;
+class CTaskScheduler;
+class CTaskDeque;
+
+// Threads beyond this many run the tasks they spawn immediately
+#define TASK_SCHEDULER_MAX_THREADS	64
+
+// Tasks a single thread can have outstanding before spawning runs them immediately
+#define TASK_DEQUE_SIZE				256
+
+
+//-----------------------------------------------------------------------------
+// A unit of work. Must stay alive until the group it was run in has been
+// waited on.
+//-----------------------------------------------------------------------------
+class CTask
+{
+public:
+	CTask() : m_pGroup( NULL ) {}
+	virtual void Run() = 0;
+
+protected:
+	~CTask() {}
+
+private:
+	friend class CTaskGroup;
+	friend class CTaskScheduler;
+
+	CTaskGroup *m_pGroup;
+};
+
+
+//-----------------------------------------------------------------------------
+// A set of tasks which can be waited on together
+//-----------------------------------------------------------------------------
+class CTaskGroup
+{
+public:
+	CTaskGroup( CTaskScheduler *pScheduler = NULL );
+	~CTaskGroup();
+
+	// Queues a task for any thread to pick up
+	void Run( CTask *pTask );
+
+	// Executes tasks, ours or anyone's, until every task in the group has finished
+	void Wait();
+
+	bool IsDone() const { return m_nPending == 0; }
+
+	CTaskScheduler *GetScheduler() { return m_pScheduler; }
+
+private:
+	friend class CTaskScheduler;
+
+	CTaskScheduler *m_pScheduler;
+	CInterlockedInt m_nPending;
+
+private:
+	CTaskGroup( const CTaskGroup & );
+	CTaskGroup &operator=( const CTaskGroup & );
+};
+
+
+//-----------------------------------------------------------------------------
+// The scheduler itself. g_TaskScheduler borrows g_pThreadPool's threads.
+//-----------------------------------------------------------------------------
+class CTaskScheduler
+{
+public:
+	// A NULL thread pool means g_pThreadPool, looked up when workers are needed
+	CTaskScheduler( IThreadPool *pThreadPool = NULL );
+	~CTaskScheduler();
+
+	IThreadPool *GetThreadPool();
+
+	// Threads which may run tasks at once, including the calling thread
+	int NumWorkers();
+
+	// Pushes a task on the calling thread's deque, waking up a pool thread if
+	// one is free. Runs the task right away if the thread can't get a deque.
+	void Spawn( CTask *pTask, CTaskGroup *pGroup );
+
+	// Runs one task, preferring the calling thread's own. Returns false if
+	// there was nothing to do.
+	bool ExecuteOne();
+
+	// Gives back the calling thread's deque early. Exiting threads give theirs
+	// back by themselves, except on platforms without thread exit callbacks (XP).
+	void ReleaseThreadDeque();
+
+private:
+	CTaskDeque *GetThreadDeque();
+	void ReleaseDeque( CTaskDeque *pDeque );
+	static void ThreadExit( void *pDeque );
+	CTask *FindTask( CTaskDeque *pOwnDeque );
+	void RunTask( CTask *pTask );
+	void WakeWorker();
+	void WorkerLoop();
+
+	IThreadPool					*m_pThreadPool;
+	CTaskDeque					*m_pDeques;
+	bool						m_bDequeInUse[TASK_SCHEDULER_MAX_THREADS];
+	int volatile				m_nDeques;			// Highest deque in use + 1
+	CThreadLocalPtr<CTaskDeque>	m_pThreadDeque;
+	CThreadFastMutex			m_DequeMutex;
+	CInterlockedInt				m_nActiveWorkers;
+
+private:
+	CTaskScheduler( const CTaskScheduler & );
+	CTaskScheduler &operator=( const CTaskScheduler & );
+};
+
+extern CTaskScheduler g_TaskScheduler;
+
+
+//-----------------------------------------------------------------------------
+// Parallel loops. The range is split in halves, the right halves are spawned
+// and the calling thread keeps going on the left; idle threads steal the big
+// halves first. nGrain is the largest range that is run without splitting,
+// 0 picks one from the number of workers.
+//
+// ParallelFor calls body( i ) for every i in [nBegin, nEnd).
+//
+// ParallelReduce calls body( i, accumulator ) on per range accumulators that
+// start as a copy of identity, then merges neighbouring ranges in order with
+// join( left, right ), which must leave the result in left.
+//-----------------------------------------------------------------------------
+inline int ParallelGrainSize( CTaskScheduler *pScheduler, int nCount, int nGrain )
+{
+	if ( nGrain > 0 )
+		return nGrain;
+
+	nGrain = nCount / ( pScheduler->NumWorkers() * 8 );
+	return MAX( nGrain, 1 );
+}
+
+template < class BODY >
+void ParallelForRange( CTaskScheduler *pScheduler, int nBegin, int nEnd, int nGrain, BODY &body );
+
+template < class BODY >
+class CParallelForTask : public CTask
+{
+public:
+	void Init( CTaskScheduler *pScheduler, int nBegin, int nEnd, int nGrain, BODY *pBody )
+	{
+		m_pScheduler = pScheduler;
+		m_nBegin = nBegin;
+		m_nEnd = nEnd;
+		m_nGrain = nGrain;
+		m_pBody = pBody;
+	}
+
+	virtual void Run()
+	{
+		ParallelForRange( m_pScheduler, m_nBegin, m_nEnd, m_nGrain, *m_pBody );
+	}
+
+private:
+	CTaskScheduler *m_pScheduler;
+	int m_nBegin;
+	int m_nEnd;
+	int m_nGrain;
+	BODY *m_pBody;
+};
+
+template < class BODY >
+void ParallelForRange( CTaskScheduler *pScheduler, int nBegin, int nEnd, int nGrain, BODY &body )
+{
+	// Each split halves the range, so 32 tasks are always enough
+	CParallelForTask<BODY> tasks[32];
+	int nTasks = 0;
+
+	CTaskGroup group( pScheduler );
+	while ( nEnd - nBegin > nGrain )
+	{
+		int nMid = nBegin + ( nEnd - nBegin ) / 2;
+		tasks[nTasks].Init( pScheduler, nMid, nEnd, nGrain, &body );
+		group.Run( &tasks[nTasks] );
+		nTasks++;
+		nEnd = nMid;
+	}
+
+	for ( int i = nBegin; i < nEnd; i++ )
+	{
+		body( i );
+	}
+
+	group.Wait();
+}
+
+template < class BODY >
+void ParallelFor( int nBegin, int nEnd, BODY &body, int nGrain = 0, CTaskScheduler *pScheduler = NULL )
+{
+	if ( nEnd <= nBegin )
+		return;
+
+	if ( !pScheduler )
+	{
+		pScheduler = &g_TaskScheduler;
+	}
+	ParallelForRange( pScheduler, nBegin, nEnd, ParallelGrainSize( pScheduler, nEnd - nBegin, nGrain ), body );
+}
+
+// ParallelFor for code below tier1 that can't instantiate the templates, it
+// gets handed this as a function pointer. Calls pfnBody( i, pContext ) for
+// every i in [0, nCount) on the global scheduler.
+typedef void (*ParallelForFunc_t)( int i, void *pContext );
+void ParallelForCallback( int nCount, ParallelForFunc_t pfnBody, void *pContext );
+
+
+template < typename T, class BODY, class JOIN >
+void ParallelReduceRange( CTaskScheduler *pScheduler, int nBegin, int nEnd, int nGrain, T &result, BODY &body, JOIN &join );
+
+template < typename T, class BODY, class JOIN >
+class CParallelReduceTask : public CTask
+{
+public:
+	void Init( CTaskScheduler *pScheduler, int nBegin, int nEnd, int nGrain, const T &identity, BODY *pBody, JOIN *pJoin )
+	{
+		m_pScheduler = pScheduler;
+		m_nBegin = nBegin;
+		m_nEnd = nEnd;
+		m_nGrain = nGrain;
+		m_Result = identity;
+		m_pBody = pBody;
+		m_pJoin = pJoin;
+	}
+
+	virtual void Run()
+	{
+		ParallelReduceRange( m_pScheduler, m_nBegin, m_nEnd, m_nGrain, m_Result, *m_pBody, *m_pJoin );
+	}
+
+	T m_Result;
+
+private:
+	CTaskScheduler *m_pScheduler;
+	int m_nBegin;
+	int m_nEnd;
+	int m_nGrain;
+	BODY *m_pBody;
+	JOIN *m_pJoin;
+};
+
+// result comes in as the identity value and goes out as the reduction of the range
+template < typename T, class BODY, class JOIN >
+void ParallelReduceRange( CTaskScheduler *pScheduler, int nBegin, int nEnd, int nGrain, T &result, BODY &body, JOIN &join )
+{
+	CParallelReduceTask<T, BODY, JOIN> tasks[32];
+	int nTasks = 0;
+
+	CTaskGroup group( pScheduler );
+	while ( nEnd - nBegin > nGrain )
+	{
+		int nMid = nBegin + ( nEnd - nBegin ) / 2;
+		tasks[nTasks].Init( pScheduler, nMid, nEnd, nGrain, result, &body, &join );
+		group.Run( &tasks[nTasks] );
+		nTasks++;
+		nEnd = nMid;
+	}
+
+	for ( int i = nBegin; i < nEnd; i++ )
+	{
+		body( i, result );
+	}
+
+	group.Wait();
+
+	// The last task spawned holds the range right after ours
+	while ( nTasks-- )
+	{
+		join( result, tasks[nTasks].m_Result );
+	}
+}
+
+template < typename T, class BODY, class JOIN >
+T ParallelReduce( int nBegin, int nEnd, const T &identity, BODY &body, JOIN &join, int nGrain = 0, CTaskScheduler *pScheduler = NULL )
+{
+	T result = identity;
+	if ( nEnd <= nBegin )
+		return result;
+
+	if ( !pScheduler )
+	{
+		pScheduler = &g_TaskScheduler;
+	}
+	ParallelReduceRange( pScheduler, nBegin, nEnd, ParallelGrainSize( pScheduler, nEnd - nBegin, nGrain ), result, body, join );
+	return result;
+}
+
+#endif // TASKSCHEDULER_H
@@ -0,0 +1,37 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Cleanup callbacks run when a thread exits.
+//
+// Per thread caches (frame arenas, task deques, decode contexts) are created
+// the first time a thread needs one, often on threads the code doesn't own,
+// such as the thread pool's workers. They register a callback here so the
+// cache goes away with the thread. The callback runs on the exiting thread
+// after its own code has returned. Other thread local values may already be
+// cleared by then, so pass everything the callback needs in its context.
+//
+// Windows needs fiber local storage for this, which XP doesn't have; there
+// ThreadAddExitCallback returns false and the caller has to clean up itself.
+//
+//=============================================================================
+
+#ifndef THREADEXIT_H
+#define THREADEXIT_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+typedef void (*ThreadExitFunc_t)( void *pContext );
+
+// Calls pfnExit( pContext ) when the calling thread exits. Callbacks run
+// last-added first. Returns false if the platform can't tell.
+bool ThreadAddExitCallback( ThreadExitFunc_t pfnExit, void *pContext );
+
+// Forgets a callback the calling thread added, when it cleaned up early
+void ThreadRemoveExitCallback( ThreadExitFunc_t pfnExit, void *pContext );
+
+// Forgets every thread's callbacks for pContext, for objects which go away
+// before the threads that used them
+void ThreadRemoveExitCallbacks( void *pContext );
+
+#endif // THREADEXIT_H
@@ -0,0 +1,1221 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: B+tree ordered containers with the CUtlRBTree / CUtlMap interface.
+//
+// CUtlBTree and CUtlBTreeMap keep their elements sorted like CUtlRBTree and
+// CUtlMap, but each node holds a sorted array of keys instead of a single
+// element. Inner nodes only hold keys and child pointers, so a lookup visits
+// a handful of cache line aligned nodes rather than one scattered node per
+// tree level. All elements live in the leaves, which are linked together, so
+// in-order iteration and range scans walk contiguous arrays.
+//
+// Differences from CUtlRBTree / CUtlMap:
+//	- indices are (leaf, slot) handles. Any Insert() or Remove() may move
+//	  elements around, so an index is only valid until the tree changes.
+//	- keys and elements are moved with memcpy, the same as CUtlVector does;
+//	  types holding pointers into themselves can't be stored.
+//	- BulkLoad() builds the tree from sorted input in linear time.
+//	- FindLowerBound(), FindUpperBound() and ScanRange() answer range queries.
+//
+//=============================================================================
+
+#ifndef UTLBTREE_H
+#define UTLBTREE_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/dbg.h"
+#include "tier0/memalloc.h"
+#include "tier1/utlmap.h"
+#include "tier1/utlvector.h"
+
+// The element type of CUtlBTree, whose nodes only have keys
+struct CUtlBTreeEmpty_t
+{
+};
+
+
+//-----------------------------------------------------------------------------
+// Shared implementation: an ordered multimap from K to V.
+// Equal keys are allowed; new ones are inserted after the existing ones.
+//-----------------------------------------------------------------------------
+template < typename K, typename V, typename L >
+class CUtlBTreeBase
+{
+public:
+	typedef K KeyType_t;
+	typedef L LessFunc_t;
+	typedef int IndexType_t;
+
+	CUtlBTreeBase( const LessFunc_t &lessfunc );
+	CUtlBTreeBase( const CUtlBTreeBase &from );
+	~CUtlBTreeBase();
+
+	CUtlBTreeBase &operator=( const CUtlBTreeBase &from );
+
+	void SetLessFunc( const LessFunc_t &func );
+
+	const KeyType_t &Key( IndexType_t i ) const					{ Assert( IsValidIndex( i ) ); return LeafKeys( LeafOf( i ) )[ SlotOf( i ) ]; }
+
+	// Num elements
+	unsigned int Count() const									{ return m_nCount; }
+
+	// Handles are in [0, MaxElement()); not all of them are in use
+	IndexType_t MaxElement() const								{ return m_Leaves.Count() << SLOT_BITS; }
+	bool IsValidIndex( IndexType_t i ) const;
+	static IndexType_t InvalidIndex()							{ return -1; }
+
+	// Checks the tree structure (slow, for debugging)
+	bool IsValid() const;
+
+	// Number of node levels, 0 for an empty tree
+	int Depth() const											{ return m_pRoot ? m_nInnerLevels + 1 : 0; }
+
+	// Returns one of the elements equal to key
+	IndexType_t Find( const KeyType_t &key ) const;
+
+	// First element not less than key / greater than key
+	IndexType_t FindLowerBound( const KeyType_t &key ) const;
+	IndexType_t FindUpperBound( const KeyType_t &key ) const;
+
+	// Remove methods
+	void RemoveAt( IndexType_t i );
+	bool Remove( const KeyType_t &key );
+	void RemoveAll();
+	void Purge();
+
+	// Iteration
+	IndexType_t FirstInorder() const							{ return m_pHead ? MakeHandle( m_pHead, 0 ) : InvalidIndex(); }
+	IndexType_t NextInorder( IndexType_t i ) const;
+	IndexType_t PrevInorder( IndexType_t i ) const;
+	IndexType_t LastInorder() const								{ return m_pTail ? MakeHandle( m_pTail, m_pTail->m_nKeys - 1 ) : InvalidIndex(); }
+
+	void Swap( CUtlBTreeBase &that );
+
+protected:
+	enum
+	{
+		// Nodes hold about four cache lines worth of keys
+		NODE_KEY_BYTES = 256,
+		NODE_ALIGN = 64,
+		NODE_KEYS = (int)( NODE_KEY_BYTES / sizeof( K ) ),
+		MAX_KEYS = ( NODE_KEYS < 8 ) ? 8 : ( ( NODE_KEYS > 64 ) ? 64 : NODE_KEYS ),
+		MIN_KEYS = MAX_KEYS / 2,
+
+		// Handles are ( leaf index << SLOT_BITS ) | slot
+		SLOT_BITS = 7,
+		SLOT_MASK = ( 1 << SLOT_BITS ) - 1,
+	};
+
+	struct Inner_t;
+
+	struct Node_t
+	{
+		Inner_t		*m_pParent;
+		int			m_nKeys;
+	};
+
+	// Followed by MAX_KEYS + 1 keys and values; the extra slot lets a full
+	// node take an insert before it is split.
+	struct Leaf_t : public Node_t
+	{
+		Leaf_t		*m_pPrev;
+		Leaf_t		*m_pNext;
+		int			m_iLeaf;		// Index in m_Leaves
+	};
+
+	// Followed by MAX_KEYS + 1 keys. Child i holds keys in [ key i - 1, key i ].
+	struct Inner_t : public Node_t
+	{
+		Node_t		*m_pChildren[ MAX_KEYS + 2 ];
+	};
+
+	// Sequential readers for BuildFromSorted()
+	struct ArraySource_t
+	{
+		const K		*m_pKeys;
+		const V		*m_pValues;		// NULL to default construct the values
+
+		void Get( const K *&pKey, const V *&pValue )
+		{
+			pKey = m_pKeys++;
+			pValue = m_pValues ? m_pValues++ : NULL;
+		}
+	};
+
+	struct TreeSource_t
+	{
+		const Leaf_t	*m_pLeaf;
+		int				m_iSlot;
+
+		void Get( const K *&pKey, const V *&pValue )
+		{
+			if ( m_iSlot == m_pLeaf->m_nKeys )
+			{
+				m_pLeaf = m_pLeaf->m_pNext;
+				m_iSlot = 0;
+			}
+			pKey = &LeafKeys( m_pLeaf )[ m_iSlot ];
+			pValue = &LeafValues( m_pLeaf )[ m_iSlot ];
+			m_iSlot++;
+		}
+	};
+
+	static size_t AlignSize( size_t nSize )						{ return ( nSize + 15 ) & ~(size_t)15; }
+	static size_t KeysOffset( size_t nHeader )					{ return AlignSize( nHeader ); }
+	static size_t ValuesOffset()								{ return KeysOffset( sizeof( Leaf_t ) ) + AlignSize( sizeof( K ) * ( MAX_KEYS + 1 ) ); }
+
+	static K *LeafKeys( const Leaf_t *pLeaf )					{ return (K *)( (uint8 *)pLeaf + KeysOffset( sizeof( Leaf_t ) ) ); }
+	static V *LeafValues( const Leaf_t *pLeaf )					{ return (V *)( (uint8 *)pLeaf + ValuesOffset() ); }
+	static K *InnerKeys( const Inner_t *pInner )				{ return (K *)( (uint8 *)pInner + KeysOffset( sizeof( Inner_t ) ) ); }
+
+	static IndexType_t MakeHandle( const Leaf_t *pLeaf, int iSlot )	{ return ( pLeaf->m_iLeaf << SLOT_BITS ) | iSlot; }
+	static int SlotOf( IndexType_t i )							{ return i & SLOT_MASK; }
+	Leaf_t *LeafOf( IndexType_t i ) const						{ return m_Leaves[ i >> SLOT_BITS ]; }
+
+	V &Value( IndexType_t i ) const								{ Assert( IsValidIndex( i ) ); return LeafValues( LeafOf( i ) )[ SlotOf( i ) ]; }
+
+	// Inserts after any equal keys. pValue may be NULL to default construct the value.
+	IndexType_t InsertInternal( const K &key, const V *pValue );
+
+	// Replaces the contents with nCount elements read from source in sorted order
+	template < typename S > void BuildFromSorted( S &source, int nCount );
+
+	// Calls func( key, value ) for each element with lo <= key < hi, in order
+	template < typename F > int ScanRangeInternal( const K &lo, const K &hi, F &func ) const;
+
+private:
+	int LowerBoundKey( const K *pKeys, int nKeys, const K &key ) const;
+	int UpperBoundKey( const K *pKeys, int nKeys, const K &key ) const;
+	Leaf_t *FindLeaf( const K &key, bool bUpper ) const;
+	IndexType_t HandleOrNext( const Leaf_t *pLeaf, int iSlot ) const;
+	static int ChildIndex( const Inner_t *pParent, const Node_t *pChild );
+
+	Leaf_t *AllocLeaf();
+	Inner_t *AllocInner();
+	void FreeLeaf( Leaf_t *pLeaf );
+	void FreeInner( Inner_t *pInner );
+	void DestroyNode( Node_t *pNode, int nLevel );
+
+	void InsertIntoParent( Node_t *pLeft, const K &separator, Node_t *pRight );
+	void RebalanceLeaf( Leaf_t *pLeaf );
+	void RebalanceInner( Inner_t *pInner );
+	void MergeLeaves( Leaf_t *pLeft, Leaf_t *pRight, int iSeparator );
+	void MergeInner( Inner_t *pLeft, Inner_t *pRight, int iSeparator );
+	static void RemoveInnerEntry( Inner_t *pInner, int iKey );
+
+	bool ValidateNode( const Node_t *pNode, int nLevel, const K *pLow, const K *pHigh, int &nCount ) const;
+
+	Node_t					*m_pRoot;
+	int						m_nInnerLevels;	// Levels of inner nodes above the leaves
+	Leaf_t					*m_pHead;
+	Leaf_t					*m_pTail;
+	int						m_nCount;
+	CUtlVector< Leaf_t * >	m_Leaves;		// Leaf index -> leaf, NULL when free
+	CUtlVector< int >		m_FreeLeaves;
+	LessFunc_t				m_LessFunc;
+};
+
+
+//-----------------------------------------------------------------------------
+// Construction
+//-----------------------------------------------------------------------------
+template < typename K, typename V, typename L >
+CUtlBTreeBase<K, V, L>::CUtlBTreeBase( const LessFunc_t &lessfunc ) : m_LessFunc( lessfunc )
+{
+	m_pRoot = NULL;
+	m_nInnerLevels = 0;
+	m_pHead = NULL;
+	m_pTail = NULL;
+	m_nCount = 0;
+}
+
+template < typename K, typename V, typename L >
+CUtlBTreeBase<K, V, L>::CUtlBTreeBase( const CUtlBTreeBase &from ) : m_LessFunc( from.m_LessFunc )
+{
+	m_pRoot = NULL;
+	m_nInnerLevels = 0;
+	m_pHead = NULL;
+	m_pTail = NULL;
+	m_nCount = 0;
+	*this = from;
+}
+
+template < typename K, typename V, typename L >
+CUtlBTreeBase<K, V, L>::~CUtlBTreeBase()
+{
+	Purge();
+}
+
+template < typename K, typename V, typename L >
+CUtlBTreeBase<K, V, L> &CUtlBTreeBase<K, V, L>::operator=( const CUtlBTreeBase &from )
+{
+	if ( this == &from )
+		return *this;
+
+	m_LessFunc = from.m_LessFunc;
+	TreeSource_t source;
+	source.m_pLeaf = from.m_pHead;
+	source.m_iSlot = 0;
+	BuildFromSorted( source, from.m_nCount );
+	return *this;
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::SetLessFunc( const LessFunc_t &func )
+{
+	// Changing the ordering of a populated tree would break it
+	Assert( !m_nCount );
+	m_LessFunc = func;
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::Swap( CUtlBTreeBase &that )
+{
+	V_swap( m_pRoot, that.m_pRoot );
+	V_swap( m_nInnerLevels, that.m_nInnerLevels );
+	V_swap( m_pHead, that.m_pHead );
+	V_swap( m_pTail, that.m_pTail );
+	V_swap( m_nCount, that.m_nCount );
+	V_swap( m_LessFunc, that.m_LessFunc );
+	m_Leaves.Swap( that.m_Leaves );
+	m_FreeLeaves.Swap( that.m_FreeLeaves );
+}
+
+
+//-----------------------------------------------------------------------------
+// Node allocation. Nodes are cache line aligned and constructed by hand;
+// only the key and value slots in use hold live objects.
+//-----------------------------------------------------------------------------
+template < typename K, typename V, typename L >
+typename CUtlBTreeBase<K, V, L>::Leaf_t *CUtlBTreeBase<K, V, L>::AllocLeaf()
+{
+	Leaf_t *pLeaf = (Leaf_t *)MemAlloc_AllocAligned( ValuesOffset() + sizeof( V ) * ( MAX_KEYS + 1 ), NODE_ALIGN );
+	pLeaf->m_pParent = NULL;
+	pLeaf->m_nKeys = 0;
+	pLeaf->m_pPrev = NULL;
+	pLeaf->m_pNext = NULL;
+
+	if ( m_FreeLeaves.Count() )
+	{
+		pLeaf->m_iLeaf = m_FreeLeaves.Tail();
+		m_FreeLeaves.RemoveMultipleFromTail( 1 );
+	}
+	else
+	{
+		AssertMsg( m_Leaves.Count() < ( 1 << ( 31 - SLOT_BITS ) ), "CUtlBTree overflow!\n" );
+		pLeaf->m_iLeaf = m_Leaves.AddToTail();
+	}
+	m_Leaves[ pLeaf->m_iLeaf ] = pLeaf;
+	return pLeaf;
+}
+
+template < typename K, typename V, typename L >
+typename CUtlBTreeBase<K, V, L>::Inner_t *CUtlBTreeBase<K, V, L>::AllocInner()
+{
+	Inner_t *pInner = (Inner_t *)MemAlloc_AllocAligned( KeysOffset( sizeof( Inner_t ) ) + sizeof( K ) * ( MAX_KEYS + 1 ), NODE_ALIGN );
+	pInner->m_pParent = NULL;
+	pInner->m_nKeys = 0;
+	return pInner;
+}
+
+// Only releases the memory, the caller takes care of the keys
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::FreeLeaf( Leaf_t *pLeaf )
+{
+	m_Leaves[ pLeaf->m_iLeaf ] = NULL;
+	m_FreeLeaves.AddToTail( pLeaf->m_iLeaf );
+	MemAlloc_FreeAligned( pLeaf );
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::FreeInner( Inner_t *pInner )
+{
+	MemAlloc_FreeAligned( pInner );
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::DestroyNode( Node_t *pNode, int nLevel )
+{
+	if ( nLevel == 0 )
+	{
+		Leaf_t *pLeaf = (Leaf_t *)pNode;
+		K *pKeys = LeafKeys( pLeaf );
+		V *pValues = LeafValues( pLeaf );
+		for ( int i = 0; i < pLeaf->m_nKeys; i++ )
+		{
+			Destruct( &pKeys[i] );
+			Destruct( &pValues[i] );
+		}
+		MemAlloc_FreeAligned( pLeaf );
+		return;
+	}
+
+	Inner_t *pInner = (Inner_t *)pNode;
+	K *pKeys = InnerKeys( pInner );
+	for ( int i = 0; i <= pInner->m_nKeys; i++ )
+	{
+		DestroyNode( pInner->m_pChildren[i], nLevel - 1 );
+	}
+	for ( int i = 0; i < pInner->m_nKeys; i++ )
+	{
+		Destruct( &pKeys[i] );
+	}
+	FreeInner( pInner );
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::RemoveAll()
+{
+	if ( m_pRoot )
+	{
+		DestroyNode( m_pRoot, m_nInnerLevels );
+	}
+	m_pRoot = NULL;
+	m_nInnerLevels = 0;
+	m_pHead = NULL;
+	m_pTail = NULL;
+	m_nCount = 0;
+	m_Leaves.RemoveAll();
+	m_FreeLeaves.RemoveAll();
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::Purge()
+{
+	RemoveAll();
+	m_Leaves.Purge();
+	m_FreeLeaves.Purge();
+}
+
+
+//-----------------------------------------------------------------------------
+// Searching
+//-----------------------------------------------------------------------------
+template < typename K, typename V, typename L >
+inline int CUtlBTreeBase<K, V, L>::LowerBoundKey( const K *pKeys, int nKeys, const K &key ) const
+{
+	int nLow = 0;
+	int nHigh = nKeys;
+	while ( nLow < nHigh )
+	{
+		int nMid = ( nLow + nHigh ) >> 1;
+		if ( m_LessFunc( pKeys[nMid], key ) )
+		{
+			nLow = nMid + 1;
+		}
+		else
+		{
+			nHigh = nMid;
+		}
+	}
+	return nLow;
+}
+
+template < typename K, typename V, typename L >
+inline int CUtlBTreeBase<K, V, L>::UpperBoundKey( const K *pKeys, int nKeys, const K &key ) const
+{
+	int nLow = 0;
+	int nHigh = nKeys;
+	while ( nLow < nHigh )
+	{
+		int nMid = ( nLow + nHigh ) >> 1;
+		if ( m_LessFunc( key, pKeys[nMid] ) )
+		{
+			nHigh = nMid;
+		}
+		else
+		{
+			nLow = nMid + 1;
+		}
+	}
+	return nLow;
+}
+
+// Finds the leftmost leaf which could hold the lower bound of key, or the
+// leaf where key would be inserted after its equals if bUpper is set
+template < typename K, typename V, typename L >
+typename CUtlBTreeBase<K, V, L>::Leaf_t *CUtlBTreeBase<K, V, L>::FindLeaf( const K &key, bool bUpper ) const
+{
+	Node_t *pNode = m_pRoot;
+	for ( int nLevel = m_nInnerLevels; nLevel > 0; nLevel-- )
+	{
+		Inner_t *pInner = (Inner_t *)pNode;
+		int iChild = bUpper ? UpperBoundKey( InnerKeys( pInner ), pInner->m_nKeys, key ) : LowerBoundKey( InnerKeys( pInner ), pInner->m_nKeys, key );
+		pNode = pInner->m_pChildren[iChild];
+	}
+	return (Leaf_t *)pNode;
+}
+
+template < typename K, typename V, typename L >
+inline typename CUtlBTreeBase<K, V, L>::IndexType_t CUtlBTreeBase<K, V, L>::HandleOrNext( const Leaf_t *pLeaf, int iSlot ) const
+{
+	if ( iSlot < pLeaf->m_nKeys )
+		return MakeHandle( pLeaf, iSlot );
+
+	// Only the root leaf is ever empty, so the next leaf has something in it
+	return pLeaf->m_pNext ? MakeHandle( pLeaf->m_pNext, 0 ) : InvalidIndex();
+}
+
+template < typename K, typename V, typename L >
+typename CUtlBTreeBase<K, V, L>::IndexType_t CUtlBTreeBase<K, V, L>::FindLowerBound( const KeyType_t &key ) const
+{
+	if ( !m_pRoot )
+		return InvalidIndex();
+
+	Leaf_t *pLeaf = FindLeaf( key, false );
+	return HandleOrNext( pLeaf, LowerBoundKey( LeafKeys( pLeaf ), pLeaf->m_nKeys, key ) );
+}
+
+template < typename K, typename V, typename L >
+typename CUtlBTreeBase<K, V, L>::IndexType_t CUtlBTreeBase<K, V, L>::FindUpperBound( const KeyType_t &key ) const
+{
+	if ( !m_pRoot )
+		return InvalidIndex();
+
+	Leaf_t *pLeaf = FindLeaf( key, true );
+	return HandleOrNext( pLeaf, UpperBoundKey( LeafKeys( pLeaf ), pLeaf->m_nKeys, key ) );
+}
+
+template < typename K, typename V, typename L >
+typename CUtlBTreeBase<K, V, L>::IndexType_t CUtlBTreeBase<K, V, L>::Find( const KeyType_t &key ) const
+{
+	IndexType_t i = FindLowerBound( key );
+	if ( i != InvalidIndex() && m_LessFunc( key, Key( i ) ) )
+		return InvalidIndex();
+	return i;
+}
+
+template < typename K, typename V, typename L >
+template < typename F >
+int CUtlBTreeBase<K, V, L>::ScanRangeInternal( const K &lo, const K &hi, F &func ) const
+{
+	if ( !m_pRoot || !m_LessFunc( lo, hi ) )
+		return 0;
+
+	int nVisited = 0;
+	Leaf_t *pLeaf = FindLeaf( lo, false );
+	int iSlot = LowerBoundKey( LeafKeys( pLeaf ), pLeaf->m_nKeys, lo );
+	for ( ; pLeaf; pLeaf = pLeaf->m_pNext, iSlot = 0 )
+	{
+		const K *pKeys = LeafKeys( pLeaf );
+		const V *pValues = LeafValues( pLeaf );
+
+		// Only the last leaf of the range needs its end searched for
+		int nEnd = pLeaf->m_nKeys;
+		bool bLast = !m_LessFunc( pKeys[nEnd - 1], hi );
+		if ( bLast )
+		{
+			nEnd = LowerBoundKey( pKeys, nEnd, hi );
+		}
+
+		for ( ; iSlot < nEnd; iSlot++ )
+		{
+			func( pKeys[iSlot], pValues[iSlot] );
+			nVisited++;
+		}
+
+		if ( bLast )
+			break;
+	}
+	return nVisited;
+}
+
+
+//-----------------------------------------------------------------------------
+// Handles and iteration
+//-----------------------------------------------------------------------------
+template < typename K, typename V, typename L >
+inline bool CUtlBTreeBase<K, V, L>::IsValidIndex( IndexType_t i ) const
+{
+	if ( i < 0 )
+		return false;
+
+	int iLeaf = i >> SLOT_BITS;
+	if ( iLeaf >= m_Leaves.Count() || !m_Leaves[iLeaf] )
+		return false;
+
+	return SlotOf( i ) < m_Leaves[iLeaf]->m_nKeys;
+}
+
+template < typename K, typename V, typename L >
+inline typename CUtlBTreeBase<K, V, L>::IndexType_t CUtlBTreeBase<K, V, L>::NextInorder( IndexType_t i ) const
+{
+	Assert( IsValidIndex( i ) );
+	const Leaf_t *pLeaf = LeafOf( i );
+	return HandleOrNext( pLeaf, SlotOf( i ) + 1 );
+}
+
+template < typename K, typename V, typename L >
+inline typename CUtlBTreeBase<K, V, L>::IndexType_t CUtlBTreeBase<K, V, L>::PrevInorder( IndexType_t i ) const
+{
+	Assert( IsValidIndex( i ) );
+	if ( SlotOf( i ) > 0 )
+		return i - 1;
+
+	const Leaf_t *pPrev = LeafOf( i )->m_pPrev;
+	return pPrev ? MakeHandle( pPrev, pPrev->m_nKeys - 1 ) : InvalidIndex();
+}
+
+
+//-----------------------------------------------------------------------------
+// Insertion
+//-----------------------------------------------------------------------------
+template < typename K, typename V, typename L >
+typename CUtlBTreeBase<K, V, L>::IndexType_t CUtlBTreeBase<K, V, L>::InsertInternal( const K &key, const V *pValue )
+{
+	if ( !m_pRoot )
+	{
+		m_pHead = m_pTail = AllocLeaf();
+		m_pRoot = m_pHead;
+	}
+
+	Leaf_t *pLeaf = FindLeaf( key, true );
+	K *pKeys = LeafKeys( pLeaf );
+	V *pValues = LeafValues( pLeaf );
+	int nKeys = pLeaf->m_nKeys;
+	int iSlot = UpperBoundKey( pKeys, nKeys, key );
+
+	// The key or value may live in this very leaf; follow it when it moves
+	const K *pKey = &key;
+	if ( pKey >= pKeys + iSlot && pKey < pKeys + nKeys )
+	{
+		pKey++;
+	}
+	if ( pValue >= pValues + iSlot && pValue < pValues + nKeys )
+	{
+		pValue++;
+	}
+
+	memmove( (void *)( pKeys + iSlot + 1 ), (void *)( pKeys + iSlot ), ( nKeys - iSlot ) * sizeof( K ) );
+	memmove( (void *)( pValues + iSlot + 1 ), (void *)( pValues + iSlot ), ( nKeys - iSlot ) * sizeof( V ) );
+	CopyConstruct( &pKeys[iSlot], *pKey );
+	if ( pValue )
+	{
+		CopyConstruct( &pValues[iSlot], *pValue );
+	}
+	else
+	{
+		Construct( &pValues[iSlot] );
+	}
+	pLeaf->m_nKeys = ++nKeys;
+	m_nCount++;
+
+	if ( nKeys <= MAX_KEYS )
+		return MakeHandle( pLeaf, iSlot );
+
+	// Split the upper half off into a new leaf
+	Leaf_t *pRight = AllocLeaf();
+	int nLeft = nKeys / 2;
+	int nRight = nKeys - nLeft;
+	memcpy( (void *)LeafKeys( pRight ), (void *)( pKeys + nLeft ), nRight * sizeof( K ) );
+	memcpy( (void *)LeafValues( pRight ), (void *)( pValues + nLeft ), nRight * sizeof( V ) );
+	pLeaf->m_nKeys = nLeft;
+	pRight->m_nKeys = nRight;
+
+	pRight->m_pPrev = pLeaf;
+	pRight->m_pNext = pLeaf->m_pNext;
+	if ( pLeaf->m_pNext )
+	{
+		pLeaf->m_pNext->m_pPrev = pRight;
+	}
+	else
+	{
+		m_pTail = pRight;
+	}
+	pLeaf->m_pNext = pRight;
+
+	InsertIntoParent( pLeaf, LeafKeys( pRight )[0], pRight );
+
+	return ( iSlot < nLeft ) ? MakeHandle( pLeaf, iSlot ) : MakeHandle( pRight, iSlot - nLeft );
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::InsertIntoParent( Node_t *pLeft, const K &separator, Node_t *pRight )
+{
+	Inner_t *pParent = pLeft->m_pParent;
+	if ( !pParent )
+	{
+		// Splitting the root grows the tree by a level
+		pParent = AllocInner();
+		CopyConstruct( &InnerKeys( pParent )[0], separator );
+		pParent->m_nKeys = 1;
+		pParent->m_pChildren[0] = pLeft;
+		pParent->m_pChildren[1] = pRight;
+		pLeft->m_pParent = pParent;
+		pRight->m_pParent = pParent;
+		m_pRoot = pParent;
+		m_nInnerLevels++;
+		return;
+	}
+
+	K *pKeys = InnerKeys( pParent );
+	int nKeys = pParent->m_nKeys;
+	int iChild = ChildIndex( pParent, pLeft );
+	memmove( (void *)( pKeys + iChild + 1 ), (void *)( pKeys + iChild ), ( nKeys - iChild ) * sizeof( K ) );
+	memmove( &pParent->m_pChildren[ iChild + 2 ], &pParent->m_pChildren[ iChild + 1 ], ( nKeys - iChild ) * sizeof( Node_t * ) );
+	CopyConstruct( &pKeys[iChild], separator );
+	pParent->m_pChildren[ iChild + 1 ] = pRight;
+	pRight->m_pParent = pParent;
+	pParent->m_nKeys = ++nKeys;
+
+	if ( nKeys <= MAX_KEYS )
+		return;
+
+	// Split the node; the middle key moves up a level
+	Inner_t *pNew = AllocInner();
+	int nLeft = nKeys / 2;
+	int nRight = nKeys - nLeft - 1;
+	memcpy( (void *)InnerKeys( pNew ), (void *)( pKeys + nLeft + 1 ), nRight * sizeof( K ) );
+	memcpy( pNew->m_pChildren, &pParent->m_pChildren[ nLeft + 1 ], ( nRight + 1 ) * sizeof( Node_t * ) );
+	for ( int i = 0; i <= nRight; i++ )
+	{
+		pNew->m_pChildren[i]->m_pParent = pNew;
+	}
+	pParent->m_nKeys = nLeft;
+	pNew->m_nKeys = nRight;
+
+	// The middle key is no longer part of either node
+	InsertIntoParent( pParent, pKeys[nLeft], pNew );
+	Destruct( &pKeys[nLeft] );
+}
+
+template < typename K, typename V, typename L >
+inline int CUtlBTreeBase<K, V, L>::ChildIndex( const Inner_t *pParent, const Node_t *pChild )
+{
+	int i = 0;
+	while ( pParent->m_pChildren[i] != pChild )
+	{
+		i++;
+		Assert( i <= pParent->m_nKeys );
+	}
+	return i;
+}
+
+
+//-----------------------------------------------------------------------------
+// Removal
+//-----------------------------------------------------------------------------
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::RemoveAt( IndexType_t i )
+{
+	Assert( IsValidIndex( i ) );
+	Leaf_t *pLeaf = LeafOf( i );
+	int iSlot = SlotOf( i );
+	K *pKeys = LeafKeys( pLeaf );
+	V *pValues = LeafValues( pLeaf );
+
+	Destruct( &pKeys[iSlot] );
+	Destruct( &pValues[iSlot] );
+	int nMove = pLeaf->m_nKeys - iSlot - 1;
+	memmove( (void *)( pKeys + iSlot ), (void *)( pKeys + iSlot + 1 ), nMove * sizeof( K ) );
+	memmove( (void *)( pValues + iSlot ), (void *)( pValues + iSlot + 1 ), nMove * sizeof( V ) );
+	pLeaf->m_nKeys--;
+	m_nCount--;
+
+	RebalanceLeaf( pLeaf );
+}
+
+template < typename K, typename V, typename L >
+bool CUtlBTreeBase<K, V, L>::Remove( const KeyType_t &key )
+{
+	IndexType_t i = Find( key );
+	if ( i == InvalidIndex() )
+		return false;
+
+	RemoveAt( i );
+	return true;
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::RebalanceLeaf( Leaf_t *pLeaf )
+{
+	if ( pLeaf == m_pRoot )
+	{
+		if ( !pLeaf->m_nKeys )
+		{
+			FreeLeaf( pLeaf );
+			m_pRoot = NULL;
+			m_pHead = NULL;
+			m_pTail = NULL;
+		}
+		return;
+	}
+
+	if ( pLeaf->m_nKeys >= MIN_KEYS )
+		return;
+
+	Inner_t *pParent = pLeaf->m_pParent;
+	int iChild = ChildIndex( pParent, pLeaf );
+	Leaf_t *pLeft = ( iChild > 0 ) ? (Leaf_t *)pParent->m_pChildren[ iChild - 1 ] : NULL;
+	Leaf_t *pRight = ( iChild < pParent->m_nKeys ) ? (Leaf_t *)pParent->m_pChildren[ iChild + 1 ] : NULL;
+	K *pKeys = LeafKeys( pLeaf );
+	V *pValues = LeafValues( pLeaf );
+	int nKeys = pLeaf->m_nKeys;
+
+	if ( pLeft && pLeft->m_nKeys > MIN_KEYS )
+	{
+		// Take the last element of the left sibling
+		int iLast = --pLeft->m_nKeys;
+		memmove( (void *)( pKeys + 1 ), (void *)pKeys, nKeys * sizeof( K ) );
+		memmove( (void *)( pValues + 1 ), (void *)pValues, nKeys * sizeof( V ) );
+		memcpy( (void *)pKeys, (void *)&LeafKeys( pLeft )[iLast], sizeof( K ) );
+		memcpy( (void *)pValues, (void *)&LeafValues( pLeft )[iLast], sizeof( V ) );
+		pLeaf->m_nKeys++;
+		InnerKeys( pParent )[ iChild - 1 ] = pKeys[0];
+	}
+	else if ( pRight && pRight->m_nKeys > MIN_KEYS )
+	{
+		// Take the first element of the right sibling
+		K *pRightKeys = LeafKeys( pRight );
+		V *pRightValues = LeafValues( pRight );
+		int nRight = --pRight->m_nKeys;
+		memcpy( (void *)&pKeys[nKeys], (void *)pRightKeys, sizeof( K ) );
+		memcpy( (void *)&pValues[nKeys], (void *)pRightValues, sizeof( V ) );
+		memmove( (void *)pRightKeys, (void *)( pRightKeys + 1 ), nRight * sizeof( K ) );
+		memmove( (void *)pRightValues, (void *)( pRightValues + 1 ), nRight * sizeof( V ) );
+		pLeaf->m_nKeys++;
+		InnerKeys( pParent )[ iChild ] = pRightKeys[0];
+	}
+	else if ( pLeft )
+	{
+		MergeLeaves( pLeft, pLeaf, iChild - 1 );
+	}
+	else
+	{
+		MergeLeaves( pLeaf, pRight, iChild );
+	}
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::MergeLeaves( Leaf_t *pLeft, Leaf_t *pRight, int iSeparator )
+{
+	int nLeft = pLeft->m_nKeys;
+	int nRight = pRight->m_nKeys;
+	memcpy( (void *)( LeafKeys( pLeft ) + nLeft ), (void *)LeafKeys( pRight ), nRight * sizeof( K ) );
+	memcpy( (void *)( LeafValues( pLeft ) + nLeft ), (void *)LeafValues( pRight ), nRight * sizeof( V ) );
+	pLeft->m_nKeys = nLeft + nRight;
+
+	pLeft->m_pNext = pRight->m_pNext;
+	if ( pRight->m_pNext )
+	{
+		pRight->m_pNext->m_pPrev = pLeft;
+	}
+	else
+	{
+		m_pTail = pLeft;
+	}
+	FreeLeaf( pRight );
+
+	Inner_t *pParent = pLeft->m_pParent;
+	Destruct( &InnerKeys( pParent )[ iSeparator ] );
+	RemoveInnerEntry( pParent, iSeparator );
+	RebalanceInner( pParent );
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::RebalanceInner( Inner_t *pInner )
+{
+	if ( pInner == m_pRoot )
+	{
+		if ( !pInner->m_nKeys )
+		{
+			// The root is down to one child, which takes its place
+			m_pRoot = pInner->m_pChildren[0];
+			m_pRoot->m_pParent = NULL;
+			FreeInner( pInner );
+			m_nInnerLevels--;
+		}
+		return;
+	}
+
+	if ( pInner->m_nKeys >= MIN_KEYS )
+		return;
+
+	Inner_t *pParent = pInner->m_pParent;
+	int iChild = ChildIndex( pParent, pInner );
+	Inner_t *pLeft = ( iChild > 0 ) ? (Inner_t *)pParent->m_pChildren[ iChild - 1 ] : NULL;
+	Inner_t *pRight = ( iChild < pParent->m_nKeys ) ? (Inner_t *)pParent->m_pChildren[ iChild + 1 ] : NULL;
+	K *pKeys = InnerKeys( pInner );
+	K *pParentKeys = InnerKeys( pParent );
+	int nKeys = pInner->m_nKeys;
+
+	if ( pLeft && pLeft->m_nKeys > MIN_KEYS )
+	{
+		// Rotate the last child of the left sibling over through the parent
+		int iLast = --pLeft->m_nKeys;
+		memmove( (void *)( pKeys + 1 ), (void *)pKeys, nKeys * sizeof( K ) );
+		memmove( &pInner->m_pChildren[1], &pInner->m_pChildren[0], ( nKeys + 1 ) * sizeof( Node_t * ) );
+		memcpy( (void *)pKeys, (void *)&pParentKeys[ iChild - 1 ], sizeof( K ) );
+		memcpy( (void *)&pParentKeys[ iChild - 1 ], (void *)&InnerKeys( pLeft )[iLast], sizeof( K ) );
+		pInner->m_pChildren[0] = pLeft->m_pChildren[ iLast + 1 ];
+		pInner->m_pChildren[0]->m_pParent = pInner;
+		pInner->m_nKeys++;
+	}
+	else if ( pRight && pRight->m_nKeys > MIN_KEYS )
+	{
+		// Rotate the first child of the right sibling over through the parent
+		K *pRightKeys = InnerKeys( pRight );
+		int nRight = --pRight->m_nKeys;
+		memcpy( (void *)&pKeys[nKeys], (void *)&pParentKeys[iChild], sizeof( K ) );
+		memcpy( (void *)&pParentKeys[iChild], (void *)pRightKeys, sizeof( K ) );
+		pInner->m_pChildren[ nKeys + 1 ] = pRight->m_pChildren[0];
+		pInner->m_pChildren[ nKeys + 1 ]->m_pParent = pInner;
+		memmove( (void *)pRightKeys, (void *)( pRightKeys + 1 ), nRight * sizeof( K ) );
+		memmove( &pRight->m_pChildren[0], &pRight->m_pChildren[1], ( nRight + 1 ) * sizeof( Node_t * ) );
+		pInner->m_nKeys++;
+	}
+	else if ( pLeft )
+	{
+		MergeInner( pLeft, pInner, iChild - 1 );
+	}
+	else
+	{
+		MergeInner( pInner, pRight, iChild );
+	}
+}
+
+template < typename K, typename V, typename L >
+void CUtlBTreeBase<K, V, L>::MergeInner( Inner_t *pLeft, Inner_t *pRight, int iSeparator )
+{
+	// The separator comes down from the parent between the two key ranges
+	Inner_t *pParent = pLeft->m_pParent;
+	K *pLeftKeys = InnerKeys( pLeft );
+	int nLeft = pLeft->m_nKeys;
+	int nRight = pRight->m_nKeys;
+	memcpy( (void *)&pLeftKeys[nLeft], (void *)&InnerKeys( pParent )[iSeparator], sizeof( K ) );
+	memcpy( (void *)&pLeftKeys[ nLeft + 1 ], (void *)InnerKeys( pRight ), nRight * sizeof( K ) );
+	memcpy( &pLeft->m_pChildren[ nLeft + 1 ], pRight->m_pChildren, ( nRight + 1 ) * sizeof( Node_t * ) );
+	for ( int i = 0; i <= nRight; i++ )
+	{
+		pRight->m_pChildren[i]->m_pParent = pLeft;
+	}
+	pLeft->m_nKeys = nLeft + 1 + nRight;
+	FreeInner( pRight );
+
+	RemoveInnerEntry( pParent, iSeparator );
+	RebalanceInner( pParent );
+}
+
+// Drops key iKey and the child to its right; the key must already be destructed or moved
+template < typename K, typename V, typename L >
+inline void CUtlBTreeBase<K, V, L>::RemoveInnerEntry( Inner_t *pInner, int iKey )
+{
+	K *pKeys = InnerKeys( pInner );
+	int nMove = pInner->m_nKeys - iKey - 1;
+	memmove( (void *)( pKeys + iKey ), (void *)( pKeys + iKey + 1 ), nMove * sizeof( K ) );
+	memmove( &pInner->m_pChildren[ iKey + 1 ], &pInner->m_pChildren[ iKey + 2 ], nMove * sizeof( Node_t * ) );
+	pInner->m_nKeys--;
+}
+
+
+//-----------------------------------------------------------------------------
+// Bulk loading. The elements are spread evenly over the fewest leaves that
+// hold them, then each inner level is built the same way over the one below.
+//-----------------------------------------------------------------------------
+template < typename K, typename V, typename L >
+template < typename S >
+void CUtlBTreeBase<K, V, L>::BuildFromSorted( S &source, int nCount )
+{
+	RemoveAll();
+	if ( nCount <= 0 )
+		return;
+
+	int nLeaves = ( nCount + MAX_KEYS - 1 ) / MAX_KEYS;
+	CUtlVector< Node_t * > level( 0, nLeaves );
+	CUtlVector< const K * > separators( 0, nLeaves );	// Lowest key under each node of the level
+
+	m_Leaves.EnsureCapacity( nLeaves );
+	for ( int i = 0; i < nLeaves; i++ )
+	{
+		Leaf_t *pLeaf = AllocLeaf();
+		K *pKeys = LeafKeys( pLeaf );
+		V *pValues = LeafValues( pLeaf );
+		int nKeys = nCount / nLeaves + ( ( i < nCount % nLeaves ) ? 1 : 0 );
+		for ( int j = 0; j < nKeys; j++ )
+		{
+			const K *pKey;
+			const V *pValue;
+			source.Get( pKey, pValue );
+			CopyConstruct( &pKeys[j], *pKey );
+			if ( pValue )
+			{
+				CopyConstruct( &pValues[j], *pValue );
+			}
+			else
+			{
+				Construct( &pValues[j] );
+			}
+			Assert( ( j > 0 ) ? !m_LessFunc( pKeys[j], pKeys[ j - 1 ] ) : ( !m_pTail || !m_LessFunc( pKeys[0], LeafKeys( m_pTail )[ m_pTail->m_nKeys - 1 ] ) ) );
+		}
+		pLeaf->m_nKeys = nKeys;
+
+		pLeaf->m_pPrev = m_pTail;
+		if ( m_pTail )
+		{
+			m_pTail->m_pNext = pLeaf;
+		}
+		else
+		{
+			m_pHead = pLeaf;
+		}
+		m_pTail = pLeaf;
+
+		level.AddToTail( pLeaf );
+		separators.AddToTail( &pKeys[0] );
+	}
+	m_nCount = nCount;
+
+	CUtlVector< Node_t * > upperLevel;
+	CUtlVector< const K * > upperSeparators;
+	while ( level.Count() > 1 )
+	{
+		int nChildren = level.Count();
+		int nNodes = ( nChildren + MAX_KEYS ) / ( MAX_KEYS + 1 );
+		upperLevel.RemoveAll();
+		upperSeparators.RemoveAll();
+
+		int iChild = 0;
+		for ( int i = 0; i < nNodes; i++ )
+		{
+			Inner_t *pInner = AllocInner();
+			K *pKeys = InnerKeys( pInner );
+			int nNodeChildren = nChildren / nNodes + ( ( i < nChildren % nNodes ) ? 1 : 0 );
+			for ( int j = 0; j < nNodeChildren; j++ )
+			{
+				Node_t *pChild = level[ iChild + j ];
+				pInner->m_pChildren[j] = pChild;
+				pChild->m_pParent = pInner;
+				if ( j > 0 )
+				{
+					CopyConstruct( &pKeys[ j - 1 ], *separators[ iChild + j ] );
+				}
+			}
+			pInner->m_nKeys = nNodeChildren - 1;
+
+			upperLevel.AddToTail( pInner );
+			upperSeparators.AddToTail( separators[iChild] );
+			iChild += nNodeChildren;
+		}
+
+		level.Swap( upperLevel );
+		separators.Swap( upperSeparators );
+		m_nInnerLevels++;
+	}
+	m_pRoot = level[0];
+}
+
+
+//-----------------------------------------------------------------------------
+// Validation
+//-----------------------------------------------------------------------------
+template < typename K, typename V, typename L >
+bool CUtlBTreeBase<K, V, L>::ValidateNode( const Node_t *pNode, int nLevel, const K *pLow, const K *pHigh, int &nCount ) const
+{
+	bool bRoot = ( pNode == m_pRoot );
+	if ( pNode->m_nKeys > MAX_KEYS || ( !bRoot && pNode->m_nKeys < MIN_KEYS ) )
+		return false;
+
+	const K *pKeys = ( nLevel == 0 ) ? LeafKeys( (const Leaf_t *)pNode ) : InnerKeys( (const Inner_t *)pNode );
+	for ( int i = 0; i < pNode->m_nKeys; i++ )
+	{
+		if ( i > 0 && m_LessFunc( pKeys[i], pKeys[ i - 1 ] ) )
+			return false;
+		if ( ( pLow && m_LessFunc( pKeys[i], *pLow ) ) || ( pHigh && m_LessFunc( *pHigh, pKeys[i] ) ) )
+			return false;
+	}
+
+	if ( nLevel == 0 )
+	{
+		nCount += pNode->m_nKeys;
+		return true;
+	}
+
+	const Inner_t *pInner = (const Inner_t *)pNode;
+	if ( bRoot && pInner->m_nKeys < 1 )
+		return false;
+
+	for ( int i = 0; i <= pInner->m_nKeys; i++ )
+	{
+		const Node_t *pChild = pInner->m_pChildren[i];
+		if ( pChild->m_pParent != pInner )
+			return false;
+
+		const K *pChildLow = ( i > 0 ) ? &pKeys[ i - 1 ] : pLow;
+		const K *pChildHigh = ( i < pInner->m_nKeys ) ? &pKeys[i] : pHigh;
+		if ( !ValidateNode( pChild, nLevel - 1, pChildLow, pChildHigh, nCount ) )
+			return false;
+	}
+	return true;
+}
+
+template < typename K, typename V, typename L >
+bool CUtlBTreeBase<K, V, L>::IsValid() const
+{
+	if ( !m_pRoot )
+		return !m_nCount && !m_pHead && !m_pTail;
+
+	if ( m_pRoot->m_pParent )
+		return false;
+
+	int nCount = 0;
+	if ( !ValidateNode( m_pRoot, m_nInnerLevels, NULL, NULL, nCount ) || nCount != m_nCount )
+		return false;
+
+	// The leaf chain has to cover every element in order
+	nCount = 0;
+	const Leaf_t *pPrev = NULL;
+	for ( const Leaf_t *pLeaf = m_pHead; pLeaf; pLeaf = pLeaf->m_pNext )
+	{
+		if ( pLeaf->m_pPrev != pPrev || m_Leaves[ pLeaf->m_iLeaf ] != pLeaf )
+			return false;
+		if ( pPrev && m_LessFunc( LeafKeys( pLeaf )[0], LeafKeys( pPrev )[ pPrev->m_nKeys - 1 ] ) )
+			return false;
+		nCount += pLeaf->m_nKeys;
+		pPrev = pLeaf;
+	}
+	return pPrev == m_pTail && nCount == m_nCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// An ordered set (or multiset) of T, in the style of CUtlRBTree.
+//-----------------------------------------------------------------------------
+template < typename T, typename L = bool (*)( const T &, const T & ) >
+class CUtlBTree : public CUtlBTreeBase< T, CUtlBTreeEmpty_t, L >
+{
+	typedef CUtlBTreeBase< T, CUtlBTreeEmpty_t, L > BaseClass;
+
+public:
+	typedef T ElemType_t;
+	typedef L LessFunc_t;
+	typedef int IndexType_t;
+
+	// LessFunc_t is required, but may be set after the constructor using SetLessFunc()
+	CUtlBTree( const LessFunc_t &lessfunc = 0 ) : BaseClass( lessfunc ) {}
+
+	// Changing an element in a way that changes its ordering breaks the tree
+	T &Element( IndexType_t i )								{ return const_cast< T & >( this->Key( i ) ); }
+	const T &Element( IndexType_t i ) const					{ return this->Key( i ); }
+	T &operator[]( IndexType_t i )							{ return Element( i ); }
+	const T &operator[]( IndexType_t i ) const				{ return Element( i ); }
+
+	// Insert methods (insert in order, after any equal elements)
+	IndexType_t Insert( const T &insert )					{ return this->InsertInternal( insert, NULL ); }
+	void Insert( const T *pArray, int nItems )
+	{
+		for ( int i = 0; i < nItems; i++ )
+		{
+			Insert( pArray[i] );
+		}
+	}
+	IndexType_t InsertIfNotFound( const T &insert )
+	{
+		IndexType_t i = this->Find( insert );
+		return ( i != this->InvalidIndex() ) ? this->InvalidIndex() : Insert( insert );
+	}
+
+	bool HasElement( const T &search ) const				{ return this->Find( search ) != this->InvalidIndex(); }
+
+	// Replaces the contents with nItems elements, which must already be sorted
+	void BulkLoad( const T *pArray, int nItems )
+	{
+		typename BaseClass::ArraySource_t source;
+		source.m_pKeys = pArray;
+		source.m_pValues = NULL;
+		this->BuildFromSorted( source, nItems );
+	}
+
+	// Calls func( element ) for every element in [lo, hi), in order. Returns the number of elements visited.
+	template < typename F > int ScanRange( const T &lo, const T &hi, F &func ) const
+	{
+		CScanAdapter< F > adapter( func );
+		return this->ScanRangeInternal( lo, hi, adapter );
+	}
+
+private:
+	template < typename F >
+	class CScanAdapter
+	{
+	public:
+		CScanAdapter( F &func ) : m_Func( func ) {}
+		void operator()( const T &elem, const CUtlBTreeEmpty_t & ) { m_Func( elem ); }
+
+	private:
+		F &m_Func;
+	};
+};
+
+
+//-----------------------------------------------------------------------------
+// An ordered map from K to T, in the style of CUtlMap. Works with FOR_EACH_MAP
+// and FOR_EACH_MAP_FAST.
+//-----------------------------------------------------------------------------
+template < typename K, typename T, typename L = bool (*)( const K &, const K & ) >
+class CUtlBTreeMap : public base_utlmap_t, public CUtlBTreeBase< K, T, L >
+{
+	typedef CUtlBTreeBase< K, T, L > BaseClass;
+
+public:
+	typedef K KeyType_t;
+	typedef T ElemType_t;
+	typedef L LessFunc_t;
+	typedef int IndexType_t;
+
+	// LessFunc_t is required, but may be set after the constructor using SetLessFunc()
+	CUtlBTreeMap( const LessFunc_t &lessfunc = 0 ) : BaseClass( lessfunc ) {}
+
+	// gets particular elements
+	ElemType_t &		Element( IndexType_t i )			{ return this->Value( i ); }
+	const ElemType_t &	Element( IndexType_t i ) const		{ return this->Value( i ); }
+	ElemType_t &		operator[]( IndexType_t i )			{ return this->Value( i ); }
+	const ElemType_t &	operator[]( IndexType_t i ) const	{ return this->Value( i ); }
+
+	// Insert methods (insert in order, after any equal keys)
+	IndexType_t Insert( const KeyType_t &key, const ElemType_t &insert )	{ return this->InsertInternal( key, &insert ); }
+	IndexType_t Insert( const KeyType_t &key )								{ return this->InsertInternal( key, NULL ); }
+
+	IndexType_t InsertOrReplace( const KeyType_t &key, const ElemType_t &insert )
+	{
+		IndexType_t i = this->Find( key );
+		if ( i != this->InvalidIndex() )
+		{
+			Element( i ) = insert;
+			return i;
+		}
+
+		return Insert( key, insert );
+	}
+
+	// Purges the map and calls delete on each element in it.
+	void PurgeAndDeleteElements()
+	{
+		for ( IndexType_t i = this->FirstInorder(); i != this->InvalidIndex(); i = this->NextInorder( i ) )
+		{
+			delete Element( i );
+		}
+		this->Purge();
+	}
+
+	// Replaces the contents with nItems key/element pairs, which must already be sorted by key.
+	// pElems may be NULL to default construct the elements.
+	void BulkLoad( const KeyType_t *pKeys, const ElemType_t *pElems, int nItems )
+	{
+		typename BaseClass::ArraySource_t source;
+		source.m_pKeys = pKeys;
+		source.m_pValues = pElems;
+		this->BuildFromSorted( source, nItems );
+	}
+
+	// Calls func( key, element ) for every key in [lo, hi), in order. Returns the number of elements visited.
+	template < typename F > int ScanRange( const KeyType_t &lo, const KeyType_t &hi, F &func ) const
+	{
+		return this->ScanRangeInternal( lo, hi, func );
+	}
+
+	void Swap( CUtlBTreeMap &that )							{ BaseClass::Swap( that ); }
+};
+
+#endif // UTLBTREE_H
@@ -0,0 +1,572 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: An open addressing hash map with the CUtlMap interface.
+//
+// CUtlFlatHashMap keeps its key/element pairs in one flat array next to a
+// parallel array of one byte control codes. Each control byte holds 7 bits
+// of the key's hash for a full slot, or marks the slot empty/deleted. A
+// lookup hashes the key once and compares a whole group of 16 control bytes
+// against the hash bits with a couple of SSE2 instructions. Only slots whose
+// bits match get a real key compare, so most lookups touch one cache line of
+// control bytes and one slot.
+//
+// Differences from CUtlMap:
+//	- keys are hashed (KeyHashT / KeyIsEqualT functors, same as CUtlHashtable)
+//	  rather than ordered; there is no less func.
+//	- keys are unique. Insert() of an existing key returns the existing index
+//	  and leaves its element alone; use InsertOrReplace() to overwrite.
+//	- FirstInorder/NextInorder iterate in slot order, not key order.
+//	- indices stay valid across Remove(), but an Insert() that grows the
+//	  table moves every element.
+//
+//=============================================================================
+
+#ifndef UTLFLATHASHMAP_H
+#define UTLFLATHASHMAP_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier0/dbg.h"
+#include "tier1/utlmap.h"
+#include "tier1/utlcommon.h"
+#include "tier1/utlmemory.h"
+
+#if !defined( _X360 ) && !defined( _PS3 ) && ( defined( _WIN32 ) || defined( __SSE2__ ) )
+#define UTLFLATHASHMAP_SSE2 1
+#include <emmintrin.h>
+#else
+#define UTLFLATHASHMAP_SSE2 0
+#endif
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+template < typename K, typename T, typename KeyHashT = DefaultHashFunctor<K>, typename KeyIsEqualT = DefaultEqualFunctor<K> >
+class CUtlFlatHashMap : public base_utlmap_t
+{
+public:
+	typedef K KeyType_t;
+	typedef T ElemType_t;
+	typedef int IndexType_t;
+
+	CUtlFlatHashMap( int initSize = 0 );
+	CUtlFlatHashMap( const CUtlFlatHashMap &from );
+	~CUtlFlatHashMap();
+
+	CUtlFlatHashMap &operator=( const CUtlFlatHashMap &from );
+
+	// Makes sure num elements fit without growing the table
+	void EnsureCapacity( int num );
+
+	// gets particular elements
+	ElemType_t &		Element( IndexType_t i )			{ Assert( IsValidIndex( i ) ); return m_pSlots[i].elem; }
+	const ElemType_t &	Element( IndexType_t i ) const		{ Assert( IsValidIndex( i ) ); return m_pSlots[i].elem; }
+	ElemType_t &		operator[]( IndexType_t i )			{ return Element( i ); }
+	const ElemType_t &	operator[]( IndexType_t i ) const	{ return Element( i ); }
+	const KeyType_t &	Key( IndexType_t i ) const			{ Assert( IsValidIndex( i ) ); return m_pSlots[i].key; }
+
+	// Num elements
+	unsigned int Count() const								{ return m_nCount; }
+
+	// Number of slots; valid indices are in [0, MaxElement())
+	IndexType_t MaxElement() const							{ return m_nCapacity; }
+
+	// Checks if a slot is valid and in the map
+	bool IsValidIndex( IndexType_t i ) const				{ return (unsigned)i < (unsigned)m_nCapacity && m_pCtrl[i] >= 0; }
+
+	bool IsValid() const									{ return true; }
+
+	static IndexType_t InvalidIndex()						{ return -1; }
+
+	// Insert methods; return the index of the (possibly already present) key
+	IndexType_t Insert( const KeyType_t &key, const ElemType_t &insert );
+	IndexType_t Insert( const KeyType_t &key );
+	IndexType_t InsertOrReplace( const KeyType_t &key, const ElemType_t &insert );
+
+	// Find method
+	IndexType_t Find( const KeyType_t &key ) const;
+
+	// Remove methods
+	void RemoveAt( IndexType_t i );
+	bool Remove( const KeyType_t &key );
+	void RemoveAll();
+	void Purge();
+
+	// Purges the map and calls delete on each element in it.
+	void PurgeAndDeleteElements();
+
+	// Iteration, in slot order
+	IndexType_t FirstInorder() const						{ return NextValid( 0 ); }
+	IndexType_t NextInorder( IndexType_t i ) const			{ return NextValid( i + 1 ); }
+
+	void Swap( CUtlFlatHashMap &that );
+
+private:
+	struct Node_t
+	{
+		KeyType_t	key;
+		ElemType_t	elem;
+	};
+
+	enum
+	{
+		GROUP_WIDTH = 16,
+		MIN_CAPACITY = GROUP_WIDTH,
+	};
+
+	// Control byte values. Full slots hold the low 7 bits of the hash.
+	enum
+	{
+		CTRL_EMPTY = -128,
+		CTRL_DELETED = -2,
+	};
+
+	static int MaxLoad( int nCapacity )						{ return nCapacity - nCapacity / 8; }
+
+	unsigned int HashKey( const KeyType_t &key ) const		{ return m_hash( key ); }
+	static int8 H2( unsigned int nHash )					{ return (int8)( nHash & 0x7F ); }
+	unsigned int GroupMask() const							{ return ( m_nCapacity / GROUP_WIDTH ) - 1; }
+
+	// Bitmask of slots in the group starting at pCtrl whose control byte is value
+	static uint32 MatchGroup( const int8 *pCtrl, int8 value );
+	// Bitmask of slots in the group that are empty or deleted
+	static uint32 MatchEmptyOrDeleted( const int8 *pCtrl );
+	static uint32 MatchEmpty( const int8 *pCtrl )			{ return MatchGroup( pCtrl, (int8)CTRL_EMPTY ); }
+
+	IndexType_t FindWithHash( const KeyType_t &key, unsigned int nHash ) const;
+	IndexType_t FindInsertSlot( unsigned int nHash ) const;
+	IndexType_t InsertNew( const KeyType_t &key, unsigned int nHash );
+	IndexType_t NextValid( IndexType_t i ) const;
+	void Rehash( int nNewCapacity );
+	void Allocate( int nCapacity );
+	void DestructAll();
+
+	int8				*m_pCtrl;
+	Node_t				*m_pSlots;
+	int					m_nCapacity;
+	int					m_nCount;
+	int					m_nGrowthLeft;	// Inserts into empty slots left before a rehash
+	CUtlMemory<int8>	m_Ctrl;
+	CUtlMemory<Node_t>	m_Slots;		// Only memory; nodes are constructed in place
+	KeyHashT			m_hash;
+	KeyIsEqualT			m_eq;
+};
+
+
+//-----------------------------------------------------------------------------
+// Group matching
+//-----------------------------------------------------------------------------
+template < typename K, typename T, typename H, typename E >
+FORCEINLINE uint32 CUtlFlatHashMap<K, T, H, E>::MatchGroup( const int8 *pCtrl, int8 value )
+{
+#if UTLFLATHASHMAP_SSE2
+	__m128i group = _mm_loadu_si128( (const __m128i *)pCtrl );
+	return (uint32)_mm_movemask_epi8( _mm_cmpeq_epi8( group, _mm_set1_epi8( value ) ) );
+#else
+	uint32 nMask = 0;
+	for ( int i = 0; i < GROUP_WIDTH; i++ )
+	{
+		nMask |= ( pCtrl[i] == value ) ? ( 1u << i ) : 0;
+	}
+	return nMask;
+#endif
+}
+
+template < typename K, typename T, typename H, typename E >
+FORCEINLINE uint32 CUtlFlatHashMap<K, T, H, E>::MatchEmptyOrDeleted( const int8 *pCtrl )
+{
+#if UTLFLATHASHMAP_SSE2
+	// Empty and deleted are the only negative control bytes
+	__m128i group = _mm_loadu_si128( (const __m128i *)pCtrl );
+	return (uint32)_mm_movemask_epi8( group );
+#else
+	uint32 nMask = 0;
+	for ( int i = 0; i < GROUP_WIDTH; i++ )
+	{
+		nMask |= ( pCtrl[i] < 0 ) ? ( 1u << i ) : 0;
+	}
+	return nMask;
+#endif
+}
+
+// Index of the lowest set bit
+FORCEINLINE int UtlFlatHashMap_LowestBit( uint32 nMask )
+{
+#if defined( _MSC_VER )
+	unsigned long nIndex;
+	_BitScanForward( &nIndex, nMask );
+	return (int)nIndex;
+#elif defined( __GNUC__ )
+	return __builtin_ctz( nMask );
+#else
+	int nIndex = 0;
+	while ( !( nMask & 1 ) )
+	{
+		nMask >>= 1;
+		nIndex++;
+	}
+	return nIndex;
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Construction
+//-----------------------------------------------------------------------------
+template < typename K, typename T, typename H, typename E >
+CUtlFlatHashMap<K, T, H, E>::CUtlFlatHashMap( int initSize )
+{
+	m_pCtrl = NULL;
+	m_pSlots = NULL;
+	m_nCapacity = 0;
+	m_nCount = 0;
+	m_nGrowthLeft = 0;
+	if ( initSize > 0 )
+	{
+		EnsureCapacity( initSize );
+	}
+}
+
+template < typename K, typename T, typename H, typename E >
+CUtlFlatHashMap<K, T, H, E>::CUtlFlatHashMap( const CUtlFlatHashMap &from ) : m_hash( from.m_hash ), m_eq( from.m_eq )
+{
+	m_pCtrl = NULL;
+	m_pSlots = NULL;
+	m_nCapacity = 0;
+	m_nCount = 0;
+	m_nGrowthLeft = 0;
+	*this = from;
+}
+
+template < typename K, typename T, typename H, typename E >
+CUtlFlatHashMap<K, T, H, E>::~CUtlFlatHashMap()
+{
+	Purge();
+}
+
+template < typename K, typename T, typename H, typename E >
+CUtlFlatHashMap<K, T, H, E> &CUtlFlatHashMap<K, T, H, E>::operator=( const CUtlFlatHashMap &from )
+{
+	if ( this == &from )
+		return *this;
+
+	RemoveAll();
+	EnsureCapacity( from.Count() );
+	for ( int i = from.FirstInorder(); i != InvalidIndex(); i = from.NextInorder( i ) )
+	{
+		Insert( from.Key( i ), from.Element( i ) );
+	}
+	return *this;
+}
+
+template < typename K, typename T, typename H, typename E >
+void CUtlFlatHashMap<K, T, H, E>::Allocate( int nCapacity )
+{
+	Assert( nCapacity >= MIN_CAPACITY && ( nCapacity & ( nCapacity - 1 ) ) == 0 );
+
+	m_Ctrl.Purge();
+	m_Ctrl.EnsureCapacity( nCapacity );
+	m_Slots.Purge();
+	m_Slots.EnsureCapacity( nCapacity );
+
+	m_pCtrl = m_Ctrl.Base();
+	m_pSlots = m_Slots.Base();
+	m_nCapacity = nCapacity;
+	m_nCount = 0;
+	m_nGrowthLeft = MaxLoad( nCapacity );
+	memset( m_pCtrl, CTRL_EMPTY, nCapacity );
+}
+
+template < typename K, typename T, typename H, typename E >
+void CUtlFlatHashMap<K, T, H, E>::EnsureCapacity( int num )
+{
+	if ( num <= m_nCount + m_nGrowthLeft )
+		return;
+
+	int nCapacity = MIN_CAPACITY;
+	while ( MaxLoad( nCapacity ) < num )
+	{
+		nCapacity *= 2;
+	}
+	Rehash( nCapacity );
+}
+
+template < typename K, typename T, typename H, typename E >
+void CUtlFlatHashMap<K, T, H, E>::Rehash( int nNewCapacity )
+{
+	CUtlMemory<int8> oldCtrl;
+	CUtlMemory<Node_t> oldSlots;
+	oldCtrl.Swap( m_Ctrl );
+	oldSlots.Swap( m_Slots );
+	int nOldCapacity = m_nCapacity;
+
+	Allocate( nNewCapacity );
+
+	const int8 *pOldCtrl = oldCtrl.Base();
+	Node_t *pOldSlots = oldSlots.Base();
+	for ( int i = 0; i < nOldCapacity; i++ )
+	{
+		if ( pOldCtrl[i] < 0 )
+			continue;
+
+		// Keys are unique so no need to search before inserting
+		unsigned int nHash = HashKey( pOldSlots[i].key );
+		IndexType_t iSlot = FindInsertSlot( nHash );
+		m_pCtrl[iSlot] = H2( nHash );
+		CopyConstruct( &m_pSlots[iSlot], pOldSlots[i] );
+		Destruct( &pOldSlots[i] );
+		m_nCount++;
+		m_nGrowthLeft--;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Lookup
+//-----------------------------------------------------------------------------
+template < typename K, typename T, typename H, typename E >
+inline typename CUtlFlatHashMap<K, T, H, E>::IndexType_t CUtlFlatHashMap<K, T, H, E>::FindWithHash( const KeyType_t &key, unsigned int nHash ) const
+{
+	if ( !m_nCapacity )
+		return InvalidIndex();
+
+	unsigned int nGroupMask = GroupMask();
+	unsigned int nGroup = ( nHash >> 7 ) & nGroupMask;
+	int8 h2 = H2( nHash );
+
+	// Triangular probing over groups visits every group once
+	for ( unsigned int nProbe = 1; ; nProbe++ )
+	{
+		const int8 *pGroup = m_pCtrl + nGroup * GROUP_WIDTH;
+		uint32 nMatch = MatchGroup( pGroup, h2 );
+		while ( nMatch )
+		{
+			int iSlot = nGroup * GROUP_WIDTH + UtlFlatHashMap_LowestBit( nMatch );
+			if ( m_eq( m_pSlots[iSlot].key, key ) )
+				return iSlot;
+			nMatch &= nMatch - 1;
+		}
+
+		// An empty slot ends the probe sequence; the key would have gone there
+		if ( MatchEmpty( pGroup ) || nProbe > nGroupMask )
+			return InvalidIndex();
+
+		nGroup = ( nGroup + nProbe ) & nGroupMask;
+	}
+}
+
+template < typename K, typename T, typename H, typename E >
+inline typename CUtlFlatHashMap<K, T, H, E>::IndexType_t CUtlFlatHashMap<K, T, H, E>::Find( const KeyType_t &key ) const
+{
+	return FindWithHash( key, HashKey( key ) );
+}
+
+template < typename K, typename T, typename H, typename E >
+inline typename CUtlFlatHashMap<K, T, H, E>::IndexType_t CUtlFlatHashMap<K, T, H, E>::FindInsertSlot( unsigned int nHash ) const
+{
+	unsigned int nGroupMask = GroupMask();
+	unsigned int nGroup = ( nHash >> 7 ) & nGroupMask;
+	for ( unsigned int nProbe = 1; ; nProbe++ )
+	{
+		uint32 nMatch = MatchEmptyOrDeleted( m_pCtrl + nGroup * GROUP_WIDTH );
+		if ( nMatch )
+			return nGroup * GROUP_WIDTH + UtlFlatHashMap_LowestBit( nMatch );
+
+		// The load factor guarantees a free slot somewhere
+		Assert( nProbe <= nGroupMask );
+		nGroup = ( nGroup + nProbe ) & nGroupMask;
+	}
+}
+
+template < typename K, typename T, typename H, typename E >
+inline typename CUtlFlatHashMap<K, T, H, E>::IndexType_t CUtlFlatHashMap<K, T, H, E>::NextValid( IndexType_t i ) const
+{
+	for ( ; i < m_nCapacity; i++ )
+	{
+		if ( m_pCtrl[i] >= 0 )
+			return i;
+	}
+	return InvalidIndex();
+}
+
+
+//-----------------------------------------------------------------------------
+// Insertion
+//-----------------------------------------------------------------------------
+template < typename K, typename T, typename H, typename E >
+typename CUtlFlatHashMap<K, T, H, E>::IndexType_t CUtlFlatHashMap<K, T, H, E>::InsertNew( const KeyType_t &key, unsigned int nHash )
+{
+	IndexType_t iSlot = m_nCapacity ? FindInsertSlot( nHash ) : InvalidIndex();
+
+	// Reusing a deleted slot doesn't use up growth; only filling an empty one does
+	if ( iSlot == InvalidIndex() || ( m_nGrowthLeft == 0 && m_pCtrl[iSlot] == CTRL_EMPTY ) )
+	{
+		// Mostly tombstones? Clean them out in place rather than growing
+		int nNewCapacity = MAX( (int)MIN_CAPACITY, m_nCapacity );
+		if ( m_nCount + 1 > MaxLoad( nNewCapacity ) / 2 || !m_nCapacity )
+		{
+			nNewCapacity = m_nCapacity ? m_nCapacity * 2 : (int)MIN_CAPACITY;
+		}
+		Rehash( nNewCapacity );
+		iSlot = FindInsertSlot( nHash );
+	}
+
+	if ( m_pCtrl[iSlot] == CTRL_EMPTY )
+	{
+		m_nGrowthLeft--;
+	}
+	m_pCtrl[iSlot] = H2( nHash );
+	m_nCount++;
+
+	Node_t *pNode = &m_pSlots[iSlot];
+	CopyConstruct( &pNode->key, key );
+	Construct( &pNode->elem );
+	return iSlot;
+}
+
+template < typename K, typename T, typename H, typename E >
+typename CUtlFlatHashMap<K, T, H, E>::IndexType_t CUtlFlatHashMap<K, T, H, E>::Insert( const KeyType_t &key )
+{
+	unsigned int nHash = HashKey( key );
+	IndexType_t i = FindWithHash( key, nHash );
+	if ( i != InvalidIndex() )
+		return i;
+
+	return InsertNew( key, nHash );
+}
+
+template < typename K, typename T, typename H, typename E >
+typename CUtlFlatHashMap<K, T, H, E>::IndexType_t CUtlFlatHashMap<K, T, H, E>::Insert( const KeyType_t &key, const ElemType_t &insert )
+{
+	unsigned int nHash = HashKey( key );
+	IndexType_t i = FindWithHash( key, nHash );
+	if ( i != InvalidIndex() )
+		return i;
+
+	i = InsertNew( key, nHash );
+	m_pSlots[i].elem = insert;
+	return i;
+}
+
+template < typename K, typename T, typename H, typename E >
+typename CUtlFlatHashMap<K, T, H, E>::IndexType_t CUtlFlatHashMap<K, T, H, E>::InsertOrReplace( const KeyType_t &key, const ElemType_t &insert )
+{
+	unsigned int nHash = HashKey( key );
+	IndexType_t i = FindWithHash( key, nHash );
+	if ( i == InvalidIndex() )
+	{
+		i = InsertNew( key, nHash );
+	}
+	m_pSlots[i].elem = insert;
+	return i;
+}
+
+
+//-----------------------------------------------------------------------------
+// Removal
+//-----------------------------------------------------------------------------
+template < typename K, typename T, typename H, typename E >
+void CUtlFlatHashMap<K, T, H, E>::RemoveAt( IndexType_t i )
+{
+	if ( !IsValidIndex( i ) )
+	{
+		Assert( 0 );
+		return;
+	}
+
+	Destruct( &m_pSlots[i] );
+	m_nCount--;
+
+	// If the group still has an empty slot no probe sequence can have passed
+	// through this one, so it can go straight back to empty.
+	int iGroupStart = i & ~( GROUP_WIDTH - 1 );
+	if ( MatchEmpty( m_pCtrl + iGroupStart ) )
+	{
+		m_pCtrl[i] = CTRL_EMPTY;
+		m_nGrowthLeft++;
+	}
+	else
+	{
+		m_pCtrl[i] = CTRL_DELETED;
+	}
+}
+
+template < typename K, typename T, typename H, typename E >
+bool CUtlFlatHashMap<K, T, H, E>::Remove( const KeyType_t &key )
+{
+	IndexType_t i = Find( key );
+	if ( i == InvalidIndex() )
+		return false;
+
+	RemoveAt( i );
+	return true;
+}
+
+template < typename K, typename T, typename H, typename E >
+void CUtlFlatHashMap<K, T, H, E>::DestructAll()
+{
+	for ( int i = 0; i < m_nCapacity; i++ )
+	{
+		if ( m_pCtrl[i] >= 0 )
+		{
+			Destruct( &m_pSlots[i] );
+		}
+	}
+}
+
+template < typename K, typename T, typename H, typename E >
+void CUtlFlatHashMap<K, T, H, E>::RemoveAll()
+{
+	DestructAll();
+	if ( m_nCapacity )
+	{
+		memset( m_pCtrl, CTRL_EMPTY, m_nCapacity );
+	}
+	m_nCount = 0;
+	m_nGrowthLeft = MaxLoad( m_nCapacity );
+}
+
+template < typename K, typename T, typename H, typename E >
+void CUtlFlatHashMap<K, T, H, E>::Purge()
+{
+	DestructAll();
+	m_Ctrl.Purge();
+	m_Slots.Purge();
+	m_pCtrl = NULL;
+	m_pSlots = NULL;
+	m_nCapacity = 0;
+	m_nCount = 0;
+	m_nGrowthLeft = 0;
+}
+
+template < typename K, typename T, typename H, typename E >
+void CUtlFlatHashMap<K, T, H, E>::PurgeAndDeleteElements()
+{
+	for ( int i = 0; i < m_nCapacity; i++ )
+	{
+		if ( m_pCtrl[i] >= 0 )
+		{
+			delete m_pSlots[i].elem;
+		}
+	}
+	Purge();
+}
+
+template < typename K, typename T, typename H, typename E >
+void CUtlFlatHashMap<K, T, H, E>::Swap( CUtlFlatHashMap &that )
+{
+	m_Ctrl.Swap( that.m_Ctrl );
+	m_Slots.Swap( that.m_Slots );
+	V_swap( m_pCtrl, that.m_pCtrl );
+	V_swap( m_pSlots, that.m_pSlots );
+	V_swap( m_nCapacity, that.m_nCapacity );
+	V_swap( m_nCount, that.m_nCount );
+	V_swap( m_nGrowthLeft, that.m_nGrowthLeft );
+	V_swap( m_hash, that.m_hash );
+	V_swap( m_eq, that.m_eq );
+}
+
+#endif // UTLFLATHASHMAP_H
@@ -407,6 +407,110 @@ private:
 };
 
 
+//-----------------------------------------------------------------------------
+// The CUtlMemorySmall class:
+// Keeps up to SIZE elements inline and only goes to the heap past that.
+// Unlike CUtlMemoryFixedGrowable the inline storage isn't constructed and the
+// object doesn't point into itself, so it can be swapped and memcpy'd like
+// any other utl container.
+//-----------------------------------------------------------------------------
+template< class T, size_t SIZE >
+class CUtlMemorySmall
+{
+public:
+	// constructor, destructor
+	CUtlMemorySmall( int nGrowSize = 0, int nInitSize = 0 );
+	CUtlMemorySmall( T* pMemory, int numElements )			{ Assert( 0 ); }
+	~CUtlMemorySmall();
+
+	// Can we use this index?
+	bool IsIdxValid( int i ) const							{ return (uint32)i < (uint32)m_nAllocationCount; }
+
+	// Specify the invalid ('null') index that we'll only return on failure
+	static const int INVALID_INDEX = -1; // For use with COMPILE_TIME_ASSERT
+	static int InvalidIndex() { return INVALID_INDEX; }
+
+	// Gets the base address
+	T* Base()												{ return m_pMemory ? m_pMemory : (T*)m_Inline.m_Bytes; }
+	const T* Base() const									{ return m_pMemory ? m_pMemory : (const T*)m_Inline.m_Bytes; }
+
+	// element access
+	T& operator[]( int i )									{ Assert( IsIdxValid(i) ); return Base()[i];	}
+	const T& operator[]( int i ) const						{ Assert( IsIdxValid(i) ); return Base()[i];	}
+	T& Element( int i )										{ Assert( IsIdxValid(i) ); return Base()[i];	}
+	const T& Element( int i ) const							{ Assert( IsIdxValid(i) ); return Base()[i];	}
+
+	// Attaches the buffer to external memory....
+	void SetExternalBuffer( T* pMemory, int numElements )	{ Assert( 0 ); }
+
+	// Size
+	int NumAllocated() const								{ return m_nAllocationCount; }
+	int Count() const										{ return m_nAllocationCount; }
+
+	// Are we still using the inline storage?
+	bool IsInline() const									{ return m_pMemory == NULL; }
+
+	// Grows the memory, so that at least allocated + num elements are allocated
+	void Grow( int num = 1 );
+
+	// Makes sure we've got at least this much memory
+	void EnsureCapacity( int num );
+
+	// Memory deallocation, goes back to the inline storage
+	void Purge();
+
+	// Purge all but the given number of elements
+	void Purge( int numElements );
+
+	// Switches the contents of two memory objects. Inline elements are
+	// relocated bitwise, the same way CUtlVector shifts elements around.
+	void Swap( CUtlMemorySmall< T, SIZE > &mem );
+
+	// is the memory externally allocated?
+	bool IsExternallyAllocated() const						{ return false; }
+
+	// Set the size by which the memory grows once it is on the heap
+	void SetGrowSize( int size )							{ Assert( size >= 0 ); m_nGrowSize = size; }
+
+	class Iterator_t
+	{
+	public:
+		Iterator_t( int i ) : index( i ) {}
+		int index;
+		bool operator==( const Iterator_t it ) const	{ return index == it.index; }
+		bool operator!=( const Iterator_t it ) const	{ return index != it.index; }
+	};
+	Iterator_t First() const							{ return Iterator_t( IsIdxValid( 0 ) ? 0 : InvalidIndex() ); }
+	Iterator_t Next( const Iterator_t &it ) const		{ return Iterator_t( IsIdxValid( it.index + 1 ) ? it.index + 1 : InvalidIndex() ); }
+	int GetIndex( const Iterator_t &it ) const			{ return it.index; }
+	bool IsIdxAfter( int i, const Iterator_t &it ) const { return i > it.index; }
+	bool IsValidIterator( const Iterator_t &it ) const	{ return IsIdxValid( it.index ); }
+	Iterator_t InvalidIterator() const					{ return Iterator_t( InvalidIndex() ); }
+
+private:
+	void Reallocate( int nNewAllocationCount );
+
+	// Raw inline storage; the other members only force the alignment
+	union InlineStorage_t
+	{
+		uint8	m_Bytes[ SIZE * sizeof(T) ];
+		int64	m_nAlign;
+		double	m_flAlign;
+		void	*m_pAlign;
+	};
+
+	T *m_pMemory;				// NULL while the elements are inline
+	int m_nAllocationCount;
+	int m_nGrowSize;
+	InlineStorage_t m_Inline;
+
+private:
+	// Not copyable, same as CUtlMemory
+	CUtlMemorySmall( const CUtlMemorySmall & );
+	CUtlMemorySmall &operator=( const CUtlMemorySmall & );
+};
+
+
 //-----------------------------------------------------------------------------
 // constructor, destructor
 //-----------------------------------------------------------------------------
@@ -1073,6 +1177,114 @@ void CUtlMemoryAligned<T, nAlignment>::Purge()
 	}
 }
 
+
+//-----------------------------------------------------------------------------
+// CUtlMemorySmall
+//-----------------------------------------------------------------------------
+template< class T, size_t SIZE >
+CUtlMemorySmall<T, SIZE>::CUtlMemorySmall( int nGrowSize, int nInitSize ) : m_pMemory( NULL ), 
+	m_nAllocationCount( SIZE ), m_nGrowSize( nGrowSize )
+{
+	COMPILE_TIME_ASSERT( SIZE > 0 );
+	// Types with stricter alignment (SIMD types) should use CUtlMemoryAligned
+	COMPILE_TIME_ASSERT( __alignof( T ) <= __alignof( InlineStorage_t ) );
+	Assert( nGrowSize >= 0 );
+
+	if ( nInitSize > (int)SIZE )
+	{
+		Reallocate( nInitSize );
+	}
+}
+
+template< class T, size_t SIZE >
+CUtlMemorySmall<T, SIZE>::~CUtlMemorySmall()
+{
+	Purge();
+}
+
+template< class T, size_t SIZE >
+void CUtlMemorySmall<T, SIZE>::Reallocate( int nNewAllocationCount )
+{
+	MEM_ALLOC_CREDIT_CLASS();
+	if ( m_pMemory )
+	{
+		m_pMemory = (T*)realloc( m_pMemory, nNewAllocationCount * sizeof(T) );
+	}
+	else
+	{
+		// First spill to the heap, relocate the inline elements
+		m_pMemory = (T*)malloc( nNewAllocationCount * sizeof(T) );
+		memcpy( (void*)m_pMemory, m_Inline.m_Bytes, MIN( (int)SIZE, nNewAllocationCount ) * sizeof(T) );
+	}
+	Assert( m_pMemory );
+	m_nAllocationCount = nNewAllocationCount;
+}
+
+template< class T, size_t SIZE >
+void CUtlMemorySmall<T, SIZE>::Grow( int num )
+{
+	Assert( num > 0 );
+
+	// The inline count seeds the growth, so the first heap block holds at least 2 * SIZE
+	int nAllocationRequested = m_nAllocationCount + num;
+	Reallocate( UtlMemory_CalcNewAllocationCount( m_nAllocationCount, m_nGrowSize, nAllocationRequested, sizeof(T) ) );
+}
+
+template< class T, size_t SIZE >
+inline void CUtlMemorySmall<T, SIZE>::EnsureCapacity( int num )
+{
+	if ( m_nAllocationCount >= num )
+		return;
+
+	Reallocate( num );
+}
+
+template< class T, size_t SIZE >
+void CUtlMemorySmall<T, SIZE>::Purge()
+{
+	if ( m_pMemory )
+	{
+		free( (void*)m_pMemory );
+		m_pMemory = NULL;
+	}
+	m_nAllocationCount = SIZE;
+}
+
+template< class T, size_t SIZE >
+void CUtlMemorySmall<T, SIZE>::Purge( int numElements )
+{
+	Assert( numElements >= 0 );
+
+	if ( !m_pMemory || numElements >= m_nAllocationCount )
+		return;
+
+	if ( numElements <= (int)SIZE )
+	{
+		// Move what's left back inline
+		memcpy( m_Inline.m_Bytes, (void*)m_pMemory, numElements * sizeof(T) );
+		Purge();
+		return;
+	}
+
+	Reallocate( numElements );
+}
+
+template< class T, size_t SIZE >
+void CUtlMemorySmall<T, SIZE>::Swap( CUtlMemorySmall< T, SIZE > &mem )
+{
+	if ( IsInline() || mem.IsInline() )
+	{
+		InlineStorage_t temp;
+		memcpy( &temp, &m_Inline, sizeof( InlineStorage_t ) );
+		memcpy( &m_Inline, &mem.m_Inline, sizeof( InlineStorage_t ) );
+		memcpy( &mem.m_Inline, &temp, sizeof( InlineStorage_t ) );
+	}
+
+	V_swap( m_pMemory, mem.m_pMemory );
+	V_swap( m_nAllocationCount, mem.m_nAllocationCount );
+	V_swap( m_nGrowSize, mem.m_nGrowSize );
+}
+
 #include "tier0/memdbgoff.h"
 
 #endif // UTLMEMORY_H
@@ -0,0 +1,135 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Binary serialization buffer made of a chain of memory segments.
+//
+// CUtlSegmentedBuffer has the binary Put/Get interface of CUtlBuffer, but
+// its data doesn't have to be contiguous. Memory owned by someone else can
+// be appended without copying, an existing CUtlBuffer can be adopted along
+// with its memory, and the contents can be written with one gather write
+// (writev) instead of being flattened first.
+//
+//=============================================================================
+
+#ifndef UTLSEGMENTEDBUFFER_H
+#define UTLSEGMENTEDBUFFER_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "tier1/utlmemory.h"
+#include "tier1/utlvector.h"
+
+class CUtlBuffer;
+class IBaseFileSystem;
+typedef void * FileHandle_t;
+
+
+//-----------------------------------------------------------------------------
+// One contiguous piece of a segmented buffer, laid out like a POSIX iovec
+// so arrays of them can be handed to writev-style calls.
+//-----------------------------------------------------------------------------
+struct UtlBufferSegment_t
+{
+	const void	*m_pBase;
+	size_t		m_nLength;
+};
+
+
+class CUtlSegmentedBuffer
+{
+public:
+	CUtlSegmentedBuffer( int nGrowSize = 0 );
+	~CUtlSegmentedBuffer();
+
+	// Appends memory owned by the caller without copying it. The memory must
+	// stay valid and unchanged until the buffer is cleared or destroyed.
+	void PutExternal( const void *pMem, int nSize );
+
+	// Takes over the unread part of buf along with its memory; buf is left empty.
+	void PutBuffer( CUtlBuffer &buf );
+
+	// Copying puts, same as CUtlBuffer in binary mode
+	void Put( const void *pMem, int nSize );
+	void PutChar( char c )					{ Put( &c, sizeof( c ) ); }
+	void PutUnsignedChar( unsigned char uc ){ Put( &uc, sizeof( uc ) ); }
+	void PutShort( short s )				{ Put( &s, sizeof( s ) ); }
+	void PutUnsignedShort( unsigned short us ) { Put( &us, sizeof( us ) ); }
+	void PutInt( int i )					{ Put( &i, sizeof( i ) ); }
+	void PutUnsignedInt( unsigned int u )	{ Put( &u, sizeof( u ) ); }
+	void PutInt64( int64 i )				{ Put( &i, sizeof( i ) ); }
+	void PutUint64( uint64 u )				{ Put( &u, sizeof( u ) ); }
+	void PutFloat( float f )				{ Put( &f, sizeof( f ) ); }
+	void PutDouble( double d )				{ Put( &d, sizeof( d ) ); }
+	void PutString( const char *pString );	// Writes the null terminator too
+
+	// Gets, same as CUtlBuffer in binary mode. Reading past the end sets the
+	// get overflow state and returns zeroes.
+	void Get( void *pMem, int nSize );
+	char GetChar()							{ char c; Get( &c, sizeof( c ) ); return c; }
+	unsigned char GetUnsignedChar()			{ unsigned char uc; Get( &uc, sizeof( uc ) ); return uc; }
+	short GetShort()						{ short s; Get( &s, sizeof( s ) ); return s; }
+	unsigned short GetUnsignedShort()		{ unsigned short us; Get( &us, sizeof( us ) ); return us; }
+	int GetInt()							{ int i; Get( &i, sizeof( i ) ); return i; }
+	unsigned int GetUnsignedInt()			{ unsigned int u; Get( &u, sizeof( u ) ); return u; }
+	int64 GetInt64()						{ int64 i; Get( &i, sizeof( i ) ); return i; }
+	uint64 GetUint64()						{ uint64 u; Get( &u, sizeof( u ) ); return u; }
+	float GetFloat()						{ float f; Get( &f, sizeof( f ) ); return f; }
+	double GetDouble()						{ double d; Get( &d, sizeof( d ) ); return d; }
+	void GetString( char *pString, int nMaxChars );
+
+	int TellPut() const						{ return m_nPut; }
+	int TellGet() const						{ return m_nGet; }
+	int GetBytesRemaining() const			{ return m_nPut - m_nGet; }
+
+	// Only forward seeks relative to the current position, or absolute seeks, are supported
+	void SeekGet( int nOffset );
+
+	bool IsValid() const					{ return !m_bGetOverflow; }
+
+	// Drops all data, keeping one owned segment around for reuse
+	void Clear();
+	void Purge();
+
+	// Fills in the unread data as segments; returns how many were written.
+	// Call SeekGet( TellGet() + nBytesWritten ) after a partial gather write.
+	int GetSegments( UtlBufferSegment_t *pSegments, int nMaxSegments ) const;
+	int GetSegmentCount() const;
+
+	// Copies the unread data into a contiguous buffer
+	void CopyTo( CUtlBuffer &buf ) const;
+
+	// Writes the unread data with gather writes and advances the get position.
+	// Works on files and sockets on POSIX; on Windows it writes files segment by segment.
+	// Returns false on an I/O error.
+	bool WriteToFD( int fd );
+	bool WriteToFile( IBaseFileSystem *pFileSystem, FileHandle_t hFile );
+
+private:
+	struct Segment_t
+	{
+		uint8				*m_pData;
+		int					m_nSize;
+		int					m_nCapacity;	// 0 for external memory, which is never written to
+		CUtlMemory<uint8>	*m_pMemory;		// Owned memory, NULL for external memory
+	};
+
+	Segment_t &AddSegment();
+	void FreeSegments( int nFirst );
+	void AdvanceGet( int nBytes );
+
+	CUtlVector<Segment_t>	m_Segments;
+	int						m_nGrowSize;
+	int						m_nPut;
+	int						m_nGet;
+	int						m_iGetSegment;			// Segment containing the get position
+	int						m_nGetSegmentOffset;	// Offset of the get position in that segment
+	bool					m_bGetOverflow;
+
+private:
+	// Not copyable
+	CUtlSegmentedBuffer( const CUtlSegmentedBuffer & );
+	CUtlSegmentedBuffer &operator=( const CUtlSegmentedBuffer & );
+};
+
+#endif // UTLSEGMENTEDBUFFER_H
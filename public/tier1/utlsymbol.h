@@ -211,6 +211,92 @@ private:
 #endif
 };
 
+//-----------------------------------------------------------------------------
+// CUtlSymbolTableLockFree:
+// description:
+//    Thread safe symbol table with the same interface as CUtlSymbolTableMT,
+//    which keeps its layout because prebuilt libraries (dmxloader) embed it.
+//    Find and String never lock: strings live in an append-only pool,
+//    symbols index a table of string pointers that never moves, and the
+//    string->symbol hash is an open addressing table whose slots are filled
+//    with single 32 bit stores. AddString only locks when the string isn't
+//    there yet, and then only against other adds. A full hash table is
+//    copied into one twice the size and the old one is kept until the
+//    symbol table goes away, since readers may still be in it.
+//-----------------------------------------------------------------------------
+
+class CUtlSymbolTableLockFree
+{
+public:
+	// growSize is unused, initSize is the number of symbols to make room for up front
+	CUtlSymbolTableLockFree( int growSize = 0, int initSize = 32, bool caseInsensitive = false );
+	~CUtlSymbolTableLockFree();
+
+	// Finds and/or creates a symbol based on the string
+	CUtlSymbol AddString( const char* pString );
+
+	// Finds the symbol for pString
+	CUtlSymbol Find( const char* pString ) const;
+
+	// Look up the string associated with a particular symbol
+	const char* String( CUtlSymbol id ) const
+	{
+		if ( !id.IsValid() )
+			return "";
+
+		Assert( (UtlSymId_t)id < m_nSymbols );
+		return m_pSymbolBlocks[ (UtlSymId_t)id / SYMBOLS_PER_BLOCK ][ (UtlSymId_t)id % SYMBOLS_PER_BLOCK ];
+	}
+
+	int GetNumStrings( void ) const
+	{
+		return m_nSymbols;
+	}
+
+private:
+	enum
+	{
+		SYMBOLS_PER_BLOCK = 256,
+		MAX_SYMBOL_BLOCKS = ( UTL_INVAL_SYMBOL + SYMBOLS_PER_BLOCK ) / SYMBOLS_PER_BLOCK
+	};
+
+	// A slot holds the top 16 bits of the hash and the symbol + 1, 0 is empty
+	struct HashTable_t
+	{
+		HashTable_t		*m_pRetired;	// The table this one replaced
+		uint32			m_nMask;
+		uint32 volatile	m_Slots[1];
+	};
+
+	struct StringPool_t
+	{
+		StringPool_t	*m_pNext;
+		int				m_TotalLen;
+		int				m_SpaceUsed;
+		char			m_Data[1];
+	};
+
+	uint32 HashSymbolString( const char *pString ) const;
+	UtlSymId_t FindInTable( const HashTable_t *pTable, const char *pString, uint32 nHash ) const;
+	void InsertIntoTable( HashTable_t *pTable, uint32 nHash, UtlSymId_t id );
+	HashTable_t *AllocTable( int nSlots );
+	HashTable_t *GrowTable( HashTable_t *pTable );
+	char *AllocString( int nLen );
+
+	HashTable_t * volatile		m_pTable;
+	const char ** volatile		m_pSymbolBlocks[MAX_SYMBOL_BLOCKS];
+	int volatile				m_nSymbols;
+	bool						m_bInsensitive;
+
+	// Only touched by AddString, under the lock
+	StringPool_t				*m_pStringPools;
+	CThreadFastMutex			m_lock;
+
+private:
+	CUtlSymbolTableLockFree( const CUtlSymbolTableLockFree & );
+	CUtlSymbolTableLockFree &operator=( const CUtlSymbolTableLockFree & );
+};
+
 
 
 //-----------------------------------------------------------------------------
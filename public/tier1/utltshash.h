@@ -622,4 +622,622 @@ inline UtlTSHashHandle_t CUtlTSHash<T,BUCKET_COUNT,KEYTYPE,HashFuncs,nAlignment>
 }
 
 
+//=============================================================================
+//
+// Sharded threadsafe hash that grows
+//
+// Same interface as CUtlTSHash, but the buckets are split across SHARD_COUNT
+// shards (a power of 2), each with its own insert lock and its own bucket
+// array. A shard whose average chain gets longer than the max load factor
+// doubles its buckets on the spot; the other shards don't notice.
+//
+// Find never locks. Inserts only ever push onto the head of a chain, so a
+// reader sees either the old or the new chain. A rehash relinks the elements
+// of a shard, so a reader that misses while one of them went by (the shard's
+// version changed) looks again. Old bucket arrays are kept until RemoveAll()
+// or Purge(), since readers may still be walking them.
+//
+// Inserts are visible right away; Commit() is only there for compatibility.
+// Removal has the same rule as CUtlTSHash: no queries may be going on.
+//
+// HashFuncs::Hash is called with a mask of INT_MAX and the result is mixed;
+// the low bits pick the shard and the rest the bucket.
+//
+//=============================================================================
+
+// Chain lengths tracked by the stats; the last entry counts that many or more
+#define UTLTSHASH_CHAIN_HISTOGRAM_SIZE	8
+
+struct UtlTSHashStats_t
+{
+	int		m_nElements;
+	int		m_nBuckets;
+	float	m_flLoadFactor;			// Elements per bucket
+	int		m_nMaxChainLength;
+	int		m_nResizes;				// Shard rehashes since the hash was created
+	int		m_nChainHistogram[UTLTSHASH_CHAIN_HISTOGRAM_SIZE];	// Buckets by chain length
+};
+
+// HashIntConventional, which CUtlTSHashGenericHash uses, maps runs of keys to
+// a handful of values. The sharded hash has the room to do better.
+template < class KEYTYPE = intp >
+class CUtlShardedTSHashGenericHash
+{
+public:
+	static int Hash( const KEYTYPE &key, int nBucketMask )
+	{
+		uint64 nKey = (uint64)(intp)key;
+		return (int)( HashIntAlternate( (uint32)( nKey ^ ( nKey >> 32 ) ) ) & nBucketMask );
+	}
+
+	static bool Compare( const KEYTYPE &lhs, const KEYTYPE &rhs )
+	{
+		return lhs == rhs;
+	}
+};
+
+template< class T, class KEYTYPE = intp, class HashFuncs = CUtlShardedTSHashGenericHash< KEYTYPE >, int SHARD_COUNT = 16 >
+class CUtlShardedTSHash
+{
+public:
+	// nBucketsPerShard is rounded up to a power of 2
+	CUtlShardedTSHash( int nAllocationCount, int nBucketsPerShard = 16, float flMaxLoadFactor = 1.0f );
+	~CUtlShardedTSHash();
+
+	// Invalid handle.
+	static UtlTSHashHandle_t InvalidHandle( void )	{ return ( UtlTSHashHandle_t )0; }
+
+	// Retrieval. Lock free
+	UtlTSHashHandle_t Find( KEYTYPE uiKey );
+
+	// Insertion ( find or add ).
+	UtlTSHashHandle_t Insert( KEYTYPE uiKey, const T &data, bool *pDidInsert = NULL );
+	UtlTSHashHandle_t Insert( KEYTYPE uiKey, ITSHashConstructor<T> *pConstructor, bool *pDidInsert = NULL );
+
+	// This insertion method assumes the element is not in the hash table
+	UtlTSHashHandle_t FastInsert( KEYTYPE uiKey, const T &data );
+	UtlTSHashHandle_t FastInsert( KEYTYPE uiKey, ITSHashConstructor<T> *pConstructor );
+
+	// Inserts are visible as soon as they're made, there's nothing to commit
+	void Commit( ) {}
+
+	// Removal.	Only call when you're certain no threads are accessing the hash table
+	void FindAndRemove( KEYTYPE uiKey );
+	void Remove( UtlTSHashHandle_t hHash ) { FindAndRemove( GetID( hHash ) ); }
+	void RemoveAll( void );
+	void Purge( void );
+
+	// Returns the number of elements in the hash table
+	int Count() const;
+
+	// Returns elements in the table
+	int GetElements( int nFirstElement, int nCount, UtlTSHashHandle_t *pHandles ) const;
+
+	// Element access
+	T &Element( UtlTSHashHandle_t hHash );
+	T const &Element( UtlTSHashHandle_t hHash ) const;
+	T &operator[]( UtlTSHashHandle_t hHash );
+	T const &operator[]( UtlTSHashHandle_t hHash ) const;
+	KEYTYPE GetID( UtlTSHashHandle_t hHash ) const;
+
+	// Convert element * to hashHandle
+	UtlTSHashHandle_t ElementPtrToHandle( T* pElement ) const;
+
+	// Load factor, chain lengths and resizes. Locks each shard in turn.
+	void GetStats( UtlTSHashStats_t *pStats ) const;
+
+private:
+	// Templatized for memory tracking purposes
+	template < typename Data_t >
+	struct HashFixedDataInternal_t
+	{
+		KEYTYPE	m_uiKey;
+		HashFixedDataInternal_t< Data_t >* volatile	m_pNext;
+		Data_t	m_Data;
+	};
+
+	typedef HashFixedDataInternal_t<T> HashFixedData_t;
+
+	struct BucketArray_t
+	{
+		BucketArray_t				*m_pRetired;	// The array this one replaced
+		int							m_nMask;
+		HashFixedData_t * volatile	m_pBuckets[1];
+	};
+
+	struct Shard_t
+	{
+		BucketArray_t * volatile	m_pBuckets;
+		int volatile				m_nVersion;		// Odd while the shard is being rehashed
+		int							m_nCount;
+		int							m_nResizes;
+		mutable CThreadFastMutex	m_AddLock;
+
+		// Keep the shards from sharing cache lines
+		char						m_Pad[64];
+	};
+
+	enum
+	{
+		SHARD_MASK = SHARD_COUNT - 1
+	};
+
+	static uint32 HashKey( const KEYTYPE &uiKey )
+	{
+		// The shard and bucket come from different bits, and the key hashes
+		// aren't always good at spreading them, so mix them first
+		uint32 nHash = (uint32)HashFuncs::Hash( uiKey, INT_MAX );
+		nHash ^= nHash >> 16;
+		nHash *= 0x85ebca6b;
+		nHash ^= nHash >> 13;
+		nHash *= 0xc2b2ae35;
+		nHash ^= nHash >> 16;
+		return nHash;
+	}
+
+	static int BucketIndex( uint32 nHash, const BucketArray_t *pBuckets )
+	{
+		return (int)( nHash / SHARD_COUNT ) & pBuckets->m_nMask;
+	}
+
+	static HashFixedData_t *FindInChain( KEYTYPE uiKey, HashFixedData_t *pElement );
+	static BucketArray_t *AllocBuckets( int nBuckets );
+
+	UtlTSHashHandle_t InsertLocked( KEYTYPE uiKey, uint32 nHash, const T *pData, ITSHashConstructor<T> *pConstructor, bool bCheckExisting, bool *pDidInsert );
+	void GrowShard( Shard_t &shard );
+	void FreeRetiredBuckets();
+
+	CMemoryPoolMT m_EntryMemory;
+	Shard_t m_Shards[SHARD_COUNT];
+	float m_flMaxLoadFactor;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructor
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::CUtlShardedTSHash( int nAllocationCount, int nBucketsPerShard, float flMaxLoadFactor ) :
+	m_EntryMemory( sizeof( HashFixedData_t ), nAllocationCount, CUtlMemoryPool::GROW_SLOW, MEM_ALLOC_CLASSNAME( HashFixedData_t ) )
+{
+	COMPILE_TIME_ASSERT( ( SHARD_COUNT & SHARD_MASK ) == 0 );
+
+	int nBuckets = 1;
+	while ( nBuckets < nBucketsPerShard )
+	{
+		nBuckets *= 2;
+	}
+
+	m_flMaxLoadFactor = MAX( flMaxLoadFactor, 0.25f );
+	for ( int i = 0; i < SHARD_COUNT; i++ )
+	{
+		Shard_t &shard = m_Shards[ i ];
+		shard.m_pBuckets = AllocBuckets( nBuckets );
+		shard.m_nVersion = 0;
+		shard.m_nCount = 0;
+		shard.m_nResizes = 0;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Deconstructor
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::~CUtlShardedTSHash()
+{
+	Purge();
+	for ( int i = 0; i < SHARD_COUNT; i++ )
+	{
+		free( m_Shards[ i ].m_pBuckets );
+	}
+}
+
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+typename CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::BucketArray_t *CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::AllocBuckets( int nBuckets )
+{
+	BucketArray_t *pBuckets = (BucketArray_t *)malloc( sizeof( BucketArray_t ) + ( nBuckets - 1 ) * sizeof( HashFixedData_t * ) );
+	pBuckets->m_pRetired = NULL;
+	pBuckets->m_nMask = nBuckets - 1;
+	memset( (void *)pBuckets->m_pBuckets, 0, nBuckets * sizeof( HashFixedData_t * ) );
+	return pBuckets;
+}
+
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+void CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::FreeRetiredBuckets()
+{
+	for ( int i = 0; i < SHARD_COUNT; i++ )
+	{
+		BucketArray_t *pRetired = m_Shards[ i ].m_pBuckets->m_pRetired;
+		m_Shards[ i ].m_pBuckets->m_pRetired = NULL;
+		while ( pRetired )
+		{
+			BucketArray_t *pNext = pRetired->m_pRetired;
+			free( pRetired );
+			pRetired = pNext;
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Destroy dynamically allocated hash data.
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline void CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::Purge( void )
+{
+	RemoveAll();
+}
+
+
+//-----------------------------------------------------------------------------
+// Returns the number of elements in the hash table
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline int CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::Count() const
+{
+	int nCount = 0;
+	for ( int i = 0; i < SHARD_COUNT; i++ )
+	{
+		nCount += m_Shards[ i ].m_nCount;
+	}
+	return nCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Returns elements in the table
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+int CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::GetElements( int nFirstElement, int nCount, UtlTSHashHandle_t *pHandles ) const
+{
+	int nIndex = 0;
+	for ( int i = 0; i < SHARD_COUNT && nIndex < nCount; i++ )
+	{
+		const Shard_t &shard = m_Shards[ i ];
+		AUTO_LOCK( shard.m_AddLock );
+
+		const BucketArray_t *pBuckets = shard.m_pBuckets;
+		for ( int j = 0; j <= pBuckets->m_nMask && nIndex < nCount; j++ )
+		{
+			for ( HashFixedData_t *pElement = pBuckets->m_pBuckets[ j ]; pElement; pElement = pElement->m_pNext )
+			{
+				if ( --nFirstElement >= 0 )
+					continue;
+
+				pHandles[ nIndex++ ] = (UtlTSHashHandle_t)pElement;
+				if ( nIndex >= nCount )
+					break;
+			}
+		}
+	}
+	return nIndex;
+}
+
+
+//-----------------------------------------------------------------------------
+// Finds an element
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline typename CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::HashFixedData_t *CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::FindInChain( KEYTYPE uiKey, HashFixedData_t *pElement )
+{
+	for ( ; pElement; pElement = pElement->m_pNext )
+	{
+		if ( HashFuncs::Compare( pElement->m_uiKey, uiKey ) )
+			return pElement;
+	}
+	return NULL;
+}
+
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline UtlTSHashHandle_t CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::Find( KEYTYPE uiKey )
+{
+	uint32 nHash = HashKey( uiKey );
+	const Shard_t &shard = m_Shards[ nHash & SHARD_MASK ];
+	for ( ;; )
+	{
+		int nVersion = shard.m_nVersion;
+		ThreadMemoryBarrier();
+
+		const BucketArray_t *pBuckets = shard.m_pBuckets;
+		HashFixedData_t *pElement = FindInChain( uiKey, pBuckets->m_pBuckets[ BucketIndex( nHash, pBuckets ) ] );
+		if ( pElement )
+			return (UtlTSHashHandle_t)pElement;
+
+		// A miss only counts if no rehash went by while we were looking
+		ThreadMemoryBarrier();
+		if ( !( nVersion & 1 ) && shard.m_nVersion == nVersion )
+			return InvalidHandle();
+
+		ThreadPause();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Insert data into the hash table. The shard's lock must be held.
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+UtlTSHashHandle_t CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::InsertLocked( KEYTYPE uiKey, uint32 nHash, const T *pData, ITSHashConstructor<T> *pConstructor, bool bCheckExisting, bool *pDidInsert )
+{
+	Shard_t &shard = m_Shards[ nHash & SHARD_MASK ];
+	BucketArray_t *pBuckets = shard.m_pBuckets;
+	HashFixedData_t * volatile &pFirst = pBuckets->m_pBuckets[ BucketIndex( nHash, pBuckets ) ];
+
+	if ( bCheckExisting )
+	{
+		HashFixedData_t *pExisting = FindInChain( uiKey, pFirst );
+		if ( pExisting )
+			return (UtlTSHashHandle_t)pExisting;
+	}
+
+	// Readers can get to the element as soon as it's linked, so it has to be complete first
+	HashFixedData_t *pNewElement = static_cast< HashFixedData_t * >( m_EntryMemory.Alloc() );
+	pNewElement->m_uiKey = uiKey;
+	if ( pConstructor )
+	{
+		pConstructor->Construct( &pNewElement->m_Data );
+	}
+	else
+	{
+		CopyConstruct( &pNewElement->m_Data, *pData );
+	}
+	pNewElement->m_pNext = pFirst;
+
+	ThreadMemoryBarrier();
+	pFirst = pNewElement;
+
+	if ( pDidInsert )
+	{
+		*pDidInsert = true;
+	}
+
+	if ( ++shard.m_nCount > ( pBuckets->m_nMask + 1 ) * m_flMaxLoadFactor )
+	{
+		GrowShard( shard );
+	}
+	return (UtlTSHashHandle_t)pNewElement;
+}
+
+
+//-----------------------------------------------------------------------------
+// Doubles the buckets of a shard. The shard's lock must be held.
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+void CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::GrowShard( Shard_t &shard )
+{
+	BucketArray_t *pOldBuckets = shard.m_pBuckets;
+	BucketArray_t *pNewBuckets = AllocBuckets( ( pOldBuckets->m_nMask + 1 ) * 2 );
+	pNewBuckets->m_pRetired = pOldBuckets;
+
+	// Readers that miss from here on will look again
+	shard.m_nVersion = shard.m_nVersion + 1;
+	ThreadMemoryBarrier();
+
+	for ( int i = 0; i <= pOldBuckets->m_nMask; i++ )
+	{
+		HashFixedData_t *pElement = pOldBuckets->m_pBuckets[ i ];
+		while ( pElement )
+		{
+			HashFixedData_t *pNext = pElement->m_pNext;
+			HashFixedData_t * volatile &pFirst = pNewBuckets->m_pBuckets[ BucketIndex( HashKey( pElement->m_uiKey ), pNewBuckets ) ];
+			pElement->m_pNext = pFirst;
+			pFirst = pElement;
+			pElement = pNext;
+		}
+	}
+
+	ThreadMemoryBarrier();
+	shard.m_pBuckets = pNewBuckets;
+	ThreadMemoryBarrier();
+	shard.m_nVersion = shard.m_nVersion + 1;
+	shard.m_nResizes++;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Insert data into the hash table given its key, with
+//          a check to see if the element already exists within the tree.
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline UtlTSHashHandle_t CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::Insert( KEYTYPE uiKey, const T &data, bool *pDidInsert )
+{
+	if ( pDidInsert )
+	{
+		*pDidInsert = false;
+	}
+
+	// First try lock-free
+	UtlTSHashHandle_t h = Find( uiKey );
+	if ( h != InvalidHandle() )
+		return h;
+
+	uint32 nHash = HashKey( uiKey );
+	AUTO_LOCK( m_Shards[ nHash & SHARD_MASK ].m_AddLock );
+	return InsertLocked( uiKey, nHash, &data, NULL, true, pDidInsert );
+}
+
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline UtlTSHashHandle_t CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::Insert( KEYTYPE uiKey, ITSHashConstructor<T> *pConstructor, bool *pDidInsert )
+{
+	if ( pDidInsert )
+	{
+		*pDidInsert = false;
+	}
+
+	// First try lock-free
+	UtlTSHashHandle_t h = Find( uiKey );
+	if ( h != InvalidHandle() )
+		return h;
+
+	uint32 nHash = HashKey( uiKey );
+	AUTO_LOCK( m_Shards[ nHash & SHARD_MASK ].m_AddLock );
+	return InsertLocked( uiKey, nHash, NULL, pConstructor, true, pDidInsert );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Insert data into the hash table given its key
+//          without a check to see if the element already exists within the tree.
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline UtlTSHashHandle_t CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::FastInsert( KEYTYPE uiKey, const T &data )
+{
+	uint32 nHash = HashKey( uiKey );
+	AUTO_LOCK( m_Shards[ nHash & SHARD_MASK ].m_AddLock );
+	return InsertLocked( uiKey, nHash, &data, NULL, false, NULL );
+}
+
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline UtlTSHashHandle_t CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::FastInsert( KEYTYPE uiKey, ITSHashConstructor<T> *pConstructor )
+{
+	uint32 nHash = HashKey( uiKey );
+	AUTO_LOCK( m_Shards[ nHash & SHARD_MASK ].m_AddLock );
+	return InsertLocked( uiKey, nHash, NULL, pConstructor, false, NULL );
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Remove a single element from the hash
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline void CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::FindAndRemove( KEYTYPE uiKey )
+{
+	if ( m_EntryMemory.Count() == 0 )
+		return;
+
+	// This must occur when no queries are occurring
+	uint32 nHash = HashKey( uiKey );
+	Shard_t &shard = m_Shards[ nHash & SHARD_MASK ];
+	AUTO_LOCK( shard.m_AddLock );
+
+	BucketArray_t *pBuckets = shard.m_pBuckets;
+	HashFixedData_t * volatile *ppLink = &pBuckets->m_pBuckets[ BucketIndex( nHash, pBuckets ) ];
+	for ( HashFixedData_t *pElement = *ppLink; pElement; ppLink = &pElement->m_pNext, pElement = *ppLink )
+	{
+		if ( !HashFuncs::Compare( pElement->m_uiKey, uiKey ) )
+			continue;
+
+		*ppLink = pElement->m_pNext;
+		shard.m_nCount--;
+
+		Destruct( &pElement->m_Data );
+
+#ifdef _DEBUG
+		memset( pElement, 0xDD, sizeof(HashFixedData_t) );
+#endif
+
+		m_EntryMemory.Free( pElement );
+		break;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Remove all elements from the hash
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline void CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::RemoveAll( void )
+{
+	// This must occur when no queries are occurring
+	FreeRetiredBuckets();
+	if ( m_EntryMemory.Count() == 0 )
+		return;
+
+	for ( int i = 0; i < SHARD_COUNT; i++ )
+	{
+		Shard_t &shard = m_Shards[ i ];
+		AUTO_LOCK( shard.m_AddLock );
+
+		BucketArray_t *pBuckets = shard.m_pBuckets;
+		for ( int j = 0; j <= pBuckets->m_nMask; j++ )
+		{
+			for ( HashFixedData_t *pElement = pBuckets->m_pBuckets[ j ]; pElement; pElement = pElement->m_pNext )
+			{
+				Destruct( &pElement->m_Data );
+			}
+			pBuckets->m_pBuckets[ j ] = NULL;
+		}
+		shard.m_nCount = 0;
+	}
+
+	m_EntryMemory.Clear();
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Return data given a hash handle.
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline T &CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::Element( UtlTSHashHandle_t hHash )
+{
+	return ((HashFixedData_t *)hHash)->m_Data;
+}
+
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline T const &CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::Element( UtlTSHashHandle_t hHash ) const
+{
+	return ((HashFixedData_t *)hHash)->m_Data;
+}
+
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline T &CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::operator[]( UtlTSHashHandle_t hHash )
+{
+	return ((HashFixedData_t *)hHash)->m_Data;
+}
+
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline T const &CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::operator[]( UtlTSHashHandle_t hHash ) const
+{
+	return ((HashFixedData_t *)hHash)->m_Data;
+}
+
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline KEYTYPE CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::GetID( UtlTSHashHandle_t hHash ) const
+{
+	return ((HashFixedData_t *)hHash)->m_uiKey;
+}
+
+// Convert element * to hashHandle
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+inline UtlTSHashHandle_t CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::ElementPtrToHandle( T* pElement ) const
+{
+	Assert( pElement );
+	HashFixedData_t *pFixedData = (HashFixedData_t*)( (uint8*)pElement - offsetof( HashFixedData_t, m_Data ) );
+	return (UtlTSHashHandle_t)pFixedData;
+}
+
+
+//-----------------------------------------------------------------------------
+// Stats
+//-----------------------------------------------------------------------------
+template< class T, class KEYTYPE, class HashFuncs, int SHARD_COUNT >
+void CUtlShardedTSHash<T,KEYTYPE,HashFuncs,SHARD_COUNT>::GetStats( UtlTSHashStats_t *pStats ) const
+{
+	memset( pStats, 0, sizeof( UtlTSHashStats_t ) );
+	for ( int i = 0; i < SHARD_COUNT; i++ )
+	{
+		const Shard_t &shard = m_Shards[ i ];
+		AUTO_LOCK( shard.m_AddLock );
+
+		const BucketArray_t *pBuckets = shard.m_pBuckets;
+		for ( int j = 0; j <= pBuckets->m_nMask; j++ )
+		{
+			int nLength = 0;
+			for ( HashFixedData_t *pElement = pBuckets->m_pBuckets[ j ]; pElement; pElement = pElement->m_pNext )
+			{
+				nLength++;
+			}
+			pStats->m_nChainHistogram[ MIN( nLength, UTLTSHASH_CHAIN_HISTOGRAM_SIZE - 1 ) ]++;
+			pStats->m_nMaxChainLength = MAX( pStats->m_nMaxChainLength, nLength );
+		}
+
+		pStats->m_nElements += shard.m_nCount;
+		pStats->m_nBuckets += pBuckets->m_nMask + 1;
+		pStats->m_nResizes += shard.m_nResizes;
+	}
+	pStats->m_flLoadFactor = (float)pStats->m_nElements / (float)pStats->m_nBuckets;
+}
+
+
 #endif // UTLTSHASH_H
@@ -30,6 +30,22 @@
 #define FOR_EACH_VEC_BACK( vecName, iteratorName ) \
 	for ( int iteratorName = (vecName).Count()-1; iteratorName >= 0; iteratorName-- )
 
+//-----------------------------------------------------------------------------
+// Growth tracking: build with UTLVECTOR_TRACK_GROWTH to record every time a
+// vector has to reallocate, keyed by the call stack that caused it.
+// UtlVector_DumpGrowthStats lists the busiest call sites, which are the
+// candidates for CUtlSmallVector or an up front EnsureCapacity.
+//-----------------------------------------------------------------------------
+#ifdef UTLVECTOR_TRACK_GROWTH
+void UtlVector_TrackGrowth( int nRequested, int nBytesItem );
+void UtlVector_DumpGrowthStats( int nMaxCallSites = 32 );
+void UtlVector_ResetGrowthStats();
+
+#define UTLVECTOR_TRACK_GROW( nRequested )	do { if ( (nRequested) > m_Memory.NumAllocated() ) UtlVector_TrackGrowth( (nRequested), sizeof(T) ); } while ( 0 )
+#else
+#define UTLVECTOR_TRACK_GROW( nRequested )	((void)0)
+#endif
+
 //-----------------------------------------------------------------------------
 // The CUtlVector class:
 // A growable array class which doubles in size by default.
@@ -267,6 +283,35 @@ public:
 };
 
 
+//-----------------------------------------------------------------------------
+// The CUtlSmallVector class:
+// A drop in CUtlVector which keeps up to INLINE_SIZE elements inside the
+// object and never touches the heap until it holds more than that.
+// Elements are relocated bitwise, like everywhere else in CUtlVector.
+//-----------------------------------------------------------------------------
+template< class T, size_t INLINE_SIZE >
+class CUtlSmallVector : public CUtlVector< T, CUtlMemorySmall<T, INLINE_SIZE > >
+{
+	typedef CUtlVector< T, CUtlMemorySmall<T, INLINE_SIZE > > BaseClass;
+
+public:
+	// constructor, destructor
+	explicit CUtlSmallVector( int growSize = 0, int initSize = 0 ) : BaseClass( growSize, initSize ) {}
+
+	// Is the vector still using its inline storage?
+	bool IsInline() const { return this->m_Memory.IsInline(); }
+
+	void Swap( CUtlSmallVector< T, INLINE_SIZE > &vec )
+	{
+		BaseClass::Swap( vec );
+
+		// Inline elements stay in place, so the debugger pointers must be recomputed
+		this->ResetDbgInfo();
+		vec.ResetDbgInfo();
+	}
+};
+
+
 //-----------------------------------------------------------------------------
 // The CUtlVectorConservative class:
 // A array class with a conservative allocation scheme
@@ -751,6 +796,7 @@ void CUtlVector<T, A>::GrowVector( int num )
 {
 	if (m_Size + num > m_Memory.NumAllocated())
 	{
+		UTLVECTOR_TRACK_GROW( m_Size + num );
 		MEM_ALLOC_CREDIT_CLASS();
 		m_Memory.Grow( m_Size + num - m_Memory.NumAllocated() );
 	}
@@ -801,6 +847,7 @@ void CUtlVector<T, A>::Sort( int (__cdecl *pfnCompare)(const T *, const T *) )
 template< typename T, class A >
 void CUtlVector<T, A>::EnsureCapacity( int num )
 {
+	UTLVECTOR_TRACK_GROW( num );
 	MEM_ALLOC_CREDIT_CLASS();
 	m_Memory.EnsureCapacity(num);
 	ResetDbgInfo();
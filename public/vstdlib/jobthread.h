@@ -33,6 +33,7 @@
 #include "tier1/utllinkedlist.h"
 #include "tier1/utlvector.h"
 #include "tier1/functors.h"
+#include "tier1/taskscheduler.h"
 #include "tier0/vprof_telemetry.h"
 
 #include "vstdlib/vstdlib.h"
@@ -863,14 +864,46 @@ public:
 		if ( nItems == 0 )
 			return;
 
-		if ( !pThreadPool )
+		m_pItems = pItems;
+		m_pLimit = pItems + nItems;
+
+		// Other pools aren't known to the task scheduler, give them jobs directly
+		if ( pThreadPool && pThreadPool != g_pThreadPool )
 		{
-			pThreadPool = g_pThreadPool;
+			RunOnThreadPool( nItems, nMaxParallel, pThreadPool );
+			return;
 		}
 
-		m_pItems = pItems;
-		m_pLimit = pItems + nItems;
+		// Every task pulls items until they run out, on whichever thread picks
+		// it up. Waiting runs tasks as well, so parallel processing can nest.
+		int nTasks = MIN( (int)nItems - 1, nMaxParallel );
+		nTasks = MIN( nTasks, g_TaskScheduler.NumWorkers() - 1 );
+
+		CProcessTask tasks[TASK_SCHEDULER_MAX_THREADS];
+		CTaskGroup group;
+		for ( int i = 0; i < nTasks; i++ )
+		{
+			tasks[i].m_pProcessor = this;
+			group.Run( &tasks[i] );
+		}
 
+		DoExecute();
+		group.Wait();
+	}
+
+	ITEM_PROCESSOR_TYPE m_ItemProcessor;
+
+private:
+	class CProcessTask : public CTask
+	{
+	public:
+		virtual void Run()	{ m_pProcessor->DoExecute(); }
+		CParallelProcessor<ITEM_TYPE, ITEM_PROCESSOR_TYPE> *m_pProcessor;
+	};
+	friend class CProcessTask;
+
+	void RunOnThreadPool( unsigned nItems, int nMaxParallel, IThreadPool *pThreadPool )
+	{
 		int nJobs = nItems - 1;
 
 		if ( nJobs > nMaxParallel )
@@ -878,12 +911,6 @@ public:
 			nJobs = nMaxParallel;
 		}
 
-		if (! pThreadPool )									// only possible on linux
-		{
-			DoExecute( );
-			return;
-		}
-
 		int nThreads = pThreadPool->NumThreads();
 		if ( nJobs > nThreads )
 		{
@@ -915,9 +942,6 @@ public:
 		}
 	}
 
-	ITEM_PROCESSOR_TYPE m_ItemProcessor;
-
-private:
 	void DoExecute()
 	{
 		tmZone( TELEMETRY_LEVEL0, TMZF_NONE, "DoExecute %s", m_szDescription );
@@ -983,7 +1007,6 @@ public:
 	CParallelLoopProcessor( const char *pszDescription )
 	{
 		m_lIndex = m_lLimit= 0;
-		m_nActive = 0;
 		m_szDescription = pszDescription;
 	}
 
@@ -993,32 +1016,33 @@ public:
 		{
 			m_lIndex = lBegin;
 			m_lLimit = lBegin + nItems;
-			int i = g_pThreadPool->NumIdleThreads();
 
-			if ( nMaxParallel < i)
-			{
-				i = nMaxParallel;
-			}
+			int nTasks = MIN( g_TaskScheduler.NumWorkers() - 1, nMaxParallel );
 
-			while( i-- )
+			CLoopTask tasks[TASK_SCHEDULER_MAX_THREADS];
+			CTaskGroup group;
+			for ( int i = 0; i < nTasks; i++ )
 			{
-				++m_nActive;
-				ThreadExecute( this, &CParallelLoopProcessor<ITEM_PROCESSOR_TYPE>::DoExecute )->Release();
+				tasks[i].m_pProcessor = this;
+				group.Run( &tasks[i] );
 			}
 
-			++m_nActive;
 			DoExecute();
-
-			while ( m_nActive )
-			{
-				ThreadPause();
-			}
+			group.Wait();
 		}
 	}
 
 	ITEM_PROCESSOR_TYPE m_ItemProcessor;
 
 private:
+	class CLoopTask : public CTask
+	{
+	public:
+		virtual void Run()	{ m_pProcessor->DoExecute(); }
+		CParallelLoopProcessor<ITEM_PROCESSOR_TYPE> *m_pProcessor;
+	};
+	friend class CLoopTask;
+
 	void DoExecute()
 	{
 		tmZone( TELEMETRY_LEVEL0, TMZF_NONE, "DoExecute %s", m_szDescription );
@@ -1041,12 +1065,9 @@ private:
 		}
 
 		m_ItemProcessor.End();
-
-		--m_nActive;
 	}
 	CInterlockedInt				m_lIndex;
 	long						m_lLimit;
-	CInterlockedInt				m_nActive;
 	const char *				m_szDescription;
 };
 
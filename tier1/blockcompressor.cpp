@@ -0,0 +1,658 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Streaming block compression on top of CUtlBuffer.
+//
+//=============================================================================
+
+#include "tier1/blockcompressor.h"
+#include "tier1/snappy.h"
+#include "tier1/lzss.h"
+#include "tier1/lzmaDecoder.h"
+#include "vstdlib/jobthread.h"
+#include "tier0/dbg.h"
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+
+//-----------------------------------------------------------------------------
+// Little endian field helpers
+//-----------------------------------------------------------------------------
+static void PutLittleUint32( CUtlBuffer &buf, uint32 nValue )
+{
+	nValue = LittleDWord( nValue );
+	buf.Put( &nValue, sizeof( nValue ) );
+}
+
+static uint32 ReadLittleUint32( const uint8 *pData )
+{
+	uint32 nValue;
+	memcpy( &nValue, pData, sizeof( nValue ) );
+	return LittleDWord( nValue );
+}
+
+static void PutIndexEntry( CUtlBuffer &buf, const blockstream_index_entry_t &entry )
+{
+	blockstream_index_entry_t swapped;
+	swapped.uncompressedOffset = LittleQWord( entry.uncompressedOffset );
+	swapped.frameOffset = LittleDWord( entry.frameOffset );
+	swapped.uncompressedSize = LittleDWord( entry.uncompressedSize );
+	buf.Put( &swapped, sizeof( swapped ) );
+}
+
+static void ReadIndexEntry( const uint8 *pData, blockstream_index_entry_t &entry )
+{
+	memcpy( &entry, pData, sizeof( entry ) );
+	entry.uncompressedOffset = LittleQWord( entry.uncompressedOffset );
+	entry.frameOffset = LittleDWord( entry.frameOffset );
+	entry.uncompressedSize = LittleDWord( entry.uncompressedSize );
+}
+
+static bool ReadHeader( const uint8 *pData, blockstream_header_t &header )
+{
+	memcpy( &header, pData, sizeof( header ) );
+	header.id = LittleDWord( header.id );
+	header.blockSize = LittleDWord( header.blockSize );
+
+	return header.id == BLOCKSTREAM_ID &&
+		header.version == BLOCKSTREAM_VERSION &&
+		header.compressionType < COMPRESSION_TYPE_COUNT &&
+		header.blockSize > 0 && header.blockSize <= BLOCKSTREAM_MAX_BLOCK_SIZE;
+}
+
+// Block frames start with the stored size and the uncompressed size
+#define BLOCKSTREAM_FRAME_HEADER_SIZE	( 2 * sizeof( uint32 ) )
+
+
+//-----------------------------------------------------------------------------
+// Built in codecs
+//-----------------------------------------------------------------------------
+class CNullCompressionCodec : public ICompressionCodec
+{
+public:
+	virtual CompressionType_t GetType() const { return COMPRESSION_NONE; }
+	virtual bool CanCompress() const { return true; }
+	virtual unsigned int GetMaxCompressedSize( unsigned int nInputSize ) const { return nInputSize; }
+
+	// Returning 0 makes the caller store the block raw
+	virtual unsigned int Compress( const void *pInput, unsigned int nInputSize, void *pOutput, unsigned int nOutputSize ) { return 0; }
+	virtual bool Decompress( const void *pInput, unsigned int nInputSize, void *pOutput, unsigned int nOutputSize ) { return false; }
+};
+
+class CSnappyCompressionCodec : public ICompressionCodec
+{
+public:
+	virtual CompressionType_t GetType() const { return COMPRESSION_SNAPPY; }
+	virtual bool CanCompress() const { return true; }
+
+	virtual unsigned int GetMaxCompressedSize( unsigned int nInputSize ) const
+	{
+		return (unsigned int)snappy::MaxCompressedLength( nInputSize );
+	}
+
+	virtual unsigned int Compress( const void *pInput, unsigned int nInputSize, void *pOutput, unsigned int nOutputSize )
+	{
+		if ( nOutputSize < GetMaxCompressedSize( nInputSize ) )
+			return 0;
+
+		size_t nCompressedSize = 0;
+		snappy::RawCompress( (const char *)pInput, nInputSize, (char *)pOutput, &nCompressedSize );
+		return (unsigned int)nCompressedSize;
+	}
+
+	virtual bool Decompress( const void *pInput, unsigned int nInputSize, void *pOutput, unsigned int nOutputSize )
+	{
+		size_t nActualSize = 0;
+		if ( !snappy::GetUncompressedLength( (const char *)pInput, nInputSize, &nActualSize ) || nActualSize != nOutputSize )
+			return false;
+
+		return snappy::RawUncompress( (const char *)pInput, nInputSize, (char *)pOutput );
+	}
+};
+
+// lzss.cpp isn't part of every tier1 build, see tier1.vpc
+#ifdef TIER1_LZSS
+class CLZSSCompressionCodec : public ICompressionCodec
+{
+public:
+	virtual CompressionType_t GetType() const { return COMPRESSION_LZSS; }
+	virtual bool CanCompress() const { return true; }
+
+	virtual unsigned int GetMaxCompressedSize( unsigned int nInputSize ) const
+	{
+		// LZSS gives up as soon as the output isn't smaller than the input
+		return nInputSize + sizeof( lzss_header_t ) + 16;
+	}
+
+	virtual unsigned int Compress( const void *pInput, unsigned int nInputSize, void *pOutput, unsigned int nOutputSize )
+	{
+		if ( nOutputSize < GetMaxCompressedSize( nInputSize ) )
+			return 0;
+
+		// CLZSS keeps its hash chains in members, so use one per call
+		CLZSS lzss;
+		unsigned int nCompressedSize = 0;
+		if ( !lzss.CompressNoAlloc( (const unsigned char *)pInput, nInputSize, (unsigned char *)pOutput, &nCompressedSize ) )
+			return 0;
+		return nCompressedSize;
+	}
+
+	virtual bool Decompress( const void *pInput, unsigned int nInputSize, void *pOutput, unsigned int nOutputSize )
+	{
+		const unsigned char *pData = (const unsigned char *)pInput;
+		if ( nInputSize < sizeof( lzss_header_t ) || !CLZSS::IsCompressed( pData ) || CLZSS::GetActualSize( pData ) != nOutputSize )
+			return false;
+
+		CLZSS lzss;
+		return lzss.SafeUncompress( pData, (unsigned char *)pOutput, nOutputSize ) == nOutputSize;
+	}
+};
+
+#endif // TIER1_LZSS
+
+// Game time LZMA is decode only; blocks are produced by tools using LZMA_Compress
+// through a custom codec with the COMPRESSION_LZMA type.
+class CLZMACompressionCodec : public ICompressionCodec
+{
+public:
+	virtual CompressionType_t GetType() const { return COMPRESSION_LZMA; }
+	virtual bool CanCompress() const { return false; }
+	virtual unsigned int GetMaxCompressedSize( unsigned int nInputSize ) const { return 0; }
+	virtual unsigned int Compress( const void *pInput, unsigned int nInputSize, void *pOutput, unsigned int nOutputSize ) { return 0; }
+
+	virtual bool Decompress( const void *pInput, unsigned int nInputSize, void *pOutput, unsigned int nOutputSize )
+	{
+		unsigned char *pData = (unsigned char *)pInput;
+		if ( nInputSize < sizeof( lzma_header_t ) || !CLZMA::IsCompressed( pData ) || CLZMA::GetActualSize( pData ) != nOutputSize )
+			return false;
+
+		lzma_header_t *pHeader = (lzma_header_t *)pData;
+		if ( LittleDWord( pHeader->lzmaSize ) > nInputSize - sizeof( lzma_header_t ) )
+			return false;
+
+		return CLZMA::Uncompress( pData, (unsigned char *)pOutput ) == nOutputSize;
+	}
+};
+
+static CNullCompressionCodec s_NullCodec;
+static CSnappyCompressionCodec s_SnappyCodec;
+#ifdef TIER1_LZSS
+static CLZSSCompressionCodec s_LZSSCodec;
+#endif
+static CLZMACompressionCodec s_LZMACodec;
+
+ICompressionCodec *GetCompressionCodec( CompressionType_t type )
+{
+	switch ( type )
+	{
+	case COMPRESSION_NONE:		return &s_NullCodec;
+	case COMPRESSION_SNAPPY:	return &s_SnappyCodec;
+#ifdef TIER1_LZSS
+	case COMPRESSION_LZSS:		return &s_LZSSCodec;
+#endif
+	case COMPRESSION_LZMA:		return &s_LZMACodec;
+	default:					return NULL;
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// CBlockCompressor
+//-----------------------------------------------------------------------------
+CBlockCompressor::CBlockCompressor( CUtlBuffer &output, CompressionType_t type, int nBlockSize, int nParallelBlocks, IThreadPool *pThreadPool ) :
+	m_Output( output )
+{
+	Init( GetCompressionCodec( type ), nBlockSize, nParallelBlocks, pThreadPool );
+}
+
+CBlockCompressor::CBlockCompressor( CUtlBuffer &output, ICompressionCodec *pCodec, int nBlockSize, int nParallelBlocks, IThreadPool *pThreadPool ) :
+	m_Output( output )
+{
+	Init( pCodec, nBlockSize, nParallelBlocks, pThreadPool );
+}
+
+CBlockCompressor::~CBlockCompressor()
+{
+	if ( m_bValid && !m_bFinished )
+	{
+		Finish();
+	}
+}
+
+void CBlockCompressor::Init( ICompressionCodec *pCodec, int nBlockSize, int nParallelBlocks, IThreadPool *pThreadPool )
+{
+	m_pCodec = pCodec;
+	m_pThreadPool = pThreadPool;
+	m_nStreamStart = m_Output.TellPut();
+	m_nBlockSize = clamp( nBlockSize, 1, BLOCKSTREAM_MAX_BLOCK_SIZE );
+	m_nParallelBlocks = MAX( nParallelBlocks, 1 );
+	m_nUncompressedSize = 0;
+	m_nPending = 0;
+	m_bFinished = false;
+
+	m_bValid = ( pCodec != NULL ) && pCodec->CanCompress();
+	if ( !m_bValid )
+	{
+		AssertMsg( false, "CBlockCompressor: codec can't compress\n" );
+		return;
+	}
+
+	m_Pending.EnsureCapacity( m_nBlockSize * m_nParallelBlocks );
+	m_Scratch.EnsureCapacity( pCodec->GetMaxCompressedSize( m_nBlockSize ) * m_nParallelBlocks );
+	m_Jobs.EnsureCapacity( m_nParallelBlocks );
+
+	PutLittleUint32( m_Output, BLOCKSTREAM_ID );
+	m_Output.PutUnsignedChar( BLOCKSTREAM_VERSION );
+	m_Output.PutUnsignedChar( (unsigned char)pCodec->GetType() );
+	m_Output.PutUnsignedChar( 0 );
+	m_Output.PutUnsignedChar( 0 );
+	PutLittleUint32( m_Output, m_nBlockSize );
+}
+
+bool CBlockCompressor::Write( const void *pData, int nBytes )
+{
+	if ( !m_bValid || m_bFinished || !m_Output.IsValid() )
+		return false;
+
+	const uint8 *pSrc = (const uint8 *)pData;
+	int nBatchSize = m_nBlockSize * m_nParallelBlocks;
+	while ( nBytes > 0 )
+	{
+		// Whole batches can be compressed straight out of the caller's memory
+		if ( m_nPending == 0 && nBytes >= nBatchSize )
+		{
+			FlushBlocks( pSrc, nBatchSize );
+			pSrc += nBatchSize;
+			nBytes -= nBatchSize;
+			continue;
+		}
+
+		int nCopy = MIN( nBytes, nBatchSize - m_nPending );
+		memcpy( m_Pending.Base() + m_nPending, pSrc, nCopy );
+		m_nPending += nCopy;
+		pSrc += nCopy;
+		nBytes -= nCopy;
+
+		if ( m_nPending == nBatchSize )
+		{
+			FlushBlocks( m_Pending.Base(), m_nPending );
+			m_nPending = 0;
+		}
+	}
+
+	return m_Output.IsValid();
+}
+
+bool CBlockCompressor::Finish()
+{
+	if ( !m_bValid || m_bFinished )
+		return false;
+
+	if ( m_nPending )
+	{
+		FlushBlocks( m_Pending.Base(), m_nPending );
+		m_nPending = 0;
+	}
+	m_bFinished = true;
+
+	// End of blocks
+	PutLittleUint32( m_Output, 0 );
+	PutLittleUint32( m_Output, 0 );
+
+	blockstream_trailer_t trailer;
+	trailer.indexOffset = LittleDWord( (uint32)( m_Output.TellPut() - m_nStreamStart ) );
+	trailer.id = LittleDWord( BLOCKSTREAM_INDEX_ID );
+
+	PutLittleUint32( m_Output, m_Index.Count() );
+	for ( int i = 0; i < m_Index.Count(); i++ )
+	{
+		PutIndexEntry( m_Output, m_Index[i] );
+	}
+	m_Output.Put( &trailer, sizeof( trailer ) );
+
+	m_Pending.Purge();
+	m_Scratch.Purge();
+	return m_Output.IsValid();
+}
+
+void CBlockCompressor::CompressBlock( BlockJob_t &job )
+{
+	job.m_nCompressedSize = job.m_pCodec->Compress( job.m_pInput, job.m_nInputSize, job.m_pOutput, job.m_nOutputSize );
+
+	// Not worth it, store the block as-is
+	if ( job.m_nCompressedSize >= job.m_nInputSize )
+	{
+		job.m_nCompressedSize = 0;
+	}
+}
+
+void CBlockCompressor::FlushBlocks( const uint8 *pData, int nBytes )
+{
+	unsigned int nMaxCompressed = m_pCodec->GetMaxCompressedSize( m_nBlockSize );
+
+	m_Jobs.RemoveAll();
+	for ( int nOffset = 0; nOffset < nBytes; nOffset += m_nBlockSize )
+	{
+		BlockJob_t &job = m_Jobs[ m_Jobs.AddToTail() ];
+		job.m_pCodec = m_pCodec;
+		job.m_pInput = pData + nOffset;
+		job.m_nInputSize = MIN( nBytes - nOffset, m_nBlockSize );
+		job.m_pOutput = m_Scratch.Base() + ( m_Jobs.Count() - 1 ) * nMaxCompressed;
+		job.m_nOutputSize = nMaxCompressed;
+		job.m_nCompressedSize = 0;
+	}
+
+	if ( m_Jobs.Count() > 1 )
+	{
+		ParallelProcess( "CBlockCompressor::FlushBlocks", m_pThreadPool, m_Jobs.Base(), m_Jobs.Count(), &CBlockCompressor::CompressBlock );
+	}
+	else
+	{
+		for ( int i = 0; i < m_Jobs.Count(); i++ )
+		{
+			CompressBlock( m_Jobs[i] );
+		}
+	}
+
+	for ( int i = 0; i < m_Jobs.Count(); i++ )
+	{
+		WriteFrame( m_Jobs[i] );
+	}
+}
+
+void CBlockCompressor::WriteFrame( const BlockJob_t &job )
+{
+	blockstream_index_entry_t &entry = m_Index[ m_Index.AddToTail() ];
+	entry.uncompressedOffset = m_nUncompressedSize;
+	entry.frameOffset = m_Output.TellPut() - m_nStreamStart;
+	entry.uncompressedSize = job.m_nInputSize;
+
+	if ( job.m_nCompressedSize )
+	{
+		PutLittleUint32( m_Output, job.m_nCompressedSize );
+		PutLittleUint32( m_Output, job.m_nInputSize );
+		m_Output.Put( job.m_pOutput, job.m_nCompressedSize );
+	}
+	else
+	{
+		PutLittleUint32( m_Output, job.m_nInputSize | BLOCKSTREAM_STORED_RAW );
+		PutLittleUint32( m_Output, job.m_nInputSize );
+		m_Output.Put( job.m_pInput, job.m_nInputSize );
+	}
+
+	m_nUncompressedSize += job.m_nInputSize;
+}
+
+bool CBlockCompressor::CompressBuffer( CUtlBuffer &output, const void *pData, int nBytes, CompressionType_t type, int nBlockSize, int nParallelBlocks )
+{
+	CBlockCompressor compressor( output, type, nBlockSize, nParallelBlocks );
+	return compressor.Write( pData, nBytes ) && compressor.Finish();
+}
+
+
+//-----------------------------------------------------------------------------
+// CBlockDecompressor
+//-----------------------------------------------------------------------------
+CBlockDecompressor::CBlockDecompressor()
+{
+	m_pCodec = NULL;
+	m_nBlockSize = 0;
+	m_nUncompressedSize = 0;
+	m_bHeaderParsed = false;
+	m_bFinished = false;
+	m_bValid = true;
+}
+
+bool CBlockDecompressor::Write( const void *pData, int nBytes, CUtlBuffer &output )
+{
+	if ( !m_bValid )
+		return false;
+
+	// Anything after the block data is the index, which streaming readers don't need
+	if ( m_bFinished )
+		return true;
+
+	m_Input.Put( pData, nBytes );
+	m_bValid = ProcessInput( output );
+
+	// Drop consumed input so a long stream doesn't accumulate in memory
+	int nRemaining = m_Input.TellPut() - m_Input.TellGet();
+	if ( nRemaining == 0 )
+	{
+		m_Input.Clear();
+	}
+	else if ( m_Input.TellGet() > nRemaining )
+	{
+		CUtlBuffer remaining;
+		remaining.Put( m_Input.PeekGet(), nRemaining );
+		m_Input.Swap( remaining );
+	}
+
+	return m_bValid;
+}
+
+bool CBlockDecompressor::ProcessInput( CUtlBuffer &output )
+{
+	if ( !m_bHeaderParsed )
+	{
+		if ( m_Input.TellPut() - m_Input.TellGet() < (int)sizeof( blockstream_header_t ) )
+			return true;
+
+		blockstream_header_t header;
+		if ( !ReadHeader( (const uint8 *)m_Input.PeekGet(), header ) )
+			return false;
+
+		m_pCodec = GetCompressionCodec( (CompressionType_t)header.compressionType );
+		if ( !m_pCodec )
+			return false;
+
+		m_nBlockSize = header.blockSize;
+		m_bHeaderParsed = true;
+		m_Input.SeekGet( CUtlBuffer::SEEK_CURRENT, sizeof( blockstream_header_t ) );
+	}
+
+	CUtlMemory<uint8> decoded;
+	while ( !m_bFinished )
+	{
+		int nAvailable = m_Input.TellPut() - m_Input.TellGet();
+		if ( nAvailable < (int)BLOCKSTREAM_FRAME_HEADER_SIZE )
+			break;
+
+		const uint8 *pFrame = (const uint8 *)m_Input.PeekGet();
+		uint32 nStoredSize = ReadLittleUint32( pFrame );
+		uint32 nUncompressedSize = ReadLittleUint32( pFrame + sizeof( uint32 ) );
+		bool bRaw = ( nStoredSize & BLOCKSTREAM_STORED_RAW ) != 0;
+		nStoredSize &= ~BLOCKSTREAM_STORED_RAW;
+
+		if ( nStoredSize == 0 && nUncompressedSize == 0 )
+		{
+			m_bFinished = true;
+			m_Input.SeekGet( CUtlBuffer::SEEK_CURRENT, BLOCKSTREAM_FRAME_HEADER_SIZE );
+			break;
+		}
+
+		if ( nUncompressedSize > (uint32)m_nBlockSize || nStoredSize > BLOCKSTREAM_MAX_BLOCK_SIZE * 2 || ( bRaw && nStoredSize != nUncompressedSize ) )
+			return false;
+
+		if ( nAvailable < (int)( BLOCKSTREAM_FRAME_HEADER_SIZE + nStoredSize ) )
+			break;
+
+		const uint8 *pPayload = pFrame + BLOCKSTREAM_FRAME_HEADER_SIZE;
+		if ( bRaw )
+		{
+			output.Put( pPayload, nUncompressedSize );
+		}
+		else
+		{
+			decoded.EnsureCapacity( nUncompressedSize );
+			if ( !m_pCodec->Decompress( pPayload, nStoredSize, decoded.Base(), nUncompressedSize ) )
+				return false;
+			output.Put( decoded.Base(), nUncompressedSize );
+		}
+
+		m_nUncompressedSize += nUncompressedSize;
+		m_Input.SeekGet( CUtlBuffer::SEEK_CURRENT, BLOCKSTREAM_FRAME_HEADER_SIZE + nStoredSize );
+	}
+
+	return output.IsValid();
+}
+
+bool CBlockDecompressor::DecompressBuffer( const void *pStream, int nStreamSize, CUtlBuffer &output )
+{
+	CBlockDecompressor decompressor;
+	return decompressor.Write( pStream, nStreamSize, output ) && decompressor.IsFinished();
+}
+
+
+//-----------------------------------------------------------------------------
+// CBlockCompressedReader
+//-----------------------------------------------------------------------------
+CBlockCompressedReader::CBlockCompressedReader()
+{
+	m_pStream = NULL;
+	m_nFrameAreaSize = 0;
+	m_pCodec = NULL;
+	m_nUncompressedSize = 0;
+	m_iCachedBlock = -1;
+}
+
+bool CBlockCompressedReader::Init( const void *pStream, int nStreamSize )
+{
+	m_pStream = NULL;
+	m_Index.RemoveAll();
+	m_iCachedBlock = -1;
+	m_nUncompressedSize = 0;
+
+	const uint8 *pData = (const uint8 *)pStream;
+	if ( nStreamSize < (int)( sizeof( blockstream_header_t ) + sizeof( blockstream_trailer_t ) + sizeof( uint32 ) ) )
+		return false;
+
+	blockstream_header_t header;
+	if ( !ReadHeader( pData, header ) )
+		return false;
+
+	ICompressionCodec *pCodec = GetCompressionCodec( (CompressionType_t)header.compressionType );
+	if ( !pCodec )
+		return false;
+
+	uint32 nIndexOffset = ReadLittleUint32( pData + nStreamSize - sizeof( blockstream_trailer_t ) );
+	uint32 nIndexId = ReadLittleUint32( pData + nStreamSize - sizeof( uint32 ) );
+	if ( nIndexId != BLOCKSTREAM_INDEX_ID || nIndexOffset > (uint32)nStreamSize - sizeof( blockstream_trailer_t ) - sizeof( uint32 ) )
+		return false;
+
+	uint32 nBlocks = ReadLittleUint32( pData + nIndexOffset );
+	uint32 nIndexSpace = nStreamSize - sizeof( blockstream_trailer_t ) - sizeof( uint32 ) - nIndexOffset;
+	if ( nBlocks > nIndexSpace / sizeof( blockstream_index_entry_t ) )
+		return false;
+
+	m_Index.SetCount( nBlocks );
+	const uint8 *pEntry = pData + nIndexOffset + sizeof( uint32 );
+	for ( uint32 i = 0; i < nBlocks; i++, pEntry += sizeof( blockstream_index_entry_t ) )
+	{
+		blockstream_index_entry_t &entry = m_Index[i];
+		ReadIndexEntry( pEntry, entry );
+		if ( entry.uncompressedOffset != (uint64)m_nUncompressedSize || entry.uncompressedSize > header.blockSize ||
+			entry.frameOffset + BLOCKSTREAM_FRAME_HEADER_SIZE > nIndexOffset )
+		{
+			m_Index.RemoveAll();
+			return false;
+		}
+		m_nUncompressedSize += entry.uncompressedSize;
+	}
+
+	m_pCodec = pCodec;
+	m_pStream = pData;
+	m_nFrameAreaSize = nIndexOffset;	// Frames never extend past the index
+	m_CachedBlock.EnsureCapacity( header.blockSize );
+	return true;
+}
+
+int CBlockCompressedReader::FindBlock( int64 nOffset ) const
+{
+	int nLow = 0;
+	int nHigh = m_Index.Count() - 1;
+	while ( nLow <= nHigh )
+	{
+		int nMid = ( nLow + nHigh ) / 2;
+		const blockstream_index_entry_t &entry = m_Index[nMid];
+		if ( nOffset < (int64)entry.uncompressedOffset )
+		{
+			nHigh = nMid - 1;
+		}
+		else if ( nOffset >= (int64)( entry.uncompressedOffset + entry.uncompressedSize ) )
+		{
+			nLow = nMid + 1;
+		}
+		else
+		{
+			return nMid;
+		}
+	}
+	return -1;
+}
+
+bool CBlockCompressedReader::DecodeBlock( int iBlock, void *pOutput )
+{
+	const blockstream_index_entry_t &entry = m_Index[iBlock];
+	const uint8 *pFrame = m_pStream + entry.frameOffset;
+	uint32 nStoredSize = ReadLittleUint32( pFrame );
+	uint32 nUncompressedSize = ReadLittleUint32( pFrame + sizeof( uint32 ) );
+	bool bRaw = ( nStoredSize & BLOCKSTREAM_STORED_RAW ) != 0;
+	nStoredSize &= ~BLOCKSTREAM_STORED_RAW;
+
+	if ( nUncompressedSize != entry.uncompressedSize || nStoredSize > (uint32)m_nFrameAreaSize - entry.frameOffset - BLOCKSTREAM_FRAME_HEADER_SIZE )
+		return false;
+
+	const uint8 *pPayload = pFrame + BLOCKSTREAM_FRAME_HEADER_SIZE;
+	if ( bRaw )
+	{
+		if ( nStoredSize != nUncompressedSize )
+			return false;
+		memcpy( pOutput, pPayload, nUncompressedSize );
+		return true;
+	}
+
+	return m_pCodec->Decompress( pPayload, nStoredSize, pOutput, nUncompressedSize );
+}
+
+bool CBlockCompressedReader::ReadRange( int64 nOffset, int nBytes, void *pOutput )
+{
+	if ( !m_pStream || nOffset < 0 || nBytes < 0 || nOffset + nBytes > m_nUncompressedSize )
+		return false;
+
+	uint8 *pDest = (uint8 *)pOutput;
+	while ( nBytes > 0 )
+	{
+		int iBlock = FindBlock( nOffset );
+		if ( iBlock < 0 )
+			return false;
+
+		const blockstream_index_entry_t &entry = m_Index[iBlock];
+		int nBlockOffset = (int)( nOffset - (int64)entry.uncompressedOffset );
+		int nCopy = MIN( nBytes, (int)entry.uncompressedSize - nBlockOffset );
+
+		if ( nBlockOffset == 0 && nCopy == (int)entry.uncompressedSize && iBlock != m_iCachedBlock )
+		{
+			// Whole block requested, decode straight into the destination
+			if ( !DecodeBlock( iBlock, pDest ) )
+				return false;
+		}
+		else
+		{
+			if ( iBlock != m_iCachedBlock )
+			{
+				m_iCachedBlock = -1;
+				if ( !DecodeBlock( iBlock, m_CachedBlock.Base() ) )
+					return false;
+				m_iCachedBlock = iBlock;
+			}
+			memcpy( pDest, m_CachedBlock.Base() + nBlockOffset, nCopy );
+		}
+
+		pDest += nCopy;
+		nOffset += nCopy;
+		nBytes -= nCopy;
+	}
+
+	return true;
+}
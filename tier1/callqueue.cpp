@@ -0,0 +1,245 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Multi-producer call queue.
+//
+//=============================================================================
+
+#include "tier1/callqueue.h"
+#include "tier0/memalloc.h"
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+COMPILE_TIME_ASSERT( ( CALLQUEUEMP_RECORD_ALIGN % TSLIST_NODE_ALIGNMENT ) == 0 );
+
+
+CCallQueueMP::CCallQueueMP( int nChunkSize )
+{
+	m_pProducers = NULL;
+	m_nChunkSize = ALIGN_VALUE( MAX( nChunkSize, 1024 ), CALLQUEUEMP_RECORD_ALIGN );
+	m_nChunks = 0;
+	m_nProducers = 0;
+	m_bNoQueue = false;
+	ResetStats();
+}
+
+CCallQueueMP::~CCallQueueMP()
+{
+	Flush();
+
+	// Everything has been run, so every producer is down to the chunk it writes to
+	Producer_t *pProducer = m_pProducers;
+	while ( pProducer )
+	{
+		Producer_t *pNext = pProducer->m_pNext;
+		Assert( pProducer->m_pReadChunk == pProducer->m_pWriteChunk );
+		MemAlloc_FreeAligned( pProducer->m_pWriteChunk );
+		delete pProducer;
+		pProducer = pNext;
+	}
+
+	while ( Chunk_t *pChunk = (Chunk_t *)m_FreeChunks.Pop() )
+	{
+		MemAlloc_FreeAligned( pChunk );
+	}
+}
+
+void CCallQueueMP::DisableQueue( bool bDisable )
+{
+	if ( m_bNoQueue == bDisable )
+		return;
+
+	if ( !m_bNoQueue )
+	{
+		CallQueued();
+	}
+	m_bNoQueue = bDisable;
+}
+
+
+//-----------------------------------------------------------------------------
+// Producers are never removed, a thread that goes away leaves an empty
+// producer with one chunk behind until the queue is destroyed.
+//-----------------------------------------------------------------------------
+CCallQueueMP::Producer_t *CCallQueueMP::AddProducer()
+{
+	Producer_t *pProducer = new Producer_t;
+	pProducer->m_pWriteChunk = AllocChunk( 0 );
+	pProducer->m_nQueued = 0;
+	pProducer->m_flFirstQueued = 0.0;
+	pProducer->m_pReadChunk = pProducer->m_pWriteChunk;
+	pProducer->m_nReadOffset = 0;
+	pProducer->m_nRun = 0;
+
+	Producer_t *pHead;
+	do
+	{
+		pHead = m_pProducers;
+		pProducer->m_pNext = pHead;
+	} while ( !ThreadInterlockedAssignPointerIf( (void * volatile *)&m_pProducers, pProducer, pHead ) );
+
+	++m_nProducers;
+	m_pThreadProducer = pProducer;
+	return pProducer;
+}
+
+CCallQueueMP::Chunk_t *CCallQueueMP::AllocChunk( int nRecordSize )
+{
+	Chunk_t *pChunk = NULL;
+	int nSize = m_nChunkSize;
+	if ( nRecordSize <= nSize )
+	{
+		pChunk = (Chunk_t *)m_FreeChunks.Pop();
+	}
+	else
+	{
+		// Oversized calls get a chunk of their own, which isn't recycled
+		nSize = nRecordSize;
+	}
+
+	if ( !pChunk )
+	{
+		int nHeaderSize = ALIGN_VALUE( sizeof( Chunk_t ), CALLQUEUEMP_RECORD_ALIGN );
+		pChunk = (Chunk_t *)MemAlloc_AllocAligned( nHeaderSize + nSize, CALLQUEUEMP_RECORD_ALIGN );
+		++m_nChunks;
+	}
+
+	pChunk->Next = NULL;
+	pChunk->m_pNext = NULL;
+	pChunk->m_nCommitted = 0;
+	pChunk->m_nSize = nSize;
+	return pChunk;
+}
+
+void CCallQueueMP::FreeChunk( Chunk_t *pChunk )
+{
+	if ( pChunk->m_nSize == m_nChunkSize )
+	{
+		m_FreeChunks.Push( pChunk );
+	}
+	else
+	{
+		MemAlloc_FreeAligned( pChunk );
+		--m_nChunks;
+	}
+}
+
+CCallQueueMP::Chunk_t *CCallQueueMP::AddChunk( Producer_t *pProducer, int nRecordSize )
+{
+	Chunk_t *pChunk = AllocChunk( nRecordSize );
+
+	// The running thread moves on once it sees the link, so the new chunk has
+	// to be set up first. Nothing more gets committed to the old chunk.
+	ThreadMemoryBarrier();
+	pProducer->m_pWriteChunk->m_pNext = pChunk;
+	pProducer->m_pWriteChunk = pChunk;
+	return pChunk;
+}
+
+
+//-----------------------------------------------------------------------------
+// Runs (or just destructs) a producer's calls until nTarget have been run
+//-----------------------------------------------------------------------------
+int CCallQueueMP::RunCalls( Producer_t *pProducer, int nTarget, bool bExecute )
+{
+	int nCalls = 0;
+	while ( pProducer->m_nRun != nTarget )
+	{
+		Chunk_t *pChunk = pProducer->m_pReadChunk;
+		if ( pProducer->m_nReadOffset == pChunk->m_nCommitted )
+		{
+			// There are calls left, so the producer has moved on to the next chunk
+			Chunk_t *pNext = pChunk->m_pNext;
+			Assert( pNext );
+			pProducer->m_pReadChunk = pNext;
+			pProducer->m_nReadOffset = 0;
+			FreeChunk( pChunk );
+			continue;
+		}
+
+		CallRecord_t *pRecord = (CallRecord_t *)( pChunk->Data() + pProducer->m_nReadOffset );
+		CFunctor *pFunctor = pRecord->m_pFunctor;
+		if ( bExecute )
+		{
+			(*pFunctor)();
+		}
+		pFunctor->~CFunctor();
+
+		pProducer->m_nReadOffset += pRecord->m_nSize;
+		pProducer->m_nRun = pProducer->m_nRun + 1;
+		nCalls++;
+	}
+	return nCalls;
+}
+
+void CCallQueueMP::CallQueued()
+{
+	double flStart = Plat_FloatTime();
+	double flMaxLatency = 0.0;
+	int nCalls = 0;
+
+	for ( Producer_t *pProducer = m_pProducers; pProducer; pProducer = pProducer->m_pNext )
+	{
+		// Only what has been queued so far, calls queued by the calls we run wait for next time
+		int nTarget = pProducer->m_nQueued;
+		if ( nTarget == pProducer->m_nRun )
+			continue;
+
+		ThreadMemoryBarrier();
+		double flLatency = flStart - pProducer->m_flFirstQueued;
+		flMaxLatency = MAX( flMaxLatency, flLatency );
+
+		nCalls += RunCalls( pProducer, nTarget, true );
+	}
+
+	if ( !nCalls )
+		return;
+
+	float flTime = (float)( Plat_FloatTime() - flStart );
+	m_Stats.m_nFlushes++;
+	m_Stats.m_nCallsRun += nCalls;
+	m_Stats.m_nLastFlushCalls = nCalls;
+	m_Stats.m_nMaxFlushCalls = MAX( m_Stats.m_nMaxFlushCalls, nCalls );
+	m_Stats.m_flLastFlushTime = flTime;
+	m_Stats.m_flMaxFlushTime = MAX( m_Stats.m_flMaxFlushTime, flTime );
+	m_Stats.m_flTotalFlushTime += flTime;
+	m_Stats.m_flLastFlushLatency = (float)flMaxLatency;
+	m_Stats.m_flMaxFlushLatency = MAX( m_Stats.m_flMaxFlushLatency, (float)flMaxLatency );
+}
+
+void CCallQueueMP::Flush()
+{
+	for ( Producer_t *pProducer = m_pProducers; pProducer; pProducer = pProducer->m_pNext )
+	{
+		int nTarget = pProducer->m_nQueued;
+		ThreadMemoryBarrier();
+		RunCalls( pProducer, nTarget, false );
+	}
+}
+
+int CCallQueueMP::Count()
+{
+	int nCount = 0;
+	for ( Producer_t *pProducer = m_pProducers; pProducer; pProducer = pProducer->m_pNext )
+	{
+		nCount += pProducer->m_nQueued - pProducer->m_nRun;
+	}
+	return nCount;
+}
+
+
+//-----------------------------------------------------------------------------
+// Stats
+//-----------------------------------------------------------------------------
+void CCallQueueMP::GetStats( CallQueueStats_t *pStats )
+{
+	*pStats = m_Stats;
+	pStats->m_nDepth = Count();
+	pStats->m_nProducers = m_nProducers;
+	pStats->m_nChunks = m_nChunks;
+}
+
+void CCallQueueMP::ResetStats()
+{
+	memset( &m_Stats, 0, sizeof( m_Stats ) );
+}
@@ -303,3 +303,261 @@ void MD5_ProcessSingleBuffer( const void *p, int len, MD5Value_t &md5Result )
 	MD5Update( &ctx, (unsigned char const *)p, len );
 	MD5Final( md5Result.bits, &ctx );
 }
+
+
+//-----------------------------------------------------------------------------
+// Multi-buffer MD5. Each lane of an SSE2 register carries a different buffer
+// through the same rounds, so four independent hashes cost about one.
+//-----------------------------------------------------------------------------
+#if ( defined( _WIN32 ) && !defined( _X360 ) ) || defined( __SSE2__ )
+#define MD5_MULTI_BUFFER_SIMD 1
+#include <emmintrin.h>
+#else
+#define MD5_MULTI_BUFFER_SIMD 0
+#endif
+
+#if MD5_MULTI_BUFFER_SIMD
+
+#define MD5_SIMD_LANES 4
+
+#define F1_SIMD(x, y, z) _mm_xor_si128( z, _mm_and_si128( x, _mm_xor_si128( y, z ) ) )
+#define F2_SIMD(x, y, z) F1_SIMD(z, x, y)
+#define F3_SIMD(x, y, z) _mm_xor_si128( _mm_xor_si128( x, y ), z )
+#define F4_SIMD(x, y, z) _mm_xor_si128( y, _mm_or_si128( x, _mm_xor_si128( z, allOnes ) ) )
+
+#define MD5STEP_SIMD(f, w, x, y, z, data, k, s) \
+	( w = _mm_add_epi32( w, _mm_add_epi32( f(x, y, z), _mm_add_epi32( data, _mm_set1_epi32( (int)k ) ) ) ), \
+	  w = _mm_or_si128( _mm_slli_epi32( w, s ), _mm_srli_epi32( w, 32-s ) ), \
+	  w = _mm_add_epi32( w, x ) )
+
+// One lane's view of its buffer: whole 64 byte blocks are read in place, the
+// rest plus the MD5 padding and length is copied into m_Tail.
+struct MD5Lane_t
+{
+	const unsigned char	*m_pData;
+	int					m_nDataBlocks;
+	int					m_nBlocks;
+	unsigned char		m_Tail[128];
+};
+
+static void MD5Lane_Init( MD5Lane_t *pLane, const void *pData, int nLength )
+{
+	Assert( nLength >= 0 );
+	pLane->m_pData = (const unsigned char *)pData;
+	pLane->m_nDataBlocks = nLength / 64;
+
+	int nTail = nLength - pLane->m_nDataBlocks * 64;
+	int nTailBlocks = ( nTail + 1 + 8 <= 64 ) ? 1 : 2;
+	memset( pLane->m_Tail, 0, sizeof( pLane->m_Tail ) );
+	memcpy( pLane->m_Tail, pLane->m_pData + pLane->m_nDataBlocks * 64, nTail );
+	pLane->m_Tail[nTail] = 0x80;
+
+	uint64 nBits = (uint64)nLength << 3;
+	unsigned char *pBitCount = pLane->m_Tail + nTailBlocks * 64 - 8;
+	for ( int i = 0; i < 8; i++ )
+	{
+		pBitCount[i] = (unsigned char)( nBits >> ( i * 8 ) );
+	}
+
+	pLane->m_nBlocks = pLane->m_nDataBlocks + nTailBlocks;
+}
+
+static const unsigned char *MD5Lane_GetBlock( const MD5Lane_t *pLane, int iBlock )
+{
+	if ( iBlock < pLane->m_nDataBlocks )
+		return pLane->m_pData + iBlock * 64;
+	if ( iBlock < pLane->m_nBlocks )
+		return pLane->m_Tail + ( iBlock - pLane->m_nDataBlocks ) * 64;
+
+	// This lane is done; it still goes through the rounds but the result is masked off.
+	return pLane->m_Tail;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: MD5Transform on four lanes at once. in[] holds word i of every
+//  lane's block, and lanes with a zero mask keep their old state.
+//-----------------------------------------------------------------------------
+static void MD5Transform_SIMD( __m128i buf[4], const __m128i in[16], __m128i laneMask )
+{
+	const __m128i allOnes = _mm_set1_epi32( -1 );
+	__m128i a = buf[0];
+	__m128i b = buf[1];
+	__m128i c = buf[2];
+	__m128i d = buf[3];
+
+		MD5STEP_SIMD(F1_SIMD, a, b, c, d, in[0], 0xd76aa478, 7);
+		MD5STEP_SIMD(F1_SIMD, d, a, b, c, in[1], 0xe8c7b756, 12);
+		MD5STEP_SIMD(F1_SIMD, c, d, a, b, in[2], 0x242070db, 17);
+		MD5STEP_SIMD(F1_SIMD, b, c, d, a, in[3], 0xc1bdceee, 22);
+		MD5STEP_SIMD(F1_SIMD, a, b, c, d, in[4], 0xf57c0faf, 7);
+		MD5STEP_SIMD(F1_SIMD, d, a, b, c, in[5], 0x4787c62a, 12);
+		MD5STEP_SIMD(F1_SIMD, c, d, a, b, in[6], 0xa8304613, 17);
+		MD5STEP_SIMD(F1_SIMD, b, c, d, a, in[7], 0xfd469501, 22);
+		MD5STEP_SIMD(F1_SIMD, a, b, c, d, in[8], 0x698098d8, 7);
+		MD5STEP_SIMD(F1_SIMD, d, a, b, c, in[9], 0x8b44f7af, 12);
+		MD5STEP_SIMD(F1_SIMD, c, d, a, b, in[10], 0xffff5bb1, 17);
+		MD5STEP_SIMD(F1_SIMD, b, c, d, a, in[11], 0x895cd7be, 22);
+		MD5STEP_SIMD(F1_SIMD, a, b, c, d, in[12], 0x6b901122, 7);
+		MD5STEP_SIMD(F1_SIMD, d, a, b, c, in[13], 0xfd987193, 12);
+		MD5STEP_SIMD(F1_SIMD, c, d, a, b, in[14], 0xa679438e, 17);
+		MD5STEP_SIMD(F1_SIMD, b, c, d, a, in[15], 0x49b40821, 22);
+
+		MD5STEP_SIMD(F2_SIMD, a, b, c, d, in[1], 0xf61e2562, 5);
+		MD5STEP_SIMD(F2_SIMD, d, a, b, c, in[6], 0xc040b340, 9);
+		MD5STEP_SIMD(F2_SIMD, c, d, a, b, in[11], 0x265e5a51, 14);
+		MD5STEP_SIMD(F2_SIMD, b, c, d, a, in[0], 0xe9b6c7aa, 20);
+		MD5STEP_SIMD(F2_SIMD, a, b, c, d, in[5], 0xd62f105d, 5);
+		MD5STEP_SIMD(F2_SIMD, d, a, b, c, in[10], 0x02441453, 9);
+		MD5STEP_SIMD(F2_SIMD, c, d, a, b, in[15], 0xd8a1e681, 14);
+		MD5STEP_SIMD(F2_SIMD, b, c, d, a, in[4], 0xe7d3fbc8, 20);
+		MD5STEP_SIMD(F2_SIMD, a, b, c, d, in[9], 0x21e1cde6, 5);
+		MD5STEP_SIMD(F2_SIMD, d, a, b, c, in[14], 0xc33707d6, 9);
+		MD5STEP_SIMD(F2_SIMD, c, d, a, b, in[3], 0xf4d50d87, 14);
+		MD5STEP_SIMD(F2_SIMD, b, c, d, a, in[8], 0x455a14ed, 20);
+		MD5STEP_SIMD(F2_SIMD, a, b, c, d, in[13], 0xa9e3e905, 5);
+		MD5STEP_SIMD(F2_SIMD, d, a, b, c, in[2], 0xfcefa3f8, 9);
+		MD5STEP_SIMD(F2_SIMD, c, d, a, b, in[7], 0x676f02d9, 14);
+		MD5STEP_SIMD(F2_SIMD, b, c, d, a, in[12], 0x8d2a4c8a, 20);
+
+		MD5STEP_SIMD(F3_SIMD, a, b, c, d, in[5], 0xfffa3942, 4);
+		MD5STEP_SIMD(F3_SIMD, d, a, b, c, in[8], 0x8771f681, 11);
+		MD5STEP_SIMD(F3_SIMD, c, d, a, b, in[11], 0x6d9d6122, 16);
+		MD5STEP_SIMD(F3_SIMD, b, c, d, a, in[14], 0xfde5380c, 23);
+		MD5STEP_SIMD(F3_SIMD, a, b, c, d, in[1], 0xa4beea44, 4);
+		MD5STEP_SIMD(F3_SIMD, d, a, b, c, in[4], 0x4bdecfa9, 11);
+		MD5STEP_SIMD(F3_SIMD, c, d, a, b, in[7], 0xf6bb4b60, 16);
+		MD5STEP_SIMD(F3_SIMD, b, c, d, a, in[10], 0xbebfbc70, 23);
+		MD5STEP_SIMD(F3_SIMD, a, b, c, d, in[13], 0x289b7ec6, 4);
+		MD5STEP_SIMD(F3_SIMD, d, a, b, c, in[0], 0xeaa127fa, 11);
+		MD5STEP_SIMD(F3_SIMD, c, d, a, b, in[3], 0xd4ef3085, 16);
+		MD5STEP_SIMD(F3_SIMD, b, c, d, a, in[6], 0x04881d05, 23);
+		MD5STEP_SIMD(F3_SIMD, a, b, c, d, in[9], 0xd9d4d039, 4);
+		MD5STEP_SIMD(F3_SIMD, d, a, b, c, in[12], 0xe6db99e5, 11);
+		MD5STEP_SIMD(F3_SIMD, c, d, a, b, in[15], 0x1fa27cf8, 16);
+		MD5STEP_SIMD(F3_SIMD, b, c, d, a, in[2], 0xc4ac5665, 23);
+
+		MD5STEP_SIMD(F4_SIMD, a, b, c, d, in[0], 0xf4292244, 6);
+		MD5STEP_SIMD(F4_SIMD, d, a, b, c, in[7], 0x432aff97, 10);
+		MD5STEP_SIMD(F4_SIMD, c, d, a, b, in[14], 0xab9423a7, 15);
+		MD5STEP_SIMD(F4_SIMD, b, c, d, a, in[5], 0xfc93a039, 21);
+		MD5STEP_SIMD(F4_SIMD, a, b, c, d, in[12], 0x655b59c3, 6);
+		MD5STEP_SIMD(F4_SIMD, d, a, b, c, in[3], 0x8f0ccc92, 10);
+		MD5STEP_SIMD(F4_SIMD, c, d, a, b, in[10], 0xffeff47d, 15);
+		MD5STEP_SIMD(F4_SIMD, b, c, d, a, in[1], 0x85845dd1, 21);
+		MD5STEP_SIMD(F4_SIMD, a, b, c, d, in[8], 0x6fa87e4f, 6);
+		MD5STEP_SIMD(F4_SIMD, d, a, b, c, in[15], 0xfe2ce6e0, 10);
+		MD5STEP_SIMD(F4_SIMD, c, d, a, b, in[6], 0xa3014314, 15);
+		MD5STEP_SIMD(F4_SIMD, b, c, d, a, in[13], 0x4e0811a1, 21);
+		MD5STEP_SIMD(F4_SIMD, a, b, c, d, in[4], 0xf7537e82, 6);
+		MD5STEP_SIMD(F4_SIMD, d, a, b, c, in[11], 0xbd3af235, 10);
+		MD5STEP_SIMD(F4_SIMD, c, d, a, b, in[2], 0x2ad7d2bb, 15);
+		MD5STEP_SIMD(F4_SIMD, b, c, d, a, in[9], 0xeb86d391, 21);
+
+	a = _mm_add_epi32( a, buf[0] );
+	b = _mm_add_epi32( b, buf[1] );
+	c = _mm_add_epi32( c, buf[2] );
+	d = _mm_add_epi32( d, buf[3] );
+	buf[0] = _mm_or_si128( _mm_and_si128( laneMask, a ), _mm_andnot_si128( laneMask, buf[0] ) );
+	buf[1] = _mm_or_si128( _mm_and_si128( laneMask, b ), _mm_andnot_si128( laneMask, buf[1] ) );
+	buf[2] = _mm_or_si128( _mm_and_si128( laneMask, c ), _mm_andnot_si128( laneMask, buf[2] ) );
+	buf[3] = _mm_or_si128( _mm_and_si128( laneMask, d ), _mm_andnot_si128( laneMask, buf[3] ) );
+}
+
+static void MD5_ProcessBuffers_SIMD( int nBuffers, const void * const *ppBuffers, const int *pLengths, MD5Value_t *pResults )
+{
+	Assert( nBuffers > 0 && nBuffers <= MD5_SIMD_LANES );
+
+	MD5Lane_t lanes[MD5_SIMD_LANES];
+	int nMaxBlocks = 0;
+	for ( int i = 0; i < MD5_SIMD_LANES; i++ )
+	{
+		// Unused lanes hash an empty buffer and get thrown away.
+		if ( i < nBuffers )
+		{
+			MD5Lane_Init( &lanes[i], ppBuffers[i], pLengths[i] );
+		}
+		else
+		{
+			MD5Lane_Init( &lanes[i], NULL, 0 );
+		}
+		nMaxBlocks = MAX( nMaxBlocks, lanes[i].m_nBlocks );
+	}
+
+	__m128i buf[4];
+	buf[0] = _mm_set1_epi32( 0x67452301 );
+	buf[1] = _mm_set1_epi32( (int)0xefcdab89 );
+	buf[2] = _mm_set1_epi32( (int)0x98badcfe );
+	buf[3] = _mm_set1_epi32( 0x10325476 );
+
+	for ( int iBlock = 0; iBlock < nMaxBlocks; iBlock++ )
+	{
+		const unsigned char *pBlocks[MD5_SIMD_LANES];
+		for ( int i = 0; i < MD5_SIMD_LANES; i++ )
+		{
+			pBlocks[i] = MD5Lane_GetBlock( &lanes[i], iBlock );
+		}
+
+		// Transpose so in[j] holds word j of each lane's block.
+		__m128i in[16];
+		for ( int j = 0; j < 16; j += 4 )
+		{
+			__m128i r0 = _mm_loadu_si128( (const __m128i *)( pBlocks[0] + j * 4 ) );
+			__m128i r1 = _mm_loadu_si128( (const __m128i *)( pBlocks[1] + j * 4 ) );
+			__m128i r2 = _mm_loadu_si128( (const __m128i *)( pBlocks[2] + j * 4 ) );
+			__m128i r3 = _mm_loadu_si128( (const __m128i *)( pBlocks[3] + j * 4 ) );
+			__m128i t0 = _mm_unpacklo_epi32( r0, r1 );
+			__m128i t1 = _mm_unpacklo_epi32( r2, r3 );
+			__m128i t2 = _mm_unpackhi_epi32( r0, r1 );
+			__m128i t3 = _mm_unpackhi_epi32( r2, r3 );
+			in[j + 0] = _mm_unpacklo_epi64( t0, t1 );
+			in[j + 1] = _mm_unpackhi_epi64( t0, t1 );
+			in[j + 2] = _mm_unpacklo_epi64( t2, t3 );
+			in[j + 3] = _mm_unpackhi_epi64( t2, t3 );
+		}
+
+		__m128i laneMask = _mm_setr_epi32(
+			( iBlock < lanes[0].m_nBlocks ) ? -1 : 0,
+			( iBlock < lanes[1].m_nBlocks ) ? -1 : 0,
+			( iBlock < lanes[2].m_nBlocks ) ? -1 : 0,
+			( iBlock < lanes[3].m_nBlocks ) ? -1 : 0 );
+
+		MD5Transform_SIMD( buf, in, laneMask );
+	}
+
+	ALIGN16 uint32 digest[4][MD5_SIMD_LANES] ALIGN16_POST;
+	for ( int j = 0; j < 4; j++ )
+	{
+		_mm_store_si128( (__m128i *)digest[j], buf[j] );
+	}
+
+	for ( int i = 0; i < nBuffers; i++ )
+	{
+		for ( int j = 0; j < 4; j++ )
+		{
+			uint32 nWord = digest[j][i];
+			pResults[i].bits[j * 4 + 0] = (unsigned char)( nWord );
+			pResults[i].bits[j * 4 + 1] = (unsigned char)( nWord >> 8 );
+			pResults[i].bits[j * 4 + 2] = (unsigned char)( nWord >> 16 );
+			pResults[i].bits[j * 4 + 3] = (unsigned char)( nWord >> 24 );
+		}
+	}
+}
+
+#endif // MD5_MULTI_BUFFER_SIMD
+
+//-----------------------------------------------------------------------------
+void MD5_ProcessMultipleBuffers( int nBuffers, const void * const *ppBuffers, const int *pLengths, MD5Value_t *pResults )
+{
+#if MD5_MULTI_BUFFER_SIMD
+	for ( int i = 0; i < nBuffers; i += MD5_SIMD_LANES )
+	{
+		int nLanes = MIN( nBuffers - i, MD5_SIMD_LANES );
+		MD5_ProcessBuffers_SIMD( nLanes, ppBuffers + i, pLengths + i, pResults + i );
+	}
+#else
+	for ( int i = 0; i < nBuffers; i++ )
+	{
+		MD5_ProcessSingleBuffer( ppBuffers[i], pLengths[i], pResults[i] );
+	}
+#endif
+}
@@ -297,3 +297,236 @@ bool HashLessFunc( SHADigest_t const &lhs, SHADigest_t const &rhs )
 	return ( iRes < 0 );
 }
 #endif
+
+
+#ifndef	_MINIMUM_BUILD_
+
+//-----------------------------------------------------------------------------
+// Multi-buffer SHA-1. Each lane of an SSE2 register carries a different
+// buffer through the same rounds, so four independent hashes cost about one.
+//-----------------------------------------------------------------------------
+#if ( defined( _WIN32 ) && !defined( _X360 ) ) || defined( __SSE2__ )
+#define SHA1_MULTI_BUFFER_SIMD 1
+#include <emmintrin.h>
+#else
+#define SHA1_MULTI_BUFFER_SIMD 0
+#endif
+
+#if SHA1_MULTI_BUFFER_SIMD
+
+#define SHA1_SIMD_LANES 4
+
+#define ROL32_SIMD(_val, _nBits) _mm_or_si128( _mm_slli_epi32( _val, _nBits ), _mm_srli_epi32( _val, 32 - (_nBits) ) )
+
+// One lane's view of its buffer: whole 64 byte blocks are read in place, the
+// rest plus the SHA-1 padding and length is copied into m_Tail.
+struct SHA1Lane_t
+{
+	const unsigned char	*m_pData;
+	int					m_nDataBlocks;
+	int					m_nBlocks;
+	unsigned char		m_Tail[128];
+};
+
+static void SHA1Lane_Init( SHA1Lane_t *pLane, const void *pData, int nLength )
+{
+	pLane->m_pData = (const unsigned char *)pData;
+	pLane->m_nDataBlocks = nLength / 64;
+
+	int nTail = nLength - pLane->m_nDataBlocks * 64;
+	int nTailBlocks = ( nTail + 1 + 8 <= 64 ) ? 1 : 2;
+	memset( pLane->m_Tail, 0, sizeof( pLane->m_Tail ) );
+	memcpy( pLane->m_Tail, pLane->m_pData + pLane->m_nDataBlocks * 64, nTail );
+	pLane->m_Tail[nTail] = 0x80;
+
+	// The bit count is big endian.
+	unsigned long long nBits = (unsigned long long)nLength << 3;
+	unsigned char *pBitCount = pLane->m_Tail + nTailBlocks * 64 - 8;
+	for ( int i = 0; i < 8; i++ )
+	{
+		pBitCount[i] = (unsigned char)( nBits >> ( ( 7 - i ) * 8 ) );
+	}
+
+	pLane->m_nBlocks = pLane->m_nDataBlocks + nTailBlocks;
+}
+
+static const unsigned char *SHA1Lane_GetBlock( const SHA1Lane_t *pLane, int iBlock )
+{
+	if ( iBlock < pLane->m_nDataBlocks )
+		return pLane->m_pData + iBlock * 64;
+	if ( iBlock < pLane->m_nBlocks )
+		return pLane->m_Tail + ( iBlock - pLane->m_nDataBlocks ) * 64;
+
+	// This lane is done; it still goes through the rounds but the result is masked off.
+	return pLane->m_Tail;
+}
+
+// Swaps the bytes of each 32 bit lane.
+static inline __m128i SHA1_ByteSwap_SIMD( __m128i x )
+{
+	x = _mm_shufflehi_epi16( _mm_shufflelo_epi16( x, 0xB1 ), 0xB1 );
+	return _mm_or_si128( _mm_slli_epi16( x, 8 ), _mm_srli_epi16( x, 8 ) );
+}
+
+// Private SHA-1 transformation on four lanes at once. Lanes with a zero mask keep their old state.
+static void SHA1Transform_SIMD( __m128i state[5], const unsigned char * const pBlocks[SHA1_SIMD_LANES], __m128i laneMask )
+{
+	// Transpose so w[j] holds (big endian) word j of each lane's block.
+	__m128i w[16];
+	for ( int j = 0; j < 16; j += 4 )
+	{
+		__m128i r0 = _mm_loadu_si128( (const __m128i *)( pBlocks[0] + j * 4 ) );
+		__m128i r1 = _mm_loadu_si128( (const __m128i *)( pBlocks[1] + j * 4 ) );
+		__m128i r2 = _mm_loadu_si128( (const __m128i *)( pBlocks[2] + j * 4 ) );
+		__m128i r3 = _mm_loadu_si128( (const __m128i *)( pBlocks[3] + j * 4 ) );
+		__m128i t0 = _mm_unpacklo_epi32( r0, r1 );
+		__m128i t1 = _mm_unpacklo_epi32( r2, r3 );
+		__m128i t2 = _mm_unpackhi_epi32( r0, r1 );
+		__m128i t3 = _mm_unpackhi_epi32( r2, r3 );
+		w[j + 0] = SHA1_ByteSwap_SIMD( _mm_unpacklo_epi64( t0, t1 ) );
+		w[j + 1] = SHA1_ByteSwap_SIMD( _mm_unpackhi_epi64( t0, t1 ) );
+		w[j + 2] = SHA1_ByteSwap_SIMD( _mm_unpacklo_epi64( t2, t3 ) );
+		w[j + 3] = SHA1_ByteSwap_SIMD( _mm_unpackhi_epi64( t2, t3 ) );
+	}
+
+	__m128i a = state[0];
+	__m128i b = state[1];
+	__m128i c = state[2];
+	__m128i d = state[3];
+	__m128i e = state[4];
+
+	for ( int i = 0; i < 80; i++ )
+	{
+		__m128i data;
+		if ( i < 16 )
+		{
+			data = w[i];
+		}
+		else
+		{
+			data = _mm_xor_si128( _mm_xor_si128( w[(i+13)&15], w[(i+8)&15] ), _mm_xor_si128( w[(i+2)&15], w[i&15] ) );
+			data = ROL32_SIMD( data, 1 );
+			w[i&15] = data;
+		}
+
+		__m128i f, k;
+		if ( i < 20 )
+		{
+			f = _mm_xor_si128( _mm_and_si128( b, _mm_xor_si128( c, d ) ), d );
+			k = _mm_set1_epi32( 0x5A827999 );
+		}
+		else if ( i < 40 )
+		{
+			f = _mm_xor_si128( _mm_xor_si128( b, c ), d );
+			k = _mm_set1_epi32( 0x6ED9EBA1 );
+		}
+		else if ( i < 60 )
+		{
+			f = _mm_or_si128( _mm_and_si128( _mm_or_si128( b, c ), d ), _mm_and_si128( b, c ) );
+			k = _mm_set1_epi32( (int)0x8F1BBCDC );
+		}
+		else
+		{
+			f = _mm_xor_si128( _mm_xor_si128( b, c ), d );
+			k = _mm_set1_epi32( (int)0xCA62C1D6 );
+		}
+
+		__m128i temp = _mm_add_epi32( _mm_add_epi32( ROL32_SIMD( a, 5 ), f ), _mm_add_epi32( _mm_add_epi32( e, k ), data ) );
+		e = d;
+		d = c;
+		c = ROL32_SIMD( b, 30 );
+		b = a;
+		a = temp;
+	}
+
+	a = _mm_add_epi32( a, state[0] );
+	b = _mm_add_epi32( b, state[1] );
+	c = _mm_add_epi32( c, state[2] );
+	d = _mm_add_epi32( d, state[3] );
+	e = _mm_add_epi32( e, state[4] );
+	state[0] = _mm_or_si128( _mm_and_si128( laneMask, a ), _mm_andnot_si128( laneMask, state[0] ) );
+	state[1] = _mm_or_si128( _mm_and_si128( laneMask, b ), _mm_andnot_si128( laneMask, state[1] ) );
+	state[2] = _mm_or_si128( _mm_and_si128( laneMask, c ), _mm_andnot_si128( laneMask, state[2] ) );
+	state[3] = _mm_or_si128( _mm_and_si128( laneMask, d ), _mm_andnot_si128( laneMask, state[3] ) );
+	state[4] = _mm_or_si128( _mm_and_si128( laneMask, e ), _mm_andnot_si128( laneMask, state[4] ) );
+}
+
+static void SHA1_ProcessBuffers_SIMD( int nBuffers, const void * const *ppBuffers, const int *pLengths, SHADigest_t *pResults )
+{
+	SHA1Lane_t lanes[SHA1_SIMD_LANES];
+	int nMaxBlocks = 0;
+	for ( int i = 0; i < SHA1_SIMD_LANES; i++ )
+	{
+		// Unused lanes hash an empty buffer and get thrown away.
+		if ( i < nBuffers )
+		{
+			SHA1Lane_Init( &lanes[i], ppBuffers[i], pLengths[i] );
+		}
+		else
+		{
+			SHA1Lane_Init( &lanes[i], NULL, 0 );
+		}
+		if ( lanes[i].m_nBlocks > nMaxBlocks )
+		{
+			nMaxBlocks = lanes[i].m_nBlocks;
+		}
+	}
+
+	__m128i state[5];
+	state[0] = _mm_set1_epi32( 0x67452301 );
+	state[1] = _mm_set1_epi32( (int)0xEFCDAB89 );
+	state[2] = _mm_set1_epi32( (int)0x98BADCFE );
+	state[3] = _mm_set1_epi32( 0x10325476 );
+	state[4] = _mm_set1_epi32( (int)0xC3D2E1F0 );
+
+	for ( int iBlock = 0; iBlock < nMaxBlocks; iBlock++ )
+	{
+		const unsigned char *pBlocks[SHA1_SIMD_LANES];
+		for ( int i = 0; i < SHA1_SIMD_LANES; i++ )
+		{
+			pBlocks[i] = SHA1Lane_GetBlock( &lanes[i], iBlock );
+		}
+
+		__m128i laneMask = _mm_setr_epi32(
+			( iBlock < lanes[0].m_nBlocks ) ? -1 : 0,
+			( iBlock < lanes[1].m_nBlocks ) ? -1 : 0,
+			( iBlock < lanes[2].m_nBlocks ) ? -1 : 0,
+			( iBlock < lanes[3].m_nBlocks ) ? -1 : 0 );
+
+		SHA1Transform_SIMD( state, pBlocks, laneMask );
+	}
+
+	unsigned int digest[5][SHA1_SIMD_LANES];
+	for ( int j = 0; j < 5; j++ )
+	{
+		_mm_storeu_si128( (__m128i *)digest[j], state[j] );
+	}
+
+	for ( int i = 0; i < nBuffers; i++ )
+	{
+		for ( unsigned int j = 0; j < k_cubHash; j++ )
+		{
+			pResults[i][j] = (unsigned char)( ( digest[j >> 2][i] >> ( ( 3 - ( j & 3 ) ) * 8 ) ) & 255 );
+		}
+	}
+}
+
+#endif // SHA1_MULTI_BUFFER_SIMD
+
+void SHA1_ProcessMultipleBuffers( int nBuffers, const void * const *ppBuffers, const int *pLengths, SHADigest_t *pResults )
+{
+#if SHA1_MULTI_BUFFER_SIMD
+	for ( int i = 0; i < nBuffers; i += SHA1_SIMD_LANES )
+	{
+		int nLanes = ( nBuffers - i < SHA1_SIMD_LANES ) ? nBuffers - i : SHA1_SIMD_LANES;
+		SHA1_ProcessBuffers_SIMD( nLanes, ppBuffers + i, pLengths + i, pResults + i );
+	}
+#else
+	for ( int i = 0; i < nBuffers; i++ )
+	{
+		GenerateHash( pResults[i], ppBuffers[i], pLengths[i] );
+	}
+#endif
+}
+
+#endif // _MINIMUM_BUILD_
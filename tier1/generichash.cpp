@@ -435,3 +435,156 @@ uint64 MurmurHash64( const void * key, int len, uint32 seed )
 	return h;
 }
 
+
+//-----------------------------------------------------------------------------
+// FastHash64 - a wyhash style 64 bit hash. The bulk loop runs three
+// independent multiply chains over 48 byte stripes so they overlap in the
+// pipeline, and short keys are handled with a couple of overlapping loads
+// instead of a byte loop.
+//-----------------------------------------------------------------------------
+static const uint64 g_FastHashSecret[4] =
+{
+	0x2d358dccaa6c78a5ull, 0x8bb84b93962eacc9ull, 0x4b33a62ed433d4a3ull, 0x4d5a2da51de1aa47ull
+};
+
+// 64x64->128 bit multiply, returns the low half in A and the high half in B
+static FORCEINLINE void FastHash_Mum( uint64 *pA, uint64 *pB )
+{
+#if defined( __SIZEOF_INT128__ )
+	unsigned __int128 r = *pA;
+	r *= *pB;
+	*pA = (uint64)r;
+	*pB = (uint64)( r >> 64 );
+#elif defined( _MSC_VER ) && defined( _M_X64 )
+	*pA = _umul128( *pA, *pB, pB );
+#else
+	uint64 ha = *pA >> 32, hb = *pB >> 32, la = (uint32)*pA, lb = (uint32)*pB;
+	uint64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64 t = rl + ( rm0 << 32 );
+	uint64 c = t < rl;
+	uint64 lo = t + ( rm1 << 32 );
+	c += lo < t;
+	*pA = lo;
+	*pB = rh + ( rm0 >> 32 ) + ( rm1 >> 32 ) + c;
+#endif
+}
+
+static FORCEINLINE uint64 FastHash_Mix( uint64 a, uint64 b )
+{
+	FastHash_Mum( &a, &b );
+	return a ^ b;
+}
+
+// ASCII lowercase of every byte in a word at once: bytes in 'A'..'Z' get 0x20 or'ed in.
+static FORCEINLINE uint64 FastHash_FoldCase64( uint64 x )
+{
+	const uint64 nHigh = 0x8080808080808080ull;
+	uint64 nLow7 = x & ~nHigh;
+	uint64 nAboveA = nLow7 + 0x3f3f3f3f3f3f3f3full;	// high bit set where byte >= 'A'
+	uint64 nAboveZ = nLow7 + 0x2525252525252525ull;	// high bit set where byte > 'Z'
+	uint64 nUpper = ( nAboveA ^ nAboveZ ) & ~x & nHigh;
+	return x | ( nUpper >> 2 );
+}
+
+static FORCEINLINE uint32 FastHash_FoldCase32( uint32 x )
+{
+	const uint32 nHigh = 0x80808080;
+	uint32 nLow7 = x & ~nHigh;
+	uint32 nAboveA = nLow7 + 0x3f3f3f3f;
+	uint32 nAboveZ = nLow7 + 0x25252525;
+	uint32 nUpper = ( nAboveA ^ nAboveZ ) & ~x & nHigh;
+	return x | ( nUpper >> 2 );
+}
+
+template < bool bCaseless >
+static FORCEINLINE uint64 FastHash_Read8( const uint8 *p )
+{
+	uint64 v;
+	memcpy( &v, p, sizeof( v ) );
+	v = LittleQWord( v );
+	return bCaseless ? FastHash_FoldCase64( v ) : v;
+}
+
+template < bool bCaseless >
+static FORCEINLINE uint64 FastHash_Read4( const uint8 *p )
+{
+	uint32 v;
+	memcpy( &v, p, sizeof( v ) );
+	v = LittleDWord( v );
+	return bCaseless ? FastHash_FoldCase32( v ) : v;
+}
+
+template < bool bCaseless >
+static FORCEINLINE uint64 FastHash_Read3( const uint8 *p, int nLen )
+{
+	uint32 v = ( (uint32)p[0] << 16 ) | ( (uint32)p[nLen >> 1] << 8 ) | p[nLen - 1];
+	return bCaseless ? FastHash_FoldCase32( v ) : v;
+}
+
+template < bool bCaseless >
+static uint64 FastHash64_Internal( const void *pKey, int nLen, uint64 nSeed )
+{
+	const uint8 *p = (const uint8 *)pKey;
+	const uint64 *s = g_FastHashSecret;
+	uint64 a, b;
+
+	nSeed ^= FastHash_Mix( nSeed ^ s[0], s[1] );
+	if ( nLen <= 16 )
+	{
+		if ( nLen >= 4 )
+		{
+			int nOffset = ( nLen >> 3 ) << 2;
+			a = ( FastHash_Read4<bCaseless>( p ) << 32 ) | FastHash_Read4<bCaseless>( p + nOffset );
+			b = ( FastHash_Read4<bCaseless>( p + nLen - 4 ) << 32 ) | FastHash_Read4<bCaseless>( p + nLen - 4 - nOffset );
+		}
+		else if ( nLen > 0 )
+		{
+			a = FastHash_Read3<bCaseless>( p, nLen );
+			b = 0;
+		}
+		else
+		{
+			a = b = 0;
+		}
+	}
+	else
+	{
+		int i = nLen;
+		if ( i > 48 )
+		{
+			uint64 nSeed1 = nSeed, nSeed2 = nSeed;
+			do
+			{
+				nSeed = FastHash_Mix( FastHash_Read8<bCaseless>( p ) ^ s[1], FastHash_Read8<bCaseless>( p + 8 ) ^ nSeed );
+				nSeed1 = FastHash_Mix( FastHash_Read8<bCaseless>( p + 16 ) ^ s[2], FastHash_Read8<bCaseless>( p + 24 ) ^ nSeed1 );
+				nSeed2 = FastHash_Mix( FastHash_Read8<bCaseless>( p + 32 ) ^ s[3], FastHash_Read8<bCaseless>( p + 40 ) ^ nSeed2 );
+				p += 48;
+				i -= 48;
+			} while ( i > 48 );
+			nSeed ^= nSeed1 ^ nSeed2;
+		}
+		while ( i > 16 )
+		{
+			nSeed = FastHash_Mix( FastHash_Read8<bCaseless>( p ) ^ s[1], FastHash_Read8<bCaseless>( p + 8 ) ^ nSeed );
+			i -= 16;
+			p += 16;
+		}
+		a = FastHash_Read8<bCaseless>( p + i - 16 );
+		b = FastHash_Read8<bCaseless>( p + i - 8 );
+	}
+
+	a ^= s[1];
+	b ^= nSeed;
+	FastHash_Mum( &a, &b );
+	return FastHash_Mix( a ^ s[0] ^ (uint64)nLen, b ^ s[1] );
+}
+
+uint64 FastHash64( const void *pKey, int nLen, uint64 nSeed )
+{
+	return FastHash64_Internal<false>( pKey, nLen, nSeed );
+}
+
+uint64 FastHash64Caseless( const void *pKey, int nLen, uint64 nSeed )
+{
+	return FastHash64_Internal<true>( pKey, nLen, nSeed );
+}
@@ -310,3 +310,193 @@ void CUtlMemoryPool::Free( void *memBlock )
 }
 
 
+//-----------------------------------------------------------------------------
+// CThreadCachedMemoryPool
+//-----------------------------------------------------------------------------
+CThreadCachedMemoryPool::CThreadCachedMemoryPool( int blockSize, int numElements, int growMode, const char *pszAllocOwner ) :
+	m_Pool( blockSize, numElements, growMode, pszAllocOwner )
+{
+	m_nBlockSize = MAX( blockSize, (int)sizeof( void * ) );
+	m_nBlocksAllocated = 0;
+	m_nPeakAlloc = 0;
+}
+
+CThreadCachedMemoryPool::~CThreadCachedMemoryPool()
+{
+	m_FullMagazines.Detach();
+	m_EmptyMagazines.Detach();
+	for ( int i = 0; i < m_Magazines.Count(); i++ )
+	{
+		MemAlloc_FreeAligned( m_Magazines[i] );
+	}
+	m_ThreadCaches.PurgeAndDeleteElements();
+
+	// Blocks sitting in magazines are still allocated as far as the block pool
+	// is concerned; don't let it report them as leaks.
+	m_Pool.Clear();
+}
+
+CThreadCachedMemoryPool::ThreadCache_t *CThreadCachedMemoryPool::CreateThreadCache()
+{
+	ThreadCache_t *pCache = new ThreadCache_t;
+	pCache->m_pLoaded = GetEmptyMagazine();
+	pCache->m_pPrevious = GetEmptyMagazine();
+	pCache->m_nCountDelta = 0;
+
+	{
+		AUTO_LOCK( m_mutex );
+		m_ThreadCaches.AddToTail( pCache );
+	}
+
+	m_pThreadCache = pCache;
+	return pCache;
+}
+
+CThreadCachedMemoryPool::Magazine_t *CThreadCachedMemoryPool::GetEmptyMagazine()
+{
+	Magazine_t *pMagazine = (Magazine_t *)m_EmptyMagazines.Pop();
+	if ( !pMagazine )
+	{
+		MEM_ALLOC_CREDIT_( "CThreadCachedMemoryPool magazines" );
+		pMagazine = (Magazine_t *)MemAlloc_AllocAligned( sizeof( Magazine_t ), TSLIST_NODE_ALIGNMENT );
+		pMagazine->m_nBlocks = 0;
+
+		AUTO_LOCK( m_mutex );
+		m_Magazines.AddToTail( pMagazine );
+	}
+	return pMagazine;
+}
+
+void CThreadCachedMemoryPool::ReturnToDepot( Magazine_t *pMagazine )
+{
+	if ( pMagazine->m_nBlocks )
+	{
+		m_FullMagazines.Push( pMagazine );
+	}
+	else
+	{
+		m_EmptyMagazines.Push( pMagazine );
+	}
+}
+
+void CThreadCachedMemoryPool::PublishCount( ThreadCache_t *pCache )
+{
+	if ( !pCache->m_nCountDelta )
+		return;
+
+	int nCount = ThreadInterlockedExchangeAdd( &m_nBlocksAllocated, pCache->m_nCountDelta ) + pCache->m_nCountDelta;
+	pCache->m_nCountDelta = 0;
+
+	int nPeak = m_nPeakAlloc;
+	while ( nCount > nPeak && !ThreadInterlockedAssignIf( &m_nPeakAlloc, nCount, nPeak ) )
+	{
+		nPeak = m_nPeakAlloc;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Called when the loaded magazine is empty. Returns false if the pool is out of blocks.
+//-----------------------------------------------------------------------------
+bool CThreadCachedMemoryPool::Reload( ThreadCache_t *pCache )
+{
+	if ( pCache->m_pPrevious->m_nBlocks )
+	{
+		V_swap( pCache->m_pLoaded, pCache->m_pPrevious );
+		return true;
+	}
+
+	PublishCount( pCache );
+
+	// Both magazines are empty; trade one for a full one from the depot
+	Magazine_t *pFull = (Magazine_t *)m_FullMagazines.Pop();
+	if ( pFull )
+	{
+		m_EmptyMagazines.Push( pCache->m_pPrevious );
+		pCache->m_pPrevious = pCache->m_pLoaded;
+		pCache->m_pLoaded = pFull;
+		return true;
+	}
+
+	// The depot is dry too, so fill the magazine from the block pool
+	Magazine_t *pLoaded = pCache->m_pLoaded;
+	AUTO_LOCK( m_mutex );
+	while ( pLoaded->m_nBlocks < MAGAZINE_SIZE )
+	{
+		void *pBlock = m_Pool.Alloc();
+		if ( !pBlock )
+			break;
+		pLoaded->m_pBlocks[ pLoaded->m_nBlocks++ ] = pBlock;
+	}
+	return pLoaded->m_nBlocks != 0;
+}
+
+//-----------------------------------------------------------------------------
+// Called when the loaded magazine is full
+//-----------------------------------------------------------------------------
+void CThreadCachedMemoryPool::Unload( ThreadCache_t *pCache )
+{
+	if ( pCache->m_pPrevious->m_nBlocks < MAGAZINE_SIZE )
+	{
+		V_swap( pCache->m_pLoaded, pCache->m_pPrevious );
+		return;
+	}
+
+	PublishCount( pCache );
+
+	// Both magazines are full; hand one to the depot and start on an empty one
+	m_FullMagazines.Push( pCache->m_pPrevious );
+	pCache->m_pPrevious = pCache->m_pLoaded;
+	pCache->m_pLoaded = GetEmptyMagazine();
+}
+
+void CThreadCachedMemoryPool::ReleaseThreadCache()
+{
+	ThreadCache_t *pCache = m_pThreadCache;
+	if ( !pCache )
+		return;
+
+	PublishCount( pCache );
+	ReturnToDepot( pCache->m_pLoaded );
+	ReturnToDepot( pCache->m_pPrevious );
+	m_pThreadCache = (ThreadCache_t *)NULL;
+
+	{
+		AUTO_LOCK( m_mutex );
+		m_ThreadCaches.FindAndFastRemove( pCache );
+	}
+	delete pCache;
+}
+
+int CThreadCachedMemoryPool::Count()
+{
+	AUTO_LOCK( m_mutex );
+	int nCount = m_nBlocksAllocated;
+	for ( int i = 0; i < m_ThreadCaches.Count(); i++ )
+	{
+		nCount += m_ThreadCaches[i]->m_nCountDelta;
+	}
+	return nCount;
+}
+
+void CThreadCachedMemoryPool::Clear()
+{
+	AUTO_LOCK( m_mutex );
+
+	for ( int i = 0; i < m_ThreadCaches.Count(); i++ )
+	{
+		ThreadCache_t *pCache = m_ThreadCaches[i];
+		pCache->m_pLoaded->m_nBlocks = 0;
+		pCache->m_pPrevious->m_nBlocks = 0;
+		pCache->m_nCountDelta = 0;
+	}
+
+	Magazine_t *pMagazine;
+	while ( ( pMagazine = (Magazine_t *)m_FullMagazines.Pop() ) != NULL )
+	{
+		pMagazine->m_nBlocks = 0;
+		m_EmptyMagazines.Push( pMagazine );
+	}
+
+	m_Pool.Clear();
+	m_nBlocksAllocated = 0;
+}
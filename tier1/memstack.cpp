@@ -15,8 +15,11 @@
 #endif
 
 #include "tier0/dbg.h"
+#include "tier0/threadtools.h"
 #include "memstack.h"
+#include "threadexit.h"
 #include "utlmap.h"
+#include "utlvector.h"
 #include "tier0/memdbgon.h"
 
 #ifdef _WIN32
@@ -295,3 +298,90 @@ void CMemoryStack::PrintContents()
 }
 
 //-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// CFrameArena
+//-----------------------------------------------------------------------------
+static CTHREADLOCALPTR( CFrameArena ) s_pThreadFrameArena;
+static unsigned s_nFrameArenaSize = FRAME_ARENA_DEFAULT_SIZE;
+
+// Every live arena, for PrintStats
+static CThreadFastMutex s_FrameArenaMutex;
+static CUtlVector<CFrameArena *> s_FrameArenas;
+
+CFrameArena::CFrameArena( unsigned nMaxSize )
+{
+	m_Stack.Init( nMaxSize, 0, 0, FRAME_ARENA_ALIGNMENT );
+	m_nHighWater = 0;
+	m_nFailedAllocs = 0;
+	m_nThreadId = ThreadGetCurrentId();
+}
+
+CFrameArena::~CFrameArena()
+{
+	m_Stack.Term();
+}
+
+CFrameArena &CFrameArena::ThreadArena()
+{
+	CFrameArena *pArena = s_pThreadFrameArena;
+	if ( !pArena )
+	{
+		MEM_ALLOC_CREDIT_( "CFrameArena" );
+		pArena = new CFrameArena( s_nFrameArenaSize );
+		s_pThreadFrameArena = pArena;
+
+		{
+			AUTO_LOCK( s_FrameArenaMutex );
+			s_FrameArenas.AddToTail( pArena );
+		}
+
+		// Pool threads come and go without telling anyone
+		ThreadAddExitCallback( &CFrameArena::ThreadExit, pArena );
+	}
+	return *pArena;
+}
+
+void CFrameArena::Free( CFrameArena *pArena )
+{
+	Assert( !pArena->GetUsed() );
+	{
+		AUTO_LOCK( s_FrameArenaMutex );
+		s_FrameArenas.FindAndFastRemove( pArena );
+	}
+	delete pArena;
+}
+
+void CFrameArena::ThreadExit( void *pArena )
+{
+	s_pThreadFrameArena = (CFrameArena *)NULL;
+	Free( (CFrameArena *)pArena );
+}
+
+void CFrameArena::ReleaseThreadArena()
+{
+	CFrameArena *pArena = s_pThreadFrameArena;
+	if ( !pArena )
+		return;
+
+	ThreadRemoveExitCallback( &CFrameArena::ThreadExit, pArena );
+	s_pThreadFrameArena = (CFrameArena *)NULL;
+	Free( pArena );
+}
+
+void CFrameArena::SetDefaultSize( unsigned nMaxSize )
+{
+	s_nFrameArenaSize = nMaxSize;
+}
+
+void CFrameArena::PrintStats()
+{
+	AUTO_LOCK( s_FrameArenaMutex );
+	for ( int i = 0; i < s_FrameArenas.Count(); i++ )
+	{
+		// Reads another thread's counters without synchronization, good enough for a report
+		CFrameArena *pArena = s_FrameArenas[i];
+		Msg( "Frame arena (thread %u): %d used, %d high water, %d max, %d failed allocations\n",
+			pArena->m_nThreadId, pArena->GetUsed(), pArena->GetHighWater(), pArena->GetMaxSize(), pArena->m_nFailedAllocs );
+	}
+}
@@ -12,6 +12,8 @@ bool CheckMMXTechnology(void) { return false; }
 bool CheckSSETechnology(void) { return false; }
 bool CheckSSE2Technology(void) { return false; }
 bool Check3DNowTechnology(void) { return false; }
+bool CheckSSE42Technology(void) { return false; }
+bool CheckPCLMULQDQTechnology(void) { return false; }
 
 #elif defined( _WIN32 ) && !defined( _X360 )
 
@@ -269,6 +271,48 @@ bool Check3DNowTechnology(void)
     return retval;
 }
 
+// Returns the feature flags CPUID leaf 1 reports in ecx, or 0 if CPUID isn't supported.
+static unsigned int GetCPUIDFeaturesECX(void)
+{
+    unsigned int RegECX = 0;
+
+#ifdef CPUID
+	_asm pushad;
+#endif
+
+    __try
+	{
+        _asm
+		{
+            mov eax, 1				// set up CPUID to return processor version and features
+            CPUID					// code bytes = 0fh,  0a2h
+            mov RegECX, ecx			// extended features returned in ecx
+		}
+    } 
+	__except(EXCEPTION_EXECUTE_HANDLER) 
+	{ 
+		RegECX = 0; 
+	}
+
+#ifdef CPUID
+	_asm popad;
+#endif
+
+    return RegECX;
+}
+
+bool CheckSSE42Technology(void)
+{
+	// bit 20 is set for SSE4.2 (which includes the crc32 instruction)
+	return ( GetCPUIDFeaturesECX() & 0x00100000 ) != 0;
+}
+
+bool CheckPCLMULQDQTechnology(void)
+{
+	// bit 1 is set for carry-less multiply
+	return ( GetCPUIDFeaturesECX() & 0x00000002 ) != 0;
+}
+
 #pragma optimize( "", on )
 
 #endif // _WIN32
@@ -0,0 +1,396 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Work stealing fork/join task scheduler.
+//
+//=============================================================================
+
+#include "tier1/taskscheduler.h"
+#include "tier1/threadexit.h"
+#include "vstdlib/jobthread.h"
+#include "tier0/memalloc.h"
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+// Failed attempts to find work before a borrowed pool thread goes back to the pool
+#define TASK_WORKER_IDLE_SPINS		2000
+
+// Failed attempts in Wait before yielding the time slice
+#define TASK_WAIT_SPINS_BEFORE_YIELD	256
+
+COMPILE_TIME_ASSERT( ( TASK_DEQUE_SIZE & ( TASK_DEQUE_SIZE - 1 ) ) == 0 );
+
+CTaskScheduler g_TaskScheduler;
+
+
+//-----------------------------------------------------------------------------
+// Chase-Lev work stealing deque with a fixed capacity. Only the owning thread
+// calls Push and Pop, any thread can Steal. Indices only ever increase and
+// are compared by difference, so wrapping around is harmless.
+//-----------------------------------------------------------------------------
+class CTaskDeque
+{
+public:
+	void Init( CTaskScheduler *pScheduler )
+	{
+		m_pScheduler = pScheduler;
+		m_nTop = 0;
+		m_nBottom = 0;
+	}
+
+	CTaskScheduler *GetScheduler() const
+	{
+		return m_pScheduler;
+	}
+
+	int Count() const
+	{
+		return m_nBottom - m_nTop;
+	}
+
+	bool Push( CTask *pTask )
+	{
+		int nBottom = m_nBottom;
+		if ( nBottom - m_nTop >= TASK_DEQUE_SIZE )
+			return false;
+
+		m_pTasks[ nBottom & ( TASK_DEQUE_SIZE - 1 ) ] = pTask;
+
+		// The task has to be visible before the new bottom
+		ThreadMemoryBarrier();
+		m_nBottom = nBottom + 1;
+		return true;
+	}
+
+	CTask *Pop()
+	{
+		int nBottom = m_nBottom - 1;
+
+		// Full barrier: the new bottom must be visible to thieves before we read the top
+		ThreadInterlockedExchange( &m_nBottom, nBottom );
+
+		int nTop = m_nTop;
+		int nCount = nBottom - nTop;
+		if ( nCount < 0 )
+		{
+			m_nBottom = nBottom + 1;
+			return NULL;
+		}
+
+		CTask *pTask = m_pTasks[ nBottom & ( TASK_DEQUE_SIZE - 1 ) ];
+		if ( nCount > 0 )
+			return pTask;
+
+		// Last task, race the thieves for it
+		if ( !ThreadInterlockedAssignIf( &m_nTop, nTop + 1, nTop ) )
+		{
+			pTask = NULL;
+		}
+		m_nBottom = nTop + 1;
+		return pTask;
+	}
+
+	CTask *Steal()
+	{
+		int nTop = m_nTop;
+		ThreadMemoryBarrier();
+		int nBottom = m_nBottom;
+		if ( nBottom - nTop <= 0 )
+			return NULL;
+
+		CTask *pTask = m_pTasks[ nTop & ( TASK_DEQUE_SIZE - 1 ) ];
+		if ( !ThreadInterlockedAssignIf( &m_nTop, nTop + 1, nTop ) )
+			return NULL;
+
+		return pTask;
+	}
+
+private:
+	// Thieves hammer the top, keep the owner's bottom on its own cache line
+	int volatile	m_nTop;
+	char			m_Pad0[ 64 - sizeof( int ) ];
+	int volatile	m_nBottom;
+	char			m_Pad1[ 64 - sizeof( int ) ];
+	CTask			*m_pTasks[ TASK_DEQUE_SIZE ];
+	CTaskScheduler	*m_pScheduler;
+};
+
+
+//-----------------------------------------------------------------------------
+// CTaskGroup
+//-----------------------------------------------------------------------------
+CTaskGroup::CTaskGroup( CTaskScheduler *pScheduler )
+{
+	m_pScheduler = pScheduler ? pScheduler : &g_TaskScheduler;
+	m_nPending = 0;
+}
+
+CTaskGroup::~CTaskGroup()
+{
+	// Tasks may point back at us, never leave any running
+	Wait();
+}
+
+void CTaskGroup::Run( CTask *pTask )
+{
+	++m_nPending;
+	m_pScheduler->Spawn( pTask, this );
+}
+
+void CTaskGroup::Wait()
+{
+	int nSpins = 0;
+	while ( m_nPending != 0 )
+	{
+		if ( m_pScheduler->ExecuteOne() )
+		{
+			nSpins = 0;
+			continue;
+		}
+
+		// Whatever is left is running on other threads
+		if ( ++nSpins < TASK_WAIT_SPINS_BEFORE_YIELD )
+		{
+			ThreadPause();
+		}
+		else
+		{
+			ThreadSleep( 0 );
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// CTaskScheduler
+//-----------------------------------------------------------------------------
+CTaskScheduler::CTaskScheduler( IThreadPool *pThreadPool )
+{
+	m_pThreadPool = pThreadPool;
+	m_pDeques = (CTaskDeque *)MemAlloc_AllocAligned( TASK_SCHEDULER_MAX_THREADS * sizeof( CTaskDeque ), 64 );
+	for ( int i = 0; i < TASK_SCHEDULER_MAX_THREADS; i++ )
+	{
+		m_pDeques[i].Init( this );
+		m_bDequeInUse[i] = false;
+	}
+	m_nDeques = 0;
+	m_nActiveWorkers = 0;
+}
+
+CTaskScheduler::~CTaskScheduler()
+{
+	// Borrowed pool threads may still be looking for work
+	while ( m_nActiveWorkers != 0 )
+	{
+		ThreadSleep( 1 );
+	}
+	for ( int i = 0; i < TASK_SCHEDULER_MAX_THREADS; i++ )
+	{
+		ThreadRemoveExitCallbacks( &m_pDeques[i] );
+	}
+	MemAlloc_FreeAligned( m_pDeques );
+}
+
+IThreadPool *CTaskScheduler::GetThreadPool()
+{
+	return m_pThreadPool ? m_pThreadPool : g_pThreadPool;
+}
+
+int CTaskScheduler::NumWorkers()
+{
+	IThreadPool *pThreadPool = GetThreadPool();
+	int nWorkers = 1 + ( pThreadPool ? pThreadPool->NumThreads() : 0 );
+	return MIN( nWorkers, TASK_SCHEDULER_MAX_THREADS );
+}
+
+//-----------------------------------------------------------------------------
+// Only threads that spawn get a deque, threads that just run tasks steal.
+// The deque goes back when the thread exits.
+//-----------------------------------------------------------------------------
+CTaskDeque *CTaskScheduler::GetThreadDeque()
+{
+	CTaskDeque *pDeque = m_pThreadDeque;
+	if ( pDeque )
+		return pDeque;
+
+	{
+		AUTO_LOCK( m_DequeMutex );
+		for ( int i = 0; i < TASK_SCHEDULER_MAX_THREADS && !pDeque; i++ )
+		{
+			if ( !m_bDequeInUse[i] )
+			{
+				m_bDequeInUse[i] = true;
+				if ( i >= m_nDeques )
+				{
+					m_nDeques = i + 1;
+				}
+				pDeque = &m_pDeques[i];
+				m_pThreadDeque = pDeque;
+			}
+		}
+	}
+
+	// Out of deques, this thread will run whatever it spawns itself
+	if ( pDeque )
+	{
+		ThreadAddExitCallback( &CTaskScheduler::ThreadExit, pDeque );
+	}
+	return pDeque;
+}
+
+void CTaskScheduler::ThreadExit( void *pDeque )
+{
+	// m_pThreadDeque may already be cleared
+	( (CTaskDeque *)pDeque )->GetScheduler()->ReleaseDeque( (CTaskDeque *)pDeque );
+}
+
+void CTaskScheduler::ReleaseThreadDeque()
+{
+	CTaskDeque *pDeque = m_pThreadDeque;
+	if ( !pDeque )
+		return;
+
+	ThreadRemoveExitCallback( &CTaskScheduler::ThreadExit, pDeque );
+	ReleaseDeque( pDeque );
+}
+
+void CTaskScheduler::ReleaseDeque( CTaskDeque *pDeque )
+{
+	// Anything still queued would be lost
+	CTask *pTask;
+	while ( ( pTask = pDeque->Pop() ) != NULL )
+	{
+		RunTask( pTask );
+	}
+	Assert( pDeque->Count() == 0 );
+
+	AUTO_LOCK( m_DequeMutex );
+	m_bDequeInUse[ pDeque - m_pDeques ] = false;
+	m_pThreadDeque = (CTaskDeque *)NULL;
+}
+
+void CTaskScheduler::Spawn( CTask *pTask, CTaskGroup *pGroup )
+{
+	pTask->m_pGroup = pGroup;
+
+	CTaskDeque *pDeque = GetThreadDeque();
+	if ( !pDeque || !pDeque->Push( pTask ) )
+	{
+		RunTask( pTask );
+		return;
+	}
+
+	WakeWorker();
+}
+
+void CTaskScheduler::RunTask( CTask *pTask )
+{
+	// The task may be gone as soon as its group is done
+	CTaskGroup *pGroup = pTask->m_pGroup;
+	pTask->Run();
+	--pGroup->m_nPending;
+}
+
+CTask *CTaskScheduler::FindTask( CTaskDeque *pOwnDeque )
+{
+	if ( pOwnDeque )
+	{
+		CTask *pTask = pOwnDeque->Pop();
+		if ( pTask )
+			return pTask;
+	}
+
+	// Start right after our own deque so the thieves don't all go for the same one
+	int nDeques = m_nDeques;
+	int iStart = pOwnDeque ? ( pOwnDeque - m_pDeques ) + 1 : 0;
+	for ( int i = 0; i < nDeques; i++ )
+	{
+		CTaskDeque *pVictim = &m_pDeques[ ( iStart + i ) % nDeques ];
+		if ( pVictim == pOwnDeque )
+			continue;
+
+		CTask *pTask = pVictim->Steal();
+		if ( pTask )
+			return pTask;
+	}
+
+	return NULL;
+}
+
+bool CTaskScheduler::ExecuteOne()
+{
+	CTask *pTask = FindTask( m_pThreadDeque );
+	if ( !pTask )
+		return false;
+
+	RunTask( pTask );
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------
+// Pool threads are borrowed one at a time while there is work to steal, and
+// go back to the pool once they can't find any.
+//-----------------------------------------------------------------------------
+void CTaskScheduler::WakeWorker()
+{
+	IThreadPool *pThreadPool = GetThreadPool();
+	if ( !pThreadPool )
+		return;
+
+	int nActive = m_nActiveWorkers;
+	int nMaxWorkers = NumWorkers() - 1;
+	if ( nActive >= nMaxWorkers || !pThreadPool->NumIdleThreads() )
+		return;
+
+	if ( !m_nActiveWorkers.AssignIf( nActive, nActive + 1 ) )
+		return;
+
+	pThreadPool->QueueCall( this, &CTaskScheduler::WorkerLoop )->Release();
+}
+
+void CTaskScheduler::WorkerLoop()
+{
+	tmZone( TELEMETRY_LEVEL0, TMZF_NONE, "CTaskScheduler::WorkerLoop" );
+
+	int nIdle = 0;
+	while ( nIdle < TASK_WORKER_IDLE_SPINS )
+	{
+		if ( ExecuteOne() )
+		{
+			nIdle = 0;
+		}
+		else
+		{
+			nIdle++;
+			ThreadPause();
+		}
+	}
+
+	--m_nActiveWorkers;
+}
+
+
+//-----------------------------------------------------------------------------
+// ParallelFor over a function pointer
+//-----------------------------------------------------------------------------
+class CParallelForCallbackBody
+{
+public:
+	CParallelForCallbackBody( ParallelForFunc_t pfnBody, void *pContext ) : m_pfnBody( pfnBody ), m_pContext( pContext ) {}
+
+	void operator()( int i )
+	{
+		m_pfnBody( i, m_pContext );
+	}
+
+private:
+	ParallelForFunc_t m_pfnBody;
+	void *m_pContext;
+};
+
+void ParallelForCallback( int nCount, ParallelForFunc_t pfnBody, void *pContext )
+{
+	CParallelForCallbackBody body( pfnBody, pContext );
+	ParallelFor( 0, nCount, body );
+}
@@ -0,0 +1,273 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Cleanup callbacks run when a thread exits.
+//
+//=============================================================================
+
+#if defined( _WIN32 ) && !defined( _X360 )
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined( POSIX )
+#include <pthread.h>
+#endif
+
+#include "tier0/dbg.h"
+#include "tier0/threadtools.h"
+#include "tier1/threadexit.h"
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+struct ThreadExitCallback_t
+{
+	ThreadExitFunc_t		m_pfnExit;
+	void					*m_pContext;
+	ThreadExitCallback_t	*m_pNext;
+};
+
+// The callbacks of one thread. Every thread's list is linked up so
+// ThreadRemoveExitCallbacks can get to all of them.
+struct ThreadExitList_t
+{
+	ThreadExitCallback_t	*m_pCallbacks;
+	ThreadExitList_t		*m_pPrev;
+	ThreadExitList_t		*m_pNext;
+};
+
+// Guards every list and the slot setup
+static CThreadFastMutex s_ThreadExitMutex;
+static ThreadExitList_t *s_pThreadExitLists;
+static bool s_bThreadExitInitialized;
+static bool s_bThreadExitAvailable;
+
+// Set while this module goes away, it's too late to run anything then
+static bool volatile s_bThreadExitShutdown;
+
+static void RunThreadExitCallbacks( void *pList );
+
+
+//-----------------------------------------------------------------------------
+// The per thread slot. pthread keys and fiber local storage both call a
+// destructor for a thread's value when it exits.
+//-----------------------------------------------------------------------------
+#if defined( _WIN32 ) && !defined( _X360 )
+
+typedef VOID (WINAPI *FlsCallback_t)( PVOID );
+typedef DWORD (WINAPI *FlsAllocFunc_t)( FlsCallback_t );
+typedef BOOL (WINAPI *FlsFreeFunc_t)( DWORD );
+typedef PVOID (WINAPI *FlsGetValueFunc_t)( DWORD );
+typedef BOOL (WINAPI *FlsSetValueFunc_t)( DWORD, PVOID );
+
+static FlsFreeFunc_t s_pfnFlsFree;
+static FlsGetValueFunc_t s_pfnFlsGetValue;
+static FlsSetValueFunc_t s_pfnFlsSetValue;
+static DWORD s_nThreadExitSlot;
+
+static VOID WINAPI ThreadExitFlsCallback( PVOID pList )
+{
+	RunThreadExitCallbacks( pList );
+}
+
+static bool InitThreadExitSlot()
+{
+	// Not on XP, look them up at run time
+	HMODULE hKernel = GetModuleHandleA( "kernel32.dll" );
+	FlsAllocFunc_t pfnFlsAlloc = (FlsAllocFunc_t)GetProcAddress( hKernel, "FlsAlloc" );
+	s_pfnFlsFree = (FlsFreeFunc_t)GetProcAddress( hKernel, "FlsFree" );
+	s_pfnFlsGetValue = (FlsGetValueFunc_t)GetProcAddress( hKernel, "FlsGetValue" );
+	s_pfnFlsSetValue = (FlsSetValueFunc_t)GetProcAddress( hKernel, "FlsSetValue" );
+	if ( !pfnFlsAlloc || !s_pfnFlsFree || !s_pfnFlsGetValue || !s_pfnFlsSetValue )
+		return false;
+
+	s_nThreadExitSlot = pfnFlsAlloc( ThreadExitFlsCallback );
+	return s_nThreadExitSlot != TLS_OUT_OF_INDEXES;	// Same value as FLS_OUT_OF_INDEXES, which older SDKs lack
+}
+
+static void FreeThreadExitSlot()
+{
+	s_pfnFlsFree( s_nThreadExitSlot );
+}
+
+static ThreadExitList_t *GetThreadExitSlot()
+{
+	return (ThreadExitList_t *)s_pfnFlsGetValue( s_nThreadExitSlot );
+}
+
+static void SetThreadExitSlot( ThreadExitList_t *pList )
+{
+	s_pfnFlsSetValue( s_nThreadExitSlot, pList );
+}
+
+#elif defined( POSIX )
+
+static pthread_key_t s_ThreadExitSlot;
+
+static bool InitThreadExitSlot()
+{
+	return pthread_key_create( &s_ThreadExitSlot, RunThreadExitCallbacks ) == 0;
+}
+
+static void FreeThreadExitSlot()
+{
+	pthread_key_delete( s_ThreadExitSlot );
+}
+
+static ThreadExitList_t *GetThreadExitSlot()
+{
+	return (ThreadExitList_t *)pthread_getspecific( s_ThreadExitSlot );
+}
+
+static void SetThreadExitSlot( ThreadExitList_t *pList )
+{
+	pthread_setspecific( s_ThreadExitSlot, pList );
+}
+
+#else
+
+static bool InitThreadExitSlot()						{ return false; }
+static void FreeThreadExitSlot()						{}
+static ThreadExitList_t *GetThreadExitSlot()			{ return NULL; }
+static void SetThreadExitSlot( ThreadExitList_t * )	{}
+
+#endif
+
+// The slot's destructor would point into this module after it's unloaded
+class CThreadExitShutdown
+{
+public:
+	~CThreadExitShutdown()
+	{
+		AUTO_LOCK( s_ThreadExitMutex );
+		s_bThreadExitShutdown = true;
+		if ( s_bThreadExitAvailable )
+		{
+			FreeThreadExitSlot();
+			s_bThreadExitAvailable = false;
+		}
+	}
+};
+static CThreadExitShutdown s_ThreadExitShutdown;
+
+
+//-----------------------------------------------------------------------------
+// Runs on the exiting thread
+//-----------------------------------------------------------------------------
+static void RunThreadExitCallbacks( void *pData )
+{
+	ThreadExitList_t *pList = (ThreadExitList_t *)pData;
+	while ( pList && !s_bThreadExitShutdown )
+	{
+		ThreadExitCallback_t *pCallbacks;
+		{
+			AUTO_LOCK( s_ThreadExitMutex );
+			if ( pList->m_pPrev )
+			{
+				pList->m_pPrev->m_pNext = pList->m_pNext;
+			}
+			else
+			{
+				s_pThreadExitLists = pList->m_pNext;
+			}
+			if ( pList->m_pNext )
+			{
+				pList->m_pNext->m_pPrev = pList->m_pPrev;
+			}
+			pCallbacks = pList->m_pCallbacks;
+			if ( s_bThreadExitAvailable )
+			{
+				SetThreadExitSlot( NULL );
+			}
+		}
+		delete pList;
+
+		while ( pCallbacks )
+		{
+			ThreadExitCallback_t *pNext = pCallbacks->m_pNext;
+			pCallbacks->m_pfnExit( pCallbacks->m_pContext );
+			delete pCallbacks;
+			pCallbacks = pNext;
+		}
+
+		// The callbacks may have set up something new on the way out
+		AUTO_LOCK( s_ThreadExitMutex );
+		pList = s_bThreadExitAvailable ? GetThreadExitSlot() : NULL;
+	}
+}
+
+bool ThreadAddExitCallback( ThreadExitFunc_t pfnExit, void *pContext )
+{
+	AUTO_LOCK( s_ThreadExitMutex );
+	if ( !s_bThreadExitInitialized )
+	{
+		s_bThreadExitInitialized = true;
+		s_bThreadExitAvailable = InitThreadExitSlot();
+	}
+
+	if ( !s_bThreadExitAvailable )
+		return false;
+
+	ThreadExitList_t *pList = GetThreadExitSlot();
+	if ( !pList )
+	{
+		pList = new ThreadExitList_t;
+		pList->m_pCallbacks = NULL;
+		pList->m_pPrev = NULL;
+		pList->m_pNext = s_pThreadExitLists;
+		if ( s_pThreadExitLists )
+		{
+			s_pThreadExitLists->m_pPrev = pList;
+		}
+		s_pThreadExitLists = pList;
+		SetThreadExitSlot( pList );
+	}
+
+	ThreadExitCallback_t *pCallback = new ThreadExitCallback_t;
+	pCallback->m_pfnExit = pfnExit;
+	pCallback->m_pContext = pContext;
+	pCallback->m_pNext = pList->m_pCallbacks;
+	pList->m_pCallbacks = pCallback;
+	return true;
+}
+
+// Unlinks and frees the matching callbacks of one list, any function if pfnExit is NULL
+static void RemoveThreadExitCallbacks( ThreadExitList_t *pList, ThreadExitFunc_t pfnExit, void *pContext )
+{
+	ThreadExitCallback_t **ppCallback = &pList->m_pCallbacks;
+	while ( *ppCallback )
+	{
+		ThreadExitCallback_t *pCallback = *ppCallback;
+		if ( pCallback->m_pContext == pContext && ( !pfnExit || pCallback->m_pfnExit == pfnExit ) )
+		{
+			*ppCallback = pCallback->m_pNext;
+			delete pCallback;
+		}
+		else
+		{
+			ppCallback = &pCallback->m_pNext;
+		}
+	}
+}
+
+void ThreadRemoveExitCallback( ThreadExitFunc_t pfnExit, void *pContext )
+{
+	Assert( pfnExit );
+
+	AUTO_LOCK( s_ThreadExitMutex );
+	if ( !s_bThreadExitAvailable )
+		return;
+
+	ThreadExitList_t *pList = GetThreadExitSlot();
+	if ( pList )
+	{
+		RemoveThreadExitCallbacks( pList, pfnExit, pContext );
+	}
+}
+
+void ThreadRemoveExitCallbacks( void *pContext )
+{
+	AUTO_LOCK( s_ThreadExitMutex );
+	for ( ThreadExitList_t *pList = s_pThreadExitLists; pList; pList = pList->m_pNext )
+	{
+		RemoveThreadExitCallbacks( pList, NULL, pContext );
+	}
+}
@@ -0,0 +1,384 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Binary serialization buffer made of a chain of memory segments.
+//
+//=============================================================================
+
+#include "tier1/utlsegmentedbuffer.h"
+#include "tier1/utlbuffer.h"
+#include "filesystem.h"
+#include "tier0/dbg.h"
+
+#ifdef POSIX
+#include <sys/uio.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+#elif defined( _WIN32 )
+#include <io.h>
+#endif
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+// Smallest owned segment we'll allocate for copying puts
+#define SEGMENTED_BUFFER_MIN_GROW_SIZE	4096
+
+#ifdef POSIX
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+COMPILE_TIME_ASSERT( sizeof( UtlBufferSegment_t ) == sizeof( struct iovec ) );
+#endif
+
+
+CUtlSegmentedBuffer::CUtlSegmentedBuffer( int nGrowSize )
+{
+	m_nGrowSize = MAX( nGrowSize, SEGMENTED_BUFFER_MIN_GROW_SIZE );
+	m_nPut = 0;
+	m_nGet = 0;
+	m_iGetSegment = 0;
+	m_nGetSegmentOffset = 0;
+	m_bGetOverflow = false;
+}
+
+CUtlSegmentedBuffer::~CUtlSegmentedBuffer()
+{
+	FreeSegments( 0 );
+}
+
+void CUtlSegmentedBuffer::FreeSegments( int nFirst )
+{
+	for ( int i = nFirst; i < m_Segments.Count(); i++ )
+	{
+		delete m_Segments[i].m_pMemory;
+	}
+	m_Segments.RemoveMultipleFromTail( m_Segments.Count() - nFirst );
+}
+
+CUtlSegmentedBuffer::Segment_t &CUtlSegmentedBuffer::AddSegment()
+{
+	Segment_t &segment = m_Segments[ m_Segments.AddToTail() ];
+	segment.m_pData = NULL;
+	segment.m_nSize = 0;
+	segment.m_nCapacity = 0;
+	segment.m_pMemory = NULL;
+	return segment;
+}
+
+
+//-----------------------------------------------------------------------------
+// Clears the contents. The first owned segment is kept to avoid reallocating
+// when the buffer is reused for the next message.
+//-----------------------------------------------------------------------------
+void CUtlSegmentedBuffer::Clear()
+{
+	int iKeep = -1;
+	for ( int i = 0; i < m_Segments.Count(); i++ )
+	{
+		if ( m_Segments[i].m_nCapacity )
+		{
+			iKeep = i;
+			break;
+		}
+	}
+
+	if ( iKeep > 0 )
+	{
+		V_swap( m_Segments[0], m_Segments[iKeep] );
+	}
+	FreeSegments( iKeep >= 0 ? 1 : 0 );
+
+	if ( m_Segments.Count() )
+	{
+		m_Segments[0].m_nSize = 0;
+	}
+
+	m_nPut = 0;
+	m_nGet = 0;
+	m_iGetSegment = 0;
+	m_nGetSegmentOffset = 0;
+	m_bGetOverflow = false;
+}
+
+void CUtlSegmentedBuffer::Purge()
+{
+	Clear();
+	FreeSegments( 0 );
+	m_Segments.Purge();
+}
+
+
+//-----------------------------------------------------------------------------
+// Puts
+//-----------------------------------------------------------------------------
+void CUtlSegmentedBuffer::PutExternal( const void *pMem, int nSize )
+{
+	if ( nSize <= 0 )
+		return;
+
+	Segment_t &segment = AddSegment();
+	segment.m_pData = (uint8 *)pMem;
+	segment.m_nSize = nSize;
+	m_nPut += nSize;
+}
+
+void CUtlSegmentedBuffer::PutBuffer( CUtlBuffer &buf )
+{
+	Assert( !buf.IsText() );
+
+	int nStart = buf.TellGet();
+	int nSize = buf.TellPut() - nStart;
+	if ( nSize <= 0 )
+	{
+		buf.Clear();
+		return;
+	}
+
+	// Small buffers aren't worth a segment of their own
+	if ( nSize < m_nGrowSize / 4 )
+	{
+		Put( buf.PeekGet(), nSize );
+		buf.Clear();
+		return;
+	}
+
+	CUtlMemory<uint8> *pMemory = new CUtlMemory<uint8>;
+	buf.Swap( *pMemory );
+
+	Segment_t &segment = AddSegment();
+	segment.m_pData = pMemory->Base() + nStart;
+	segment.m_nSize = nSize;
+	segment.m_pMemory = pMemory;
+
+	// Externally allocated memory isn't ours to append to
+	if ( !pMemory->IsExternallyAllocated() )
+	{
+		segment.m_nCapacity = pMemory->NumAllocated() - nStart;
+	}
+
+	m_nPut += nSize;
+	buf.Clear();
+}
+
+void CUtlSegmentedBuffer::Put( const void *pMem, int nSize )
+{
+	const uint8 *pSrc = (const uint8 *)pMem;
+	while ( nSize > 0 )
+	{
+		Segment_t *pSegment = m_Segments.Count() ? &m_Segments.Tail() : NULL;
+		if ( !pSegment || pSegment->m_nSize >= pSegment->m_nCapacity )
+		{
+			int nCapacity = MAX( m_nGrowSize, nSize );
+			pSegment = &AddSegment();
+			pSegment->m_pMemory = new CUtlMemory<uint8>( 0, nCapacity );
+			pSegment->m_pData = pSegment->m_pMemory->Base();
+			pSegment->m_nCapacity = nCapacity;
+		}
+
+		int nCopy = MIN( nSize, pSegment->m_nCapacity - pSegment->m_nSize );
+		memcpy( pSegment->m_pData + pSegment->m_nSize, pSrc, nCopy );
+		pSegment->m_nSize += nCopy;
+		m_nPut += nCopy;
+		pSrc += nCopy;
+		nSize -= nCopy;
+	}
+}
+
+void CUtlSegmentedBuffer::PutString( const char *pString )
+{
+	if ( !pString )
+	{
+		pString = "";
+	}
+	Put( pString, V_strlen( pString ) + 1 );
+}
+
+
+//-----------------------------------------------------------------------------
+// Gets
+//-----------------------------------------------------------------------------
+void CUtlSegmentedBuffer::AdvanceGet( int nBytes )
+{
+	m_nGet += nBytes;
+	m_nGetSegmentOffset += nBytes;
+	while ( m_iGetSegment < m_Segments.Count() && m_nGetSegmentOffset >= m_Segments[m_iGetSegment].m_nSize )
+	{
+		// Stay at the end of the last segment so later puts into it are picked up
+		if ( m_iGetSegment == m_Segments.Count() - 1 && m_nGetSegmentOffset == m_Segments[m_iGetSegment].m_nSize )
+			break;
+
+		m_nGetSegmentOffset -= m_Segments[m_iGetSegment].m_nSize;
+		m_iGetSegment++;
+	}
+}
+
+void CUtlSegmentedBuffer::Get( void *pMem, int nSize )
+{
+	if ( nSize > GetBytesRemaining() )
+	{
+		m_bGetOverflow = true;
+		memset( pMem, 0, nSize );
+		return;
+	}
+
+	uint8 *pDest = (uint8 *)pMem;
+	while ( nSize > 0 )
+	{
+		const Segment_t &segment = m_Segments[m_iGetSegment];
+		int nCopy = MIN( nSize, segment.m_nSize - m_nGetSegmentOffset );
+		if ( nCopy == 0 )
+		{
+			// At the end of this segment and the data continues in the next
+			m_iGetSegment++;
+			m_nGetSegmentOffset = 0;
+			continue;
+		}
+
+		memcpy( pDest, segment.m_pData + m_nGetSegmentOffset, nCopy );
+		pDest += nCopy;
+		nSize -= nCopy;
+		AdvanceGet( nCopy );
+	}
+}
+
+void CUtlSegmentedBuffer::GetString( char *pString, int nMaxChars )
+{
+	Assert( nMaxChars > 0 );
+
+	int nLen = 0;
+	bool bTerminated = false;
+	while ( GetBytesRemaining() > 0 )
+	{
+		char c = GetChar();
+		if ( c == '\0' )
+		{
+			bTerminated = true;
+			break;
+		}
+		if ( nLen < nMaxChars - 1 )
+		{
+			pString[nLen++] = c;
+		}
+	}
+	pString[nLen] = '\0';
+
+	if ( !bTerminated )
+	{
+		m_bGetOverflow = true;
+	}
+}
+
+void CUtlSegmentedBuffer::SeekGet( int nOffset )
+{
+	if ( nOffset < 0 || nOffset > m_nPut )
+	{
+		m_bGetOverflow = true;
+		return;
+	}
+
+	m_bGetOverflow = false;
+	if ( nOffset < m_nGet )
+	{
+		m_nGet = 0;
+		m_iGetSegment = 0;
+		m_nGetSegmentOffset = 0;
+	}
+	AdvanceGet( nOffset - m_nGet );
+}
+
+
+//-----------------------------------------------------------------------------
+// Scatter/gather access
+//-----------------------------------------------------------------------------
+int CUtlSegmentedBuffer::GetSegmentCount() const
+{
+	int nCount = 0;
+	for ( int i = m_iGetSegment; i < m_Segments.Count(); i++ )
+	{
+		int nStart = ( i == m_iGetSegment ) ? m_nGetSegmentOffset : 0;
+		if ( m_Segments[i].m_nSize > nStart )
+		{
+			nCount++;
+		}
+	}
+	return nCount;
+}
+
+int CUtlSegmentedBuffer::GetSegments( UtlBufferSegment_t *pSegments, int nMaxSegments ) const
+{
+	int nCount = 0;
+	for ( int i = m_iGetSegment; i < m_Segments.Count() && nCount < nMaxSegments; i++ )
+	{
+		int nStart = ( i == m_iGetSegment ) ? m_nGetSegmentOffset : 0;
+		const Segment_t &segment = m_Segments[i];
+		if ( segment.m_nSize > nStart )
+		{
+			pSegments[nCount].m_pBase = segment.m_pData + nStart;
+			pSegments[nCount].m_nLength = segment.m_nSize - nStart;
+			nCount++;
+		}
+	}
+	return nCount;
+}
+
+void CUtlSegmentedBuffer::CopyTo( CUtlBuffer &buf ) const
+{
+	buf.EnsureCapacity( buf.TellPut() + GetBytesRemaining() );
+	for ( int i = m_iGetSegment; i < m_Segments.Count(); i++ )
+	{
+		int nStart = ( i == m_iGetSegment ) ? m_nGetSegmentOffset : 0;
+		const Segment_t &segment = m_Segments[i];
+		if ( segment.m_nSize > nStart )
+		{
+			buf.Put( segment.m_pData + nStart, segment.m_nSize - nStart );
+		}
+	}
+}
+
+bool CUtlSegmentedBuffer::WriteToFD( int fd )
+{
+#ifdef POSIX
+	struct iovec vecs[64];
+	while ( GetBytesRemaining() > 0 )
+	{
+		int nVecs = GetSegments( (UtlBufferSegment_t *)vecs, MIN( (int)ARRAYSIZE( vecs ), IOV_MAX ) );
+		ssize_t nWritten = writev( fd, vecs, nVecs );
+		if ( nWritten < 0 )
+		{
+			if ( errno == EINTR )
+				continue;
+			return false;
+		}
+		AdvanceGet( (int)nWritten );
+	}
+	return true;
+#elif defined( _WIN32 )
+	while ( GetBytesRemaining() > 0 )
+	{
+		UtlBufferSegment_t segment;
+		GetSegments( &segment, 1 );
+		int nWritten = _write( fd, segment.m_pBase, (unsigned int)segment.m_nLength );
+		if ( nWritten < 0 )
+			return false;
+		AdvanceGet( nWritten );
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool CUtlSegmentedBuffer::WriteToFile( IBaseFileSystem *pFileSystem, FileHandle_t hFile )
+{
+	while ( GetBytesRemaining() > 0 )
+	{
+		UtlBufferSegment_t segment;
+		GetSegments( &segment, 1 );
+		int nWritten = pFileSystem->Write( segment.m_pBase, (int)segment.m_nLength, hFile );
+		if ( nWritten <= 0 )
+			return false;
+		AdvanceGet( nWritten );
+	}
+	return true;
+}
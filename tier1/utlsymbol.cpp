@@ -17,6 +17,7 @@
 #include "stringpool.h"
 #include "utlhashtable.h"
 #include "utlstring.h"
+#include "generichash.h"
 
 // Ensure that everybody has the right compiler version installed. The version
 // number can be obtained by looking at the compiler output when you type 'cl'
@@ -291,6 +292,197 @@ void CUtlSymbolTable::RemoveAll()
 
 
 
+//-----------------------------------------------------------------------------
+// CUtlSymbolTableLockFree
+//-----------------------------------------------------------------------------
+
+#define SYMBOL_HASH_TAG_MASK	0xFFFF0000
+
+CUtlSymbolTableLockFree::CUtlSymbolTableLockFree( int growSize, int initSize, bool caseInsensitive )
+{
+	// Keep the hash table at most half full
+	int nSlots = 64;
+	while ( nSlots < initSize * 2 )
+	{
+		nSlots *= 2;
+	}
+
+	m_pTable = AllocTable( nSlots );
+	memset( (void *)m_pSymbolBlocks, 0, sizeof( m_pSymbolBlocks ) );
+	m_nSymbols = 0;
+	m_bInsensitive = caseInsensitive;
+	m_pStringPools = NULL;
+}
+
+CUtlSymbolTableLockFree::~CUtlSymbolTableLockFree()
+{
+	HashTable_t *pTable = m_pTable;
+	while ( pTable )
+	{
+		HashTable_t *pRetired = pTable->m_pRetired;
+		free( pTable );
+		pTable = pRetired;
+	}
+
+	for ( int i = 0; i < MAX_SYMBOL_BLOCKS; i++ )
+	{
+		free( (void *)m_pSymbolBlocks[i] );
+	}
+
+	StringPool_t *pPool = m_pStringPools;
+	while ( pPool )
+	{
+		StringPool_t *pNext = pPool->m_pNext;
+		free( pPool );
+		pPool = pNext;
+	}
+}
+
+uint32 CUtlSymbolTableLockFree::HashSymbolString( const char *pString ) const
+{
+	return FastHashFold32( m_bInsensitive ? FastHashString64Caseless( pString ) : FastHashString64( pString ) );
+}
+
+UtlSymId_t CUtlSymbolTableLockFree::FindInTable( const HashTable_t *pTable, const char *pString, uint32 nHash ) const
+{
+	uint32 nTag = nHash & SYMBOL_HASH_TAG_MASK;
+	uint32 nMask = pTable->m_nMask;
+	for ( uint32 i = nHash & nMask; ; i = ( i + 1 ) & nMask )
+	{
+		uint32 nSlot = pTable->m_Slots[i];
+		if ( !nSlot )
+			return UTL_INVAL_SYMBOL;
+
+		if ( ( nSlot & SYMBOL_HASH_TAG_MASK ) != nTag )
+			continue;
+
+		UtlSymId_t id = (UtlSymId_t)( ( nSlot & ~SYMBOL_HASH_TAG_MASK ) - 1 );
+		const char *pSymbolString = String( id );
+		if ( m_bInsensitive ? !V_stricmp( pSymbolString, pString ) : !V_strcmp( pSymbolString, pString ) )
+			return id;
+	}
+}
+
+void CUtlSymbolTableLockFree::InsertIntoTable( HashTable_t *pTable, uint32 nHash, UtlSymId_t id )
+{
+	uint32 nMask = pTable->m_nMask;
+	uint32 i = nHash & nMask;
+	while ( pTable->m_Slots[i] )
+	{
+		i = ( i + 1 ) & nMask;
+	}
+
+	// A single store, readers either see the whole symbol or nothing
+	pTable->m_Slots[i] = ( nHash & SYMBOL_HASH_TAG_MASK ) | ( (uint32)id + 1 );
+}
+
+CUtlSymbolTableLockFree::HashTable_t *CUtlSymbolTableLockFree::AllocTable( int nSlots )
+{
+	HashTable_t *pTable = (HashTable_t *)malloc( sizeof( HashTable_t ) + ( nSlots - 1 ) * sizeof( uint32 ) );
+	pTable->m_pRetired = NULL;
+	pTable->m_nMask = nSlots - 1;
+	memset( (void *)pTable->m_Slots, 0, nSlots * sizeof( uint32 ) );
+	return pTable;
+}
+
+CUtlSymbolTableLockFree::HashTable_t *CUtlSymbolTableLockFree::GrowTable( HashTable_t *pTable )
+{
+	HashTable_t *pNewTable = AllocTable( ( pTable->m_nMask + 1 ) * 2 );
+	int nSymbols = m_nSymbols;
+	for ( int i = 0; i < nSymbols; i++ )
+	{
+		InsertIntoTable( pNewTable, HashSymbolString( String( (UtlSymId_t)i ) ), (UtlSymId_t)i );
+	}
+	pNewTable->m_pRetired = pTable;
+
+	// The new table has to be complete before readers can get to it
+	ThreadMemoryBarrier();
+	m_pTable = pNewTable;
+	return pNewTable;
+}
+
+char *CUtlSymbolTableLockFree::AllocString( int nLen )
+{
+	StringPool_t *pPool = m_pStringPools;
+	if ( !pPool || pPool->m_TotalLen - pPool->m_SpaceUsed < nLen )
+	{
+		// Whatever is left in the old pool is wasted, it's never more than a string's worth
+		int nPoolSize = V_max( nLen, MIN_STRING_POOL_SIZE );
+		pPool = (StringPool_t *)malloc( sizeof( StringPool_t ) + nPoolSize - 1 );
+		pPool->m_pNext = m_pStringPools;
+		pPool->m_TotalLen = nPoolSize;
+		pPool->m_SpaceUsed = 0;
+		m_pStringPools = pPool;
+	}
+
+	char *pString = &pPool->m_Data[pPool->m_SpaceUsed];
+	pPool->m_SpaceUsed += nLen;
+	return pString;
+}
+
+CUtlSymbol CUtlSymbolTableLockFree::Find( const char* pString ) const
+{
+	if ( !pString )
+		return CUtlSymbol();
+
+	return CUtlSymbol( FindInTable( m_pTable, pString, HashSymbolString( pString ) ) );
+}
+
+CUtlSymbol CUtlSymbolTableLockFree::AddString( const char* pString )
+{
+	if ( !pString )
+		return CUtlSymbol( UTL_INVAL_SYMBOL );
+
+	uint32 nHash = HashSymbolString( pString );
+	UtlSymId_t id = FindInTable( m_pTable, pString, nHash );
+	if ( id != UTL_INVAL_SYMBOL )
+		return CUtlSymbol( id );
+
+	AUTO_LOCK( m_lock );
+
+	// Someone else may have added it while we were waiting
+	HashTable_t *pTable = m_pTable;
+	id = FindInTable( pTable, pString, nHash );
+	if ( id != UTL_INVAL_SYMBOL )
+		return CUtlSymbol( id );
+
+	int nSymbols = m_nSymbols;
+	if ( nSymbols >= UTL_INVAL_SYMBOL )
+	{
+		AssertMsg( false, "CUtlSymbolTableLockFree is full\n" );
+		return CUtlSymbol( UTL_INVAL_SYMBOL );
+	}
+
+	if ( ( nSymbols + 1 ) * 2 > (int)( pTable->m_nMask + 1 ) )
+	{
+		pTable = GrowTable( pTable );
+	}
+
+	int len = V_strlen( pString ) + 1;
+	char *pCopy = AllocString( len );
+	memcpy( pCopy, pString, len );
+
+	int iBlock = nSymbols / SYMBOLS_PER_BLOCK;
+	if ( !m_pSymbolBlocks[iBlock] )
+	{
+		const char **pBlock = (const char **)malloc( SYMBOLS_PER_BLOCK * sizeof( const char * ) );
+		memset( pBlock, 0, SYMBOLS_PER_BLOCK * sizeof( const char * ) );
+		ThreadMemoryBarrier();
+		m_pSymbolBlocks[iBlock] = pBlock;
+	}
+	m_pSymbolBlocks[iBlock][ nSymbols % SYMBOLS_PER_BLOCK ] = pCopy;
+
+	// The string has to be reachable and the symbol counted before the symbol can be found
+	ThreadMemoryBarrier();
+	m_nSymbols = nSymbols + 1;
+	ThreadMemoryBarrier();
+	id = (UtlSymId_t)nSymbols;
+	InsertIntoTable( pTable, nHash, id );
+
+	return CUtlSymbol( id );
+}
+
+
 class CUtlFilenameSymbolTable::HashTable : public CUtlStableHashtable<CUtlConstString>
 {
 };
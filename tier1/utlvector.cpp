@@ -0,0 +1,163 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per call site growth statistics for CUtlVector, see UTLVECTOR_TRACK_GROWTH.
+//
+//=============================================================================//
+
+#include "tier0/dbg.h"
+#include "tier0/threadtools.h"
+#include "tier1/utlvector.h"
+#include "tier1/strtools.h"
+
+// The header only declares these when UTLVECTOR_TRACK_GROWTH is defined, but
+// they're always built so any module built with it can link against tier1.
+void UtlVector_TrackGrowth( int nRequested, int nBytesItem );
+void UtlVector_DumpGrowthStats( int nMaxCallSites );
+void UtlVector_ResetGrowthStats();
+
+#ifdef POSIX
+#include <execinfo.h>
+#else
+#include "tier0/stacktools.h"
+#endif
+
+// NOTE: This has to be the last file included!
+#include "tier0/memdbgon.h"
+
+// Frames kept per call site; the top ones are usually inlined CUtlVector code
+#define UTLVECTOR_GROWTH_STACK_DEPTH	6
+
+// Fixed size table so recording never allocates (and never grows a vector)
+#define UTLVECTOR_GROWTH_TABLE_SIZE		4096
+
+struct UtlVectorGrowthSite_t
+{
+	void	*m_pStack[UTLVECTOR_GROWTH_STACK_DEPTH];
+	int		m_nStackDepth;
+	int		m_nGrowths;
+	int		m_nMaxRequested;
+	int		m_nBytesItem;
+};
+
+static UtlVectorGrowthSite_t s_GrowthSites[UTLVECTOR_GROWTH_TABLE_SIZE];
+static int s_nDroppedGrowths;
+static CThreadFastMutex s_GrowthMutex;
+
+
+static int CaptureStack( void **pStack, int nMaxDepth )
+{
+#ifdef POSIX
+	void *pFrames[UTLVECTOR_GROWTH_STACK_DEPTH + 2];
+	int nFrames = backtrace( pFrames, ARRAYSIZE( pFrames ) );
+
+	// Skip CaptureStack and UtlVector_TrackGrowth
+	int nDepth = 0;
+	for ( int i = 2; i < nFrames && nDepth < nMaxDepth; i++ )
+	{
+		pStack[nDepth++] = pFrames[i];
+	}
+	return nDepth;
+#else
+	return GetCallStack( pStack, nMaxDepth, 2 );
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+// Records one reallocation of a vector to hold nRequested elements
+//-----------------------------------------------------------------------------
+void UtlVector_TrackGrowth( int nRequested, int nBytesItem )
+{
+	void *pStack[UTLVECTOR_GROWTH_STACK_DEPTH];
+	memset( pStack, 0, sizeof( pStack ) );
+	int nDepth = CaptureStack( pStack, UTLVECTOR_GROWTH_STACK_DEPTH );
+
+	uint32 nHash = 0;
+	for ( int i = 0; i < nDepth; i++ )
+	{
+		nHash = nHash * 31 + (uint32)( (uintp)pStack[i] >> 2 );
+	}
+
+	AUTO_LOCK( s_GrowthMutex );
+
+	// Open addressing, entries are never removed until a reset
+	for ( int nProbe = 0; nProbe < UTLVECTOR_GROWTH_TABLE_SIZE; nProbe++ )
+	{
+		UtlVectorGrowthSite_t &site = s_GrowthSites[ ( nHash + nProbe ) & ( UTLVECTOR_GROWTH_TABLE_SIZE - 1 ) ];
+		if ( site.m_nGrowths == 0 )
+		{
+			memcpy( site.m_pStack, pStack, sizeof( pStack ) );
+			site.m_nStackDepth = nDepth;
+			site.m_nGrowths = 1;
+			site.m_nMaxRequested = nRequested;
+			site.m_nBytesItem = nBytesItem;
+			return;
+		}
+
+		if ( site.m_nStackDepth == nDepth && site.m_nBytesItem == nBytesItem && !memcmp( site.m_pStack, pStack, sizeof( pStack ) ) )
+		{
+			site.m_nGrowths++;
+			site.m_nMaxRequested = MAX( site.m_nMaxRequested, nRequested );
+			return;
+		}
+	}
+
+	s_nDroppedGrowths++;
+}
+
+
+static int __cdecl GrowthSiteCompare( const void *pLeft, const void *pRight )
+{
+	const UtlVectorGrowthSite_t *pA = *(const UtlVectorGrowthSite_t * const *)pLeft;
+	const UtlVectorGrowthSite_t *pB = *(const UtlVectorGrowthSite_t * const *)pRight;
+	return pB->m_nGrowths - pA->m_nGrowths;
+}
+
+
+//-----------------------------------------------------------------------------
+// Prints the call sites which reallocated the most
+//-----------------------------------------------------------------------------
+void UtlVector_DumpGrowthStats( int nMaxCallSites )
+{
+	AUTO_LOCK( s_GrowthMutex );
+
+	// Static so dumping doesn't allocate either
+	static UtlVectorGrowthSite_t *s_pSorted[UTLVECTOR_GROWTH_TABLE_SIZE];
+	int nSites = 0;
+	for ( int i = 0; i < UTLVECTOR_GROWTH_TABLE_SIZE; i++ )
+	{
+		if ( s_GrowthSites[i].m_nGrowths )
+		{
+			s_pSorted[nSites++] = &s_GrowthSites[i];
+		}
+	}
+
+	qsort( s_pSorted, nSites, sizeof( s_pSorted[0] ), GrowthSiteCompare );
+
+	Msg( "CUtlVector growth: %d call sites, %d growths not recorded\n", nSites, s_nDroppedGrowths );
+	for ( int i = 0; i < nSites && i < nMaxCallSites; i++ )
+	{
+		const UtlVectorGrowthSite_t &site = *s_pSorted[i];
+		Msg( "  %6d growths, peak %6d elements of %d bytes\n", site.m_nGrowths, site.m_nMaxRequested, site.m_nBytesItem );
+
+#ifdef POSIX
+		char **ppSymbols = backtrace_symbols( site.m_pStack, site.m_nStackDepth );
+		for ( int j = 0; j < site.m_nStackDepth; j++ )
+		{
+			Msg( "      %s\n", ppSymbols ? ppSymbols[j] : "?" );
+		}
+		free( ppSymbols );
+#else
+		char szStack[2048];
+		TranslateStackInfo( site.m_pStack, site.m_nStackDepth, szStack, sizeof( szStack ), "\n      ", TSISTYLEFLAG_DEFAULT );
+		Msg( "      %s\n", szStack );
+#endif
+	}
+}
+
+void UtlVector_ResetGrowthStats()
+{
+	AUTO_LOCK( s_GrowthMutex );
+	memset( s_GrowthSites, 0, sizeof( s_GrowthSites ) );
+	s_nDroppedGrowths = 0;
+}